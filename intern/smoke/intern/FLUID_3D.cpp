@@ -400,30 +400,22 @@ void FLUID_3D::step(float dt, float gravity[3])
 	SWAP_POINTERS(_zVelocity, _zVelocityTemp);
 #if PARALLEL==1
 	}	// end of single
+	}	// end of parallel
 
-	#pragma omp barrier
-
-	#pragma omp for
-	for (int i=0; i<2; i++)
-	{
-		if (i==0)
-		{
-#endif
-			project();
-#if PARALLEL==1
-		}
-		else if (i==1)
-		{
+	/*
+	* The solvers run their own parallel loops over slabs,
+	* so they are called one after another here
+	*/
 #endif
-			if (_heat) {
-				diffuseHeat();
-			}
-#if PARALLEL==1
-		}
-	}
+	project();
 
-	#pragma omp barrier
+	if (_heat) {
+		diffuseHeat();
+	}
 
+#if PARALLEL==1
+	#pragma omp parallel
+	{
 	#pragma omp single
 	{
 #endif
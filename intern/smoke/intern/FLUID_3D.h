@@ -187,6 +187,8 @@ struct FLUID_3D
 		void diffuseColor();
 		void solvePressure(float* field, float* b, unsigned char* skip);
 		void solvePressurePre(float* field, float* b, unsigned char* skip);
+		void setupPreconditioner(float* precond, unsigned char* aplus, unsigned char* skip, int zBegin, int zEnd);
+		void applyPreconditioner(float* h, float* r, float* precond, unsigned char* aplus, int zBegin, int zEnd);
 		void solveHeat(float* field, float* b, unsigned char* skip);
 		void solveDiffusion(float* field, float* b, float* factor);
 
@@ -237,12 +239,14 @@ struct FLUID_3D
 		
 
 		// static advection functions, also used by WTURBULENCE
+		// xSpan optionally limits each row y + z * res[1] to the cells
+		// [xSpan[2 * row], xSpan[2 * row + 1]), the others are set to zero
 		static void advectFieldSemiLagrange(const float dt, const float* velx, const float* vely,  const float* velz,
-				float* oldField, float* newField, Vec3Int res, int zBegin, int zEnd);
+				float* oldField, float* newField, Vec3Int res, int zBegin, int zEnd, const int *xSpan = NULL);
 		static void advectFieldMacCormack1(const float dt, const float* xVelocity, const float* yVelocity, const float* zVelocity, 
-				float* oldField, float* tempResult, Vec3Int res, int zBegin, int zEnd);
+				float* oldField, float* tempResult, Vec3Int res, int zBegin, int zEnd, const int *xSpan = NULL);
 		static void advectFieldMacCormack2(const float dt, const float* xVelocity, const float* yVelocity, const float* zVelocity, 
-				float* oldField, float* newField, float* tempResult, float* temp1,Vec3Int res, const unsigned char* obstacles, int zBegin, int zEnd);
+				float* oldField, float* newField, float* tempResult, float* temp1,Vec3Int res, const unsigned char* obstacles, int zBegin, int zEnd, const int *xSpan = NULL);
 
 
 		// temp ones for testing
@@ -253,9 +257,9 @@ struct FLUID_3D
 
 		// maccormack helper functions
 		static void clampExtrema(const float dt, const float* xVelocity, const float* yVelocity,  const float* zVelocity,
-				float* oldField, float* newField, Vec3Int res, int zBegin, int zEnd);
+				float* oldField, float* newField, Vec3Int res, int zBegin, int zEnd, const int *xSpan = NULL);
 		static void clampOutsideRays(const float dt, const float* xVelocity, const float* yVelocity,  const float* zVelocity,
-				float* oldField, float* newField, Vec3Int res, const unsigned char* obstacles, const float *oldAdvection, int zBegin, int zEnd);
+				float* oldField, float* newField, Vec3Int res, const unsigned char* obstacles, const float *oldAdvection, int zBegin, int zEnd, const int *xSpan = NULL);
 
 
 
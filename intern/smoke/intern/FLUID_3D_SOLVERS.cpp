@@ -28,19 +28,41 @@
 //////////////////////////////////////////////////////////////////////
 
 #include "FLUID_3D.h"
+#include <algorithm>
 #include <cstring>
+#include <vector>
 #define SOLVER_ACCURACY 1e-06
+#define PRESSURE_ACCURACY 1e-02f	// relative to the initial residual
+
+// The solvers work on slabs of z layers in parallel. The number of slabs
+// only depends on the resolution, so the preconditioner, which is built per
+// slab, and the order in which dot products are summed up don't change with
+// the number of threads.
+#define SOLVER_SLAB_LAYERS 16
+
+static void solverSlabs(int zRes, vector<int> &bounds)
+{
+	const int layers = zRes - 2;
+	const int slabs = max(1, layers / SOLVER_SLAB_LAYERS);
+
+	bounds.resize(slabs + 1);
+	for (int s = 0; s <= slabs; s++)
+		bounds[s] = 1 + (s * layers) / slabs;
+}
 
 //////////////////////////////////////////////////////////////////////
 // solve the heat equation with CG
 //////////////////////////////////////////////////////////////////////
 void FLUID_3D::solveHeat(float* field, float* b, unsigned char* skip)
 {
-	int x, y, z;
 	const int twoxr = 2 * _xRes;
-	size_t index;
 	const float heatConst = _dt * _heatDiffusion / (_dx * _dx);
 	float *_q, *_residual, *_direction, *_Acenter;
+	vector<int> slab;
+
+	solverSlabs(_zRes, slab);
+	const int slabs = (int)slab.size() - 1;
+	vector<float> partialSum(slabs), partialMax(slabs);
 
 	// i = 0
 	int i = 0;
@@ -58,40 +80,50 @@ void FLUID_3D::solveHeat(float* field, float* b, unsigned char* skip)
 	float deltaNew = 0.0f;
 
   // r = b - Ax
-  index = _slabSize + _xRes + 1;
-  for (z = 1; z < _zRes - 1; z++, index += twoxr)
-    for (y = 1; y < _yRes - 1; y++, index += 2)
-      for (x = 1; x < _xRes - 1; x++, index++)
-      {
-        // if the cell is a variable
-        _Acenter[index] = 1.0f;
-        if (!skip[index])
+#if PARALLEL==1
+  #pragma omp parallel for schedule(static)
+#endif
+  for (int s = 0; s < slabs; s++)
+  {
+    float delta = 0.0f;
+    size_t index = (size_t)slab[s] * _slabSize + _xRes + 1;
+    for (int z = slab[s]; z < slab[s + 1]; z++, index += twoxr)
+      for (int y = 1; y < _yRes - 1; y++, index += 2)
+        for (int x = 1; x < _xRes - 1; x++, index++)
         {
-          // set the matrix to the Poisson stencil in order
-          if (!skip[index + 1]) _Acenter[index] += heatConst;
-          if (!skip[index - 1]) _Acenter[index] += heatConst;
-          if (!skip[index + _xRes]) _Acenter[index] += heatConst;
-          if (!skip[index - _xRes]) _Acenter[index] += heatConst;
-          if (!skip[index + _slabSize]) _Acenter[index] += heatConst;
-          if (!skip[index - _slabSize]) _Acenter[index] += heatConst;
-
-		  _residual[index] = b[index] - (_Acenter[index] * field[index] + 
-          field[index - 1] * (skip[index - 1] ? 0.0f : -heatConst) +
-          field[index + 1] * (skip[index + 1] ? 0.0f : -heatConst) +
-          field[index - _xRes] * (skip[index - _xRes] ? 0.0f : -heatConst) +
-          field[index + _xRes] * (skip[index + _xRes] ? 0.0f : -heatConst) +
-          field[index - _slabSize] * (skip[index - _slabSize] ? 0.0f : -heatConst) +
-          field[index + _slabSize] * (skip[index + _slabSize] ? 0.0f : -heatConst));
-        }
-		else
-		{
-        _residual[index] = 0.0f;
-		}
+          // if the cell is a variable
+          _Acenter[index] = 1.0f;
+          if (!skip[index])
+          {
+            // set the matrix to the Poisson stencil in order
+            if (!skip[index + 1]) _Acenter[index] += heatConst;
+            if (!skip[index - 1]) _Acenter[index] += heatConst;
+            if (!skip[index + _xRes]) _Acenter[index] += heatConst;
+            if (!skip[index - _xRes]) _Acenter[index] += heatConst;
+            if (!skip[index + _slabSize]) _Acenter[index] += heatConst;
+            if (!skip[index - _slabSize]) _Acenter[index] += heatConst;
+
+            _residual[index] = b[index] - (_Acenter[index] * field[index] +
+            field[index - 1] * (skip[index - 1] ? 0.0f : -heatConst) +
+            field[index + 1] * (skip[index + 1] ? 0.0f : -heatConst) +
+            field[index - _xRes] * (skip[index - _xRes] ? 0.0f : -heatConst) +
+            field[index + _xRes] * (skip[index + _xRes] ? 0.0f : -heatConst) +
+            field[index - _slabSize] * (skip[index - _slabSize] ? 0.0f : -heatConst) +
+            field[index + _slabSize] * (skip[index + _slabSize] ? 0.0f : -heatConst));
+          }
+          else
+          {
+            _residual[index] = 0.0f;
+          }
 
-		_direction[index] = _residual[index];
-		deltaNew += _residual[index] * _residual[index];
-      }
+          _direction[index] = _residual[index];
+          delta += _residual[index] * _residual[index];
+        }
+    partialSum[s] = delta;
+  }
 
+  for (int s = 0; s < slabs; s++)
+    deltaNew += partialSum[s];
 
   // While deltaNew > (eps^2) * delta0
   const float eps  = SOLVER_ACCURACY;
@@ -101,29 +133,39 @@ void FLUID_3D::solveHeat(float* field, float* b, unsigned char* skip)
     // q = Ad
 	float alpha = 0.0f;
 
-    index = _slabSize + _xRes + 1;
-    for (z = 1; z < _zRes - 1; z++, index += twoxr)
-      for (y = 1; y < _yRes - 1; y++, index += 2)
-        for (x = 1; x < _xRes - 1; x++, index++)
-        {
-          // if the cell is a variable
-          if (!skip[index])
+#if PARALLEL==1
+    #pragma omp parallel for schedule(static)
+#endif
+    for (int s = 0; s < slabs; s++)
+    {
+      float sum = 0.0f;
+      size_t index = (size_t)slab[s] * _slabSize + _xRes + 1;
+      for (int z = slab[s]; z < slab[s + 1]; z++, index += twoxr)
+        for (int y = 1; y < _yRes - 1; y++, index += 2)
+          for (int x = 1; x < _xRes - 1; x++, index++)
           {
-
-			_q[index] = (_Acenter[index] * _direction[index] + 
-            _direction[index - 1] * (skip[index - 1] ? 0.0f : -heatConst) +
-            _direction[index + 1] * (skip[index + 1] ? 0.0f : -heatConst) +
-            _direction[index - _xRes] * (skip[index - _xRes] ? 0.0f : -heatConst) +
-            _direction[index + _xRes] * (skip[index + _xRes] ? 0.0f : -heatConst) +
-            _direction[index - _slabSize] * (skip[index - _slabSize] ? 0.0f : -heatConst) +
-            _direction[index + _slabSize] * (skip[index + _slabSize] ? 0.0f : -heatConst));
+            // if the cell is a variable
+            if (!skip[index])
+            {
+              _q[index] = (_Acenter[index] * _direction[index] +
+              _direction[index - 1] * (skip[index - 1] ? 0.0f : -heatConst) +
+              _direction[index + 1] * (skip[index + 1] ? 0.0f : -heatConst) +
+              _direction[index - _xRes] * (skip[index - _xRes] ? 0.0f : -heatConst) +
+              _direction[index + _xRes] * (skip[index + _xRes] ? 0.0f : -heatConst) +
+              _direction[index - _slabSize] * (skip[index - _slabSize] ? 0.0f : -heatConst) +
+              _direction[index + _slabSize] * (skip[index + _slabSize] ? 0.0f : -heatConst));
+            }
+            else
+            {
+              _q[index] = 0.0f;
+            }
+            sum += _direction[index] * _q[index];
           }
-		  else
-		  {
-          _q[index] = 0.0f;
-		  }
-		  alpha += _direction[index] * _q[index];
-        }
+      partialSum[s] = sum;
+    }
+
+    for (int s = 0; s < slabs; s++)
+      alpha += partialSum[s];
 
     if (fabs(alpha) > 0.0f)
       alpha = deltaNew / alpha;
@@ -133,26 +175,47 @@ void FLUID_3D::solveHeat(float* field, float* b, unsigned char* skip)
 
 	maxR = 0.0f;
 
-    index = _slabSize + _xRes + 1;
-    for (z = 1; z < _zRes - 1; z++, index += twoxr)
-      for (y = 1; y < _yRes - 1; y++, index += 2)
-        for (x = 1; x < _xRes - 1; x++, index++)
-		{
-          field[index] += alpha * _direction[index];
+#if PARALLEL==1
+    #pragma omp parallel for schedule(static)
+#endif
+    for (int s = 0; s < slabs; s++)
+    {
+      float delta = 0.0f, sMaxR = 0.0f;
+      size_t index = (size_t)slab[s] * _slabSize + _xRes + 1;
+      for (int z = slab[s]; z < slab[s + 1]; z++, index += twoxr)
+        for (int y = 1; y < _yRes - 1; y++, index += 2)
+          for (int x = 1; x < _xRes - 1; x++, index++)
+          {
+            field[index] += alpha * _direction[index];
 
-		  _residual[index] -= alpha * _q[index];
-          maxR = (_residual[index] > maxR) ? _residual[index] : maxR;
+            _residual[index] -= alpha * _q[index];
+            sMaxR = (_residual[index] > sMaxR) ? _residual[index] : sMaxR;
 
-		  deltaNew += _residual[index] * _residual[index];
-		}
+            delta += _residual[index] * _residual[index];
+          }
+      partialSum[s] = delta;
+      partialMax[s] = sMaxR;
+    }
+
+    for (int s = 0; s < slabs; s++)
+    {
+      deltaNew += partialSum[s];
+      maxR = max(maxR, partialMax[s]);
+    }
 
     float beta = deltaNew / deltaOld;
 
-    index = _slabSize + _xRes + 1;
-    for (z = 1; z < _zRes - 1; z++, index += twoxr)
-      for (y = 1; y < _yRes - 1; y++, index += 2)
-        for (x = 1; x < _xRes - 1; x++, index++)
-         _direction[index] = _residual[index] + beta * _direction[index];
+#if PARALLEL==1
+    #pragma omp parallel for schedule(static)
+#endif
+    for (int s = 0; s < slabs; s++)
+    {
+      size_t index = (size_t)slab[s] * _slabSize + _xRes + 1;
+      for (int z = slab[s]; z < slab[s + 1]; z++, index += twoxr)
+        for (int y = 1; y < _yRes - 1; y++, index += 2)
+          for (int x = 1; x < _xRes - 1; x++, index++)
+            _direction[index] = _residual[index] + beta * _direction[index];
+    }
 
 	
     i++;
@@ -165,11 +228,147 @@ void FLUID_3D::solveHeat(float* field, float* b, unsigned char* skip)
 	if (_Acenter)  delete[] _Acenter;
 }
 
+//////////////////////////////////////////////////////////////////////
+// Modified incomplete Cholesky, MIC(0), preconditioner of the pressure
+// solve, following Bridson's "Fluid Simulation for Computer Graphics".
+// It is built and applied independently for each slab [zBegin, zEnd),
+// leaving out the couplings between slabs, so slabs can run in parallel.
+//////////////////////////////////////////////////////////////////////
+#define MIC_TAU 0.97f		// amount of modification
+#define MIC_SIGMA 0.25f		// safety against small pivots
+
+// bits of the couplings stored in aplus
+#define MIC_PLUS_X 1
+#define MIC_PLUS_Y 2
+#define MIC_PLUS_Z 4
+
+void FLUID_3D::setupPreconditioner(float* precond, unsigned char* aplus, unsigned char* skip, int zBegin, int zEnd)
+{
+	size_t index = (size_t)zBegin * _slabSize + _xRes + 1;
+	for (int z = zBegin; z < zEnd; z++, index += 2 * _xRes)
+		for (int y = 1; y < _yRes - 1; y++, index += 2)
+			for (int x = 1; x < _xRes - 1; x++, index++)
+			{
+				aplus[index] = 0;
+				precond[index] = 0.0f;
+
+				if (skip[index])
+					continue;
+
+				// couplings to the next cell in x, y and z that are unknowns of this slab
+				if (x < _xRes - 2 && !skip[index + 1]) aplus[index] |= MIC_PLUS_X;
+				if (y < _yRes - 2 && !skip[index + _xRes]) aplus[index] |= MIC_PLUS_Y;
+				if (z < zEnd - 1 && !skip[index + _slabSize]) aplus[index] |= MIC_PLUS_Z;
+
+				// diagonal of the Poisson stencil, see solvePressurePre()
+				float Acenter = 0.0f;
+				if (!skip[index + 1]) Acenter += 1.0f;
+				if (!skip[index - 1]) Acenter += 1.0f;
+				if (!skip[index + _xRes]) Acenter += 1.0f;
+				if (!skip[index - _xRes]) Acenter += 1.0f;
+				if (!skip[index + _slabSize]) Acenter += 1.0f;
+				if (!skip[index - _slabSize]) Acenter += 1.0f;
+
+				if (Acenter < 1.0f)
+					continue;
+
+				float e = Acenter;
+				unsigned char a;
+				float p;
+
+				a = aplus[index - 1];
+				if (a & MIC_PLUS_X) {
+					p = precond[index - 1];
+					e -= p * p * (1.0f + MIC_TAU * (((a & MIC_PLUS_Y) ? 1.0f : 0.0f) + ((a & MIC_PLUS_Z) ? 1.0f : 0.0f)));
+				}
+				a = aplus[index - _xRes];
+				if (a & MIC_PLUS_Y) {
+					p = precond[index - _xRes];
+					e -= p * p * (1.0f + MIC_TAU * (((a & MIC_PLUS_X) ? 1.0f : 0.0f) + ((a & MIC_PLUS_Z) ? 1.0f : 0.0f)));
+				}
+				if (z > zBegin) {
+					a = aplus[index - _slabSize];
+					if (a & MIC_PLUS_Z) {
+						p = precond[index - _slabSize];
+						e -= p * p * (1.0f + MIC_TAU * (((a & MIC_PLUS_X) ? 1.0f : 0.0f) + ((a & MIC_PLUS_Y) ? 1.0f : 0.0f)));
+					}
+				}
+
+				if (e < MIC_SIGMA * Acenter)
+					e = Acenter;
+
+				precond[index] = 1.0f / sqrtf(e);
+			}
+}
+
+// h = M^-1 r, solving L q = r and then L^T h = q in place. The couplings
+// are applied as factors of 0 or 1, and the one along x is carried from
+// the previous cell. Cells that aren't unknowns end up with h = 0 since
+// their precond is 0.
+void FLUID_3D::applyPreconditioner(float* h, float* r, float* precond, unsigned char* aplus, int zBegin, int zEnd)
+{
+	size_t index = (size_t)zBegin * _slabSize + _xRes + 1;
+	for (int z = zBegin; z < zEnd; z++, index += 2 * _xRes)
+	{
+		const int below = (z > zBegin) ? _slabSize : 0;
+
+		for (int y = 1; y < _yRes - 1; y++, index += 2)
+		{
+			float carry = 0.0f;
+
+			for (int x = 1; x < _xRes - 1; x++, index++)
+			{
+				const unsigned char a = aplus[index];
+				float t = r[index] +
+				          (float)((aplus[index - _xRes] & MIC_PLUS_Y) >> 1) * precond[index - _xRes] * h[index - _xRes];
+
+				if (below)
+					t += (float)((aplus[index - below] & MIC_PLUS_Z) >> 2) * precond[index - below] * h[index - below];
+
+				t += carry;
+
+				const float p = precond[index];
+				h[index] = t * p;
+				carry = (float)(a & MIC_PLUS_X) * (p * p) * t;
+			}
+		}
+	}
+
+	index = (size_t)(zEnd - 1) * _slabSize + (size_t)(_yRes - 2) * _xRes + _xRes - 2;
+	for (int z = zEnd - 1; z >= zBegin; z--, index -= 2 * _xRes)
+	{
+		const int above = (z < zEnd - 1) ? _slabSize : 0;
+
+		for (int y = _yRes - 2; y >= 1; y--, index -= 2)
+		{
+			float carry = 0.0f;
+
+			for (int x = _xRes - 2; x >= 1; x--, index--)
+			{
+				const unsigned char a = aplus[index];
+				const float p = precond[index];
+				float t = (float)((a & MIC_PLUS_Y) >> 1) * h[index + _xRes];
+
+				if (above)
+					t += (float)((a & MIC_PLUS_Z) >> 2) * h[index + above];
+
+				t = (h[index] + p * t) * p;
+				carry = t + (float)(a & MIC_PLUS_X) * (p * p) * carry;
+				h[index] = carry;
+			}
+		}
+	}
+}
+
 void FLUID_3D::solvePressurePre(float* field, float* b, unsigned char* skip)
 {
-	int x, y, z;
-	size_t index;
 	float *_q, *_Precond, *_h, *_residual, *_direction;
+	unsigned char *_Aplus;
+	vector<int> slab;
+
+	solverSlabs(_zRes, slab);
+	const int slabs = (int)slab.size() - 1;
+	vector<float> partialSum(slabs), partialMax(slabs);
 
 	// i = 0
 	int i = 0;
@@ -179,102 +378,128 @@ void FLUID_3D::solvePressurePre(float* field, float* b, unsigned char* skip)
 	_q            = new float[_totalCells]; // set 0
 	_h			  = new float[_totalCells]; // set 0
 	_Precond	  = new float[_totalCells]; // set 0
+	_Aplus		  = new unsigned char[_totalCells]; // set 0
 
 	memset(_residual, 0, sizeof(float)*_xRes*_yRes*_zRes);
 	memset(_q, 0, sizeof(float)*_xRes*_yRes*_zRes);
 	memset(_direction, 0, sizeof(float)*_xRes*_yRes*_zRes);
 	memset(_h, 0, sizeof(float)*_xRes*_yRes*_zRes);
 	memset(_Precond, 0, sizeof(float)*_xRes*_yRes*_zRes);
+	memset(_Aplus, 0, sizeof(unsigned char)*_xRes*_yRes*_zRes);
 
 	float deltaNew = 0.0f;
 
 	// r = b - Ax
-	index = _slabSize + _xRes + 1;
-	for (z = 1; z < _zRes - 1; z++, index += 2 * _xRes)
-		for (y = 1; y < _yRes - 1; y++, index += 2)
-		  for (x = 1; x < _xRes - 1; x++, index++)
-		  {
-			// if the cell is a variable
-			float Acenter = 0.0f;
-			if (!skip[index])
-			{
-			  // set the matrix to the Poisson stencil in order
-			  if (!skip[index + 1]) Acenter += 1.0f;
-			  if (!skip[index - 1]) Acenter += 1.0f;
-			  if (!skip[index + _xRes]) Acenter += 1.0f;
-			  if (!skip[index - _xRes]) Acenter += 1.0f;
-			  if (!skip[index + _slabSize]) Acenter += 1.0f;
-			  if (!skip[index - _slabSize]) Acenter += 1.0f;
-
-			  _residual[index] = b[index] - (Acenter * field[index] +  
-			  field[index - 1] * (skip[index - 1] ? 0.0f : -1.0f) +
-			  field[index + 1] * (skip[index + 1] ? 0.0f : -1.0f) +
-			  field[index - _xRes] * (skip[index - _xRes] ? 0.0f : -1.0f)+
-			  field[index + _xRes] * (skip[index + _xRes] ? 0.0f : -1.0f)+
-			  field[index - _slabSize] * (skip[index - _slabSize] ? 0.0f : -1.0f)+
-			  field[index + _slabSize] * (skip[index + _slabSize] ? 0.0f : -1.0f) );
-			}
-			else
-			{
-			_residual[index] = 0.0f;
-			}
-
-			// P^-1
-			if(Acenter < 1.0f)
-				_Precond[index] = 0.0;
-			else
-				_Precond[index] = 1.0f / Acenter;
-
-			// p = P^-1 * r
-			_direction[index] = _residual[index] * _Precond[index];
-
-			deltaNew += _residual[index] * _direction[index];
-		  }
-
+#if PARALLEL==1
+	#pragma omp parallel for schedule(static)
+#endif
+	for (int s = 0; s < slabs; s++)
+	{
+		size_t index = (size_t)slab[s] * _slabSize + _xRes + 1;
+		for (int z = slab[s]; z < slab[s + 1]; z++, index += 2 * _xRes)
+			for (int y = 1; y < _yRes - 1; y++, index += 2)
+			  for (int x = 1; x < _xRes - 1; x++, index++)
+			  {
+				// if the cell is a variable
+				float Acenter = 0.0f;
+				if (!skip[index])
+				{
+				  // set the matrix to the Poisson stencil in order
+				  if (!skip[index + 1]) Acenter += 1.0f;
+				  if (!skip[index - 1]) Acenter += 1.0f;
+				  if (!skip[index + _xRes]) Acenter += 1.0f;
+				  if (!skip[index - _xRes]) Acenter += 1.0f;
+				  if (!skip[index + _slabSize]) Acenter += 1.0f;
+				  if (!skip[index - _slabSize]) Acenter += 1.0f;
+
+				  _residual[index] = b[index] - (Acenter * field[index] +  
+				  field[index - 1] * (skip[index - 1] ? 0.0f : -1.0f) +
+				  field[index + 1] * (skip[index + 1] ? 0.0f : -1.0f) +
+				  field[index - _xRes] * (skip[index - _xRes] ? 0.0f : -1.0f)+
+				  field[index + _xRes] * (skip[index + _xRes] ? 0.0f : -1.0f)+
+				  field[index - _slabSize] * (skip[index - _slabSize] ? 0.0f : -1.0f)+
+				  field[index + _slabSize] * (skip[index + _slabSize] ? 0.0f : -1.0f) );
+				}
+				else
+				{
+				_residual[index] = 0.0f;
+				}
+			  }
+
+		// P^-1
+		setupPreconditioner(_Precond, _Aplus, skip, slab[s], slab[s + 1]);
+
+		// p = P^-1 * r
+		applyPreconditioner(_direction, _residual, _Precond, _Aplus, slab[s], slab[s + 1]);
+
+		float delta = 0.0f;
+		index = (size_t)slab[s] * _slabSize + _xRes + 1;
+		for (int z = slab[s]; z < slab[s + 1]; z++, index += 2 * _xRes)
+			for (int y = 1; y < _yRes - 1; y++, index += 2)
+			  for (int x = 1; x < _xRes - 1; x++, index++)
+				delta += _residual[index] * _direction[index];
+		partialSum[s] = delta;
+	}
+
+	for (int s = 0; s < slabs; s++)
+		deltaNew += partialSum[s];
 
   // While deltaNew > (eps^2) * delta0
   const float eps  = SOLVER_ACCURACY;
-  //while ((i < _iterations) && (deltaNew > eps*delta0))
+  // stop once the residual is reduced by PRESSURE_ACCURACY, which the MIC(0)
+  // preconditioner gets to well before _iterations
+  const float relEps = PRESSURE_ACCURACY * PRESSURE_ACCURACY;
+  const float delta0 = deltaNew;
   float maxR = 2.0f * eps;
   // while (i < _iterations)
-  while ((i < _iterations) && (maxR > 0.001f * eps))
+  while ((i < _iterations) && (maxR > 0.001f * eps) && (deltaNew > relEps * delta0))
   {
 
 	float alpha = 0.0f;
 
-    index = _slabSize + _xRes + 1;
-    for (z = 1; z < _zRes - 1; z++, index += 2 * _xRes)
-      for (y = 1; y < _yRes - 1; y++, index += 2)
-        for (x = 1; x < _xRes - 1; x++, index++)
-        {
-          // if the cell is a variable
-          float Acenter = 0.0f;
-          if (!skip[index])
+#if PARALLEL==1
+    #pragma omp parallel for schedule(static)
+#endif
+    for (int s = 0; s < slabs; s++)
+    {
+      float sum = 0.0f;
+      size_t index = (size_t)slab[s] * _slabSize + _xRes + 1;
+      for (int z = slab[s]; z < slab[s + 1]; z++, index += 2 * _xRes)
+        for (int y = 1; y < _yRes - 1; y++, index += 2)
+          for (int x = 1; x < _xRes - 1; x++, index++)
           {
-            // set the matrix to the Poisson stencil in order
-            if (!skip[index + 1]) Acenter += 1.0f;
-            if (!skip[index - 1]) Acenter += 1.0f;
-            if (!skip[index + _xRes]) Acenter += 1.0f;
-            if (!skip[index - _xRes]) Acenter += 1.0f;
-            if (!skip[index + _slabSize]) Acenter += 1.0f;
-            if (!skip[index - _slabSize]) Acenter += 1.0f;
-
-			_q[index] = Acenter * _direction[index] +  
-            _direction[index - 1] * (skip[index - 1] ? 0.0f : -1.0f) +
-            _direction[index + 1] * (skip[index + 1] ? 0.0f : -1.0f) +
-            _direction[index - _xRes] * (skip[index - _xRes] ? 0.0f : -1.0f) +
-            _direction[index + _xRes] * (skip[index + _xRes] ? 0.0f : -1.0f)+
-            _direction[index - _slabSize] * (skip[index - _slabSize] ? 0.0f : -1.0f) +
-            _direction[index + _slabSize] * (skip[index + _slabSize] ? 0.0f : -1.0f);
+            // if the cell is a variable
+            float Acenter = 0.0f;
+            if (!skip[index])
+            {
+              // set the matrix to the Poisson stencil in order
+              if (!skip[index + 1]) Acenter += 1.0f;
+              if (!skip[index - 1]) Acenter += 1.0f;
+              if (!skip[index + _xRes]) Acenter += 1.0f;
+              if (!skip[index - _xRes]) Acenter += 1.0f;
+              if (!skip[index + _slabSize]) Acenter += 1.0f;
+              if (!skip[index - _slabSize]) Acenter += 1.0f;
+
+              _q[index] = Acenter * _direction[index] +  
+              _direction[index - 1] * (skip[index - 1] ? 0.0f : -1.0f) +
+              _direction[index + 1] * (skip[index + 1] ? 0.0f : -1.0f) +
+              _direction[index - _xRes] * (skip[index - _xRes] ? 0.0f : -1.0f) +
+              _direction[index + _xRes] * (skip[index + _xRes] ? 0.0f : -1.0f)+
+              _direction[index - _slabSize] * (skip[index - _slabSize] ? 0.0f : -1.0f) +
+              _direction[index + _slabSize] * (skip[index + _slabSize] ? 0.0f : -1.0f);
+            }
+            else
+            {
+              _q[index] = 0.0f;
+            }
+
+            sum += _direction[index] * _q[index];
           }
-		  else
-		  {
-          _q[index] = 0.0f;
-		  }
-
-		  alpha += _direction[index] * _q[index];
-        }
+      partialSum[s] = sum;
+    }
 
+    for (int s = 0; s < slabs; s++)
+      alpha += partialSum[s];
 
     if (fabs(alpha) > 0.0f)
       alpha = deltaNew / alpha;
@@ -284,36 +509,60 @@ void FLUID_3D::solvePressurePre(float* field, float* b, unsigned char* skip)
 
 	maxR = 0.0;
 
-	float tmp;
-
     // x = x + alpha * d
-    index = _slabSize + _xRes + 1;
-    for (z = 1; z < _zRes - 1; z++, index += 2 * _xRes)
-      for (y = 1; y < _yRes - 1; y++, index += 2)
-        for (x = 1; x < _xRes - 1; x++, index++)
-		{
-          field[index] += alpha * _direction[index];
-
-		  _residual[index] -= alpha * _q[index];
+#if PARALLEL==1
+    #pragma omp parallel for schedule(static)
+#endif
+    for (int s = 0; s < slabs; s++)
+    {
+      size_t index = (size_t)slab[s] * _slabSize + _xRes + 1;
+      for (int z = slab[s]; z < slab[s + 1]; z++, index += 2 * _xRes)
+        for (int y = 1; y < _yRes - 1; y++, index += 2)
+          for (int x = 1; x < _xRes - 1; x++, index++)
+          {
+            field[index] += alpha * _direction[index];
 
-		  _h[index] = _Precond[index] * _residual[index];
+            _residual[index] -= alpha * _q[index];
+          }
 
-		  tmp = _residual[index] * _h[index];
-		  deltaNew += tmp;
-		  maxR = (tmp > maxR) ? tmp : maxR;
+      // h = P^-1 * r
+      applyPreconditioner(_h, _residual, _Precond, _Aplus, slab[s], slab[s + 1]);
 
-		}
+      float delta = 0.0f, sMaxR = 0.0f;
+      index = (size_t)slab[s] * _slabSize + _xRes + 1;
+      for (int z = slab[s]; z < slab[s + 1]; z++, index += 2 * _xRes)
+        for (int y = 1; y < _yRes - 1; y++, index += 2)
+          for (int x = 1; x < _xRes - 1; x++, index++)
+          {
+            float tmp = _residual[index] * _h[index];
+            delta += tmp;
+            sMaxR = (tmp > sMaxR) ? tmp : sMaxR;
+          }
+      partialSum[s] = delta;
+      partialMax[s] = sMaxR;
+    }
 
+    for (int s = 0; s < slabs; s++)
+    {
+      deltaNew += partialSum[s];
+      maxR = max(maxR, partialMax[s]);
+    }
 
     // beta = deltaNew / deltaOld
     float beta = deltaNew / deltaOld;
 
     // d = h + beta * d
-    index = _slabSize + _xRes + 1;
-    for (z = 1; z < _zRes - 1; z++, index += 2 * _xRes)
-      for (y = 1; y < _yRes - 1; y++, index += 2)
-        for (x = 1; x < _xRes - 1; x++, index++)
-          _direction[index] = _h[index] + beta * _direction[index];
+#if PARALLEL==1
+    #pragma omp parallel for schedule(static)
+#endif
+    for (int s = 0; s < slabs; s++)
+    {
+      size_t index = (size_t)slab[s] * _slabSize + _xRes + 1;
+      for (int z = slab[s]; z < slab[s + 1]; z++, index += 2 * _xRes)
+        for (int y = 1; y < _yRes - 1; y++, index += 2)
+          for (int x = 1; x < _xRes - 1; x++, index++)
+            _direction[index] = _h[index] + beta * _direction[index];
+    }
 
     // i = i + 1
     i++;
@@ -322,6 +571,7 @@ void FLUID_3D::solvePressurePre(float* field, float* b, unsigned char* skip)
 
 	if (_h) delete[] _h;
 	if (_Precond) delete[] _Precond;
+	if (_Aplus) delete[] _Aplus;
 	if (_residual) delete[] _residual;
 	if (_direction) delete[] _direction;
 	if (_q)       delete[] _q;
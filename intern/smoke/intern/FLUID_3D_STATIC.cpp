@@ -297,7 +297,7 @@ void FLUID_3D::copyBorderZ(float* field, Vec3Int res, int zBegin, int zEnd)
 // advect field with the semi lagrangian method
 //////////////////////////////////////////////////////////////////////
 void FLUID_3D::advectFieldSemiLagrange(const float dt, const float* velx, const float* vely,  const float* velz,
-		float* oldField, float* newField, Vec3Int res, int zBegin, int zEnd)
+		float* oldField, float* newField, Vec3Int res, int zBegin, int zEnd, const int *xSpan)
 {
 	const int xres = res[0];
 	const int yres = res[1];
@@ -307,7 +307,21 @@ void FLUID_3D::advectFieldSemiLagrange(const float dt, const float* velx, const
 
 	for (int z = zBegin; z < zEnd; z++)
 		for (int y = 0; y < yres; y++)
-			for (int x = 0; x < xres; x++)
+		{
+			int xBegin = 0, xEnd = xres;
+
+			if (xSpan) {
+				const int row = y + z * yres;
+				xBegin = xSpan[2 * row];
+				xEnd = xSpan[2 * row + 1];
+
+				for (int x = 0; x < xBegin; x++)
+					newField[x + y * xres + z * slabSize] = 0.0f;
+				for (int x = xEnd; x < xres; x++)
+					newField[x + y * xres + z * slabSize] = 0.0f;
+			}
+
+			for (int x = xBegin; x < xEnd; x++)
 			{
 				const int index = x + y * xres + z * xres*yres;
 				
@@ -360,6 +374,7 @@ void FLUID_3D::advectFieldSemiLagrange(const float dt, const float* velx, const
 							s1 * (t0 * oldField[i101] +
 								t1 * oldField[i111]));
 			}
+		}
 }
 
 
@@ -369,7 +384,7 @@ void FLUID_3D::advectFieldSemiLagrange(const float dt, const float* velx, const
 // comments are the pseudocode from selle's paper
 //////////////////////////////////////////////////////////////////////
 void FLUID_3D::advectFieldMacCormack1(const float dt, const float* xVelocity, const float* yVelocity, const float* zVelocity, 
-				float* oldField, float* tempResult, Vec3Int res, int zBegin, int zEnd)
+				float* oldField, float* tempResult, Vec3Int res, int zBegin, int zEnd, const int *xSpan)
 {
 	/*const int sx= res[0];
 	const int sy= res[1];
@@ -384,13 +399,13 @@ void FLUID_3D::advectFieldMacCormack1(const float dt, const float* xVelocity, co
 
 
 	// phiHatN1 = A(phiN)
-	advectFieldSemiLagrange(  dt, xVelocity, yVelocity, zVelocity, phiN, phiN1, res, zBegin, zEnd);		// uses wide data from old field and velocities (both are whole)
+	advectFieldSemiLagrange(  dt, xVelocity, yVelocity, zVelocity, phiN, phiN1, res, zBegin, zEnd, xSpan);		// uses wide data from old field and velocities (both are whole)
 }
 
 
 
 void FLUID_3D::advectFieldMacCormack2(const float dt, const float* xVelocity, const float* yVelocity, const float* zVelocity, 
-				float* oldField, float* newField, float* tempResult, float* temp1, Vec3Int res, const unsigned char* obstacles, int zBegin, int zEnd)
+				float* oldField, float* newField, float* tempResult, float* temp1, Vec3Int res, const unsigned char* obstacles, int zBegin, int zEnd, const int *xSpan)
 {
 	float* phiHatN  = tempResult;
 	float* t1  = temp1;
@@ -403,7 +418,7 @@ void FLUID_3D::advectFieldMacCormack2(const float dt, const float* xVelocity, co
 
 
 	// phiHatN = A^R(phiHatN1)
-	advectFieldSemiLagrange( -1.0f*dt, xVelocity, yVelocity, zVelocity, phiHatN, t1, res, zBegin, zEnd);		// uses wide data from old field and velocities (both are whole)
+	advectFieldSemiLagrange( -1.0f*dt, xVelocity, yVelocity, zVelocity, phiHatN, t1, res, zBegin, zEnd, xSpan);		// uses wide data from old field and velocities (both are whole)
 
 	// phiN1 = phiHatN1 + (phiN - phiHatN) / 2
 	const int border = 0; 
@@ -419,10 +434,10 @@ void FLUID_3D::advectFieldMacCormack2(const float dt, const float* xVelocity, co
 	copyBorderZ(phiN1, res, zBegin, zEnd);
 
 	// clamp any newly created extrema
-	clampExtrema(dt, xVelocity, yVelocity, zVelocity, oldField, newField, res, zBegin, zEnd);		// uses wide data from old field and velocities (both are whole)
+	clampExtrema(dt, xVelocity, yVelocity, zVelocity, oldField, newField, res, zBegin, zEnd, xSpan);		// uses wide data from old field and velocities (both are whole)
 
 	// if the error estimate was bad, revert to first order
-	clampOutsideRays(dt, xVelocity, yVelocity, zVelocity, oldField, newField, res, obstacles, phiHatN, zBegin, zEnd);	// phiHatN is only used at cells within thread range, so its ok
+	clampOutsideRays(dt, xVelocity, yVelocity, zVelocity, oldField, newField, res, obstacles, phiHatN, zBegin, zEnd, xSpan);	// phiHatN is only used at cells within thread range, so its ok
 
 } 
 
@@ -431,7 +446,7 @@ void FLUID_3D::advectFieldMacCormack2(const float dt, const float* xVelocity, co
 // Clamp the extrema generated by the BFECC error correction
 //////////////////////////////////////////////////////////////////////
 void FLUID_3D::clampExtrema(const float dt, const float* velx, const float* vely,  const float* velz,
-		float* oldField, float* newField, Vec3Int res, int zBegin, int zEnd)
+		float* oldField, float* newField, Vec3Int res, int zBegin, int zEnd, const int *xSpan)
 {
 	const int xres= res[0];
 	const int yres= res[1];
@@ -447,7 +462,16 @@ void FLUID_3D::clampExtrema(const float dt, const float* velx, const float* vely
 
 	for (int z = zBegin+bb; z < zEnd-bt; z++)
 		for (int y = 1; y < yres-1; y++)
-			for (int x = 1; x < xres-1; x++)
+		{
+			int xBegin = 1, xEnd = xres-1;
+
+			if (xSpan) {
+				const int row = y + z * yres;
+				xBegin = max(xBegin, xSpan[2 * row]);
+				xEnd = min(xEnd, xSpan[2 * row + 1]);
+			}
+
+			for (int x = xBegin; x < xEnd; x++)
 			{
 				const int index = x + y * xres+ z * xres*yres;
 				// backtrace
@@ -507,6 +531,7 @@ void FLUID_3D::clampExtrema(const float dt, const float* velx, const float* vely
 				newField[index] = (newField[index] > maxField) ? maxField : newField[index];
 				newField[index] = (newField[index] < minField) ? minField : newField[index];
 			}
+		}
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -515,7 +540,7 @@ void FLUID_3D::clampExtrema(const float dt, const float* velx, const float* vely
 // incorrect
 //////////////////////////////////////////////////////////////////////
 void FLUID_3D::clampOutsideRays(const float dt, const float* velx, const float* vely,  const float* velz,
-				float* oldField, float* newField, Vec3Int res, const unsigned char* obstacles, const float *oldAdvection, int zBegin, int zEnd)
+				float* oldField, float* newField, Vec3Int res, const unsigned char* obstacles, const float *oldAdvection, int zBegin, int zEnd, const int *xSpan)
 {
 	const int sx= res[0];
 	const int sy= res[1];
@@ -530,7 +555,16 @@ void FLUID_3D::clampOutsideRays(const float dt, const float* velx, const float*
 
 	for (int z = zBegin+bb; z < zEnd-bt; z++)
 		for (int y = 1; y < sy-1; y++)
-			for (int x = 1; x < sx-1; x++)
+		{
+			int xBegin = 1, xEnd = sx-1;
+
+			if (xSpan) {
+				const int row = y + z * sy;
+				xBegin = max(xBegin, xSpan[2 * row]);
+				xEnd = min(xEnd, xSpan[2 * row + 1]);
+			}
+
+			for (int x = xBegin; x < xEnd; x++)
 			{
 				const int index = x + y * sx+ z * slabSize;
 				// backtrace
@@ -642,5 +676,6 @@ void FLUID_3D::clampOutsideRays(const float dt, const float* velx, const float*
 								s1 * (t0 * oldField[i101] +
 									t1 * oldField[i111])); 
 				}
-			} // xyz
+			}
+		}
 }
@@ -208,6 +208,17 @@ WTURBULENCE::~WTURBULENCE() {
 // type (1<<1) = FFT / 4
 // type (1<<2) = curl / 8
 //////////////////////////////////////////////////////////////////////
+static float noiseTileMaxAbs(const float *tile)
+{
+	const int n3 = noiseTileSize * noiseTileSize * noiseTileSize;
+	float maxAbs = 0.0f;
+
+	for (int i = 0; i < n3; i++)
+		if (fabsf(tile[i]) > maxAbs) maxAbs = fabsf(tile[i]);
+
+	return maxAbs;
+}
+
 void WTURBULENCE::setNoise(int type, const char *noisefile_path)
 {
 	if(type == (1<<1)) // FFT
@@ -216,6 +227,7 @@ void WTURBULENCE::setNoise(int type, const char *noisefile_path)
 		// needs fft
 		std::string noiseTileFilename = std::string(noisefile_path) + std::string("noise.fft");
 		generatTile_FFT(_noiseTile, noiseTileFilename);
+		_noiseTileMax = noiseTileMaxAbs(_noiseTile);
 		return;
 #else
 		fprintf(stderr, "FFTW not enabled, falling back to wavelet noise.\n");
@@ -231,6 +243,7 @@ void WTURBULENCE::setNoise(int type, const char *noisefile_path)
 
 	std::string noiseTileFilename = std::string(noisefile_path) + std::string("noise.wavelets");
 	generateTile_WAVELET(_noiseTile, noiseTileFilename);
+	_noiseTileMax = noiseTileMaxAbs(_noiseTile);
 }
 
 // init direct access functions from blender
@@ -810,62 +823,161 @@ Vec3 WTURBULENCE::WVelocityWithJacobian(Vec3 orgPos, float* xUnwarped, float* yU
 
 //struct
 
+// states of the blocks of big cells covered by one small cell
+enum {
+	BLOCK_INACTIVE = 0,		// not reachable by the big fields this step
+	BLOCK_SYNTHESIZE = 1,	// reachable, noise still has to be added
+	BLOCK_DONE = 2,			// noise has been added
+};
+
 //////////////////////////////////////////////////////////////////////
-// perform the full turbulence algorithm, including OpenMP 
-// if available
+// mark the blocks which contain any density, fuel, reaction or color
 //////////////////////////////////////////////////////////////////////
-void WTURBULENCE::stepTurbulenceFull(float dtOrg, float* xvel, float* yvel, float* zvel, unsigned char *obstacles)
+void WTURBULENCE::computeActiveBlocks(unsigned char *active)
 {
-	// enlarge timestep to match grid
-	const float dt = dtOrg * _amplify;
-	const float invAmp = 1.0f / _amplify;
-	float *tempFuelBig = NULL, *tempReactBig = NULL;
-	float *tempColor_rBig = NULL, *tempColor_gBig = NULL, *tempColor_bBig = NULL;
-	float *tempDensityBig = (float *)calloc(_totalCellsBig, sizeof(float));
-	float *tempBig = (float *)calloc(_totalCellsBig, sizeof(float));
-	float *bigUx = (float *)calloc(_totalCellsBig, sizeof(float));
-	float *bigUy = (float *)calloc(_totalCellsBig, sizeof(float));
-	float *bigUz = (float *)calloc(_totalCellsBig, sizeof(float)); 
-	float *_energy = (float *)calloc(_totalCellsSm, sizeof(float));
-	float *highFreqEnergy = (float *)calloc(_totalCellsSm, sizeof(float));
-	float *eigMin  = (float *)calloc(_totalCellsSm, sizeof(float));
-	float *eigMax  = (float *)calloc(_totalCellsSm, sizeof(float));
+	float *fields[6];
+	int numFields = 0;
 
+	fields[numFields++] = _densityBig;
 	if (_fuelBig) {
-		tempFuelBig = (float *)calloc(_totalCellsBig, sizeof(float));
-		tempReactBig = (float *)calloc(_totalCellsBig, sizeof(float));
+		fields[numFields++] = _fuelBig;
+		fields[numFields++] = _reactBig;
 	}
 	if (_color_rBig) {
-		tempColor_rBig = (float *)calloc(_totalCellsBig, sizeof(float));
-		tempColor_gBig = (float *)calloc(_totalCellsBig, sizeof(float));
-		tempColor_bBig = (float *)calloc(_totalCellsBig, sizeof(float));
+		fields[numFields++] = _color_rBig;
+		fields[numFields++] = _color_gBig;
+		fields[numFields++] = _color_bBig;
 	}
 
-	memset(_tcTemp, 0, sizeof(float)*_totalCellsSm);
+#if PARALLEL==1
+#pragma omp parallel for schedule(static)
+#endif
+	for (int zSmall = 0; zSmall < _zResSm; zSmall++)
+		for (int ySmall = 0; ySmall < _yResSm; ySmall++)
+			for (int xSmall = 0; xSmall < _xResSm; xSmall++)
+			{
+				bool found = false;
+
+				for (int zBig = 0; zBig < _amplify && !found; zBig++)
+					for (int yBig = 0; yBig < _amplify && !found; yBig++)
+					{
+						const int row = xSmall * _amplify + (ySmall * _amplify + yBig) * _xResBig +
+						                (zSmall * _amplify + zBig) * _slabSizeBig;
+
+						for (int f = 0; f < numFields && !found; f++)
+							for (int xBig = 0; xBig < _amplify; xBig++)
+								if (fields[f][row + xBig] != 0.0f) {
+									found = true;
+									break;
+								}
+					}
+
+				active[xSmall + ySmall * _xResSm + zSmall * _slabSizeSm] = found;
+			}
+}
 
+//////////////////////////////////////////////////////////////////////
+// set dst to whether src has any flag within radius along the line
+//////////////////////////////////////////////////////////////////////
+static void dilateLine(const unsigned char *src, unsigned char *dst, int len, int stride, int radius)
+{
+	int count = 0;
 
-	// prepare textures
-	advectTextureCoordinates(dtOrg, xvel,yvel,zvel, tempDensityBig, tempBig);
+	for (int i = 0; i < radius && i < len; i++)
+		count += (src[i * stride] != 0);
 
-	// do wavelet decomposition of energy
-	computeEnergy(_energy, xvel, yvel, zvel, obstacles);
+	for (int i = 0; i < len; i++) {
+		if (i + radius < len)
+			count += (src[(i + radius) * stride] != 0);
+		if (i - radius - 1 >= 0)
+			count -= (src[(i - radius - 1) * stride] != 0);
+		dst[i * stride] = (count > 0);
+	}
+}
 
-	for (int x = 0; x < _totalCellsSm; x++)
-		if (obstacles[x]) _energy[x] = 0.f;
+//////////////////////////////////////////////////////////////////////
+// mark the inactive blocks within radius blocks of an active one for
+// synthesis, the box is dilated one axis at a time
+//////////////////////////////////////////////////////////////////////
+void WTURBULENCE::dilateBlocks(const unsigned char *active, unsigned char *blocks, int radius)
+{
+	unsigned char *tempX = (unsigned char *)malloc(_totalCellsSm);
+	unsigned char *tempY = (unsigned char *)malloc(_totalCellsSm);
 
-	decomposeEnergy(_energy, highFreqEnergy);
+	for (int z = 0; z < _zResSm; z++)
+		for (int y = 0; y < _yResSm; y++) {
+			const int offset = y * _xResSm + z * _slabSizeSm;
+			dilateLine(active + offset, tempX + offset, _xResSm, 1, radius);
+		}
+	for (int z = 0; z < _zResSm; z++)
+		for (int x = 0; x < _xResSm; x++) {
+			const int offset = x + z * _slabSizeSm;
+			dilateLine(tempX + offset, tempY + offset, _yResSm, _xResSm, radius);
+		}
+	for (int y = 0; y < _yResSm; y++)
+		for (int x = 0; x < _xResSm; x++) {
+			const int offset = x + y * _xResSm;
+			dilateLine(tempY + offset, tempX + offset, _zResSm, _slabSizeSm, radius);
+		}
 
-	// zero out coefficients inside of the obstacle
-	for (int x = 0; x < _totalCellsSm; x++)
-		if (obstacles[x]) highFreqEnergy[x] = 0.f;
+	for (int i = 0; i < _totalCellsSm; i++)
+		if (tempX[i] && blocks[i] == BLOCK_INACTIVE)
+			blocks[i] = BLOCK_SYNTHESIZE;
 
-	Vec3Int ressm(_xResSm, _yResSm, _zResSm);
-	FLUID_3D::setNeumannX(highFreqEnergy, ressm, 0 , ressm[2]);
-	FLUID_3D::setNeumannY(highFreqEnergy, ressm, 0 , ressm[2]);
-	FLUID_3D::setNeumannZ(highFreqEnergy, ressm, 0 , ressm[2]);
+	free(tempX);
+	free(tempY);
+}
 
+//////////////////////////////////////////////////////////////////////
+// get the range of synthesized big cells in every big row, in the
+// layout expected by the FLUID_3D advection functions
+//////////////////////////////////////////////////////////////////////
+void WTURBULENCE::computeRowSpans(const unsigned char *blocks, int *xSpan)
+{
+	for (int z = 0; z < _zResBig; z++)
+		for (int y = 0; y < _yResBig; y++)
+		{
+			const unsigned char *rowSm = blocks + (y / _amplify) * _xResSm + (z / _amplify) * _slabSizeSm;
+			const int row = y + z * _yResBig;
+			int begin = 0, end = _xResSm;
+
+			while (begin < end && rowSm[begin] != BLOCK_DONE) begin++;
+			while (end > begin && rowSm[end - 1] != BLOCK_DONE) end--;
 
-   int threadval = 1;
+			xSpan[2 * row] = begin * _amplify;
+			xSpan[2 * row + 1] = end * _amplify;
+		}
+}
+
+//////////////////////////////////////////////////////////////////////
+// based on the maximum velocity present, see if we need to substep,
+// but cap the maximum number of substeps to 25
+//////////////////////////////////////////////////////////////////////
+static int turbulenceSubsteps(float maxVelMag, float dt)
+{
+	const int maxSubSteps = 25;
+	const int maxVel = 5;
+	int totalSubsteps = (int)(sqrt(maxVelMag) * dt / (float)maxVel);
+	totalSubsteps = (totalSubsteps < 1) ? 1 : totalSubsteps;
+	totalSubsteps = (totalSubsteps > maxSubSteps) ? maxSubSteps : totalSubsteps;
+	return totalSubsteps;
+}
+
+//////////////////////////////////////////////////////////////////////
+// store the interpolated velocity plus turbulence of the blocks marked
+// for synthesis in the big grid, returns the largest squared velocity
+// magnitude among them. With allBlocks the eigenvalues of the texture
+// jacobian are computed for every block as well, and velBound gets an
+// upper bound of the velocity magnitude in every block
+//////////////////////////////////////////////////////////////////////
+float WTURBULENCE::synthesizeVelocity(float* xvel, float* yvel, float* zvel, unsigned char *obstacles,
+                                      float *highFreqEnergy, float *eigMin, float *eigMax,
+                                      unsigned char *blocks, bool allBlocks, float *velBound,
+                                      float *bigUx, float *bigUy, float *bigUz)
+{
+  const float invAmp = 1.0f / _amplify;
+
+  int threadval = 1;
 #if PARALLEL==1
   threadval = omp_get_max_threads();
 #endif
@@ -897,6 +1009,11 @@ void WTURBULENCE::stepTurbulenceFull(float dtOrg, float* xvel, float* yvel, floa
   {
     const int indexSmall = xSmall + ySmall * _xResSm + zSmall * _slabSizeSm;
 
+    // the eigenvalues are needed everywhere for resetting the texture
+    // coordinates, so only the first pass visits every block
+    if (!allBlocks && blocks[indexSmall] != BLOCK_SYNTHESIZE)
+      continue;
+
     // compute jacobian
     float jacobian[3][3] = {
       { minDx(xSmall, ySmall, zSmall, _tcU, _resSm), minDx(xSmall, ySmall, zSmall, _tcV, _resSm), minDx(xSmall, ySmall, zSmall, _tcW, _resSm) } ,
@@ -936,6 +1053,47 @@ void WTURBULENCE::stepTurbulenceFull(float dtOrg, float* xvel, float* yvel, floa
       eigMax[indexSmall] = MAX3V(eigenvalues);
       eigMin[indexSmall] = MIN3V(eigenvalues);
     }
+
+    if (velBound) {
+      // The interpolated velocity and energy of the block's cells are
+      // convex combinations of these small cells.
+      float velMax = 0.0f, energyMax = 0.0f;
+
+      for (int z = max(zSmall - 1, 0); z <= min(zSmall + 1, _zResSm - 1); z++)
+      for (int y = max(ySmall - 1, 0); y <= min(ySmall + 1, _yResSm - 1); y++)
+      for (int x = max(xSmall - 1, 0); x <= min(xSmall + 1, _xResSm - 1); x++)
+      {
+        const int i = x + y * _xResSm + z * _slabSizeSm;
+        const float velMag = xvel[i] * xvel[i] + yvel[i] * yvel[i] + zvel[i] * zvel[i];
+        if (velMag > velMax) velMax = velMag;
+        if (fabsf(highFreqEnergy[i]) > energyMax) energyMax = fabsf(highFreqEnergy[i]);
+      }
+
+      float bound = sqrtf(velMax);
+
+      if (eigMax[indexSmall] < 2.0f && eigMin[indexSmall] > 0.5f) {
+        // the weights of a noise derivative add up to at most 2 in
+        // absolute value, see WNoiseDx()
+        const float derivMax = 2.0f * _noiseTileMax;
+        const float nx = fabsf(xUnwarped[0]) + fabsf(xUnwarped[1]) + fabsf(xUnwarped[2]);
+        const float ny = fabsf(yUnwarped[0]) + fabsf(yUnwarped[1]) + fabsf(yUnwarped[2]);
+        const float nz = fabsf(zUnwarped[0]) + fabsf(zUnwarped[1]) + fabsf(zUnwarped[2]);
+        const float curlMax = derivMax * sqrtf((ny + nz) * (ny + nz) + (nz + nx) * (nz + nx) + (nx + ny) * (nx + ny));
+
+        float amplitudeScaled = *_strength * fabs(0.5f * sqrtf(2.0f * energyMax)) * persistence;
+        for (int octave = 0; octave < _octaves; octave++) {
+          bound += curlMax * amplitudeScaled;
+          amplitudeScaled *= persistence;
+        }
+      }
+
+      // leave room for float rounding
+      velBound[indexSmall] = bound * 1.001f + 1e-6f;
+    }
+
+    if (blocks[indexSmall] != BLOCK_SYNTHESIZE)
+      continue;
+    blocks[indexSmall] = BLOCK_DONE;
     
     // make sure to skip one on the beginning and end
     int xStart = (xSmall == 0) ? 1 : 0;
@@ -1024,14 +1182,14 @@ void WTURBULENCE::stepTurbulenceFull(float dtOrg, float* xvel, float* yvel, floa
       if (obsCheck > 0.95f)
         bigUx[index] = bigUy[index] = bigUz[index] = 0.;
     } // xyz*/
+  }
+  }
 
 #if PARALLEL==1
-    maxVelMagThreads[id] = maxVelMag1;
+  maxVelMagThreads[id] = maxVelMag1;
 #else
-    maxVelMagThreads[0] = maxVelMag1;
+  maxVelMagThreads[0] = maxVelMag1;
 #endif
-  }
-  }
   } // omp
   
   // compute maximum over threads
@@ -1043,6 +1201,118 @@ void WTURBULENCE::stepTurbulenceFull(float dtOrg, float* xvel, float* yvel, floa
 #endif
   delete [] maxVelMagThreads;
 
+  return maxVelMag;
+}
+
+//////////////////////////////////////////////////////////////////////
+// perform the full turbulence algorithm, including OpenMP 
+// if available
+//////////////////////////////////////////////////////////////////////
+void WTURBULENCE::stepTurbulenceFull(float dtOrg, float* xvel, float* yvel, float* zvel, unsigned char *obstacles)
+{
+	// enlarge timestep to match grid
+	const float dt = dtOrg * _amplify;
+	// the fields are advected one after another and share this array
+	float *tempFieldBig = (float *)calloc(_totalCellsBig, sizeof(float));
+	float *tempBig = (float *)calloc(_totalCellsBig, sizeof(float));
+	float *bigUx = (float *)calloc(_totalCellsBig, sizeof(float));
+	float *bigUy = (float *)calloc(_totalCellsBig, sizeof(float));
+	float *bigUz = (float *)calloc(_totalCellsBig, sizeof(float)); 
+	float *_energy = (float *)calloc(_totalCellsSm, sizeof(float));
+	float *highFreqEnergy = (float *)calloc(_totalCellsSm, sizeof(float));
+	float *eigMin  = (float *)calloc(_totalCellsSm, sizeof(float));
+	float *eigMax  = (float *)calloc(_totalCellsSm, sizeof(float));
+	unsigned char *activeBlocks = (unsigned char *)calloc(_totalCellsSm, sizeof(unsigned char));
+	unsigned char *blocks = (unsigned char *)calloc(_totalCellsSm, sizeof(unsigned char));
+	int *xSpan = (int *)malloc(sizeof(int) * 2 * _yResBig * _zResBig);
+
+	// find the content before the texture advection reuses the
+	// temporary arrays
+	computeActiveBlocks(activeBlocks);
+
+	memset(_tcTemp, 0, sizeof(float)*_totalCellsSm);
+
+
+	// prepare textures
+	advectTextureCoordinates(dtOrg, xvel,yvel,zvel, tempFieldBig, tempBig);
+
+	// do wavelet decomposition of energy
+	computeEnergy(_energy, xvel, yvel, zvel, obstacles);
+
+	for (int x = 0; x < _totalCellsSm; x++)
+		if (obstacles[x]) _energy[x] = 0.f;
+
+	decomposeEnergy(_energy, highFreqEnergy);
+
+	// zero out coefficients inside of the obstacle
+	for (int x = 0; x < _totalCellsSm; x++)
+		if (obstacles[x]) highFreqEnergy[x] = 0.f;
+
+	Vec3Int ressm(_xResSm, _yResSm, _zResSm);
+	FLUID_3D::setNeumannX(highFreqEnergy, ressm, 0 , ressm[2]);
+	FLUID_3D::setNeumannY(highFreqEnergy, ressm, 0 , ressm[2]);
+	FLUID_3D::setNeumannZ(highFreqEnergy, ressm, 0 , ressm[2]);
+
+
+  // Noise and advection are only needed in the blocks the big fields
+  // can reach during this step. The substeps depend on the largest
+  // velocity in the whole big grid, as before. Rather than synthesizing
+  // noise everywhere, every block gets an upper bound of its velocity,
+  // and only the blocks outside the content whose bound could raise the
+  // substep count are synthesized to find the actual count. The band is
+  // dilated to cover the distance the fields can move at the largest
+  // velocity that is possible anywhere, plus the interpolation stencils
+  // of every substep, so cells outside of it can't pull in any content.
+  const int maxRadius = max(_xResSm, max(_yResSm, _zResSm));
+  float *velBound = (float *)malloc(sizeof(float) * _totalCellsSm);
+  unsigned char *boundBlocks = (unsigned char *)calloc(_totalCellsSm, sizeof(unsigned char));
+
+  dilateBlocks(activeBlocks, blocks, 1);
+  float maxVelMag = synthesizeVelocity(xvel, yvel, zvel, obstacles, highFreqEnergy,
+      eigMin, eigMax, blocks, true, velBound, bigUx, bigUy, bigUz);
+  int totalSubsteps = turbulenceSubsteps(maxVelMag, dt);
+
+  bool boundExceeded = false;
+  for (int i = 0; i < _totalCellsSm; i++)
+    if (blocks[i] == BLOCK_INACTIVE && turbulenceSubsteps(velBound[i] * velBound[i], dt) > totalSubsteps) {
+      boundBlocks[i] = BLOCK_SYNTHESIZE;
+      boundExceeded = true;
+    }
+
+  if (boundExceeded) {
+    // these blocks only contribute to the maximum, they stay out of the
+    // band unless the dilation below reaches them
+    const float maxVelMagBound = synthesizeVelocity(xvel, yvel, zvel, obstacles, highFreqEnergy,
+        eigMin, eigMax, boundBlocks, false, NULL, bigUx, bigUy, bigUz);
+    if (maxVelMag < maxVelMagBound)
+      maxVelMag = maxVelMagBound;
+    totalSubsteps = turbulenceSubsteps(maxVelMag, dt);
+  }
+
+  float maxVel = sqrtf(maxVelMag);
+  for (int i = 0; i < _totalCellsSm; i++)
+    if (blocks[i] == BLOCK_INACTIVE && boundBlocks[i] == BLOCK_INACTIVE && velBound[i] > maxVel)
+      maxVel = velBound[i];
+  free(velBound);
+
+  const int reachBig = 2 * ((int)ceil(maxVel * dt) + totalSubsteps) + 1;
+  const int neededRadius = min((reachBig + _amplify - 1) / _amplify, maxRadius);
+
+  if (neededRadius > 1) {
+    dilateBlocks(activeBlocks, blocks, neededRadius);
+    for (int i = 0; i < _totalCellsSm; i++)
+      if (blocks[i] == BLOCK_SYNTHESIZE && boundBlocks[i] == BLOCK_DONE)
+        blocks[i] = BLOCK_DONE;
+    synthesizeVelocity(xvel, yvel, zvel, obstacles, highFreqEnergy,
+        eigMin, eigMax, blocks, false, NULL, bigUx, bigUy, bigUz);
+  }
+
+  free(boundBlocks);
+
+  computeRowSpans(blocks, xSpan);
+  free(activeBlocks);
+  free(blocks);
+
 
   // prepare density for an advection
   SWAP_POINTERS(_densityBig, _densityBigOld);
@@ -1052,15 +1322,6 @@ void WTURBULENCE::stepTurbulenceFull(float dtOrg, float* xvel, float* yvel, floa
   SWAP_POINTERS(_color_gBig, _color_gBigOld);
   SWAP_POINTERS(_color_bBig, _color_bBigOld);
 
-  // based on the maximum velocity present, see if we need to substep,
-  // but cap the maximum number of substeps to 5
-  const int maxSubSteps = 25;
-  const int maxVel = 5;
-  maxVelMag = sqrt(maxVelMag) * dt;
-  int totalSubsteps = (int)(maxVelMag / (float)maxVel);
-  totalSubsteps = (totalSubsteps < 1) ? 1 : totalSubsteps;
-  // printf("totalSubsteps: %d\n", totalSubsteps);
-  totalSubsteps = (totalSubsteps > maxSubSteps) ? maxSubSteps : totalSubsteps;
   const float dtSubdiv = dt / (float)totalSubsteps;
 
   // set boundaries of big velocity grid
@@ -1069,6 +1330,7 @@ void WTURBULENCE::stepTurbulenceFull(float dtOrg, float* xvel, float* yvel, floa
   FLUID_3D::setZeroZ(bigUz, _resBig, 0 , _resBig[2]);
 
 #if PARALLEL==1
+  const int threadval = omp_get_max_threads();
   int stepParts = threadval*2;	// Dividing parallelized sections into numOfThreads * 2 sections
   float partSize = (float)_zResBig/stepParts;	// Size of one part;
 
@@ -1084,11 +1346,27 @@ void WTURBULENCE::stepTurbulenceFull(float dtOrg, float* xvel, float* yvel, floa
   // do the MacCormack advection, with substepping if necessary
   for(int substep = 0; substep < totalSubsteps; substep++)
   {
+	float *fieldsOld[6], *fields[6];
+	int numFields = 0;
+
+	fieldsOld[numFields] = _densityBigOld; fields[numFields++] = _densityBig;
+	if (_fuelBig) {
+		fieldsOld[numFields] = _fuelBigOld; fields[numFields++] = _fuelBig;
+		fieldsOld[numFields] = _reactBigOld; fields[numFields++] = _reactBig;
+	}
+	if (_color_rBig) {
+		fieldsOld[numFields] = _color_rBigOld; fields[numFields++] = _color_rBig;
+		fieldsOld[numFields] = _color_gBigOld; fields[numFields++] = _color_gBig;
+		fieldsOld[numFields] = _color_bBigOld; fields[numFields++] = _color_bBig;
+	}
 
 #if PARALLEL==1
 	#pragma omp parallel
 	{
-
+#endif
+	for (int f = 0; f < numFields; f++)
+	{
+#if PARALLEL==1
 	#pragma omp for schedule(static,1)
 	for (int i=0; i<stepParts; i++)
 	{
@@ -1096,26 +1374,10 @@ void WTURBULENCE::stepTurbulenceFull(float dtOrg, float* xvel, float* yvel, floa
 		int zEnd = (int)((float)(i+1)*partSize + 0.5f);
 #endif
 		FLUID_3D::advectFieldMacCormack1(dtSubdiv, bigUx, bigUy, bigUz, 
-		    _densityBigOld, tempDensityBig, _resBig, zBegin, zEnd);
-		if (_fuelBig) {
-			FLUID_3D::advectFieldMacCormack1(dtSubdiv, bigUx, bigUy, bigUz, 
-				_fuelBigOld, tempFuelBig, _resBig, zBegin, zEnd);
-			FLUID_3D::advectFieldMacCormack1(dtSubdiv, bigUx, bigUy, bigUz, 
-				_reactBigOld, tempReactBig, _resBig, zBegin, zEnd);
-		}
-		if (_color_rBig) {
-			FLUID_3D::advectFieldMacCormack1(dtSubdiv, bigUx, bigUy, bigUz, 
-				_color_rBigOld, tempColor_rBig, _resBig, zBegin, zEnd);
-			FLUID_3D::advectFieldMacCormack1(dtSubdiv, bigUx, bigUy, bigUz, 
-				_color_gBigOld, tempColor_gBig, _resBig, zBegin, zEnd);
-			FLUID_3D::advectFieldMacCormack1(dtSubdiv, bigUx, bigUy, bigUz, 
-				_color_bBigOld, tempColor_bBig, _resBig, zBegin, zEnd);
-		}
+		    fieldsOld[f], tempFieldBig, _resBig, zBegin, zEnd, xSpan);
 #if PARALLEL==1
 	}
 
-	#pragma omp barrier
-
 	#pragma omp for schedule(static,1)
 	for (int i=0; i<stepParts; i++)
 	{
@@ -1123,23 +1385,12 @@ void WTURBULENCE::stepTurbulenceFull(float dtOrg, float* xvel, float* yvel, floa
 		int zEnd = (int)((float)(i+1)*partSize + 0.5f);
 #endif
 		FLUID_3D::advectFieldMacCormack2(dtSubdiv, bigUx, bigUy, bigUz, 
-		    _densityBigOld, _densityBig, tempDensityBig, tempBig, _resBig, NULL, zBegin, zEnd);
-		if (_fuelBig) {
-			FLUID_3D::advectFieldMacCormack2(dtSubdiv, bigUx, bigUy, bigUz, 
-				_fuelBigOld, _fuelBig, tempFuelBig, tempBig, _resBig, NULL, zBegin, zEnd);
-			FLUID_3D::advectFieldMacCormack2(dtSubdiv, bigUx, bigUy, bigUz, 
-				_reactBigOld, _reactBig, tempReactBig, tempBig, _resBig, NULL, zBegin, zEnd);
-		}
-		if (_color_rBig) {
-			FLUID_3D::advectFieldMacCormack2(dtSubdiv, bigUx, bigUy, bigUz, 
-				_color_rBigOld, _color_rBig, tempColor_rBig, tempBig, _resBig, NULL, zBegin, zEnd);
-			FLUID_3D::advectFieldMacCormack2(dtSubdiv, bigUx, bigUy, bigUz, 
-				_color_gBigOld, _color_gBig, tempColor_gBig, tempBig, _resBig, NULL, zBegin, zEnd);
-			FLUID_3D::advectFieldMacCormack2(dtSubdiv, bigUx, bigUy, bigUz, 
-				_color_bBigOld, _color_bBig, tempColor_bBig, tempBig, _resBig, NULL, zBegin, zEnd);
-		}
+		    fieldsOld[f], fields[f], tempFieldBig, tempBig, _resBig, NULL, zBegin, zEnd, xSpan);
 #if PARALLEL==1
 	}
+#endif
+	}
+#if PARALLEL==1
 	}
 #endif
 
@@ -1153,13 +1404,9 @@ void WTURBULENCE::stepTurbulenceFull(float dtOrg, float* xvel, float* yvel, floa
 	}
   } // substep
 
-  free(tempDensityBig);
-  if (tempFuelBig) free(tempFuelBig);
-  if (tempReactBig) free(tempReactBig);
-  if (tempColor_rBig) free(tempColor_rBig);
-  if (tempColor_gBig) free(tempColor_gBig);
-  if (tempColor_bBig) free(tempColor_bBig);
+  free(tempFieldBig);
   free(tempBig);
+  free(xSpan);
   free(bigUx);
   free(bigUy);
   free(bigUz);
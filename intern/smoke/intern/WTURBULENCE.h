@@ -114,6 +114,9 @@ struct WTURBULENCE
 		int _totalCellsSm;
 		int _slabSizeSm;
 
+		// big fields are dense _totalCellsBig arrays handed out as is by smoke_API,
+		// inactive blocks are skipped in the step but still allocated
+		// TODO: block-sparse storage allocating only active blocks
 		float* _densityBig;
 		float* _densityBigOld;
 		float* _flameBig;
@@ -137,6 +140,7 @@ struct WTURBULENCE
 
 		// noise data
 		float* _noiseTile;
+		float _noiseTileMax;  // largest absolute value in _noiseTile
 		//float* _noiseTileExt;
 
 		// step counter
@@ -144,6 +148,16 @@ struct WTURBULENCE
 		
 		void computeEigenvalues(float *_eigMin, float *_eigMax);
 		void decomposeEnergy(float *energy, float *_highFreqEnergy);
+
+		// blocks are the _amplify^3 big cells covered by one small cell,
+		// only the ones reachable by the big fields are synthesized
+		void computeActiveBlocks(unsigned char *active);
+		void dilateBlocks(const unsigned char *active, unsigned char *blocks, int radius);
+		void computeRowSpans(const unsigned char *blocks, int *xSpan);
+		float synthesizeVelocity(float* xvel, float* yvel, float* zvel, unsigned char *obstacles,
+				float *highFreqEnergy, float *eigMin, float *eigMax,
+				unsigned char *blocks, bool allBlocks, float *velBound,
+				float *bigUx, float *bigUy, float *bigUz);
 };
 
 #endif // WTURBULENCE_H
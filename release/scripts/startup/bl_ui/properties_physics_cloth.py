@@ -283,6 +283,7 @@ class PHYSICS_PT_cloth_collision(PhysicButtonsPanel, Panel):
         sub.active = cloth.use_self_collision
         sub.prop(cloth, "self_friction", text="Friction")
         sub.prop(cloth, "self_distance_min", slider=True, text="Distance")
+        sub.prop(cloth, "use_self_collision_continuous", text="Continuous")
         sub.prop(cloth, "self_impulse_clamp")
         sub.prop_search(cloth, "vertex_group_self_collisions", ob, "vertex_groups", text="Vertex Group")
 
@@ -1049,6 +1049,9 @@ class USERPREF_PT_file(Panel):
         col.label(text="Save & Load:")
         col.prop(paths, "use_relative_paths")
         col.prop(paths, "use_file_compression")
+        sub = col.column()
+        sub.active = paths.use_file_compression
+        sub.prop(paths, "file_compression_level")
         col.prop(paths, "use_load_ui")
         col.prop(paths, "use_filter_files")
         col.prop(paths, "show_hidden_files_datablocks")
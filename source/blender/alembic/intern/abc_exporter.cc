@@ -44,6 +44,7 @@ extern "C" {
 #include "DNA_space_types.h"  /* for FILE_MAX */
 
 #include "BLI_string.h"
+#include "BLI_task.h"
 
 #ifdef WIN32
 /* needed for MSCV because of snprintf from BLI_string */
@@ -57,6 +58,8 @@ extern "C" {
 #include "BKE_modifier.h"
 #include "BKE_particle.h"
 #include "BKE_scene.h"
+
+#include "DEG_depsgraph_query.h"
 }
 
 using Alembic::Abc::TimeSamplingPtr;
@@ -325,6 +328,8 @@ void AbcExporter::operator()(Main *bmain, float &progress, bool &was_canceled)
 		setCurrentFrame(bmain, frame);
 
 		if (shape_frames.count(frame) != 0) {
+			prepareParallelMeshes();
+
 			for (int i = 0, e = m_shapes.size(); i != e; ++i) {
 				m_shapes[i]->write();
 			}
@@ -545,6 +550,65 @@ void AbcExporter::createParticleSystemsWriters(Object *ob, AbcTransformWriter *x
 	}
 }
 
+static void modifier_object_link_cb(void *userdata, Object * /*ob*/, Object **obpoin, int /*cb_flag*/)
+{
+	if (*obpoin != NULL) {
+		*static_cast<bool *>(userdata) = true;
+	}
+}
+
+/* Whether the render mesh of the object can be built in parallel with the
+ * meshes of other objects. */
+static bool object_mesh_is_parallel_safe(Scene *scene, Object *ob)
+{
+	/* Modifiers such as Boolean or Shrinkwrap read the meshes of other
+	 * objects, which may be built at the same time. */
+	bool uses_objects = false;
+	modifiers_foreachObjectLink(ob, modifier_object_link_cb, &uses_objects);
+	if (uses_objects) {
+		return false;
+	}
+
+	if (scene->depsgraph) {
+		return DEG_id_is_frame_independent(scene->depsgraph, &ob->id);
+	}
+
+	/* The legacy depsgraph has no operations to inspect, so check the object
+	 * itself. Animation and drivers are already evaluated by the frame change,
+	 * only simulations and other time dependent modifiers keep state. */
+	if (ob->rigidbody_object || ob->particlesystem.first) {
+		return false;
+	}
+
+	for (ModifierData *md = static_cast<ModifierData *>(ob->modifiers.first); md; md = md->next) {
+		if (modifier_dependsOnTime(md)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static void prepare_mesh_cb(void *userdata, const int index)
+{
+	AbcMeshWriter **writers = static_cast<AbcMeshWriter **>(userdata);
+	writers[index]->prepareMesh();
+}
+
+/* Building the render mesh is usually the most expensive part of exporting a
+ * frame, and unlike writing to the archive it does not need to be serial for
+ * objects which are not affected by simulations. */
+void AbcExporter::prepareParallelMeshes()
+{
+	const int num_meshes = m_parallel_meshes.size();
+
+	if (num_meshes == 0) {
+		return;
+	}
+
+	BLI_task_parallel_range(0, num_meshes, &m_parallel_meshes[0], prepare_mesh_cb, num_meshes > 1);
+}
+
 void AbcExporter::createShapeWriter(Object *ob, Object *dupliObParent)
 {
 	if (!object_type_is_exportable(ob)) {
@@ -578,7 +642,19 @@ void AbcExporter::createShapeWriter(Object *ob, Object *dupliObParent)
 				return;
 			}
 
-			m_shapes.push_back(new AbcMeshWriter(m_scene, ob, xform, m_shape_sampling_index, m_settings));
+			AbcMeshWriter *writer = new AbcMeshWriter(m_scene, ob, xform, m_shape_sampling_index, m_settings);
+			m_shapes.push_back(writer);
+
+			/* Objects instanced multiple times share their modifier stack, and
+			 * objects sharing a mesh may update it lazily (texture space), so
+			 * only one writer of each may build the mesh in parallel. */
+			if (object_mesh_is_parallel_safe(m_scene, ob) &&
+			    m_parallel_mesh_data.find(&me->id) == m_parallel_mesh_data.end() &&
+			    m_parallel_mesh_objects.insert(ob).second)
+			{
+				m_parallel_mesh_data.insert(&me->id);
+				m_parallel_meshes.push_back(writer);
+			}
 			break;
 		}
 		case OB_SURF:
@@ -30,11 +30,13 @@
 
 #include "abc_util.h"
 
+class AbcMeshWriter;
 class AbcObjectWriter;
 class AbcTransformWriter;
 class ArchiveWriter;
 
 struct EvaluationContext;
+struct ID;
 struct Main;
 struct Object;
 struct Scene;
@@ -97,6 +99,13 @@ class AbcExporter {
 
 	std::vector<AbcObjectWriter *> m_shapes;
 
+	/* Mesh writers whose objects do not depend on simulation state or other
+	 * objects, so their meshes can be created in parallel before writing a
+	 * frame. */
+	std::vector<AbcMeshWriter *> m_parallel_meshes;
+	std::set<Object *> m_parallel_mesh_objects;
+	std::set<ID *> m_parallel_mesh_data;
+
 public:
 	AbcExporter(Scene *scene, const char *filename, ExportSettings &settings);
 	~AbcExporter();
@@ -118,6 +127,7 @@ private:
 	void createShapeWriters(EvaluationContext *eval_ctx);
 	void createShapeWriter(Object *ob, Object *dupliObParent);
 	void createParticleSystemsWriters(Object *ob, AbcTransformWriter *xform);
+	void prepareParallelMeshes();
 
 	AbcTransformWriter *getXForm(const std::string &name);
 
@@ -297,6 +297,7 @@ AbcMeshWriter::AbcMeshWriter(Scene *scene,
 	m_is_animated = isAnimated();
 	m_subsurf_mod = NULL;
 	m_is_subd = false;
+	m_prepared_dm = NULL;
 
 	/* If the object is static, use the default static time sampling. */
 	if (!m_is_animated) {
@@ -330,6 +331,10 @@ AbcMeshWriter::AbcMeshWriter(Scene *scene,
 
 AbcMeshWriter::~AbcMeshWriter()
 {
+	if (m_prepared_dm) {
+		freeMesh(m_prepared_dm);
+	}
+
 	if (m_subsurf_mod) {
 		m_subsurf_mod->mode &= ~eModifierMode_DisableTemporary;
 	}
@@ -358,13 +363,24 @@ bool AbcMeshWriter::isAnimated() const
 	return me->adt != NULL;
 }
 
+void AbcMeshWriter::prepareMesh()
+{
+	/* We have already stored a sample for this object. */
+	if (!m_first_frame && !m_is_animated)
+		return;
+
+	BLI_assert(m_prepared_dm == NULL);
+	m_prepared_dm = getFinalMesh();
+}
+
 void AbcMeshWriter::do_write()
 {
 	/* We have already stored a sample for this object. */
 	if (!m_first_frame && !m_is_animated)
 		return;
 
-	DerivedMesh *dm = getFinalMesh();
+	DerivedMesh *dm = (m_prepared_dm != NULL) ? m_prepared_dm : getFinalMesh();
+	m_prepared_dm = NULL;
 
 	try {
 		if (m_settings.use_subdiv_schema && m_subdiv_schema.valid()) {
@@ -49,6 +49,9 @@ class AbcMeshWriter : public AbcObjectWriter {
 	bool m_is_liquid;
 	bool m_is_subd;
 
+	/* Mesh created by prepareMesh(), written and freed by do_write(). */
+	DerivedMesh *m_prepared_dm;
+
 public:
 	AbcMeshWriter(Scene *scene,
 	              Object *ob,
@@ -58,6 +61,11 @@ public:
 
 	~AbcMeshWriter();
 
+	/* Create the mesh for the current frame ahead of writing it. Safe to call
+	 * from multiple threads for writers of different objects.
+	 */
+	void prepareMesh();
+
 private:
 	virtual void do_write();
 
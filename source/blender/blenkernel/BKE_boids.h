@@ -50,12 +50,20 @@ typedef struct BoidBrainData {
 	float goal_nor[3];
 	float goal_priority;
 
+	/* Set by the brain and applied afterwards, so that other boids thinking at
+	 * the same time always see the state from the start of the step. */
+	struct ParticleData *enemy_pa;    /* enemy hit in a fight, see boid_apply_damage() */
+	float enemy_damage;
+	float jump_vel[3];                /* new velocity when jumping, applied by boid_body() */
+	bool jump;
+
 	struct RNG *rng;
 } BoidBrainData;
 
 void boids_precalc_rules(struct ParticleSettings *part, float cfra);
 void boid_brain(BoidBrainData *bbd, int p, struct ParticleData *pa);
 void boid_body(BoidBrainData *bbd, struct ParticleData *pa);
+void boid_apply_damage(BoidBrainData *bbd);
 void boid_default_settings(BoidSettings *boids);
 BoidRule *boid_new_rule(int type);
 BoidState *boid_new_state(BoidSettings *boids);
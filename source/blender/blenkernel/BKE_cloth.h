@@ -96,6 +96,7 @@ typedef struct Cloth {
 	struct BVHTree 		*bvhselftree;			/* collision tree for this cloth object */
 	struct MVertTri		*tri;
 	struct Implicit_Data	*implicit; 		/* our implicit solver connects to this pointer */
+	struct ClothSpringBatches *spring_batches;	/* springs grouped for computing forces in parallel, owned by the solver */
 	int last_frame;
 	float adapt_fact;	/* Stability dt compensation factor */
 	float max_col_trouble;
@@ -190,6 +191,7 @@ typedef enum {
 typedef enum {
 	CLOTH_COLLSETTINGS_FLAG_ENABLED = ( 1 << 1 ), /* enables cloth - object collisions */
 	CLOTH_COLLSETTINGS_FLAG_SELF = ( 1 << 2 ), /* enables selfcollisions */
+	CLOTH_COLLSETTINGS_FLAG_SELF_CCD = ( 1 << 3 ), /* continuous selfcollision detection */
 } CLOTH_COLLISIONSETTINGS_FLAGS;
 
 /* Spring types as defined in the paper.*/
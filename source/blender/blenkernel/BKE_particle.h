@@ -62,6 +62,7 @@ struct RNG;
 struct BVHTreeRay;
 struct BVHTreeRayHit; 
 struct EdgeHash;
+struct SPHGrid;
 
 #define PARTICLE_COLLISION_MAX_COLLISIONS 10
 
@@ -235,6 +236,8 @@ typedef struct ParticleCollision {
 	float acc[3], boid_z;
 
 	int boid;
+
+	unsigned int seed;  /* for random damping & permeability, advanced on every use */
 } ParticleCollision;
 
 typedef struct ParticleDrawData {
@@ -352,6 +355,7 @@ void psys_apply_child_modifiers(struct ParticleThreadContext *ctx, struct ListBa
 void psys_sph_init(struct ParticleSimulationData *sim, struct SPHData *sphdata);
 void psys_sph_finalise(struct SPHData *sphdata);
 void psys_sph_density(struct BVHTree *tree, struct SPHData *data, float co[3], float vars[2]);
+void psys_sph_grid_free(struct SPHGrid *grid);
 
 /* for anim.c */
 void psys_get_dupli_texture(struct ParticleSystem *psys, struct ParticleSettings *part,
@@ -287,6 +287,9 @@ void BKE_ptcache_ids_from_object(struct ListBase *lb, struct Object *ob, struct
 /***************** Global funcs ****************************/
 void BKE_ptcache_remove(void);
 
+void BKE_ptcache_io_init(void);
+void BKE_ptcache_io_exit(void);
+
 /************ ID specific functions ************************/
 void    BKE_ptcache_id_clear(PTCacheID *id, int mode, unsigned int cfra);
 int     BKE_ptcache_id_exist(PTCacheID *id, int cfra);
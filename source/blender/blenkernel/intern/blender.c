@@ -57,6 +57,7 @@
 #include "BKE_image.h"
 #include "BKE_library.h"
 #include "BKE_node.h"
+#include "BKE_pointcache.h"
 #include "BKE_report.h"
 #include "BKE_scene.h"
 #include "BKE_screen.h"
@@ -86,6 +87,7 @@ void BKE_blender_free(void)
 	
 	IMB_exit();
 	BKE_cachefiles_exit();
+	BKE_ptcache_io_exit();
 	BKE_images_exit();
 	DAG_exit();
 
@@ -73,6 +73,9 @@
 
 #define UNDO_DISK   0
 
+/* Compress memfile data not used by the last two undo steps. */
+#define USE_UNDO_COMPRESS
+
 typedef struct UndoElem {
 	struct UndoElem *next, *prev;
 	char str[FILE_MAX];
@@ -110,7 +113,7 @@ static int read_undosave(bContext *C, UndoElem *uel)
 	if (UNDO_DISK)
 		success = (BKE_blendfile_read(C, uel->str, NULL, 0) != BKE_BLENDFILE_READ_FAIL);
 	else
-		success = BKE_blendfile_read_from_memfile(C, &uel->memfile, NULL, 0);
+		success = BKE_blendfile_read_from_memfile(C, &uel->memfile, NULL, BLO_READ_SKIP_UNCHANGED);
 
 	/* restore */
 	BLI_strncpy(G.main->name, mainstr, sizeof(G.main->name)); /* restore */
@@ -197,6 +200,13 @@ void BKE_undo_write(bContext *C, const char *name)
 		memused = MEM_get_memory_in_use();
 		/* success = */ /* UNUSED */ BLO_write_file_mem(CTX_data_main(C), prevfile, &curundo->memfile, G.fileflags);
 		curundo->undosize = MEM_get_memory_in_use() - memused;
+
+#ifdef USE_UNDO_COMPRESS
+		{
+			MemFile *memfiles_hot[2] = {&curundo->memfile, prevfile};
+			BLO_memfile_compress_cold(memfiles_hot, ARRAY_SIZE(memfiles_hot));
+		}
+#endif
 	}
 
 	if (U.undomemory != 0) {
@@ -370,7 +380,7 @@ bool BKE_undo_save_file(const char *filename)
 	}
 
 	for (chunk = uel->memfile.chunks.first; chunk; chunk = chunk->next) {
-		if (write(file, chunk->buf, chunk->size) != chunk->size) {
+		if (write(file, BLO_memfile_chunk_data(chunk), chunk->size) != chunk->size) {
 			break;
 		}
 	}
@@ -696,8 +696,8 @@ static int rule_fight(BoidRule *rule, BoidBrainData *bbd, BoidValues *val, Parti
 
 			/* must face enemy to fight */
 			if (dot_v3v3(pa->prev_state.ave, enemy_dir)>0.5f) {
-				bpa = enemy_pa->boid;
-				bpa->data.health -= bbd->part->boids->strength * bbd->timestep * ((1.0f-bbd->part->boids->accuracy)*damage + bbd->part->boids->accuracy);
+				bbd->enemy_pa = enemy_pa;
+				bbd->enemy_damage = bbd->part->boids->strength * bbd->timestep * ((1.0f-bbd->part->boids->accuracy)*damage + bbd->part->boids->accuracy);
 			}
 		}
 		else {
@@ -972,6 +972,10 @@ void boid_brain(BoidBrainData *bbd, int p, ParticleData *pa)
 	int rand;
 	//BoidCondition *cond;
 
+	bbd->enemy_pa = NULL;
+	bbd->enemy_damage = 0.0f;
+	bbd->jump = false;
+
 	if (bpa->data.health <= 0.0f) {
 		pa->alive = PARS_DYING;
 		pa->dietime = bbd->cfra;
@@ -1110,12 +1114,19 @@ void boid_brain(BoidBrainData *bbd, int p, ParticleData *pa)
 			}
 
 			if (jump) {
-				copy_v3_v3(pa->prev_state.vel, jump_v);
+				copy_v3_v3(bbd->jump_vel, jump_v);
+				bbd->jump = true;
 				bpa->data.mode = eBoidMode_Falling;
 			}
 		}
 	}
 }
+/* applies the damage dealt by boid_brain(), once all boids have chosen their actions */
+void boid_apply_damage(BoidBrainData *bbd)
+{
+	if (bbd->enemy_pa)
+		bbd->enemy_pa->boid->data.health -= bbd->enemy_damage;
+}
 /* tries to realize the wanted velocity taking all constraints into account */
 void boid_body(BoidBrainData *bbd, ParticleData *pa)
 {
@@ -1135,6 +1146,9 @@ void boid_body(BoidBrainData *bbd, ParticleData *pa)
 
 	set_boid_values(&val, boids, pa);
 
+	if (bbd->jump)
+		copy_v3_v3(pa->prev_state.vel, bbd->jump_vel);
+
 	/* make sure there's something in new velocity, location & rotation */
 	copy_particle_key(&pa->state, &pa->prev_state, 0);
 
@@ -82,6 +82,7 @@ typedef struct SelfColDetectData {
 	BVHTreeOverlap *overlap;
 	CollPair *collisions;
 	unsigned int *colind;
+	bool use_ccd;
 } SelfColDetectData;
 
 /***********************************
@@ -1019,6 +1020,307 @@ static int cloth_selfcollision_response_static(ClothModifierData *clmd, CollPair
 #  pragma GCC diagnostic pop
 #endif
 
+/* Continuous self collision detection.
+ *
+ * Within a step cloth vertices move linearly from txold to tx, so a vertex and a face, or two edges, can only touch
+ * when their four points are coplanar. The coplanarity times are the roots of a cubic in [0, 1], which are checked
+ * for proximity in order, so the earliest contact is found even if the triangles passed through each other. */
+
+#define CCD_ROOT_ITER 24
+
+BLI_INLINE float ccd_cubic_eval(const float c[4], const float t)
+{
+	return ((c[3] * t + c[2]) * t + c[1]) * t + c[0];
+}
+
+/* Root of the cubic in [t0, t1], where it is known to change sign. */
+static float ccd_cubic_bisect(const float c[4], float t0, float t1, float f0)
+{
+	for (int i = 0; i < CCD_ROOT_ITER; i++) {
+		const float tm = 0.5f * (t0 + t1);
+		const float fm = ccd_cubic_eval(c, tm);
+
+		if ((fm < 0.0f) == (f0 < 0.0f)) {
+			t0 = tm;
+			f0 = fm;
+		}
+		else {
+			t1 = tm;
+		}
+	}
+
+	return 0.5f * (t0 + t1);
+}
+
+/* Times in [0, 1] at which the four points x + t * v are coplanar, in increasing order. */
+static int ccd_coplanar_times(float x[4][3], float v[4][3], float r_t[3])
+{
+	float p[3], q[3], r[3], dp[3], dq[3], dr[3];
+	float pq[3], dpdq[3], mix[3], tmp[3];
+	float c[4], split[4];
+	int split_num = 0, root_num = 0;
+
+	sub_v3_v3v3(p, x[1], x[0]);
+	sub_v3_v3v3(q, x[2], x[0]);
+	sub_v3_v3v3(r, x[3], x[0]);
+	sub_v3_v3v3(dp, v[1], v[0]);
+	sub_v3_v3v3(dq, v[2], v[0]);
+	sub_v3_v3v3(dr, v[3], v[0]);
+
+	cross_v3_v3v3(pq, p, q);
+	cross_v3_v3v3(dpdq, dp, dq);
+	cross_v3_v3v3(mix, dp, q);
+	cross_v3_v3v3(tmp, p, dq);
+	add_v3_v3(mix, tmp);
+
+	/* (p + t * dp) x (q + t * dq) . (r + t * dr) */
+	c[0] = dot_v3v3(pq, r);
+	c[1] = dot_v3v3(mix, r) + dot_v3v3(pq, dr);
+	c[2] = dot_v3v3(dpdq, r) + dot_v3v3(mix, dr);
+	c[3] = dot_v3v3(dpdq, dr);
+
+	/* Split [0, 1] at the extrema, so each interval holds at most one root. */
+	split[split_num++] = 0.0f;
+	{
+		const float a = 3.0f * c[3], b = 2.0f * c[2];
+		float e[2];
+		int e_num = 0;
+
+		if (fabsf(a) > FLT_EPSILON * fabsf(b)) {
+			const float disc = b * b - 4.0f * a * c[1];
+
+			if (disc > 0.0f) {
+				const float s = sqrtf(disc);
+				e[0] = (-b - s) / (2.0f * a);
+				e[1] = (-b + s) / (2.0f * a);
+				if (e[0] > e[1]) {
+					SWAP(float, e[0], e[1]);
+				}
+				e_num = 2;
+			}
+		}
+		else if (b != 0.0f) {
+			e[0] = -c[1] / b;
+			e_num = 1;
+		}
+
+		for (int i = 0; i < e_num; i++) {
+			if (e[i] > 0.0f && e[i] < 1.0f) {
+				split[split_num++] = e[i];
+			}
+		}
+	}
+	split[split_num++] = 1.0f;
+
+	for (int i = 0; i < split_num - 1; i++) {
+		const float f0 = ccd_cubic_eval(c, split[i]);
+		const float f1 = ccd_cubic_eval(c, split[i + 1]);
+
+		if (i == 0 && f0 == 0.0f) {
+			r_t[root_num++] = split[i];
+		}
+		else if (f1 == 0.0f) {
+			r_t[root_num++] = split[i + 1];
+		}
+		else if ((f0 < 0.0f) != (f1 < 0.0f)) {
+			r_t[root_num++] = ccd_cubic_bisect(c, split[i], split[i + 1], f0);
+		}
+	}
+
+	return root_num;
+}
+
+/* Vertex x[0] against face x[1], x[2], x[3]. */
+static bool ccd_vert_face(float x[4][3], float v[4][3], const float epsilon, float *r_t, float r_w[3], float r_no[3])
+{
+	float t[3];
+	const int t_num = ccd_coplanar_times(x, v, t);
+
+	for (int i = 0; i < t_num; i++) {
+		float xt[4][3], co[3];
+
+		for (int j = 0; j < 4; j++) {
+			madd_v3_v3v3fl(xt[j], x[j], v[j], t[i]);
+		}
+
+		closest_on_tri_to_point_v3(co, xt[0], xt[1], xt[2], xt[3]);
+
+		if (len_squared_v3v3(co, xt[0]) < epsilon * epsilon) {
+			interp_weights_tri_v3(r_w, xt[1], xt[2], xt[3], co);
+			normal_tri_v3(r_no, xt[1], xt[2], xt[3]);
+			*r_t = t[i];
+
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/* Edge x[0], x[1] against edge x[2], x[3]. */
+static bool ccd_edge_edge(float x[4][3], float v[4][3], const float epsilon, float *r_t, float r_f[2], float r_no[3])
+{
+	float t[3];
+	const int t_num = ccd_coplanar_times(x, v, t);
+
+	for (int i = 0; i < t_num; i++) {
+		float xt[4][3], co_a[3], co_b[3];
+
+		for (int j = 0; j < 4; j++) {
+			madd_v3_v3v3fl(xt[j], x[j], v[j], t[i]);
+		}
+
+		if (isect_seg_seg(xt[0], xt[1], xt[2], xt[3], co_a, co_b) &&
+		    (len_squared_v3v3(co_a, co_b) < epsilon * epsilon))
+		{
+			float ea[3], eb[3];
+
+			sub_v3_v3v3(ea, xt[1], xt[0]);
+			sub_v3_v3v3(eb, xt[3], xt[2]);
+			cross_v3_v3v3(r_no, ea, eb);
+
+			if (normalize_v3(r_no) < FLT_EPSILON) {
+				continue;
+			}
+
+			r_f[0] = line_point_factor_v3(co_a, xt[0], xt[1]);
+			r_f[1] = line_point_factor_v3(co_b, xt[2], xt[3]);
+			*r_t = t[i];
+
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/* Earliest contact between two cloth triangles moving from txold to tx, filled into collpair like the discrete test
+ * does, with the normal pointing from b to a and the contact points on the end positions. */
+static bool cloth_selfcollision_ccd(const ClothVertex *verts, const MVertTri *tri_a, const MVertTri *tri_b,
+                                    const float epsilon, CollPair *collpair)
+{
+	float xa[3][3], va[3][3], xb[3][3], vb[3][3];
+	float wa[3] = {0.0f}, wb[3] = {0.0f}, normal[3] = {0.0f};
+	float vel_a[3], vel_b[3], rel_vel[3];
+	float x[4][3], v[4][3], t, w[3], no[3];
+	float t_min = FLT_MAX;
+	bool moving = false;
+
+	for (int i = 0; i < 3; i++) {
+		copy_v3_v3(xa[i], verts[tri_a->tri[i]].txold);
+		sub_v3_v3v3(va[i], verts[tri_a->tri[i]].tx, xa[i]);
+		copy_v3_v3(xb[i], verts[tri_b->tri[i]].txold);
+		sub_v3_v3v3(vb[i], verts[tri_b->tri[i]].tx, xb[i]);
+
+		moving |= !is_zero_v3(va[i]) || !is_zero_v3(vb[i]);
+	}
+
+	if (!moving) {
+		return false;
+	}
+
+	/* Vertices of a against face b */
+	copy_v3_v3(x[1], xb[0]); copy_v3_v3(x[2], xb[1]); copy_v3_v3(x[3], xb[2]);
+	copy_v3_v3(v[1], vb[0]); copy_v3_v3(v[2], vb[1]); copy_v3_v3(v[3], vb[2]);
+
+	for (int i = 0; i < 3; i++) {
+		copy_v3_v3(x[0], xa[i]);
+		copy_v3_v3(v[0], va[i]);
+
+		if (ccd_vert_face(x, v, epsilon, &t, w, no) && (t < t_min)) {
+			t_min = t;
+			zero_v3(wa);
+			wa[i] = 1.0f;
+			copy_v3_v3(wb, w);
+			copy_v3_v3(normal, no);
+		}
+	}
+
+	/* Vertices of b against face a */
+	copy_v3_v3(x[1], xa[0]); copy_v3_v3(x[2], xa[1]); copy_v3_v3(x[3], xa[2]);
+	copy_v3_v3(v[1], va[0]); copy_v3_v3(v[2], va[1]); copy_v3_v3(v[3], va[2]);
+
+	for (int i = 0; i < 3; i++) {
+		copy_v3_v3(x[0], xb[i]);
+		copy_v3_v3(v[0], vb[i]);
+
+		if (ccd_vert_face(x, v, epsilon, &t, w, no) && (t < t_min)) {
+			t_min = t;
+			copy_v3_v3(wa, w);
+			zero_v3(wb);
+			wb[i] = 1.0f;
+			copy_v3_v3(normal, no);
+		}
+	}
+
+	/* Edges of a against edges of b */
+	for (int i = 0; i < 3; i++) {
+		for (int j = 0; j < 3; j++) {
+			float f[2];
+
+			copy_v3_v3(x[0], xa[i]); copy_v3_v3(x[1], xa[next_ind(i)]);
+			copy_v3_v3(x[2], xb[j]); copy_v3_v3(x[3], xb[next_ind(j)]);
+			copy_v3_v3(v[0], va[i]); copy_v3_v3(v[1], va[next_ind(i)]);
+			copy_v3_v3(v[2], vb[j]); copy_v3_v3(v[3], vb[next_ind(j)]);
+
+			if (ccd_edge_edge(x, v, epsilon, &t, f, no) && (t < t_min)) {
+				t_min = t;
+				zero_v3(wa);
+				wa[i] = 1.0f - f[0];
+				wa[next_ind(i)] = f[0];
+				zero_v3(wb);
+				wb[j] = 1.0f - f[1];
+				wb[next_ind(j)] = f[1];
+				copy_v3_v3(normal, no);
+			}
+		}
+	}
+
+	if (t_min == FLT_MAX) {
+		return false;
+	}
+
+	/* The contact points approach each other along the normal when it points from b to a. */
+	zero_v3(vel_a);
+	zero_v3(vel_b);
+	for (int i = 0; i < 3; i++) {
+		madd_v3_v3fl(vel_a, va[i], wa[i]);
+		madd_v3_v3fl(vel_b, vb[i], wb[i]);
+	}
+	sub_v3_v3v3(rel_vel, vel_b, vel_a);
+
+	if (fabsf(dot_v3v3(rel_vel, normal)) < FLT_EPSILON) {
+		return false;
+	}
+	else if (dot_v3v3(rel_vel, normal) < 0.0f) {
+		negate_v3(normal);
+	}
+
+	collpair->ap1 = tri_a->tri[0];
+	collpair->ap2 = tri_a->tri[1];
+	collpair->ap3 = tri_a->tri[2];
+
+	collpair->bp1 = tri_b->tri[0];
+	collpair->bp2 = tri_b->tri[1];
+	collpair->bp3 = tri_b->tri[2];
+
+	zero_v3(collpair->pa);
+	zero_v3(collpair->pb);
+	for (int i = 0; i < 3; i++) {
+		madd_v3_v3fl(collpair->pa, verts[tri_a->tri[i]].tx, wa[i]);
+		madd_v3_v3fl(collpair->pb, verts[tri_b->tri[i]].tx, wb[i]);
+	}
+
+	copy_v3_v3(collpair->normal, normal);
+	copy_v3_v3(collpair->vector, normal);
+
+	collpair->distance = 0.0f;
+	collpair->time = t_min;
+	collpair->flag = 0;
+
+	return true;
+}
+
 //Determines collisions on overlap, collisions are written to collpair[i] and collision+number_collision_found is returned
 static void cloth_collision(void *userdata, void *UNUSED(userdata_chunk), const int index, const int UNUSED(threadid))
 {
@@ -1129,6 +1431,17 @@ static void cloth_selfcollision(void *userdata, void *UNUSED(userdata_chunk), co
 		collpair[ind].distance = distance;
 		collpair[ind].flag = 0;
 	}
+	else if (data->use_ccd) {
+		CollPair ccd_collpair;
+
+		if (cloth_selfcollision_ccd(verts1, tri_a, tri_b, epsilon, &ccd_collpair)) {
+			int ind;
+
+			ind = atomic_add_and_fetch_u(colind, 1);
+
+			collpair[ind] = ccd_collpair;
+		}
+	}
 }
 
 static void add_collision_object(Object ***objs, unsigned int *numobj, unsigned int *maxobj, Object *ob, Object *self, int level, unsigned int modifier_type)
@@ -1300,16 +1613,18 @@ static void cloth_bvh_objcollisions_nearcheck(ClothModifierData * clmd, Collisio
 }
 
 static void cloth_bvh_selfcollisions_nearcheck(ClothModifierData * clmd, CollPair *collisions, unsigned int *colind,
-                                               int numresult, BVHTreeOverlap *overlap)
+                                               int numresult, BVHTreeOverlap *overlap, bool use_ccd)
 {
 	*colind = -1;
 
 	SelfColDetectData data = {.clmd = clmd,
 	                          .overlap = overlap,
 	                          .collisions = collisions,
-	                          .colind = colind};
+	                          .colind = colind,
+	                          .use_ccd = use_ccd};
 
-	BLI_task_parallel_range_ex(0, numresult, &data, NULL, 0, cloth_selfcollision, true, false);
+	/* Continuous tests only run for pairs the discrete test misses, so their cost varies a lot between pairs. */
+	BLI_task_parallel_range_ex(0, numresult, &data, NULL, 0, cloth_selfcollision, true, use_ccd);
 }
 
 static int cloth_bvh_objcollisions_resolve (ClothModifierData * clmd, Object **collobjs, CollPair **collisions,
@@ -1432,6 +1747,7 @@ int cloth_bvh_objcollision(Object *ob, ClothModifierData *clmd, float step, floa
 	int ret = 0, ret2 = 0;
 	Object **collobjs = NULL;
 	unsigned int numcollobj = 0;
+	const bool use_self_ccd = (clmd->coll_parms->flags & CLOTH_COLLSETTINGS_FLAG_SELF_CCD) != 0;
 
 	if ((clmd->sim_parms->flags & CLOTH_SIMSETTINGS_FLAG_COLLOBJ) || cloth_bvh==NULL)
 		return 0;
@@ -1464,7 +1780,7 @@ int cloth_bvh_objcollision(Object *ob, ClothModifierData *clmd, float step, floa
 		}
 	}
 
-	if (clmd->coll_parms->flags & CLOTH_COLLSETTINGS_FLAG_SELF) {
+	if ((clmd->coll_parms->flags & CLOTH_COLLSETTINGS_FLAG_SELF) && !use_self_ccd) {
 		bvhtree_update_from_cloth(clmd, false, true);
 	}
 
@@ -1533,13 +1849,18 @@ int cloth_bvh_objcollision(Object *ob, ClothModifierData *clmd, float step, floa
 			verts = cloth->verts;
 
 			if ( cloth->bvhselftree ) {
+				/* refit on the triangles swept from txold to tx, which change with every round */
+				if (use_self_ccd) {
+					bvhtree_update_from_cloth(clmd, true, true);
+				}
+
 				// search for overlapping collision pairs
 				overlap = BLI_bvhtree_overlap(cloth->bvhselftree, cloth->bvhselftree, &result, NULL, NULL);
 
 				if (result && overlap) {
 					collisions = (CollPair *)MEM_mallocN(sizeof(CollPair) * result, "collision array");
 
-					cloth_bvh_selfcollisions_nearcheck(clmd, collisions, &collisions_index, result, overlap);
+					cloth_bvh_selfcollisions_nearcheck(clmd, collisions, &collisions_index, result, overlap, use_self_ccd);
 
 					ret += cloth_bvh_selfcollisions_resolve(clmd, collisions,  collisions_index, dt);
 					ret2 += ret;
@@ -34,6 +34,7 @@
 
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "MEM_guardedalloc.h"
 
@@ -49,6 +50,7 @@
 
 #include "BLI_math.h"
 #include "BLI_blenlib.h"
+#include "BLI_hash.h"
 #include "BLI_noise.h"
 #include "BLI_rand.h"
 #include "BLI_utildefines.h"
@@ -272,10 +274,6 @@ void pdEndEffectors(ListBase **effectors)
 static void precalculate_effector(EffectorCache *eff)
 {
 	unsigned int cfra = (unsigned int)(eff->scene->r.cfra >= 0 ? eff->scene->r.cfra : -eff->scene->r.cfra);
-	if (!eff->pd->rng)
-		eff->pd->rng = BLI_rng_new(eff->pd->seed + cfra);
-	else
-		BLI_rng_srandom(eff->pd->rng, eff->pd->seed + cfra);
 
 	if (eff->pd->forcefield == PFIELD_GUIDE && eff->ob->type==OB_CURVE) {
 		Curve *cu= eff->ob->data;
@@ -448,11 +446,27 @@ static float eff_calc_visibility(ListBase *colliders, EffectorCache *eff, Effect
 	return visibility;
 }
 
+/* Noise is hashed from the point instead of drawn from a shared generator,
+ * so it does not depend on the order (or thread) points are evaluated in. */
+static unsigned int wind_seed(EffectorCache *eff, EffectedPoint *point)
+{
+	unsigned int cfra = (unsigned int)(eff->scene->r.cfra >= 0 ? eff->scene->r.cfra : -eff->scene->r.cfra);
+	unsigned int seed = BLI_hash_int_2d(eff->pd->seed + cfra, (unsigned int)point->index);
+	unsigned int loc[3];
+	int i;
+
+	memcpy(loc, point->loc, sizeof(loc));
+	for (i = 0; i < 3; i++)
+		seed = BLI_hash_int_2d(seed, loc[i]);
+
+	return seed;
+}
+
 // noise function for wind e.g.
-static float wind_func(struct RNG *rng, float strength)
+static float wind_func(unsigned int seed, float strength)
 {
-	int random = (BLI_rng_get_int(rng)+1) % 128; // max 2357
-	float force = BLI_rng_get_float(rng) + 1.0f;
+	int random = (int)(BLI_hash_int(seed) % 128); // max 2357
+	float force = BLI_hash_frand(seed) + 1.0f;
 	float ret;
 	float sign = 0;
 	
@@ -825,7 +839,6 @@ static void do_texture_effector(EffectorCache *eff, EffectorData *efd, EffectedP
 static void do_physical_effector(EffectorCache *eff, EffectorData *efd, EffectedPoint *point, float *total_force)
 {
 	PartDeflect *pd = eff->pd;
-	RNG *rng = pd->rng;
 	float force[3] = {0, 0, 0};
 	float temp[3];
 	float fac;
@@ -834,10 +847,12 @@ static void do_physical_effector(EffectorCache *eff, EffectorData *efd, Effected
 	float noise_factor = pd->f_noise;
 
 	if (noise_factor > 0.0f) {
-		strength += wind_func(rng, noise_factor);
+		unsigned int seed = wind_seed(eff, point);
+
+		strength += wind_func(seed, noise_factor);
 
 		if (ELEM(pd->forcefield, PFIELD_HARMONIC, PFIELD_DRAG))
-			damp += wind_func(rng, noise_factor);
+			damp += wind_func(seed + 1, noise_factor);
 	}
 
 	copy_v3_v3(force, efd->vec_to_point);
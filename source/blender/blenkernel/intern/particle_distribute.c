@@ -38,6 +38,7 @@
 #include "BLI_utildefines.h"
 #include "BLI_jitter.h"
 #include "BLI_kdtree.h"
+#include "BLI_hash_mm2a.h"
 #include "BLI_math.h"
 #include "BLI_rand.h"
 #include "BLI_sort.h"
@@ -740,6 +741,77 @@ static int distribute_compare_orig_index(const void *p1, const void *p2, void *u
 		return 1;
 }
 
+typedef struct DistributeAreaData {
+	const MFace *mface;
+	const MVert *mvert;
+	float (*vert_cos)[3];  /* transformed orco, used instead of mvert if set */
+	float *element_weight;
+} DistributeAreaData;
+
+static void distribute_area_task_cb(void *__restrict userdata, const int start, const int stop, const int UNUSED(thread_id))
+{
+	DistributeAreaData *data = userdata;
+	int i;
+
+	for (i = start; i < stop; i++) {
+		const MFace *mf = &data->mface[i];
+		const float *co1, *co2, *co3, *co4 = NULL;
+
+		if (data->vert_cos) {
+			co1 = data->vert_cos[mf->v1];
+			co2 = data->vert_cos[mf->v2];
+			co3 = data->vert_cos[mf->v3];
+			if (mf->v4)
+				co4 = data->vert_cos[mf->v4];
+		}
+		else {
+			co1 = data->mvert[mf->v1].co;
+			co2 = data->mvert[mf->v2].co;
+			co3 = data->mvert[mf->v3].co;
+			if (mf->v4)
+				co4 = data->mvert[mf->v4].co;
+		}
+
+		data->element_weight[i] = mf->v4 ? area_quad_v3(co1, co2, co3, co4) : area_tri_v3(co1, co2, co3);
+	}
+}
+
+typedef struct DistributeRandomData {
+	float *element_sum;
+	const int *element_map;
+	int totmapped;
+
+	int *particle_element;
+	float *particle_pos;
+
+	unsigned int seed;
+} DistributeRandomData;
+
+/* Each range draws the same random numbers BLI_frand() would give it when
+ * seeded with the same seed and stepping through all particles in order.
+ * BLI_rng_skip() jumps ahead in O(log n), so ranges can start anywhere. */
+static void distribute_random_task_cb(void *__restrict userdata, const int start, const int stop, const int UNUSED(thread_id))
+{
+	DistributeRandomData *data = userdata;
+	RNG *rng = BLI_rng_new_srandom(data->seed);
+	int p;
+
+	BLI_rng_skip(rng, start);
+
+	for (p = start; p < stop; p++) {
+		/* In theory element_sum[totmapped - 1] should be 1.0,
+		 * but due to float errors this is not necessarily always true, so scale pos accordingly. */
+		const float pos = BLI_rng_get_float(rng) * data->element_sum[data->totmapped - 1];
+		const int eidx = distribute_binary_search(data->element_sum, data->totmapped, pos);
+		data->particle_element[p] = data->element_map[eidx];
+		data->particle_pos[p] = pos;
+		BLI_assert(pos <= data->element_sum[eidx]);
+		BLI_assert(eidx ? (pos > data->element_sum[eidx - 1]) : (pos >= 0.0f));
+	}
+
+	BLI_rng_free(rng);
+}
+
 static void distribute_invalid(Scene *scene, ParticleSystem *psys, int from)
 {
 	if (from == PART_FROM_CHILD) {
@@ -784,6 +856,7 @@ static int psys_thread_context_init_distribute(ParticleThreadContext *ctx, Parti
 	int cfrom=0;
 	int totelem=0, totpart, *particle_element=0, children=0, totseam=0;
 	int jitlevel= 1, distr;
+	unsigned int seed;
 	float *element_weight=NULL,*jitter_offset=NULL, *vweight=NULL;
 	float cur, maxweight=0.0, tweight, totweight, inv_totweight, co[3], nor[3], orco[3];
 	
@@ -843,7 +916,8 @@ static int psys_thread_context_init_distribute(ParticleThreadContext *ctx, Parti
 	/* Create trees and original coordinates if needed */
 	if (from == PART_FROM_CHILD) {
 		distr=PART_DISTR_RAND;
-		BLI_srandom(31415926 + psys->seed + psys->child_seed);
+		seed = 31415926 + psys->seed + psys->child_seed;
+		BLI_srandom(seed);
 		dm= finaldm;
 
 		/* BMESH ONLY */
@@ -866,7 +940,8 @@ static int psys_thread_context_init_distribute(ParticleThreadContext *ctx, Parti
 	}
 	else {
 		distr = part->distr;
-		BLI_srandom(31415926 + psys->seed);
+		seed = 31415926 + psys->seed;
+		BLI_srandom(seed);
 		
 		if (psys->part->use_modifier_stack)
 			dm = finaldm;
@@ -925,46 +1000,36 @@ static int psys_thread_context_init_distribute(ParticleThreadContext *ctx, Parti
 
 	/* Calculate weights from face areas */
 	if ((part->flag&PART_EDISTR || children) && from != PART_FROM_VERT) {
-		MVert *v1, *v2, *v3, *v4;
-		float totarea=0.f, co1[3], co2[3], co3[3], co4[3];
+		DistributeAreaData area_data;
+		float totarea=0.f;
 		float (*orcodata)[3];
 		
 		orcodata= dm->getVertDataArray(dm, CD_ORCO);
 
+		area_data.mface = dm->getTessFaceDataArray(dm, CD_MFACE);
+		area_data.element_weight = element_weight;
+		area_data.vert_cos = NULL;
+		area_data.mvert = NULL;
+
+		if (orcodata) {
+			area_data.vert_cos = MEM_dupallocN(orcodata);
+			BKE_mesh_orco_verts_transform((Mesh*)ob->data, area_data.vert_cos, dm->getNumVerts(dm), 1);
+		}
+		else {
+			area_data.mvert = dm->getVertDataArray(dm, CD_MVERT);
+		}
+
+		BLI_task_parallel_for(0, totelem, &area_data, distribute_area_task_cb, 0);
+
+		if (area_data.vert_cos)
+			MEM_freeN(area_data.vert_cos);
+
 		for (i=0; i<totelem; i++) {
-			MFace *mf=dm->getTessFaceData(dm,i,CD_MFACE);
-
-			if (orcodata) {
-				copy_v3_v3(co1, orcodata[mf->v1]);
-				copy_v3_v3(co2, orcodata[mf->v2]);
-				copy_v3_v3(co3, orcodata[mf->v3]);
-				BKE_mesh_orco_verts_transform((Mesh*)ob->data, &co1, 1, 1);
-				BKE_mesh_orco_verts_transform((Mesh*)ob->data, &co2, 1, 1);
-				BKE_mesh_orco_verts_transform((Mesh*)ob->data, &co3, 1, 1);
-				if (mf->v4) {
-					copy_v3_v3(co4, orcodata[mf->v4]);
-					BKE_mesh_orco_verts_transform((Mesh*)ob->data, &co4, 1, 1);
-				}
-			}
-			else {
-				v1= (MVert*)dm->getVertData(dm,mf->v1,CD_MVERT);
-				v2= (MVert*)dm->getVertData(dm,mf->v2,CD_MVERT);
-				v3= (MVert*)dm->getVertData(dm,mf->v3,CD_MVERT);
-				copy_v3_v3(co1, v1->co);
-				copy_v3_v3(co2, v2->co);
-				copy_v3_v3(co3, v3->co);
-				if (mf->v4) {
-					v4= (MVert*)dm->getVertData(dm,mf->v4,CD_MVERT);
-					copy_v3_v3(co4, v4->co);
-				}
-			}
+			cur = element_weight[i];
 
-			cur = mf->v4 ? area_quad_v3(co1, co2, co3, co4) : area_tri_v3(co1, co2, co3);
-			
 			if (cur > maxweight)
 				maxweight = cur;
 
-			element_weight[i] = cur;
 			totarea += cur;
 		}
 
@@ -1052,16 +1117,25 @@ static int psys_thread_context_init_distribute(ParticleThreadContext *ctx, Parti
 
 	/* Finally assign elements to particles */
 	if ((part->flag & PART_TRAND) || (part->simplify_flag & PART_SIMPLIFY_ENABLE)) {
+		DistributeRandomData random_data = {
+		    .element_sum = element_sum, .element_map = element_map, .totmapped = totmapped,
+		    .particle_element = particle_element, .seed = seed,
+		};
+
+		random_data.particle_pos = MEM_mallocN(sizeof(float) * totpart, "particle_distribution_pos");
+
+		BLI_task_parallel_for(0, totpart, &random_data, distribute_random_task_cb, 0);
+
+		/* leave the global generator where the serial loop did, the volume
+		 * distribution takes its random offsets from it afterwards */
+		BLI_rand_skip(totpart);
+
+		/* the last particle on an element gives its offset, as when done serially */
 		for (p = 0; p < totpart; p++) {
-			/* In theory element_sum[totmapped - 1] should be 1.0,
-			 * but due to float errors this is not necessarily always true, so scale pos accordingly. */
-			const float pos = BLI_frand() * element_sum[totmapped - 1];
-			const int eidx = distribute_binary_search(element_sum, totmapped, pos);
-			particle_element[p] = element_map[eidx];
-			BLI_assert(pos <= element_sum[eidx]);
-			BLI_assert(eidx ? (pos > element_sum[eidx - 1]) : (pos >= 0.0f));
-			jitter_offset[particle_element[p]] = pos;
+			jitter_offset[particle_element[p]] = random_data.particle_pos[p];
 		}
+
+		MEM_freeN(random_data.particle_pos);
 	}
 	else {
 		double step, pos;
@@ -1163,14 +1237,112 @@ static void psys_task_init_distribute(ParticleTask *task, ParticleSimulationData
 	task->rng = BLI_rng_new(seed);
 }
 
+/* Hash of everything the child distribution depends on: emitter mesh, parents
+ * and the settings used by psys_thread_context_init_distribute() & co. Most
+ * child settings (clump, kink, roughness...) only affect the paths, so an edit
+ * of those does not need to redistribute millions of children. */
+static int distribute_children_hash(ParticleSimulationData *sim)
+{
+	ParticleSystem *psys = sim->psys;
+	ParticleSettings *part = psys->part;
+	DerivedMesh *dm = sim->psmd->dm_final;
+	Mesh *me = (Mesh *)sim->ob->data;
+	BLI_HashMurmur2A mm2;
+	float (*vert_cos)[3];
+	float *vweight;
+	float loc[3], size[3];
+	int totvert = dm->getNumVerts(dm);
+	int totloop = dm->getNumLoops(dm);
+	int totpoly = dm->getNumPolys(dm);
+	int i, hash;
+	PARTICLE_P;
+
+	BLI_hash_mm2a_init(&mm2, 0);
+
+	BLI_hash_mm2a_add_int(&mm2, psys->seed);
+	BLI_hash_mm2a_add_int(&mm2, psys->child_seed);
+	BLI_hash_mm2a_add_int(&mm2, psys->totpart);
+	BLI_hash_mm2a_add_int(&mm2, psys_get_tot_child(sim->scene, psys));
+	BLI_hash_mm2a_add_int(&mm2, psys->vgroup[PSYS_VG_DENSITY]);
+	BLI_hash_mm2a_add_int(&mm2, psys->vg_neg);
+	BLI_hash_mm2a_add_int(&mm2, part->type);
+	BLI_hash_mm2a_add_int(&mm2, part->from);
+	BLI_hash_mm2a_add_int(&mm2, part->flag);
+	BLI_hash_mm2a_add_int(&mm2, part->childtype);
+	BLI_hash_mm2a_add_int(&mm2, part->simplify_flag);
+	BLI_hash_mm2a_add_int(&mm2, part->use_modifier_stack);
+	BLI_hash_mm2a_add(&mm2, (const unsigned char *)&part->parents, sizeof(part->parents));
+
+	LOOP_PARTICLES {
+		BLI_hash_mm2a_add_int(&mm2, pa->num);
+		BLI_hash_mm2a_add_int(&mm2, pa->num_dmcache);
+		BLI_hash_mm2a_add(&mm2, (const unsigned char *)pa->fuv, sizeof(pa->fuv));
+		BLI_hash_mm2a_add(&mm2, (const unsigned char *)&pa->foffset, sizeof(pa->foffset));
+	}
+
+	/* emitter, as used for weights and the parent tree */
+	BKE_mesh_texspace_get(me->texcomesh ? me->texcomesh : me, loc, NULL, size);
+	BLI_hash_mm2a_add(&mm2, (const unsigned char *)loc, sizeof(loc));
+	BLI_hash_mm2a_add(&mm2, (const unsigned char *)size, sizeof(size));
+
+	BLI_hash_mm2a_add_int(&mm2, totvert);
+	BLI_hash_mm2a_add_int(&mm2, totpoly);
+
+	vert_cos = dm->getVertDataArray(dm, CD_ORCO);
+	if (vert_cos) {
+		BLI_hash_mm2a_add(&mm2, (const unsigned char *)vert_cos, sizeof(*vert_cos) * totvert);
+	}
+	else {
+		MVert *mvert = dm->getVertArray(dm);
+		for (i = 0; i < totvert; i++)
+			BLI_hash_mm2a_add(&mm2, (const unsigned char *)mvert[i].co, sizeof(mvert[i].co));
+	}
+
+	if (totpoly) {
+		const MPoly *mpoly = dm->getPolyArray(dm);
+		const MLoop *mloop = dm->getLoopArray(dm);
+
+		for (i = 0; i < totpoly; i++)
+			BLI_hash_mm2a_add_int(&mm2, mpoly[i].totloop);
+		for (i = 0; i < totloop; i++)
+			BLI_hash_mm2a_add_int(&mm2, mloop[i].v);
+	}
+
+	vweight = psys_cache_vgroup(dm, psys, PSYS_VG_DENSITY);
+	if (vweight) {
+		BLI_hash_mm2a_add(&mm2, (const unsigned char *)vweight, sizeof(float) * totvert);
+		MEM_freeN(vweight);
+	}
+
+	hash = (int)BLI_hash_mm2a_end(&mm2);
+
+	/* 0 means unknown */
+	return hash ? hash : 1;
+}
+
 static void distribute_particles_on_dm(ParticleSimulationData *sim, int from)
 {
 	TaskScheduler *task_scheduler;
 	TaskPool *task_pool;
 	ParticleThreadContext ctx;
 	ParticleTask *tasks;
+	ParticleSystem *psys = sim->psys;
 	DerivedMesh *finaldm = sim->psmd->dm_final;
 	int i, totpart, numtasks;
+
+	if (from == PART_FROM_CHILD) {
+		/* render simplification depends on the view, never reuse it */
+		int child_hash = psys->renderdata ? 0 : distribute_children_hash(sim);
+
+		if (child_hash && psys->child && psys->child_hash == child_hash &&
+		    psys->totchild == psys_get_tot_child(sim->scene, psys))
+		{
+			/* children are up to date */
+			return;
+		}
+
+		psys->child_hash = child_hash;
+	}
 	
 	/* create a task pool for distribution tasks */
 	if (!psys_thread_context_init_distribute(&ctx, sim, from))
@@ -57,6 +57,7 @@
 
 #include "BLI_utildefines.h"
 #include "BLI_edgehash.h"
+#include "BLI_hash.h"
 #include "BLI_rand.h"
 #include "BLI_jitter.h"
 #include "BLI_math.h"
@@ -103,7 +104,7 @@
 
 #endif // WITH_MOD_FLUID
 
-static ThreadRWMutex psys_bvhtree_rwlock = BLI_RWLOCK_INITIALIZER;
+static ThreadRWMutex psys_sphgrid_rwlock = BLI_RWLOCK_INITIALIZER;
 
 /************************************************/
 /*			Reacting to system events			*/
@@ -1225,40 +1226,201 @@ void psys_get_pointcache_start_end(Scene *scene, ParticleSystem *psys, int *sfra
 /************************************************/
 /*			Effectors							*/
 /************************************************/
-static void psys_update_particle_bvhtree(ParticleSystem *psys, float cfra)
+/* Uniform grid for SPH neighbour queries. The cell size is at least the interaction
+ * radius, so a query usually touches the 27 cells around a particle. Cells are
+ * hashed into a table about the size of the particle count, and the entries
+ * are sorted by bucket so the particles of one cell are contiguous in memory. */
+typedef struct SPHGridEntry {
+	float co[3];
+	int index;
+} SPHGridEntry;
+
+typedef struct SPHGrid {
+	float cell_size;
+	float inv_cell_size;
+	unsigned int mask;
+	unsigned int *bucket_start;  /* mask + 2 offsets into entries */
+	SPHGridEntry *entries;
+	int totentry;
+} SPHGrid;
+
+/* queries touching more cells than this scan all entries instead */
+#define SPH_GRID_MAX_QUERY_CELLS 64
+
+BLI_INLINE void sph_grid_cell(const SPHGrid *grid, const float co[3], int r_cell[3])
+{
+	r_cell[0] = (int)floorf(co[0] * grid->inv_cell_size);
+	r_cell[1] = (int)floorf(co[1] * grid->inv_cell_size);
+	r_cell[2] = (int)floorf(co[2] * grid->inv_cell_size);
+}
+
+BLI_INLINE unsigned int sph_grid_bucket(const SPHGrid *grid, int x, int y, int z)
+{
+	return (((unsigned int)x * 73856093u) ^ ((unsigned int)y * 19349663u) ^ ((unsigned int)z * 83492791u)) & grid->mask;
+}
+
+static SPHGrid *sph_grid_build(ParticleSystem *psys, float cfra, float cell_size)
+{
+	SPHGrid *grid = MEM_callocN(sizeof(SPHGrid), "SPHGrid");
+	SPHGridEntry *entries;
+	unsigned int *buckets, *offset;
+	unsigned int totbucket = 1;
+	int cell[3];
+	int i, totpart = 0;
+	PARTICLE_P;
+
+	LOOP_SHOWN_PARTICLES {
+		if (pa->alive == PARS_ALIVE)
+			totpart++;
+	}
+
+	while (totbucket < (unsigned int)totpart)
+		totbucket <<= 1;
+
+	grid->cell_size = cell_size > 0.0f ? cell_size : 1.0f;
+	grid->inv_cell_size = 1.0f / grid->cell_size;
+	grid->mask = totbucket - 1;
+	grid->totentry = totpart;
+	grid->bucket_start = MEM_callocN(sizeof(unsigned int) * (totbucket + 1), "SPHGrid buckets");
+	grid->entries = MEM_mallocN(sizeof(SPHGridEntry) * max_ii(totpart, 1), "SPHGrid entries");
+
+	entries = MEM_mallocN(sizeof(SPHGridEntry) * max_ii(totpart, 1), "SPHGrid unsorted");
+	buckets = MEM_mallocN(sizeof(unsigned int) * max_ii(totpart, 1), "SPHGrid entry buckets");
+
+	i = 0;
+	LOOP_SHOWN_PARTICLES {
+		if (pa->alive == PARS_ALIVE) {
+			copy_v3_v3(entries[i].co, (pa->state.time == cfra) ? pa->prev_state.co : pa->state.co);
+			entries[i].index = p;
+			sph_grid_cell(grid, entries[i].co, cell);
+			buckets[i] = sph_grid_bucket(grid, cell[0], cell[1], cell[2]);
+			grid->bucket_start[buckets[i] + 1]++;
+			i++;
+		}
+	}
+
+	/* counting sort by bucket, keeping particle order within a cell */
+	for (i = 0; i < (int)totbucket; i++)
+		grid->bucket_start[i + 1] += grid->bucket_start[i];
+
+	offset = MEM_mallocN(sizeof(unsigned int) * totbucket, "SPHGrid offsets");
+	memcpy(offset, grid->bucket_start, sizeof(unsigned int) * totbucket);
+	for (i = 0; i < totpart; i++)
+		grid->entries[offset[buckets[i]]++] = entries[i];
+
+	MEM_freeN(offset);
+	MEM_freeN(buckets);
+	MEM_freeN(entries);
+
+	return grid;
+}
+
+void psys_sph_grid_free(SPHGrid *grid)
+{
+	if (grid) {
+		MEM_freeN(grid->bucket_start);
+		MEM_freeN(grid->entries);
+		MEM_freeN(grid);
+	}
+}
+
+/* Same contract as BLI_bvhtree_range_query: callback gets every entry closer than radius. */
+static void sph_grid_range_query(const SPHGrid *grid, const float co[3], float radius,
+                                 BVHTree_RangeQuery callback, void *userdata)
+{
+	unsigned int visit[SPH_GRID_MAX_QUERY_CELLS];
+	const float radius_sq = radius * radius;
+	const float lo_co[3] = {co[0] - radius, co[1] - radius, co[2] - radius};
+	const float hi_co[3] = {co[0] + radius, co[1] + radius, co[2] + radius};
+	int lo[3], hi[3], x, y, z;
+	int i, j, totvisit = 0;
+	bool scan_all = false;
+
+	if (grid->totentry == 0)
+		return;
+
+	sph_grid_cell(grid, lo_co, lo);
+	sph_grid_cell(grid, hi_co, hi);
+
+	/* collect each bucket once, cells of a hash collision share one */
+	for (z = lo[2]; z <= hi[2] && !scan_all; z++) {
+		for (y = lo[1]; y <= hi[1] && !scan_all; y++) {
+			for (x = lo[0]; x <= hi[0]; x++) {
+				const unsigned int bucket = sph_grid_bucket(grid, x, y, z);
+
+				for (j = 0; j < totvisit && visit[j] != bucket; j++);
+				if (j < totvisit)
+					continue;
+
+				if (totvisit == SPH_GRID_MAX_QUERY_CELLS) {
+					scan_all = true;
+					break;
+				}
+				visit[totvisit++] = bucket;
+			}
+		}
+	}
+
+	if (scan_all) {
+		for (i = 0; i < grid->totentry; i++) {
+			const SPHGridEntry *entry = &grid->entries[i];
+			const float dist_sq = len_squared_v3v3(co, entry->co);
+			if (dist_sq < radius_sq)
+				callback(userdata, entry->index, co, dist_sq);
+		}
+		return;
+	}
+
+	for (j = 0; j < totvisit; j++) {
+		const unsigned int end = grid->bucket_start[visit[j] + 1];
+		unsigned int k;
+
+		for (k = grid->bucket_start[visit[j]]; k < end; k++) {
+			const SPHGridEntry *entry = &grid->entries[k];
+			const float dist_sq = len_squared_v3v3(co, entry->co);
+			if (dist_sq < radius_sq)
+				callback(userdata, entry->index, co, dist_sq);
+		}
+	}
+}
+
+/* True when the grid of psys is from cfra and its cells are large enough for
+ * queries with the given radius, so they stay within the 27 surrounding cells. */
+static bool psys_sphgrid_is_valid(ParticleSystem *psys, float cfra, float radius)
+{
+	return psys->sphgrid && psys->sphgrid_frame == cfra && psys->sphgrid->cell_size >= radius;
+}
+
+/* cell_size is the interaction radius of the fluid simulating psys. Coupled
+ * systems query the grid of their targets with their own radius, so a grid of
+ * the current frame is rebuilt with larger cells when a caller needs them. */
+static void psys_update_particle_sphgrid(ParticleSystem *psys, float cfra, float cell_size)
 {
 	if (psys) {
-		PARTICLE_P;
-		int totpart = 0;
 		bool need_rebuild;
 
-		BLI_rw_mutex_lock(&psys_bvhtree_rwlock, THREAD_LOCK_READ);
-		need_rebuild = !psys->bvhtree || psys->bvhtree_frame != cfra;
-		BLI_rw_mutex_unlock(&psys_bvhtree_rwlock);
-		
+		BLI_rw_mutex_lock(&psys_sphgrid_rwlock, THREAD_LOCK_READ);
+		need_rebuild = !psys_sphgrid_is_valid(psys, cfra, cell_size);
+		if (need_rebuild && psys->sphgrid && psys->sphgrid_frame == cfra)
+			cell_size = max_ff(cell_size, psys->sphgrid->cell_size);
+		BLI_rw_mutex_unlock(&psys_sphgrid_rwlock);
+
 		if (need_rebuild) {
-			LOOP_SHOWN_PARTICLES {
-				totpart++;
+			SPHGrid *grid = sph_grid_build(psys, cfra, cell_size);
+
+			BLI_rw_mutex_lock(&psys_sphgrid_rwlock, THREAD_LOCK_WRITE);
+
+			/* another system may have built a grid with larger cells meanwhile */
+			if (psys_sphgrid_is_valid(psys, cfra, cell_size)) {
+				psys_sph_grid_free(grid);
 			}
-			
-			BLI_rw_mutex_lock(&psys_bvhtree_rwlock, THREAD_LOCK_WRITE);
-			
-			BLI_bvhtree_free(psys->bvhtree);
-			psys->bvhtree = BLI_bvhtree_new(totpart, 0.0, 4, 6);
-			
-			LOOP_SHOWN_PARTICLES {
-				if (pa->alive == PARS_ALIVE) {
-					if (pa->state.time == cfra)
-						BLI_bvhtree_insert(psys->bvhtree, p, pa->prev_state.co, 1);
-					else
-						BLI_bvhtree_insert(psys->bvhtree, p, pa->state.co, 1);
-				}
+			else {
+				psys_sph_grid_free(psys->sphgrid);
+				psys->sphgrid = grid;
+				psys->sphgrid_frame = cfra;
 			}
-			BLI_bvhtree_balance(psys->bvhtree);
-			
-			psys->bvhtree_frame = cfra;
-			
-			BLI_rw_mutex_unlock(&psys_bvhtree_rwlock);
+
+			BLI_rw_mutex_unlock(&psys_sphgrid_rwlock);
 		}
 	}
 }
@@ -1576,11 +1738,12 @@ static void sph_evaluate_func(BVHTree *tree, ParticleSystem **psys, float co[3],
 			break;
 		}
 		else {
-			BLI_rw_mutex_lock(&psys_bvhtree_rwlock, THREAD_LOCK_READ);
-			
-			BLI_bvhtree_range_query(psys[i]->bvhtree, co, interaction_radius, callback, pfr);
-			
-			BLI_rw_mutex_unlock(&psys_bvhtree_rwlock);
+			BLI_rw_mutex_lock(&psys_sphgrid_rwlock, THREAD_LOCK_READ);
+
+			if (psys[i]->sphgrid)
+				sph_grid_range_query(psys[i]->sphgrid, co, interaction_radius, callback, pfr);
+
+			BLI_rw_mutex_unlock(&psys_sphgrid_rwlock);
 		}
 	}
 }
@@ -2035,10 +2198,19 @@ static void sph_integrate(ParticleSimulationData *sim, ParticleData *pa, float d
 /************************************************/
 /*			Basic physics						*/
 /************************************************/
+/* Random numbers of the dynamics step are hashed from the particle index
+ * rather than drawn from a shared generator, so the result does not depend
+ * on the order (or thread) particles are evaluated in. */
+static unsigned int psys_step_seed(ParticleSystem *psys, int p, float cfra)
+{
+	return BLI_hash_int_2d((unsigned int)p, (unsigned int)(31415926 + (int)cfra + psys->seed));
+}
+
 typedef struct EfData {
 	ParticleTexture ptex;
 	ParticleSimulationData *sim;
 	ParticleData *pa;
+	unsigned int seed;
 } EfData;
 static void basic_force_cb(void *efdata_v, ParticleKey *state, float *force, float *impulse)
 {
@@ -2062,9 +2234,9 @@ static void basic_force_cb(void *efdata_v, ParticleKey *state, float *force, flo
 
 	/* brownian force */
 	if (part->brownfac != 0.0f) {
-		force[0] += (BLI_frand()-0.5f) * part->brownfac;
-		force[1] += (BLI_frand()-0.5f) * part->brownfac;
-		force[2] += (BLI_frand()-0.5f) * part->brownfac;
+		force[0] += (BLI_hash_frand(efdata->seed++)-0.5f) * part->brownfac;
+		force[1] += (BLI_hash_frand(efdata->seed++)-0.5f) * part->brownfac;
+		force[2] += (BLI_hash_frand(efdata->seed++)-0.5f) * part->brownfac;
 	}
 
 	if (part->flag & PART_ROT_DYN && epoint.ave)
@@ -2084,6 +2256,7 @@ static void basic_integrate(ParticleSimulationData *sim, int p, float dfra, floa
 
 	efdata.pa = pa;
 	efdata.sim = sim;
+	efdata.seed = psys_step_seed(sim->psys, p, cfra);
 
 	/* add global acceleration (gravitation) */
 	if (psys_uses_gravity(sim) &&
@@ -2644,7 +2817,7 @@ static int collision_response(ParticleData *pa, ParticleCollision *col, BVHTreeR
 	float f = col->f + x * (1.0f - col->f);				/* time factor of collision between timestep */
 	float dt1 = (f - col->f) * col->total_time;			/* time since previous collision (in seconds) */
 	float dt2 = (1.0f - f) * col->total_time;			/* time left after collision (in seconds) */
-	int through = (BLI_frand() < pd->pdef_perm) ? 1 : 0; /* did particle pass through the collision surface? */
+	int through = (BLI_hash_frand(col->seed++) < pd->pdef_perm) ? 1 : 0; /* did particle pass through the collision surface? */
 
 	/* calculate exact collision location */
 	interp_v3_v3v3(co, col->co1, col->co2, x);
@@ -2669,8 +2842,8 @@ static int collision_response(ParticleData *pa, ParticleCollision *col, BVHTreeR
 		float v0_tan[3];/* tangential component of v0 */
 		float vc_tan[3];/* tangential component of collision surface velocity */
 		float v0_dot, vc_dot;
-		float damp = pd->pdef_damp + pd->pdef_rdamp * 2 * (BLI_frand() - 0.5f);
-		float frict = pd->pdef_frict + pd->pdef_rfrict * 2 * (BLI_frand() - 0.5f);
+		float damp = pd->pdef_damp + pd->pdef_rdamp * 2 * (BLI_hash_frand(col->seed++) - 0.5f);
+		float frict = pd->pdef_frict + pd->pdef_rfrict * 2 * (BLI_hash_frand(col->seed++) - 0.5f);
 		float distance, nor[3], dot;
 
 		CLAMP(damp,0.0f, 1.0f);
@@ -2851,6 +3024,7 @@ static void collision_check(ParticleSimulationData *sim, int p, float dfra, floa
 
 	col.cfra = cfra;
 	col.old_cfra = sim->psys->cfra;
+	col.seed = BLI_hash_int(psys_step_seed(sim->psys, p, cfra));
 
 	/* get acceleration (from gravity, forcefields etc. to be re-applied in collision response) */
 	sub_v3_v3v3(col.acc, pa->state.vel, pa->prev_state.vel);
@@ -3361,8 +3535,115 @@ typedef struct DynamicStepSolverTaskData {
 	float dtime;
 
 	SpinLock spin;
+
+	/* boids: one brain per particle, so boid_body() can run after all boids have thought */
+	const BoidBrainData *bbd_init;
+	BoidBrainData *bbd;
 } DynamicStepSolverTaskData;
 
+typedef struct DynamicStepSolverTaskChunk {
+	RNG *rng;
+} DynamicStepSolverTaskChunk;
+
+/* Particles that are effectors of their own system read each other's state
+ * while it is being integrated, so they have to be stepped in order. */
+static bool psys_effects_itself(ParticleSystem *psys)
+{
+	EffectorCache *eff;
+
+	if (psys->effectors) {
+		for (eff = psys->effectors->first; eff; eff = eff->next) {
+			if (eff->psys == psys)
+				return true;
+		}
+	}
+	return false;
+}
+
+static RNG *dynamics_step_task_rng(DynamicStepSolverTaskChunk *chunk, unsigned int seed)
+{
+	if (chunk->rng)
+		BLI_rng_srandom(chunk->rng, seed);
+	else
+		chunk->rng = BLI_rng_new_srandom(seed);
+
+	return chunk->rng;
+}
+
+static void dynamics_step_task_finalize(void *UNUSED(userdata), void *userdata_chunk)
+{
+	DynamicStepSolverTaskChunk *chunk = userdata_chunk;
+
+	if (chunk->rng)
+		BLI_rng_free(chunk->rng);
+}
+
+static void dynamics_step_newton_task_cb_ex(
+        void *userdata, void *UNUSED(userdata_chunk), const int p, const int UNUSED(thread_id))
+{
+	DynamicStepSolverTaskData *data = userdata;
+	ParticleSimulationData *sim = data->sim;
+	ParticleSystem *psys = sim->psys;
+
+	ParticleData *pa;
+
+	if ((pa = psys->particles + p)->state.time <= 0.0f) {
+		return;
+	}
+
+	/* do global forces & effectors */
+	basic_integrate(sim, p, pa->state.time, data->cfra);
+
+	/* deflection */
+	if (sim->colliders)
+		collision_check(sim, p, pa->state.time, data->cfra);
+
+	/* rotations */
+	basic_rotate(psys->part, pa, pa->state.time, data->timestep);
+}
+
+static void dynamics_step_boids_brain_task_cb_ex(
+        void *userdata, void *userdata_chunk, const int p, const int UNUSED(thread_id))
+{
+	DynamicStepSolverTaskData *data = userdata;
+	ParticleSystem *psys = data->sim->psys;
+	BoidBrainData *bbd = &data->bbd[p];
+
+	ParticleData *pa;
+
+	if ((pa = psys->particles + p)->state.time <= 0.0f) {
+		return;
+	}
+
+	*bbd = *data->bbd_init;
+	bbd->rng = dynamics_step_task_rng(userdata_chunk, psys_step_seed(psys, p, data->cfra));
+
+	boid_brain(bbd, p, pa);
+}
+
+static void dynamics_step_boids_body_task_cb_ex(
+        void *userdata, void *userdata_chunk, const int p, const int UNUSED(thread_id))
+{
+	DynamicStepSolverTaskData *data = userdata;
+	ParticleSimulationData *sim = data->sim;
+	ParticleSystem *psys = sim->psys;
+	BoidBrainData *bbd = &data->bbd[p];
+
+	ParticleData *pa;
+
+	if ((pa = psys->particles + p)->state.time <= 0.0f || pa->alive == PARS_DYING) {
+		return;
+	}
+
+	bbd->rng = dynamics_step_task_rng(userdata_chunk, BLI_hash_int(psys_step_seed(psys, p, data->cfra)));
+
+	boid_body(bbd, pa);
+
+	/* deflection */
+	if (sim->colliders)
+		collision_check(sim, p, pa->state.time, data->cfra);
+}
+
 static void dynamics_step_sph_ddr_task_cb_ex(
         void *userdata, void *userdata_chunk, const int p, const int UNUSED(thread_id))
 {
@@ -3467,7 +3748,6 @@ static void dynamics_step(ParticleSimulationData *sim, float cfra)
 {
 	ParticleSystem *psys = sim->psys;
 	ParticleSettings *part=psys->part;
-	RNG *rng;
 	BoidBrainData bbd;
 	ParticleTexture ptex;
 	PARTICLE_P;
@@ -3494,10 +3774,6 @@ static void dynamics_step(ParticleSimulationData *sim, float cfra)
 		return;
 	}
 
-	BLI_srandom(31415926 + (int)cfra + psys->seed);
-	/* for now do both, boids us 'rng' */
-	rng = BLI_rng_new_srandom(31415926 + (int)cfra + psys->seed);
-
 	psys_update_effectors(sim);
 
 	if (part->type != PART_HAIR)
@@ -3508,12 +3784,12 @@ static void dynamics_step(ParticleSimulationData *sim, float cfra)
 		case PART_PHYS_BOIDS:
 		{
 			ParticleTarget *pt = psys->targets.first;
+			memset(&bbd, 0, sizeof(bbd));
 			bbd.sim = sim;
 			bbd.part = part;
 			bbd.cfra = cfra;
 			bbd.dfra = dfra;
 			bbd.timestep = timestep;
-			bbd.rng = rng;
 
 			psys_update_particle_tree(psys, cfra);
 
@@ -3530,11 +3806,14 @@ static void dynamics_step(ParticleSimulationData *sim, float cfra)
 		case PART_PHYS_FLUID:
 		{
 			ParticleTarget *pt = psys->targets.first;
-			psys_update_particle_bvhtree(psys, cfra);
-			
-			for (; pt; pt=pt->next) {  /* Updating others systems particle tree for fluid-fluid interaction */
+			SPHFluidSettings *fluid = part->fluid;
+			float interaction_radius = fluid->radius * (fluid->flag & SPH_FAC_RADIUS ? 4.0f * part->size : 1.0f);
+
+			psys_update_particle_sphgrid(psys, cfra, interaction_radius);
+
+			for (; pt; pt=pt->next) {  /* Updating others systems particle grid for fluid-fluid interaction */
 				if (pt->ob)
-					psys_update_particle_bvhtree(BLI_findlink(&pt->ob->particlesystem, pt->psys-1), cfra);
+					psys_update_particle_sphgrid(BLI_findlink(&pt->ob->particlesystem, pt->psys-1), cfra, interaction_radius);
 			}
 			break;
 		}
@@ -3585,34 +3864,44 @@ static void dynamics_step(ParticleSimulationData *sim, float cfra)
 	switch (part->phystype) {
 		case PART_PHYS_NEWTON:
 		{
-			LOOP_DYNAMIC_PARTICLES {
-				/* do global forces & effectors */
-				basic_integrate(sim, p, pa->state.time, cfra);
-	
-				/* deflection */
-				if (sim->colliders)
-					collision_check(sim, p, pa->state.time, cfra);
+			DynamicStepSolverTaskData task_data = {
+			    .sim = sim, .cfra = cfra, .timestep = timestep, .dtime = dtime,
+			};
 
-				/* rotations */
-				basic_rotate(part, pa, pa->state.time, timestep);
-			}
+			BLI_task_parallel_range_ex(
+			            0, psys->totpart, &task_data, NULL, 0,
+			            dynamics_step_newton_task_cb_ex,
+			            psys->totpart > 100 && !psys_effects_itself(psys), true);
 			break;
 		}
 		case PART_PHYS_BOIDS:
 		{
-			LOOP_DYNAMIC_PARTICLES {
-				bbd.goal_ob = NULL;
-				
-				boid_brain(&bbd, p, pa);
+			DynamicStepSolverTaskData task_data = {
+			    .sim = sim, .cfra = cfra, .timestep = timestep, .dtime = dtime,
+			    .bbd_init = &bbd,
+			};
+			DynamicStepSolverTaskChunk task_chunk = {NULL};
+			const bool use_threading = psys->totpart > 100 && !psys_effects_itself(psys);
 
-				if (pa->alive != PARS_DYING) {
-					boid_body(&bbd, pa);
+			task_data.bbd = MEM_mallocN(sizeof(BoidBrainData) * psys->totpart, "BoidBrainData");
 
-					/* deflection */
-					if (sim->colliders)
-						collision_check(sim, p, pa->state.time, cfra);
-				}
+			/* All boids decide what to do based on the state at the start of
+			 * the step, only then are fights and movement applied. */
+			BLI_task_parallel_range_finalize(
+			            0, psys->totpart, &task_data, &task_chunk, sizeof(task_chunk),
+			            dynamics_step_boids_brain_task_cb_ex, dynamics_step_task_finalize,
+			            use_threading, true);
+
+			LOOP_DYNAMIC_PARTICLES {
+				boid_apply_damage(&task_data.bbd[p]);
 			}
+
+			BLI_task_parallel_range_finalize(
+			            0, psys->totpart, &task_data, &task_chunk, sizeof(task_chunk),
+			            dynamics_step_boids_body_task_cb_ex, dynamics_step_task_finalize,
+			            use_threading, true);
+
+			MEM_freeN(task_data.bbd);
 			break;
 		}
 		case PART_PHYS_FLUID:
@@ -3677,7 +3966,6 @@ static void dynamics_step(ParticleSimulationData *sim, float cfra)
 	}
 
 	free_collider_cache(&sim->colliders);
-	BLI_rng_free(rng);
 }
 static void update_children(ParticleSimulationData *sim)
 {
@@ -57,6 +57,10 @@
 
 #define PBVH_THREADED_LIMIT 4
 
+/* Number of primitives above which bounds are computed with threads and
+ * subtrees are built by separate tasks */
+#define PBVH_BUILD_THREADED_LIMIT 10000
+
 typedef struct PBVHStack {
 	PBVHNode *node;
 	bool revisiting;
@@ -241,15 +245,15 @@ void pbvh_grow_nodes(PBVH *bvh, int totnode)
  * a negative value for additional vertices */
 static int map_insert_vert(PBVH *bvh, GHash *map,
                            unsigned int *face_verts,
-                           unsigned int *uniq_verts, int vertex)
+                           unsigned int *uniq_verts, int vertex,
+                           unsigned int node_index)
 {
 	void *key, **value_p;
 
 	key = SET_INT_IN_POINTER(vertex);
 	if (!BLI_ghash_ensure_p(map, key, &value_p)) {
 		int value_i;
-		if (BLI_BITMAP_TEST(bvh->vert_bitmap, vertex) == 0) {
-			BLI_BITMAP_ENABLE(bvh->vert_bitmap, vertex);
+		if (bvh->vert_owner[vertex] == node_index) {
 			value_i = *uniq_verts;
 			(*uniq_verts)++;
 		}
@@ -268,6 +272,7 @@ static int map_insert_vert(PBVH *bvh, GHash *map,
 /* Find vertices used by the faces in this node and update the draw buffers */
 static void build_mesh_leaf_node(PBVH *bvh, PBVHNode *node)
 {
+	const unsigned int node_index = (unsigned int)(node - bvh->nodes);
 	bool has_visible = false;
 
 	node->uniq_verts = node->face_verts = 0;
@@ -286,7 +291,8 @@ static void build_mesh_leaf_node(PBVH *bvh, PBVHNode *node)
 		for (int j = 0; j < 3; ++j) {
 			face_vert_indices[i][j] =
 			        map_insert_vert(bvh, map, &node->face_verts,
-			                        &node->uniq_verts, bvh->mloop[lt->tri[j]].v);
+			                        &node->uniq_verts, bvh->mloop[lt->tri[j]].v,
+			                        node_index);
 		}
 
 		if (!paint_is_face_hidden(lt, bvh->verts, bvh->mloop)) {
@@ -329,14 +335,74 @@ static void build_mesh_leaf_node(PBVH *bvh, PBVHNode *node)
 	BLI_ghash_free(map, NULL, NULL);
 }
 
+typedef struct PBVHBoundsData {
+	const int *prim_indices;
+	const BBC *prim_bbc;
+	bool calc_cb;
+} PBVHBoundsData;
+
+typedef struct PBVHBoundsAccum {
+	BB vb;
+	BB cb;
+} PBVHBoundsAccum;
+
+static void pbvh_bounds_reduce_cb(void *__restrict userdata, void *__restrict accum, const int start, const int stop)
+{
+	const PBVHBoundsData *data = userdata;
+	PBVHBoundsAccum *acc = accum;
+
+	for (int i = start; i < stop; i++) {
+		const BBC *bbc = &data->prim_bbc[data->prim_indices[i]];
+
+		BB_expand_with_bb(&acc->vb, (BB *)bbc);
+		if (data->calc_cb) {
+			BB_expand(&acc->cb, bbc->bcentroid);
+		}
+	}
+}
+
+static void pbvh_bounds_join_cb(
+        void *__restrict userdata, void *__restrict accum, const void *__restrict accum_other)
+{
+	const PBVHBoundsData *data = userdata;
+	PBVHBoundsAccum *acc = accum;
+	const PBVHBoundsAccum *acc_other = accum_other;
+
+	BB_expand_with_bb(&acc->vb, (BB *)&acc_other->vb);
+	if (data->calc_cb) {
+		BB_expand_with_bb(&acc->cb, (BB *)&acc_other->cb);
+	}
+}
+
+/* Update the node bounding box, and also compute the bounding box of the
+ * primitive centroids when r_cb is given, both in a single pass */
 static void update_vb(PBVH *bvh, PBVHNode *node, BBC *prim_bbc,
-                      int offset, int count)
+                      int offset, int count, BB *r_cb, bool use_threading)
 {
-	BB_reset(&node->vb);
-	for (int i = offset + count - 1; i >= offset; --i) {
-		BB_expand_with_bb(&node->vb, (BB *)(&prim_bbc[bvh->prim_indices[i]]));
+	PBVHBoundsData data = {
+	    .prim_indices = bvh->prim_indices,
+	    .prim_bbc = prim_bbc,
+	    .calc_cb = (r_cb != NULL),
+	};
+	PBVHBoundsAccum accum;
+
+	BB_reset(&accum.vb);
+	BB_reset(&accum.cb);
+
+	if (use_threading) {
+		BLI_task_parallel_reduce(
+		            offset, offset + count, &data, &accum, sizeof(accum),
+		            pbvh_bounds_reduce_cb, pbvh_bounds_join_cb, PBVH_BUILD_THREADED_LIMIT);
+	}
+	else {
+		pbvh_bounds_reduce_cb(&data, &accum, offset, offset + count);
 	}
+
+	node->vb = accum.vb;
 	node->orig_vb = node->vb;
+	if (r_cb) {
+		*r_cb = accum.cb;
+	}
 }
 
 /* Returns the number of visible quads in the nodes' grids. */
@@ -378,6 +444,7 @@ static void build_grid_leaf_node(PBVH *bvh, PBVHNode *node)
 }
 
 
+/* Vertex and draw data of leaves is built afterwards, see pbvh_build_leaves() */
 static void build_leaf(PBVH *bvh, int node_index, BBC *prim_bbc,
                        int offset, int count)
 {
@@ -387,13 +454,7 @@ static void build_leaf(PBVH *bvh, int node_index, BBC *prim_bbc,
 	bvh->nodes[node_index].totprim = count;
 
 	/* Still need vb for searches */
-	update_vb(bvh, &bvh->nodes[node_index], prim_bbc, offset, count);
-		
-	if (bvh->looptri)
-		build_mesh_leaf_node(bvh, bvh->nodes + node_index);
-	else {
-		build_grid_leaf_node(bvh, bvh->nodes + node_index);
-	}
+	update_vb(bvh, &bvh->nodes[node_index], prim_bbc, offset, count, NULL, false);
 }
 
 /* Return zero if all primitives in the node can be drawn with the
@@ -429,6 +490,41 @@ static bool leaf_needs_material_split(PBVH *bvh, int offset, int count)
 }
 
 
+typedef struct PBVHBuildTask {
+	/* Node to build the subtree into, and its primitive range */
+	int node_index;
+	int offset, count;
+
+	/* Nodes of the subtree, root first */
+	PBVHNode *nodes;
+	int totnode;
+} PBVHBuildTask;
+
+typedef struct PBVHBuildData {
+	PBVH *bvh;
+	BBC *prim_bbc;
+
+	/* Subtrees with this many primitives or less are built by separate tasks,
+	 * zero when the whole tree is built serially */
+	int subtree_limit;
+
+	PBVHBuildTask *tasks;
+	int tot_tasks, tasks_space;
+} PBVHBuildData;
+
+static void pbvh_build_task_add(PBVHBuildData *build, int node_index, int offset, int count)
+{
+	if (UNLIKELY(build->tot_tasks == build->tasks_space)) {
+		build->tasks_space = (build->tasks_space == 0) ? 32 : build->tasks_space * 2;
+		build->tasks = MEM_recallocN_id(build->tasks, sizeof(PBVHBuildTask) * build->tasks_space, __func__);
+	}
+
+	PBVHBuildTask *task = &build->tasks[build->tot_tasks++];
+	task->node_index = node_index;
+	task->offset = offset;
+	task->count = count;
+}
+
 /* Recursively build a node in the tree
  *
  * vb is the voxel box around all of the primitives contained in
@@ -440,9 +536,11 @@ static bool leaf_needs_material_split(PBVH *bvh, int offset, int count)
  * offset and start indicate a range in the array of primitive indices
  */
 
-static void build_sub(PBVH *bvh, int node_index, BB *cb, BBC *prim_bbc,
+static void build_sub(PBVH *bvh, int node_index, BB *cb, PBVHBuildData *build,
                       int offset, int count)
 {
+	BBC *prim_bbc = build->prim_bbc;
+	const bool use_threading = (build->subtree_limit != 0);
 	int end;
 	BB cb_backing;
 
@@ -454,21 +552,25 @@ static void build_sub(PBVH *bvh, int node_index, BB *cb, BBC *prim_bbc,
 			return;
 		}
 	}
+	else if (count <= build->subtree_limit) {
+		/* Defer to a task, see pbvh_build_subtree_task_cb() */
+		pbvh_build_task_add(build, node_index, offset, count);
+		return;
+	}
 
 	/* Add two child nodes */
 	bvh->nodes[node_index].children_offset = bvh->totnode;
 	pbvh_grow_nodes(bvh, bvh->totnode + 2);
 
-	/* Update parent node bounding box */
-	update_vb(bvh, &bvh->nodes[node_index], prim_bbc, offset, count);
-
 	if (!below_leaf_limit) {
-		/* Find axis with widest range of primitive centroids */
+		/* Update parent node bounding box, and find axis with
+		 * widest range of primitive centroids */
 		if (!cb) {
 			cb = &cb_backing;
-			BB_reset(cb);
-			for (int i = offset + count - 1; i >= offset; --i)
-				BB_expand(cb, prim_bbc[bvh->prim_indices[i]].bcentroid);
+			update_vb(bvh, &bvh->nodes[node_index], prim_bbc, offset, count, cb, use_threading);
+		}
+		else {
+			update_vb(bvh, &bvh->nodes[node_index], prim_bbc, offset, count, NULL, use_threading);
 		}
 		const int axis = BB_widest_axis(cb);
 
@@ -480,15 +582,136 @@ static void build_sub(PBVH *bvh, int node_index, BB *cb, BBC *prim_bbc,
 		                        prim_bbc);
 	}
 	else {
+		/* Update parent node bounding box */
+		update_vb(bvh, &bvh->nodes[node_index], prim_bbc, offset, count, NULL, false);
+
 		/* Partition primitives by material */
 		end = partition_indices_material(bvh, offset, offset + count - 1);
 	}
 
 	/* Build children */
 	build_sub(bvh, bvh->nodes[node_index].children_offset, NULL,
-	          prim_bbc, offset, end - offset);
+	          build, offset, end - offset);
 	build_sub(bvh, bvh->nodes[node_index].children_offset + 1, NULL,
-	          prim_bbc, end, offset + count - end);
+	          build, end, offset + count - end);
+}
+
+/* Build a subtree into its own node array, primitive ranges of
+ * the tasks don't overlap so they only share read-only data */
+static void pbvh_build_subtree_task_cb(TaskPool * __restrict pool, void *taskdata, int UNUSED(threadid))
+{
+	PBVHBuildData *build = BLI_task_pool_userdata(pool);
+	PBVHBuildTask *task = taskdata;
+	PBVHBuildData sub_build = {NULL};
+	PBVH sub_bvh = *build->bvh;
+
+	sub_build.bvh = &sub_bvh;
+	sub_build.prim_bbc = build->prim_bbc;
+
+	sub_bvh.node_mem_count = 16;
+	sub_bvh.nodes = MEM_callocN(sizeof(PBVHNode) * sub_bvh.node_mem_count, "bvh subtree nodes");
+	sub_bvh.totnode = 1;
+
+	build_sub(&sub_bvh, 0, NULL, &sub_build, task->offset, task->count);
+
+	task->nodes = sub_bvh.nodes;
+	task->totnode = sub_bvh.totnode;
+}
+
+/* Append the subtrees to the main node array, root of each subtree
+ * goes to the node it was deferred from */
+static void pbvh_build_tasks_merge(PBVH *bvh, PBVHBuildData *build)
+{
+	for (int i = 0; i < build->tot_tasks; i++) {
+		PBVHBuildTask *task = &build->tasks[i];
+		const int base = bvh->totnode - 1;
+
+		pbvh_grow_nodes(bvh, bvh->totnode + task->totnode - 1);
+
+		for (int j = 0; j < task->totnode; j++) {
+			PBVHNode *node = &bvh->nodes[(j == 0) ? task->node_index : base + j];
+
+			*node = task->nodes[j];
+			if (!(node->flag & PBVH_Leaf)) {
+				node->children_offset += base;
+			}
+		}
+
+		MEM_freeN(task->nodes);
+	}
+}
+
+typedef struct PBVHBuildLeavesData {
+	PBVH *bvh;
+	const int *leaves;
+} PBVHBuildLeavesData;
+
+static void pbvh_build_vert_owner_task_cb(void *userdata, const int n)
+{
+	PBVHBuildLeavesData *data = userdata;
+	PBVH *bvh = data->bvh;
+	const unsigned int node_index = (unsigned int)data->leaves[n];
+	const PBVHNode *node = &bvh->nodes[node_index];
+
+	/* Leaf with the lowest index using a vertex owns it, so the result
+	 * doesn't depend on the order the leaves are processed in */
+	for (int i = 0; i < node->totprim; i++) {
+		const MLoopTri *lt = &bvh->looptri[node->prim_indices[i]];
+		for (int j = 0; j < 3; j++) {
+			unsigned int *owner = &bvh->vert_owner[bvh->mloop[lt->tri[j]].v];
+			unsigned int owner_prev = *owner;
+			while (node_index < owner_prev) {
+				const unsigned int owner_cas = atomic_cas_uint32(owner, owner_prev, node_index);
+				if (owner_cas == owner_prev) {
+					break;
+				}
+				owner_prev = owner_cas;
+			}
+		}
+	}
+}
+
+static void pbvh_build_leaf_task_cb(void *userdata, const int n)
+{
+	PBVHBuildLeavesData *data = userdata;
+	PBVH *bvh = data->bvh;
+	PBVHNode *node = &bvh->nodes[data->leaves[n]];
+
+	if (bvh->looptri) {
+		build_mesh_leaf_node(bvh, node);
+	}
+	else {
+		build_grid_leaf_node(bvh, node);
+	}
+}
+
+static void pbvh_build_leaves(PBVH *bvh)
+{
+	int *leaves = MEM_mallocN(sizeof(int) * bvh->totnode, __func__);
+	int totleaf = 0;
+
+	for (int i = 0; i < bvh->totnode; i++) {
+		if (bvh->nodes[i].flag & PBVH_Leaf) {
+			leaves[totleaf++] = i;
+		}
+	}
+
+	PBVHBuildLeavesData data = {
+	    .bvh = bvh,
+	    .leaves = leaves,
+	};
+
+	if (bvh->looptri) {
+		bvh->vert_owner = MEM_mallocN(sizeof(*bvh->vert_owner) * bvh->totvert, "bvh->vert_owner");
+		memset(bvh->vert_owner, 0xff, sizeof(*bvh->vert_owner) * bvh->totvert);
+
+		BLI_task_parallel_range(0, totleaf, &data, pbvh_build_vert_owner_task_cb, totleaf > PBVH_THREADED_LIMIT);
+	}
+
+	BLI_task_parallel_range(0, totleaf, &data, pbvh_build_leaf_task_cb, totleaf > PBVH_THREADED_LIMIT);
+
+	MEM_SAFE_FREE(bvh->vert_owner);
+	MEM_freeN(leaves);
 }
 
 static void pbvh_build(PBVH *bvh, BB *cb, BBC *prim_bbc, int totprim)
@@ -510,8 +733,109 @@ static void pbvh_build(PBVH *bvh, BB *cb, BBC *prim_bbc, int totprim)
 		}
 	}
 
+	PBVHBuildData build = {NULL};
+	build.bvh = bvh;
+	build.prim_bbc = prim_bbc;
+
+	/* Split the top of the tree serially until there are enough subtrees
+	 * to keep all threads busy, then build those in parallel */
+	TaskScheduler *scheduler = BLI_task_scheduler_get();
+	const int num_threads = BLI_task_scheduler_num_threads(scheduler);
+	if (num_threads > 1 && totprim > PBVH_BUILD_THREADED_LIMIT) {
+		build.subtree_limit = max_ii(totprim / (num_threads * 8), bvh->leaf_limit * 2);
+	}
+
 	bvh->totnode = 1;
-	build_sub(bvh, 0, cb, prim_bbc, 0, totprim);
+	build_sub(bvh, 0, cb, &build, 0, totprim);
+
+	if (build.tot_tasks) {
+		TaskPool *task_pool = BLI_task_pool_create(scheduler, &build);
+
+		for (int i = 0; i < build.tot_tasks; i++) {
+			BLI_task_pool_push(task_pool, pbvh_build_subtree_task_cb, &build.tasks[i], false, TASK_PRIORITY_HIGH);
+		}
+
+		BLI_task_pool_work_and_wait(task_pool);
+		BLI_task_pool_free(task_pool);
+
+		pbvh_build_tasks_merge(bvh, &build);
+		MEM_freeN(build.tasks);
+	}
+
+	pbvh_build_leaves(bvh);
+}
+
+typedef struct PBVHPrimBoundsData {
+	const PBVH *bvh;
+	BBC *prim_bbc;
+} PBVHPrimBoundsData;
+
+static void pbvh_prim_bounds_join_cb(
+        void *__restrict UNUSED(userdata), void *__restrict accum, const void *__restrict accum_other)
+{
+	BB_expand_with_bb(accum, (BB *)accum_other);
+}
+
+static void pbvh_prim_bounds_mesh_reduce_cb(
+        void *__restrict userdata, void *__restrict accum, const int start, const int stop)
+{
+	PBVHPrimBoundsData *data = userdata;
+	const PBVH *bvh = data->bvh;
+	const int sides = 3;
+
+	for (int i = start; i < stop; i++) {
+		const MLoopTri *lt = &bvh->looptri[i];
+		BBC *bbc = data->prim_bbc + i;
+
+		BB_reset((BB *)bbc);
+
+		for (int j = 0; j < sides; ++j)
+			BB_expand((BB *)bbc, bvh->verts[bvh->mloop[lt->tri[j]].v].co);
+
+		BBC_update_centroid(bbc);
+
+		BB_expand(accum, bbc->bcentroid);
+	}
+}
+
+static void pbvh_prim_bounds_grids_reduce_cb(
+        void *__restrict userdata, void *__restrict accum, const int start, const int stop)
+{
+	PBVHPrimBoundsData *data = userdata;
+	const PBVH *bvh = data->bvh;
+	const CCGKey *key = &bvh->gridkey;
+
+	for (int i = start; i < stop; i++) {
+		CCGElem *grid = bvh->grids[i];
+		BBC *bbc = data->prim_bbc + i;
+
+		BB_reset((BB *)bbc);
+
+		for (int j = 0; j < key->grid_size * key->grid_size; ++j)
+			BB_expand((BB *)bbc, CCG_elem_offset_co(key, grid, j));
+
+		BBC_update_centroid(bbc);
+
+		BB_expand(accum, bbc->bcentroid);
+	}
+}
+
+/* For each primitive, store the AABB and the AABB centroid */
+static BBC *pbvh_prim_bounds_calc(PBVH *bvh, int totprim, BB *r_cb)
+{
+	PBVHPrimBoundsData data = {
+	    .bvh = bvh,
+	    .prim_bbc = MEM_mallocN(sizeof(BBC) * totprim, "prim_bbc"),
+	};
+
+	BB_reset(r_cb);
+
+	BLI_task_parallel_reduce(
+	            0, totprim, &data, r_cb, sizeof(*r_cb),
+	            (bvh->type == PBVH_GRIDS) ? pbvh_prim_bounds_grids_reduce_cb : pbvh_prim_bounds_mesh_reduce_cb,
+	            pbvh_prim_bounds_join_cb, PBVH_BUILD_THREADED_LIMIT);
+
+	return data.prim_bbc;
 }
 
 /**
@@ -533,36 +857,17 @@ void BKE_pbvh_build_mesh(
 	bvh->mloop = mloop;
 	bvh->looptri = looptri;
 	bvh->verts = verts;
-	bvh->vert_bitmap = BLI_BITMAP_NEW(totvert, "bvh->vert_bitmap");
 	bvh->totvert = totvert;
 	bvh->leaf_limit = LEAF_LIMIT;
 	bvh->vdata = vdata;
 
-	BB_reset(&cb);
-
 	/* For each face, store the AABB and the AABB centroid */
-	prim_bbc = MEM_mallocN(sizeof(BBC) * looptri_num, "prim_bbc");
-
-	for (int i = 0; i < looptri_num; ++i) {
-		const MLoopTri *lt = &looptri[i];
-		const int sides = 3;
-		BBC *bbc = prim_bbc + i;
-
-		BB_reset((BB *)bbc);
-
-		for (int j = 0; j < sides; ++j)
-			BB_expand((BB *)bbc, verts[bvh->mloop[lt->tri[j]].v].co);
-
-		BBC_update_centroid(bbc);
-
-		BB_expand(&cb, bbc->bcentroid);
-	}
+	prim_bbc = pbvh_prim_bounds_calc(bvh, looptri_num, &cb);
 
 	if (looptri_num)
 		pbvh_build(bvh, &cb, prim_bbc, looptri_num);
 
 	MEM_freeN(prim_bbc);
-	MEM_freeN(bvh->vert_bitmap);
 }
 
 /* Do a full rebuild with on Grids data structure */
@@ -581,24 +886,9 @@ void BKE_pbvh_build_grids(PBVH *bvh, CCGElem **grids,
 	bvh->leaf_limit = max_ii(LEAF_LIMIT / ((gridsize - 1) * (gridsize - 1)), 1);
 
 	BB cb;
-	BB_reset(&cb);
 
 	/* For each grid, store the AABB and the AABB centroid */
-	BBC *prim_bbc = MEM_mallocN(sizeof(BBC) * totgrid, "prim_bbc");
-
-	for (int i = 0; i < totgrid; ++i) {
-		CCGElem *grid = grids[i];
-		BBC *bbc = prim_bbc + i;
-
-		BB_reset((BB *)bbc);
-
-		for (int j = 0; j < gridsize * gridsize; ++j)
-			BB_expand((BB *)bbc, CCG_elem_offset_co(key, grid, j));
-
-		BBC_update_centroid(bbc);
-
-		BB_expand(&cb, bbc->bcentroid);
-	}
+	BBC *prim_bbc = pbvh_prim_bounds_calc(bvh, totgrid, &cb);
 
 	if (totgrid)
 		pbvh_build(bvh, &cb, prim_bbc, totgrid);
@@ -819,55 +1109,17 @@ void BKE_pbvh_search_callback(PBVH *bvh,
 	pbvh_iter_end(&iter);
 }
 
-typedef struct node_tree {
-	PBVHNode *data;
-
-	struct node_tree *left;
-	struct node_tree *right;
-} node_tree;
-
-static void node_tree_insert(node_tree *tree, node_tree *new_node)
+static int pbvh_node_tmin_cmp(const void *a_v, const void *b_v)
 {
-	if (new_node->data->tmin < tree->data->tmin) {
-		if (tree->left) {
-			node_tree_insert(tree->left, new_node);
-		}
-		else {
-			tree->left = new_node;
-		}
-	}
-	else {
-		if (tree->right) {
-			node_tree_insert(tree->right, new_node);
-		}
-		else {
-			tree->right = new_node;
-		}
-	}
-}
+	const PBVHNode *a = *(const PBVHNode **)a_v;
+	const PBVHNode *b = *(const PBVHNode **)b_v;
 
-static void traverse_tree(node_tree *tree, BKE_pbvh_HitOccludedCallback hcb, void *hit_data, float *tmin)
-{
-	if (tree->left) traverse_tree(tree->left, hcb, hit_data, tmin);
-
-	hcb(tree->data, hit_data, tmin);
-
-	if (tree->right) traverse_tree(tree->right, hcb, hit_data, tmin);
-}
-
-static void free_tree(node_tree *tree)
-{
-	if (tree->left) {
-		free_tree(tree->left);
-		tree->left = NULL;
-	}
-
-	if (tree->right) {
-		free_tree(tree->right);
-		tree->right = NULL;
-	}
-
-	free(tree);
+	if (a->tmin < b->tmin) return -1;
+	else if (a->tmin > b->tmin) return 1;
+	/* Keep order of equally distant nodes stable */
+	else if (a < b) return -1;
+	else if (a > b) return 1;
+	else return 0;
 }
 
 float BKE_pbvh_node_get_tmin(PBVHNode *node)
@@ -881,34 +1133,45 @@ static void BKE_pbvh_search_callback_occluded(PBVH *bvh,
 {
 	PBVHIter iter;
 	PBVHNode *node;
-	node_tree *tree = NULL;
+	PBVHNode *nodes_stack[STACK_FIXED_DEPTH];
+	PBVHNode **nodes = nodes_stack;
+	int tot = 0, space = STACK_FIXED_DEPTH;
 
 	pbvh_iter_begin(&iter, bvh, scb, search_data);
 
 	while ((node = pbvh_iter_next_occluded(&iter))) {
 		if (node->flag & PBVH_Leaf) {
-			node_tree *new_node = malloc(sizeof(node_tree));
-
-			new_node->data = node;
-
-			new_node->left  = NULL;
-			new_node->right = NULL;
-
-			if (tree) {
-				node_tree_insert(tree, new_node);
-			}
-			else {
-				tree = new_node;
+			if (UNLIKELY(tot == space)) {
+				/* resize array if needed */
+				space *= 2;
+				if (nodes == nodes_stack) {
+					nodes = MEM_mallocN(sizeof(PBVHNode *) * space, __func__);
+					memcpy(nodes, nodes_stack, sizeof(PBVHNode *) * tot);
+				}
+				else {
+					nodes = MEM_reallocN(nodes, sizeof(PBVHNode *) * space);
+				}
 			}
+
+			nodes[tot++] = node;
 		}
 	}
 
 	pbvh_iter_end(&iter);
 
-	if (tree) {
+	if (tot) {
+		/* Visit hit leaves from the nearest one */
 		float tmin = FLT_MAX;
-		traverse_tree(tree, hcb, hit_data, &tmin);
-		free_tree(tree);
+
+		qsort(nodes, tot, sizeof(PBVHNode *), pbvh_node_tmin_cmp);
+
+		for (int i = 0; i < tot; i++) {
+			hcb(nodes[i], hit_data, &tmin);
+		}
+	}
+
+	if (nodes != nodes_stack) {
+		MEM_freeN(nodes);
 	}
 }
 
@@ -30,6 +30,7 @@
 #include "BLI_heap.h"
 #include "BLI_math.h"
 #include "BLI_memarena.h"
+#include "BLI_task.h"
 
 #include "BKE_ccg.h"
 #include "BKE_DerivedMesh.h"
@@ -65,6 +66,9 @@
 
 // #define USE_VERIFY
 
+/* Minimum number of nodes to find faces for the edge queue with threads */
+#define DYNTOPO_THREADED_LIMIT 4
+
 #ifdef USE_VERIFY
 static void pbvh_bmesh_verify(PBVH *bvh);
 #endif
@@ -917,59 +921,120 @@ static void short_edge_queue_edge_add(
 	}
 }
 
-static void long_edge_queue_face_add(
-        EdgeQueueContext *eq_ctx,
-        BMFace *f)
+/* Return true if the edges of the face are to be checked,
+ * doesn't modify anything so it can run from threads */
+static bool edge_queue_face_test(const EdgeQueue *q, BMFace *f)
 {
 #ifdef USE_EDGEQUEUE_FRONTFACE
-	if (eq_ctx->q->use_view_normal) {
-		if (dot_v3v3(f->no, eq_ctx->q->view_normal) < 0.0f) {
-			return;
+	if (q->use_view_normal) {
+		if (dot_v3v3(f->no, q->view_normal) < 0.0f) {
+			return false;
 		}
 	}
 #endif
 
-	if (edge_queue_tri_in_sphere(eq_ctx->q, f)) {
-		/* Check each edge of the face */
-		BMLoop *l_first = BM_FACE_FIRST_LOOP(f);
-		BMLoop *l_iter = l_first;
-		do {
+	return edge_queue_tri_in_sphere(q, f);
+}
+
+static void long_edge_queue_face_add(
+        EdgeQueueContext *eq_ctx,
+        BMFace *f)
+{
+	/* Check each edge of the face */
+	BMLoop *l_first = BM_FACE_FIRST_LOOP(f);
+	BMLoop *l_iter = l_first;
+	do {
 #ifdef USE_EDGEQUEUE_EVEN_SUBDIV
-			const float len_sq = BM_edge_calc_length_squared(l_iter->e);
-			if (len_sq > eq_ctx->q->limit_len_squared) {
-				long_edge_queue_edge_add_recursive(
-				        eq_ctx, l_iter->radial_next, l_iter,
-				        len_sq, eq_ctx->q->limit_len);
-			}
+		const float len_sq = BM_edge_calc_length_squared(l_iter->e);
+		if (len_sq > eq_ctx->q->limit_len_squared) {
+			long_edge_queue_edge_add_recursive(
+			        eq_ctx, l_iter->radial_next, l_iter,
+			        len_sq, eq_ctx->q->limit_len);
+		}
 #else
-			long_edge_queue_edge_add(eq_ctx, l_iter->e);
+		long_edge_queue_edge_add(eq_ctx, l_iter->e);
 #endif
-		} while ((l_iter = l_iter->next) != l_first);
-	}
+	} while ((l_iter = l_iter->next) != l_first);
 }
 
 static void short_edge_queue_face_add(
         EdgeQueueContext *eq_ctx,
         BMFace *f)
 {
-#ifdef USE_EDGEQUEUE_FRONTFACE
-	if (eq_ctx->q->use_view_normal) {
-		if (dot_v3v3(f->no, eq_ctx->q->view_normal) < 0.0f) {
-			return;
+	BMLoop *l_iter;
+	BMLoop *l_first;
+
+	/* Check each edge of the face */
+	l_iter = l_first = BM_FACE_FIRST_LOOP(f);
+	do {
+		short_edge_queue_edge_add(eq_ctx, l_iter->e);
+	} while ((l_iter = l_iter->next) != l_first);
+}
+
+typedef struct EdgeQueueThreadData {
+	const EdgeQueue *q;
+	PBVHNode *node;
+
+	/* Faces of the node passing edge_queue_face_test() */
+	BMFace **faces;
+	int totface;
+} EdgeQueueThreadData;
+
+static void edge_queue_node_faces_task_cb(void *userdata, const int n)
+{
+	EdgeQueueThreadData *tdata = &((EdgeQueueThreadData *)userdata)[n];
+	GSetIterator gs_iter;
+
+	tdata->faces = MEM_mallocN(sizeof(*tdata->faces) * BLI_gset_size(tdata->node->bm_faces), __func__);
+	tdata->totface = 0;
+
+	/* Check each face */
+	GSET_ITER (gs_iter, tdata->node->bm_faces) {
+		BMFace *f = BLI_gsetIterator_getKey(&gs_iter);
+
+		if (edge_queue_face_test(tdata->q, f)) {
+			tdata->faces[tdata->totface++] = f;
 		}
 	}
-#endif
+}
 
-	if (edge_queue_tri_in_sphere(eq_ctx->q, f)) {
-		BMLoop *l_iter;
-		BMLoop *l_first;
+/* Add edges of the faces of leaf nodes marked for topology update.
+ *
+ * Faces are tested for each node in parallel, edges are added to the queue
+ * afterwards in the same order as a serial loop over the nodes would,
+ * since edges shared by faces of different nodes are only queued once and
+ * long edges are followed into neighboring nodes. */
+static void edge_queue_nodes_add(
+        EdgeQueueContext *eq_ctx, PBVH *bvh,
+        void (*face_add)(EdgeQueueContext *eq_ctx, BMFace *f))
+{
+	EdgeQueueThreadData *tdata = MEM_mallocN(sizeof(*tdata) * bvh->totnode, __func__);
+	int totnode = 0;
 
-		/* Check each edge of the face */
-		l_iter = l_first = BM_FACE_FIRST_LOOP(f);
-		do {
-			short_edge_queue_edge_add(eq_ctx, l_iter->e);
-		} while ((l_iter = l_iter->next) != l_first);
+	for (int n = 0; n < bvh->totnode; n++) {
+		PBVHNode *node = &bvh->nodes[n];
+
+		/* Check leaf nodes marked for topology update */
+		if ((node->flag & PBVH_Leaf) &&
+		    (node->flag & PBVH_UpdateTopology) &&
+		    !(node->flag & PBVH_FullyHidden))
+		{
+			tdata[totnode].q = eq_ctx->q;
+			tdata[totnode].node = node;
+			totnode++;
+		}
+	}
+
+	BLI_task_parallel_range(0, totnode, tdata, edge_queue_node_faces_task_cb, totnode > DYNTOPO_THREADED_LIMIT);
+
+	for (int n = 0; n < totnode; n++) {
+		for (int i = 0; i < tdata[n].totface; i++) {
+			face_add(eq_ctx, tdata[n].faces[i]);
+		}
+		MEM_freeN(tdata[n].faces);
 	}
+
+	MEM_freeN(tdata);
 }
 
 /* Create a priority queue containing vertex pairs connected by a long
@@ -1005,24 +1070,7 @@ static void long_edge_queue_create(
 	pbvh_bmesh_edge_tag_verify(bvh);
 #endif
 
-	for (int n = 0; n < bvh->totnode; n++) {
-		PBVHNode *node = &bvh->nodes[n];
-
-		/* Check leaf nodes marked for topology update */
-		if ((node->flag & PBVH_Leaf) &&
-		    (node->flag & PBVH_UpdateTopology) &&
-		    !(node->flag & PBVH_FullyHidden))
-		{
-			GSetIterator gs_iter;
-
-			/* Check each face */
-			GSET_ITER (gs_iter, node->bm_faces) {
-				BMFace *f = BLI_gsetIterator_getKey(&gs_iter);
-
-				long_edge_queue_face_add(eq_ctx, f);
-			}
-		}
-	}
+	edge_queue_nodes_add(eq_ctx, bvh, long_edge_queue_face_add);
 }
 
 /* Create a priority queue containing vertex pairs connected by a
@@ -1054,24 +1102,7 @@ static void short_edge_queue_create(
 	UNUSED_VARS(view_normal);
 #endif
 
-	for (int n = 0; n < bvh->totnode; n++) {
-		PBVHNode *node = &bvh->nodes[n];
-
-		/* Check leaf nodes marked for topology update */
-		if ((node->flag & PBVH_Leaf) &&
-		    (node->flag & PBVH_UpdateTopology) &&
-		    !(node->flag & PBVH_FullyHidden))
-		{
-			GSetIterator gs_iter;
-
-			/* Check each face */
-			GSET_ITER (gs_iter, node->bm_faces) {
-				BMFace *f = BLI_gsetIterator_getKey(&gs_iter);
-
-				short_edge_queue_face_add(eq_ctx, f);
-			}
-		}
-	}
+	edge_queue_nodes_add(eq_ctx, bvh, short_edge_queue_face_add);
 }
 
 /*************************** Topology update **************************/
@@ -152,7 +152,7 @@ struct PBVH {
 
 	/* Only used during BVH build and update,
 	 * don't need to remain valid after */
-	BLI_bitmap *vert_bitmap;
+	unsigned int *vert_owner;
 
 #ifdef PERFCNTRS
 	int perf_modified;
@@ -2271,20 +2271,10 @@ static void openvdb_filepath(PTCacheID *pid, char *filepath, int cfra)
 }
 
 /* youll need to close yourself after! */
-static PTCacheFile *ptcache_file_open(PTCacheID *pid, int mode, int cfra)
+static PTCacheFile *ptcache_file_open_path(const char *filename, int mode, int cfra)
 {
 	PTCacheFile *pf;
 	FILE *fp = NULL;
-	char filename[FILE_MAX * 2];
-
-#ifndef DURIAN_POINTCACHE_LIB_OK
-	/* don't allow writing for linked objects */
-	if (pid->ob->id.lib && mode == PTCACHE_FILE_WRITE)
-		return NULL;
-#endif
-	if (!G.relbase_valid && (pid->cache->flag & PTCACHE_EXTERNAL)==0) return NULL; /* save blend file before using disk pointcache */
-	
-	ptcache_filename(pid, filename, cfra, 1, 1);
 
 	if (mode==PTCACHE_FILE_READ) {
 		fp = BLI_fopen(filename, "rb");
@@ -2308,6 +2298,31 @@ static PTCacheFile *ptcache_file_open(PTCacheID *pid, int mode, int cfra)
 
 	return pf;
 }
+/* check whether the disk cache of pid may be accessed */
+static bool ptcache_file_allowed(PTCacheID *pid, int mode)
+{
+#ifndef DURIAN_POINTCACHE_LIB_OK
+	/* don't allow writing for linked objects */
+	if (pid->ob->id.lib && mode == PTCACHE_FILE_WRITE)
+		return false;
+#else
+	UNUSED_VARS(mode);
+#endif
+	if (!G.relbase_valid && (pid->cache->flag & PTCACHE_EXTERNAL)==0) return false; /* save blend file before using disk pointcache */
+
+	return true;
+}
+static PTCacheFile *ptcache_file_open(PTCacheID *pid, int mode, int cfra)
+{
+	char filename[FILE_MAX * 2];
+
+	if (!ptcache_file_allowed(pid, mode))
+		return NULL;
+
+	ptcache_filename(pid, filename, cfra, 1, 1);
+
+	return ptcache_file_open_path(filename, mode, cfra);
+}
 static void ptcache_file_close(PTCacheFile *pf)
 {
 	if (pf) {
@@ -2714,19 +2729,348 @@ static void ptcache_find_frames_around(PTCacheID *pid, unsigned int frame, int *
 	}
 }
 
-static PTCacheMem *ptcache_disk_frame_to_mem(PTCacheID *pid, int cfra)
+/* Background cache I/O
+ *
+ * Frames are converted on the calling thread, so the simulation can continue
+ * right away while compression and disk I/O happen on a dedicated I/O thread.
+ * During playback the next frames of disk caches are read ahead on the same
+ * thread. Simulations are evaluated from depsgraph tasks, so a task pool can't
+ * be used here. */
+
+/* The simulation waits when more frames than this are waiting to be written,
+ * this bounds the memory held by frames that are not on disk yet. */
+#define PTCACHE_IO_MAX_WRITES 2
+/* Number of frames after the current one that are read ahead. */
+#define PTCACHE_IO_READ_AHEAD 4
+/* Read ahead frames that are kept at most, the oldest are dropped first. */
+#define PTCACHE_IO_MAX_READS 8
+
+typedef struct PTCacheIOJob {
+	struct PTCacheIOJob *next, *prev;
+	char filename[FILE_MAX * 2];
+	bool is_write;
+	bool done;
+
+	/* writing, data is owned by the job */
+	void *data;
+	bool (*write)(void *data, const char *filename);
+	void (*free)(void *data);
+
+	/* reading */
+	int frame;
+	int type;
+	int (*read_header)(PTCacheFile *pf);
+	PTCacheMem *pm;
+} PTCacheIOJob;
+
+static struct {
+	ListBase threads;
+	ThreadQueue *queue;  /* NULL until the I/O thread is started */
+	ThreadMutex lock;
+	ThreadCondition cond;
+	ListBase jobs;  /* PTCacheIOJob, writes are removed once finished */
+	int totwrite, totread;
+	int totfailed;  /* writes that failed since last checked */
+} ptcache_io;
+
+static PTCacheMem *ptcache_file_to_mem(PTCacheFile *pf, int type, int (*read_header)(PTCacheFile *pf));
+
+void BKE_ptcache_io_init(void)
+{
+	BLI_mutex_init(&ptcache_io.lock);
+	BLI_condition_init(&ptcache_io.cond);
+	BLI_listbase_clear(&ptcache_io.jobs);
+	BLI_listbase_clear(&ptcache_io.threads);
+	ptcache_io.totwrite = 0;
+	ptcache_io.totread = 0;
+	ptcache_io.totfailed = 0;
+	ptcache_io.queue = NULL;
+}
+
+static void ptcache_io_job_free(PTCacheIOJob *job)
+{
+	if (job->pm) {
+		ptcache_data_free(job->pm);
+		ptcache_extra_free(job->pm);
+		MEM_freeN(job->pm);
+	}
+	MEM_freeN(job);
+}
+
+void BKE_ptcache_io_exit(void)
+{
+	PTCacheIOJob *job, *job_next;
+
+	if (ptcache_io.queue) {
+		/* the thread finishes the queued jobs first */
+		BLI_thread_queue_nowait(ptcache_io.queue);
+		BLI_end_threads(&ptcache_io.threads);
+		BLI_thread_queue_free(ptcache_io.queue);
+		ptcache_io.queue = NULL;
+	}
+
+	/* only finished reads are left */
+	for (job = ptcache_io.jobs.first; job; job = job_next) {
+		job_next = job->next;
+		ptcache_io_job_free(job);
+	}
+	BLI_listbase_clear(&ptcache_io.jobs);
+	ptcache_io.totread = 0;
+
+	BLI_condition_end(&ptcache_io.cond);
+	BLI_mutex_end(&ptcache_io.lock);
+}
+
+static void ptcache_io_run(PTCacheIOJob *job)
+{
+	/* finished reads may be freed by other threads as soon as the lock is released */
+	const bool is_write = job->is_write;
+	bool ok = true;
+
+	if (is_write) {
+		ok = job->write(job->data, job->filename);
+		job->free(job->data);
+	}
+	else {
+		PTCacheFile *pf = ptcache_file_open_path(job->filename, PTCACHE_FILE_READ, job->frame);
+
+		if (pf) {
+			job->pm = ptcache_file_to_mem(pf, job->type, job->read_header);
+		}
+	}
+
+	BLI_mutex_lock(&ptcache_io.lock);
+	job->done = true;
+	if (is_write) {
+		BLI_remlink(&ptcache_io.jobs, job);
+		ptcache_io.totwrite--;
+		if (!ok) {
+			ptcache_io.totfailed++;
+		}
+	}
+	BLI_condition_notify_all(&ptcache_io.cond);
+	BLI_mutex_unlock(&ptcache_io.lock);
+
+	if (is_write) {
+		MEM_freeN(job);
+	}
+}
+
+static void *ptcache_io_thread(void *UNUSED(data))
+{
+	PTCacheIOJob *job;
+
+	/* only returns NULL once the queue is told to stop waiting */
+	while ((job = BLI_thread_queue_pop(ptcache_io.queue))) {
+		ptcache_io_run(job);
+	}
+
+	return NULL;
+}
+
+static PTCacheIOJob *ptcache_io_find(const char *filename, const bool unfinished_only)
+{
+	PTCacheIOJob *job;
+
+	for (job = ptcache_io.jobs.first; job; job = job->next) {
+		if ((filename == NULL || STREQ(job->filename, filename)) && (!unfinished_only || !job->done)) {
+			break;
+		}
+	}
+
+	return job;
+}
+
+static void ptcache_io_push(PTCacheIOJob *job)
+{
+	BLI_mutex_lock(&ptcache_io.lock);
+	if (ptcache_io.queue == NULL) {
+		ptcache_io.queue = BLI_thread_queue_init();
+		BLI_init_threads(&ptcache_io.threads, ptcache_io_thread, 1);
+		BLI_insert_thread(&ptcache_io.threads, NULL);
+	}
+	BLI_mutex_unlock(&ptcache_io.lock);
+
+	BLI_thread_queue_push(ptcache_io.queue, job);
+}
+
+/* Wait until filename, or any file when it is NULL, is completely written
+ * and drop frames read ahead from it. Needed before the file is read,
+ * changed or removed. */
+static void ptcache_io_wait(const char *filename)
+{
+	PTCacheIOJob *job, *job_next;
+
+	BLI_mutex_lock(&ptcache_io.lock);
+	while (ptcache_io_find(filename, true)) {
+		BLI_condition_wait(&ptcache_io.cond, &ptcache_io.lock);
+	}
+
+	for (job = ptcache_io.jobs.first; job; job = job_next) {
+		job_next = job->next;
+		if (filename == NULL || STREQ(job->filename, filename)) {
+			BLI_remlink(&ptcache_io.jobs, job);
+			ptcache_io.totread--;
+			ptcache_io_job_free(job);
+		}
+	}
+	BLI_mutex_unlock(&ptcache_io.lock);
+}
+
+/* Returns true while filename is still queued or being written in the background,
+ * the file may not be on disk yet. */
+static bool ptcache_io_is_writing(const char *filename)
+{
+	PTCacheIOJob *job;
+
+	BLI_mutex_lock(&ptcache_io.lock);
+	for (job = ptcache_io.jobs.first; job; job = job->next) {
+		if (job->is_write && STREQ(job->filename, filename)) {
+			break;
+		}
+	}
+	BLI_mutex_unlock(&ptcache_io.lock);
+
+	return job != NULL;
+}
+
+/* Returns the number of background writes that failed since the last call. */
+static int ptcache_io_failed_writes(void)
+{
+	int totfailed;
+
+	BLI_mutex_lock(&ptcache_io.lock);
+	totfailed = ptcache_io.totfailed;
+	ptcache_io.totfailed = 0;
+	BLI_mutex_unlock(&ptcache_io.lock);
+
+	return totfailed;
+}
+
+/* Takes ownership of data, which is written to filename and freed in the background. */
+static void ptcache_io_write(const char *filename, void *data,
+                             bool (*write)(void *data, const char *filename), void (*free)(void *data))
+{
+	PTCacheIOJob *job = MEM_callocN(sizeof(PTCacheIOJob), "PTCacheIOJob");
+
+	BLI_strncpy(job->filename, filename, sizeof(job->filename));
+	job->is_write = true;
+	job->data = data;
+	job->write = write;
+	job->free = free;
+
+	ptcache_io_wait(filename);
+
+	BLI_mutex_lock(&ptcache_io.lock);
+	while (ptcache_io.totwrite >= PTCACHE_IO_MAX_WRITES) {
+		BLI_condition_wait(&ptcache_io.cond, &ptcache_io.lock);
+	}
+	BLI_addtail(&ptcache_io.jobs, job);
+	ptcache_io.totwrite++;
+	BLI_mutex_unlock(&ptcache_io.lock);
+
+	ptcache_io_push(job);
+}
+
+/* Returns true when filename was read ahead, r_pm is then set to the frame or
+ * NULL if reading failed. */
+static bool ptcache_io_read_take(const char *filename, PTCacheMem **r_pm)
+{
+	PTCacheIOJob *job;
+	bool found = false;
+
+	BLI_mutex_lock(&ptcache_io.lock);
+	for (;;) {
+		job = ptcache_io_find(filename, false);
+
+		if (job == NULL || job->done) {
+			break;
+		}
+		BLI_condition_wait(&ptcache_io.cond, &ptcache_io.lock);
+	}
+
+	if (job) {
+		BLI_assert(!job->is_write);
+		BLI_remlink(&ptcache_io.jobs, job);
+		ptcache_io.totread--;
+		*r_pm = job->pm;
+		job->pm = NULL;
+		found = true;
+	}
+	BLI_mutex_unlock(&ptcache_io.lock);
+
+	if (job) {
+		ptcache_io_job_free(job);
+	}
+
+	return found;
+}
+
+/* Start reading the frames after cfra in the background. */
+static void ptcache_io_read_ahead(PTCacheID *pid, int cfra)
+{
+	char filename[FILE_MAX * 2];
+	int frame;
+
+	for (frame = cfra + 1; frame <= cfra + PTCACHE_IO_READ_AHEAD && frame <= pid->cache->endframe; frame++) {
+		PTCacheIOJob *job, *job_iter;
+
+		if (!BKE_ptcache_id_exist(pid, frame)) {
+			break;
+		}
+
+		ptcache_filename(pid, filename, frame, 1, 1);
+
+		BLI_mutex_lock(&ptcache_io.lock);
+
+		if (ptcache_io_find(filename, false)) {
+			BLI_mutex_unlock(&ptcache_io.lock);
+			continue;
+		}
+
+		/* make room by dropping the oldest finished read */
+		if (ptcache_io.totread >= PTCACHE_IO_MAX_READS) {
+			for (job_iter = ptcache_io.jobs.first; job_iter; job_iter = job_iter->next) {
+				if (!job_iter->is_write && job_iter->done) {
+					break;
+				}
+			}
+
+			if (job_iter == NULL) {
+				BLI_mutex_unlock(&ptcache_io.lock);
+				break;
+			}
+
+			BLI_remlink(&ptcache_io.jobs, job_iter);
+			ptcache_io.totread--;
+			ptcache_io_job_free(job_iter);
+		}
+
+		job = MEM_callocN(sizeof(PTCacheIOJob), "PTCacheIOJob");
+		BLI_strncpy(job->filename, filename, sizeof(job->filename));
+		job->frame = frame;
+		job->type = pid->type;
+		job->read_header = pid->read_header;
+
+		BLI_addtail(&ptcache_io.jobs, job);
+		ptcache_io.totread++;
+		BLI_mutex_unlock(&ptcache_io.lock);
+
+		ptcache_io_push(job);
+	}
+}
+
+/* Reads an open cache file into a new memory frame and closes the file,
+ * doesn't access the cache so it can run in the background. */
+static PTCacheMem *ptcache_file_to_mem(PTCacheFile *pf, int type, int (*read_header)(PTCacheFile *pf))
 {
-	PTCacheFile *pf = ptcache_file_open(pid, PTCACHE_FILE_READ, cfra);
 	PTCacheMem *pm = NULL;
 	unsigned int i, error = 0;
 
-	if (pf == NULL)
-		return NULL;
-
 	if (!ptcache_file_header_begin_read(pf))
 		error = 1;
 
-	if (!error && (pf->type != pid->type || !pid->read_header(pf)))
+	if (!error && (pf->type != type || !read_header(pf)))
 		error = 1;
 
 	if (!error) {
@@ -2795,42 +3139,57 @@ static PTCacheMem *ptcache_disk_frame_to_mem(PTCacheID *pid, int cfra)
 	
 	return pm;
 }
-static int ptcache_mem_frame_to_disk(PTCacheID *pid, PTCacheMem *pm)
+static PTCacheMem *ptcache_disk_frame_to_mem(PTCacheID *pid, int cfra)
 {
-	PTCacheFile *pf = NULL;
-	unsigned int i, error = 0;
-	
-	BKE_ptcache_id_clear(pid, PTCACHE_CLEAR_FRAME, pm->frame);
+	PTCacheFile *pf;
+	PTCacheMem *pm = NULL;
+	char filename[FILE_MAX * 2];
 
-	pf = ptcache_file_open(pid, PTCACHE_FILE_WRITE, pm->frame);
+	if (!ptcache_file_allowed(pid, PTCACHE_FILE_READ))
+		return NULL;
 
-	if (pf==NULL) {
-		if (G.debug & G_DEBUG)
-			printf("Error opening disk cache file for writing\n");
-		return 0;
+	ptcache_filename(pid, filename, cfra, 1, 1);
+
+	if (!ptcache_io_read_take(filename, &pm)) {
+		pf = ptcache_file_open_path(filename, PTCACHE_FILE_READ, cfra);
+
+		if (pf)
+			pm = ptcache_file_to_mem(pf, pid->type, pid->read_header);
 	}
 
+	if (pm)
+		ptcache_io_read_ahead(pid, cfra);
+
+	return pm;
+}
+/* Writes a memory frame to an open cache file and closes the file,
+ * doesn't access the cache so it can run in the background. */
+static int ptcache_mem_to_file(PTCacheFile *pf, PTCacheMem *pm, int type, int compression,
+                               int (*write_header)(PTCacheFile *pf))
+{
+	unsigned int i, error = 0;
+
 	pf->data_types = pm->data_types;
 	pf->totpoint = pm->totpoint;
-	pf->type = pid->type;
+	pf->type = type;
 	pf->flag = 0;
 	
 	if (pm->extradata.first)
 		pf->flag |= PTCACHE_TYPEFLAG_EXTRADATA;
 	
-	if (pid->cache->compression)
+	if (compression)
 		pf->flag |= PTCACHE_TYPEFLAG_COMPRESS;
 
-	if (!ptcache_file_header_begin_write(pf) || !pid->write_header(pf))
+	if (!ptcache_file_header_begin_write(pf) || !write_header(pf))
 		error = 1;
 
 	if (!error) {
-		if (pid->cache->compression) {
+		if (compression) {
 			for (i=0; i<BPHYS_TOT_DATA; i++) {
 				if (pm->data[i]) {
 					unsigned int in_len = pm->totpoint*ptcache_data_size[i];
 					unsigned char *out = (unsigned char *)MEM_callocN(LZO_OUT_LEN(in_len) * 4, "pointcache_lzo_buffer");
-					ptcache_file_compressed_write(pf, (unsigned char *)(pm->data[i]), in_len, out, pid->cache->compression);
+					ptcache_file_compressed_write(pf, (unsigned char *)(pm->data[i]), in_len, out, compression);
 					MEM_freeN(out);
 				}
 			}
@@ -2860,10 +3219,10 @@ static int ptcache_mem_frame_to_disk(PTCacheID *pid, PTCacheMem *pm)
 			ptcache_file_write(pf, &extra->type, 1, sizeof(unsigned int));
 			ptcache_file_write(pf, &extra->totdata, 1, sizeof(unsigned int));
 
-			if (pid->cache->compression) {
+			if (compression) {
 				unsigned int in_len = extra->totdata * ptcache_extra_datasize[extra->type];
 				unsigned char *out = (unsigned char *)MEM_callocN(LZO_OUT_LEN(in_len) * 4, "pointcache_lzo_buffer");
-				ptcache_file_compressed_write(pf, (unsigned char *)(extra->data), in_len, out, pid->cache->compression);
+				ptcache_file_compressed_write(pf, (unsigned char *)(extra->data), in_len, out, compression);
 				MEM_freeN(out);
 			}
 			else {
@@ -2879,6 +3238,83 @@ static int ptcache_mem_frame_to_disk(PTCacheID *pid, PTCacheMem *pm)
 
 	return error==0;
 }
+static PTCacheFile *ptcache_mem_frame_open_write(PTCacheID *pid, PTCacheMem *pm)
+{
+	PTCacheFile *pf;
+
+	BKE_ptcache_id_clear(pid, PTCACHE_CLEAR_FRAME, pm->frame);
+
+	pf = ptcache_file_open(pid, PTCACHE_FILE_WRITE, pm->frame);
+
+	if (pf==NULL) {
+		if (G.debug & G_DEBUG)
+			printf("Error opening disk cache file for writing\n");
+	}
+
+	return pf;
+}
+static int ptcache_mem_frame_to_disk(PTCacheID *pid, PTCacheMem *pm)
+{
+	PTCacheFile *pf = ptcache_mem_frame_open_write(pid, pm);
+
+	if (pf==NULL)
+		return 0;
+
+	return ptcache_mem_to_file(pf, pm, pid->type, pid->cache->compression, pid->write_header);
+}
+
+/* frame handed to the background thread for writing */
+typedef struct PTCacheMemWrite {
+	PTCacheFile *pf;
+	PTCacheMem *pm;
+	int type;
+	int compression;
+	int (*write_header)(PTCacheFile *pf);
+} PTCacheMemWrite;
+
+static bool ptcache_mem_write_file(void *data, const char *UNUSED(filename))
+{
+	PTCacheMemWrite *mw = data;
+
+	return ptcache_mem_to_file(mw->pf, mw->pm, mw->type, mw->compression, mw->write_header);
+}
+
+static void ptcache_mem_write_free(void *data)
+{
+	PTCacheMemWrite *mw = data;
+
+	ptcache_data_free(mw->pm);
+	ptcache_extra_free(mw->pm);
+	MEM_freeN(mw->pm);
+	MEM_freeN(mw);
+}
+
+/* Like ptcache_mem_frame_to_disk, but takes ownership of pm and writes it in the background. */
+static int ptcache_mem_frame_to_disk_background(PTCacheID *pid, PTCacheMem *pm)
+{
+	PTCacheMemWrite *mw;
+	PTCacheFile *pf = ptcache_mem_frame_open_write(pid, pm);
+	char filename[FILE_MAX * 2];
+
+	if (pf==NULL) {
+		ptcache_data_free(pm);
+		ptcache_extra_free(pm);
+		MEM_freeN(pm);
+		return 0;
+	}
+
+	mw = MEM_callocN(sizeof(PTCacheMemWrite), "PTCacheMemWrite");
+	mw->pf = pf;
+	mw->pm = pm;
+	mw->type = pid->type;
+	mw->compression = pid->cache->compression;
+	mw->write_header = pid->write_header;
+
+	ptcache_filename(pid, filename, pm->frame, 1, 1);
+	ptcache_io_write(filename, mw, ptcache_mem_write_file, ptcache_mem_write_free);
+
+	return 1;
+}
 
 static int ptcache_read_stream(PTCacheID *pid, int cfra)
 {
@@ -2937,6 +3373,9 @@ static int ptcache_read_openvdb_stream(PTCacheID *pid, int cfra)
 
 	ptcache_filename(pid, filename, cfra, 1, 1);
 
+	/* the frame may still be written in the background */
+	ptcache_io_wait(filename);
+
 	if (!BLI_exists(filename)) {
 		return 0;
 	}
@@ -2944,11 +3383,11 @@ static int ptcache_read_openvdb_stream(PTCacheID *pid, int cfra)
 	struct OpenVDBReader *reader = OpenVDBReader_create();
 	OpenVDBReader_open(reader, filename);
 
-	if (!pid->read_openvdb_stream(reader, pid->calldata)) {
-		return 0;
-	}
+	const int ok = pid->read_openvdb_stream(reader, pid->calldata);
 
-	return 1;
+	OpenVDBReader_free(reader);
+
+	return ok;
 #else
 	UNUSED_VARS(pid, cfra);
 	return 0;
@@ -3252,6 +3691,19 @@ static int ptcache_write_stream(PTCacheID *pid, int cfra, int totpoint)
 
 	return error == 0;
 }
+#ifdef WITH_OPENVDB
+static bool ptcache_openvdb_write_file(void *writer, const char *filename)
+{
+	OpenVDBWriter_write(writer, filename);
+	return true;
+}
+
+static void ptcache_openvdb_writer_free(void *writer)
+{
+	OpenVDBWriter_free(writer);
+}
+#endif
+
 static int ptcache_write_openvdb_stream(PTCacheID *pid, int cfra)
 {
 #ifdef WITH_OPENVDB
@@ -3263,10 +3715,11 @@ static int ptcache_write_openvdb_stream(PTCacheID *pid, int cfra)
 	ptcache_filename(pid, filename, cfra, 1, 1);
 	BLI_make_existing_file(filename);
 
+	/* The grids only hold sparse copies of the active voxels once exported,
+	 * so the file can be written while the next frame is simulated. */
 	int error = pid->write_openvdb_stream(writer, pid->calldata);
 
-	OpenVDBWriter_write(writer, filename);
-	OpenVDBWriter_free(writer);
+	ptcache_io_write(filename, writer, ptcache_openvdb_write_file, ptcache_openvdb_writer_free);
 
 	return error == 0;
 #else
@@ -3321,21 +3774,15 @@ static int ptcache_write(PTCacheID *pid, int cfra, int overwrite)
 	pm->frame = cfra;
 
 	if (cache->flag & PTCACHE_DISK_CACHE) {
-		error += !ptcache_mem_frame_to_disk(pid, pm);
-
-		// if (pm) /* pm is always set */
-		{
-			ptcache_data_free(pm);
-			ptcache_extra_free(pm);
-			MEM_freeN(pm);
-		}
+		/* the frames are freed once written */
+		error += !ptcache_mem_frame_to_disk_background(pid, pm);
 
 		if (pm2) {
-			error += !ptcache_mem_frame_to_disk(pid, pm2);
-			ptcache_data_free(pm2);
-			ptcache_extra_free(pm2);
-			MEM_freeN(pm2);
+			error += !ptcache_mem_frame_to_disk_background(pid, pm2);
 		}
+
+		/* earlier frames that failed to write in the background */
+		error += ptcache_io_failed_writes();
 	}
 	else {
 		BLI_addtail(&cache->mem_cache, pm);
@@ -3475,6 +3922,7 @@ void BKE_ptcache_id_clear(PTCacheID *pid, int mode, unsigned int cfra)
 	case PTCACHE_CLEAR_BEFORE:
 	case PTCACHE_CLEAR_AFTER:
 		if (pid->cache->flag & PTCACHE_DISK_CACHE) {
+			ptcache_io_wait(NULL);
 			ptcache_path(pid, path);
 			
 			dir = opendir(path);
@@ -3562,8 +4010,10 @@ void BKE_ptcache_id_clear(PTCacheID *pid, int mode, unsigned int cfra)
 		
 	case PTCACHE_CLEAR_FRAME:
 		if (pid->cache->flag & PTCACHE_DISK_CACHE) {
+			ptcache_filename(pid, filename, cfra, 1, 1); /* no path */
+			/* a frame still written in the background would be recreated after deleting */
+			ptcache_io_wait(filename);
 			if (BKE_ptcache_id_exist(pid, cfra)) {
-				ptcache_filename(pid, filename, cfra, 1, 1); /* no path */
 				BLI_delete(filename, false, false);
 			}
 		}
@@ -3614,7 +4064,7 @@ int  BKE_ptcache_id_exist(PTCacheID *pid, int cfra)
 		
 		ptcache_filename(pid, filename, cfra, 1, 1);
 
-		return BLI_exists(filename);
+		return BLI_exists(filename) || ptcache_io_is_writing(filename);
 	}
 	else {
 		PTCacheMem *pm = pid->cache->mem_cache.first;
@@ -3873,6 +4323,7 @@ void BKE_ptcache_remove(void)
 	char path_full[MAX_PTCACHE_PATH];
 	int rmdir = 1;
 	
+	ptcache_io_wait(NULL);
 	ptcache_path(NULL, path);
 
 	if (BLI_exists(path)) {
@@ -4242,6 +4693,15 @@ void BKE_ptcache_bake(PTCacheBaker *baker)
 		}
 	}
 
+	/* the bake is only done once all frames are on disk */
+	ptcache_io_wait(NULL);
+
+	{
+		const int totfailed = ptcache_io_failed_writes();
+		if (totfailed)
+			printf("Error writing %d frames to disk cache\n", totfailed);
+	}
+
 	scene->r.framelen = frameleno;
 	CFRA = cfrao;
 	
@@ -4354,6 +4814,8 @@ void BKE_ptcache_disk_cache_rename(PTCacheID *pid, const char *name_src, const c
 	char old_path_full[MAX_PTCACHE_FILE];
 	char ext[MAX_PTCACHE_PATH];
 
+	ptcache_io_wait(NULL);
+
 	/* save old name */
 	BLI_strncpy(old_name, pid->cache->name, sizeof(old_name));
 
@@ -4414,6 +4876,8 @@ void BKE_ptcache_load_external(PTCacheID *pid)
 	if (!cache)
 		return;
 
+	ptcache_io_wait(NULL);
+
 	ptcache_path(pid, path);
 	
 	len = ptcache_filename(pid, filename, 1, 0, 0); /* no path */
@@ -72,6 +72,9 @@ typedef struct GHashIterState {
 enum {
 	GHASH_FLAG_ALLOW_DUPES  = (1 << 0),  /* Only checked for in debug mode */
 	GHASH_FLAG_ALLOW_SHRINK = (1 << 1),  /* Allow to shrink buckets' size. */
+	/* Store entries inline with open addressing instead of chaining them in buckets,
+	 * faster but pointers to keys and values are only valid until the hash is modified. */
+	GHASH_FLAG_OPEN_ADDRESSING = (1 << 2),
 
 #ifdef GHASH_INTERNAL_API
 	/* Internal usage only */
@@ -61,7 +61,7 @@ void        BLI_rng_get_tri_sample_float_v2(
         float r_pt[2]) ATTR_NONNULL();
 void        BLI_rng_shuffle_array(struct RNG *rng, void *data, unsigned int elem_size_i, unsigned int elem_tot) ATTR_NONNULL(1, 2);
 
-/** Note that skipping is as slow as generating n numbers! */
+/** Skipping takes O(log n), it doesn't generate the n numbers. */
 void        BLI_rng_skip(struct RNG *rng, int n) ATTR_NONNULL(1);
 
 /** Seed for the random number generator, using noise.c hash[] */
@@ -74,6 +74,9 @@ int     BLI_rand(void) ATTR_WARN_UNUSED_RESULT;
 float   BLI_frand(void) ATTR_WARN_UNUSED_RESULT;
 void    BLI_frand_unit_v3(float v[3]);
 
+/** Advance the global generator as if \a n numbers were taken */
+void    BLI_rand_skip(int n);
+
 /** Return a pseudo-random (hash) float from an integer value */
 float	BLI_hash_frand(unsigned int seed) ATTR_WARN_UNUSED_RESULT;
 
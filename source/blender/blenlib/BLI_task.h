@@ -37,8 +37,10 @@ extern "C" {
 
 /* Task Scheduler
  * 
- * Central scheduler that holds running threads ready to execute tasks. A single
- * queue holds the task from all pools.
+ * Central scheduler that holds running threads ready to execute tasks. A shared
+ * queue holds the tasks pushed from outside of the scheduler threads, tasks
+ * pushed from scheduler threads go to a per-thread queue, from which idle
+ * threads steal work.
  *
  * Init/exit must be called before/after any task pools are created/freed, and
  * must be called from the main threads. All other scheduler and pool functions
@@ -91,6 +93,8 @@ void BLI_task_pool_push(TaskPool *pool, TaskRunFunction run,
         void *taskdata, bool free_taskdata, TaskPriority priority);
 void BLI_task_pool_push_from_thread(TaskPool *pool, TaskRunFunction run,
         void *taskdata, bool free_taskdata, TaskPriority priority, int thread_id);
+void BLI_task_pool_push_ordered(TaskPool *pool, TaskRunFunction run,
+        void *taskdata, bool free_taskdata, float priority, int thread_id);
 
 /* work and wait until all tasks are done */
 void BLI_task_pool_work_and_wait(TaskPool *pool);
@@ -134,6 +138,36 @@ void BLI_task_parallel_range_finalize(
         const bool use_threading,
         const bool use_dynamic_scheduling);
 
+/* Parallel for, reduce and scan routines, with automatic chunking */
+typedef void (*TaskParallelForFunc)(void *__restrict userdata, const int start, const int stop, const int thread_id);
+typedef void (*TaskParallelReduceFunc)(void *__restrict userdata, void *__restrict accum,
+                                       const int start, const int stop);
+typedef void (*TaskParallelScanFunc)(void *__restrict userdata, void *__restrict accum,
+                                     const int start, const int stop, const bool is_final);
+typedef void (*TaskParallelJoinFunc)(void *__restrict userdata, void *__restrict accum,
+                                     const void *__restrict accum_other);
+void BLI_task_parallel_for(
+        int start, int stop,
+        void *userdata,
+        TaskParallelForFunc func,
+        const int min_grain);
+void BLI_task_parallel_reduce(
+        int start, int stop,
+        void *userdata,
+        void *accum,
+        const size_t accum_size,
+        TaskParallelReduceFunc func,
+        TaskParallelJoinFunc join,
+        const int min_grain);
+void BLI_task_parallel_scan(
+        int start, int stop,
+        void *userdata,
+        void *accum,
+        const size_t accum_size,
+        TaskParallelScanFunc func,
+        TaskParallelJoinFunc join,
+        const int min_grain);
+
 typedef void (*TaskParallelListbaseFunc)(void *userdata,
                                          struct Link *iter,
                                          int index);
@@ -31,6 +31,9 @@
  * A general (pointer -> pointer) chaining hash table
  * for 'Abstract Data Types' (known as an ADT Hash Table).
  *
+ * Tables can optionally use open addressing instead of chaining,
+ * see #GHASH_FLAG_OPEN_ADDRESSING.
+ *
  * \note edgehash.c is based on this, make sure they stay in sync.
  */
 
@@ -77,6 +80,10 @@ const unsigned int hashsizes[] = {
 #define GHASH_LIMIT_GROW(_nbkt)   (((_nbkt) * 3) /  4)
 #define GHASH_LIMIT_SHRINK(_nbkt) (((_nbkt) * 3) / 16)
 
+/* Open addressing tables always have a power of two number of slots. */
+#define GHASH_OA_BIT_MIN 3
+#define GHASH_OA_BIT_MAX 28
+
 /***/
 
 /* WARNING! Keep in sync with ugly _gh_Entry in header!!! */
@@ -97,6 +104,24 @@ typedef Entry GSetEntry;
 #define GHASH_ENTRY_SIZE(_is_gset) \
 	((_is_gset) ? sizeof(GSetEntry) : sizeof(GHashEntry))
 
+/**
+ * Slot of open addressing storage, entries are stored inline in #GHash.oa_entries.
+ *
+ * Same layout as #Entry and #GHashEntry (so the iterator works on both),
+ * but storing the hash of the key instead of the next pointer, zero marking empty slots.
+ */
+typedef struct OAEntry {
+	uintptr_t hash;
+
+	void *key;
+} OAEntry;
+
+typedef struct OAGHashEntry {
+	OAEntry e;
+
+	void *val;
+} OAGHashEntry;
+
 struct GHash {
 	GHashHashFP hashfp;
 	GHashCmpFP cmpfp;
@@ -113,6 +138,11 @@ struct GHash {
 
 	unsigned int nentries;
 	unsigned int flag;
+
+	/* Open addressing storage, used instead of buckets and entrypool with #GHASH_FLAG_OPEN_ADDRESSING.
+	 * nbuckets and limits are shared with chaining, and count slots here. */
+	OAEntry *oa_entries;
+	unsigned int oa_bit, oa_bit_min;
 };
 
 
@@ -378,6 +408,503 @@ BLI_INLINE void ghash_buckets_reset(GHash *gh, const unsigned int nentries)
 	ghash_buckets_expand(gh, nentries, (nentries != 0));
 }
 
+/**
+ * Number of entries reserved by the user with chaining storage, zero if none.
+ */
+BLI_INLINE unsigned int ghash_buckets_reserved(GHash *gh)
+{
+#ifdef GHASH_USE_MODULO_BUCKETS
+	return gh->size_min ? GHASH_LIMIT_GROW(hashsizes[gh->size_min]) : 0;
+#else
+	return (gh->bucket_bit_min > GHASH_BUCKET_BIT_MIN) ? GHASH_LIMIT_GROW(1u << gh->bucket_bit_min) : 0;
+#endif
+}
+
+/** \} */
+
+
+/** \name Open Addressing Internal API
+ *
+ * Linear probing with Robin Hood hashing: on insertion, entries further away from their home slot
+ * take the place of entries closer to theirs. This keeps probe sequences short and allows
+ * lookups to stop early, as well as removal without tombstones (following entries are shifted back).
+ *
+ * Entries are stored inline, so unlike chaining storage,
+ * pointers to keys and values are only valid until the next insertion or removal.
+ * \{ */
+
+/**
+ * Get the hash for a key, never zero (used to mark empty slots).
+ */
+BLI_INLINE unsigned int ghash_oa_keyhash(GHash *gh, const void *key)
+{
+	const unsigned int hash = gh->hashfp(key);
+	return hash ? hash : 1;
+}
+
+/**
+ * Get the home slot of a hash, using Fibonacci hashing since many of our hash functions
+ * (pointers, sequential integers...) are weak in their low bits.
+ */
+BLI_INLINE unsigned int ghash_oa_slot_index(const GHash *gh, const unsigned int hash)
+{
+	return (hash * 2654435769u) >> (32 - gh->oa_bit);
+}
+
+BLI_INLINE OAEntry *ghash_oa_entry(const GHash *gh, const unsigned int slot_index)
+{
+	return (OAEntry *)((char *)gh->oa_entries +
+	                   (size_t)slot_index * GHASH_ENTRY_SIZE(gh->flag & GHASH_FLAG_IS_GSET));
+}
+
+/**
+ * Distance of the entry in \a slot_index from its home slot.
+ */
+BLI_INLINE unsigned int ghash_oa_entry_dist(const GHash *gh, const OAEntry *e, const unsigned int slot_index)
+{
+	return (slot_index - ghash_oa_slot_index(gh, (unsigned int)e->hash)) & (gh->nbuckets - 1);
+}
+
+/**
+ * Place an entry (there must be free slots), returns the slot the given key ends up in.
+ */
+static OAEntry *ghash_oa_insert_entry(GHash *gh, const unsigned int hash, void *key, void *val)
+{
+	const bool is_gset = (gh->flag & GHASH_FLAG_IS_GSET) != 0;
+	const unsigned int mask = gh->nbuckets - 1;
+	uintptr_t curr_hash = hash;
+	OAEntry *e_key = NULL;
+
+	for (unsigned int i = ghash_oa_slot_index(gh, hash), dist = 0; ; i = (i + 1) & mask, dist++) {
+		OAEntry *e = ghash_oa_entry(gh, i);
+
+		if (e->hash == 0) {
+			e->hash = curr_hash;
+			e->key = key;
+			if (!is_gset) {
+				((OAGHashEntry *)e)->val = val;
+			}
+			return e_key ? e_key : e;
+		}
+
+		const unsigned int e_dist = ghash_oa_entry_dist(gh, e, i);
+		if (e_dist < dist) {
+			/* Take the slot of the entry closer to its home, and carry on placing that one. */
+			SWAP(uintptr_t, e->hash, curr_hash);
+			SWAP(void *, e->key, key);
+			if (!is_gset) {
+				SWAP(void *, ((OAGHashEntry *)e)->val, val);
+			}
+			if (e_key == NULL) {
+				e_key = e;
+			}
+			dist = e_dist;
+		}
+	}
+}
+
+static void ghash_oa_resize(GHash *gh, const unsigned int bit)
+{
+	const bool is_gset = (gh->flag & GHASH_FLAG_IS_GSET) != 0;
+	OAEntry *entries_old = gh->oa_entries;
+	const unsigned int nslots_old = gh->nbuckets;
+
+	gh->oa_bit = bit;
+	gh->nbuckets = 1u << bit;
+	gh->limit_grow   = GHASH_LIMIT_GROW(gh->nbuckets);
+	gh->limit_shrink = GHASH_LIMIT_SHRINK(gh->nbuckets);
+	gh->oa_entries = MEM_callocN(GHASH_ENTRY_SIZE(is_gset) * gh->nbuckets, __func__);
+
+	if (entries_old) {
+		for (unsigned int i = 0; i < nslots_old; i++) {
+			OAEntry *e = (OAEntry *)((char *)entries_old + (size_t)i * GHASH_ENTRY_SIZE(is_gset));
+			if (e->hash) {
+				ghash_oa_insert_entry(gh, (unsigned int)e->hash, e->key, is_gset ? NULL : ((OAGHashEntry *)e)->val);
+			}
+		}
+		MEM_freeN(entries_old);
+	}
+}
+
+/**
+ * Open addressing version of #ghash_buckets_expand.
+ */
+static void ghash_oa_expand(GHash *gh, const unsigned int nentries, const bool user_defined)
+{
+	unsigned int bit = gh->oa_bit;
+
+	if (LIKELY(gh->oa_entries && (nentries <= gh->limit_grow))) {
+		return;
+	}
+
+	while ((nentries > GHASH_LIMIT_GROW(1u << bit)) &&
+	       (bit < GHASH_OA_BIT_MAX))
+	{
+		bit++;
+	}
+
+	if (user_defined) {
+		gh->oa_bit_min = bit;
+	}
+
+	if ((bit == gh->oa_bit) && gh->oa_entries) {
+		return;
+	}
+
+	ghash_oa_resize(gh, bit);
+}
+
+/**
+ * Open addressing version of #ghash_buckets_contract.
+ */
+static void ghash_oa_contract(
+        GHash *gh, const unsigned int nentries, const bool user_defined, const bool force_shrink)
+{
+	unsigned int bit = gh->oa_bit;
+
+	if (!(force_shrink || (gh->flag & GHASH_FLAG_ALLOW_SHRINK))) {
+		return;
+	}
+
+	if (LIKELY(gh->oa_entries && (nentries > gh->limit_shrink))) {
+		return;
+	}
+
+	while ((nentries < GHASH_LIMIT_SHRINK(1u << bit)) &&
+	       (bit > gh->oa_bit_min))
+	{
+		bit--;
+	}
+
+	if (user_defined) {
+		gh->oa_bit_min = bit;
+	}
+
+	if ((bit == gh->oa_bit) && gh->oa_entries) {
+		return;
+	}
+
+	ghash_oa_resize(gh, bit);
+}
+
+/**
+ * Open addressing version of #ghash_buckets_reset.
+ */
+static void ghash_oa_reset(GHash *gh, const unsigned int nentries)
+{
+	MEM_SAFE_FREE(gh->oa_entries);
+
+	gh->oa_bit = GHASH_OA_BIT_MIN;
+	gh->oa_bit_min = GHASH_OA_BIT_MIN;
+	gh->nentries = 0;
+
+	ghash_oa_expand(gh, nentries, (nentries != 0));
+}
+
+BLI_INLINE OAEntry *ghash_oa_lookup_entry_ex(
+        GHash *gh, const void *key, const unsigned int hash, unsigned int *r_slot_index)
+{
+	const unsigned int mask = gh->nbuckets - 1;
+
+	for (unsigned int i = ghash_oa_slot_index(gh, hash), dist = 0; ; i = (i + 1) & mask, dist++) {
+		OAEntry *e = ghash_oa_entry(gh, i);
+
+		/* Past this point the key would have taken the slot on insertion. */
+		if ((e->hash == 0) || (ghash_oa_entry_dist(gh, e, i) < dist)) {
+			return NULL;
+		}
+		if ((e->hash == hash) && UNLIKELY(gh->cmpfp(key, e->key) == false)) {
+			if (r_slot_index) {
+				*r_slot_index = i;
+			}
+			return e;
+		}
+	}
+}
+
+BLI_INLINE OAEntry *ghash_oa_lookup_entry(GHash *gh, const void *key)
+{
+	return ghash_oa_lookup_entry_ex(gh, key, ghash_oa_keyhash(gh, key), NULL);
+}
+
+/**
+ * Insert a new key (value is ignored for GSet), returns its entry.
+ */
+static OAEntry *ghash_oa_insert_ex(GHash *gh, void *key, void *val, const unsigned int hash)
+{
+	BLI_assert((gh->flag & GHASH_FLAG_ALLOW_DUPES) || (BLI_ghash_haskey(gh, key) == 0));
+
+	/* Grow first, so the returned entry stays valid. */
+	ghash_oa_expand(gh, ++gh->nentries, false);
+	return ghash_oa_insert_entry(gh, hash, key, val);
+}
+
+static bool ghash_oa_insert_safe(
+        GHash *gh, void *key, void *val, const bool override,
+        GHashKeyFreeFP keyfreefp, GHashValFreeFP valfreefp)
+{
+	const unsigned int hash = ghash_oa_keyhash(gh, key);
+	OAEntry *e = ghash_oa_lookup_entry_ex(gh, key, hash, NULL);
+
+	if (e) {
+		if (override) {
+			if (keyfreefp) {
+				keyfreefp(e->key);
+			}
+			e->key = key;
+			if ((gh->flag & GHASH_FLAG_IS_GSET) == 0) {
+				if (valfreefp) {
+					valfreefp(((OAGHashEntry *)e)->val);
+				}
+				((OAGHashEntry *)e)->val = val;
+			}
+		}
+		return false;
+	}
+	else {
+		ghash_oa_insert_ex(gh, key, val, hash);
+		return true;
+	}
+}
+
+/**
+ * Shared by #BLI_ghash_ensure_p, #BLI_ghash_ensure_p_ex and #BLI_gset_ensure_p_ex.
+ * When \a r_key is given, the key of a new entry is set to NULL for the caller to assign.
+ */
+static bool ghash_oa_ensure_p_ex(GHash *gh, const void *key, void ***r_key, void ***r_val)
+{
+	const unsigned int hash = ghash_oa_keyhash(gh, key);
+	OAEntry *e = ghash_oa_lookup_entry_ex(gh, key, hash, NULL);
+	const bool haskey = (e != NULL);
+
+	if (!haskey) {
+		e = ghash_oa_insert_ex(gh, (void *)key, NULL, hash);
+		if (r_key) {
+			e->key = NULL;  /* caller must re-assign */
+		}
+	}
+
+	if (r_key) {
+		*r_key = &e->key;
+	}
+	if (r_val) {
+		*r_val = &((OAGHashEntry *)e)->val;
+	}
+	return haskey;
+}
+
+/**
+ * Remove the entry in \a slot_index, shifting back following entries which are not in their home slot.
+ */
+static void ghash_oa_remove_index(GHash *gh, unsigned int slot_index)
+{
+	const size_t entry_size = GHASH_ENTRY_SIZE(gh->flag & GHASH_FLAG_IS_GSET);
+	const unsigned int mask = gh->nbuckets - 1;
+
+	for (;;) {
+		const unsigned int slot_index_next = (slot_index + 1) & mask;
+		OAEntry *e_next = ghash_oa_entry(gh, slot_index_next);
+
+		if ((e_next->hash == 0) || (ghash_oa_entry_dist(gh, e_next, slot_index_next) == 0)) {
+			break;
+		}
+		memcpy(ghash_oa_entry(gh, slot_index), e_next, entry_size);
+		slot_index = slot_index_next;
+	}
+	ghash_oa_entry(gh, slot_index)->hash = 0;
+
+	ghash_oa_contract(gh, --gh->nentries, false, false);
+}
+
+static bool ghash_oa_remove(
+        GHash *gh, const void *key,
+        GHashKeyFreeFP keyfreefp, GHashValFreeFP valfreefp,
+        void **r_val)
+{
+	unsigned int slot_index;
+	OAEntry *e = ghash_oa_lookup_entry_ex(gh, key, ghash_oa_keyhash(gh, key), &slot_index);
+
+	BLI_assert(!valfreefp || !(gh->flag & GHASH_FLAG_IS_GSET));
+
+	if (e == NULL) {
+		return false;
+	}
+
+	if (keyfreefp) {
+		keyfreefp(e->key);
+	}
+	if (valfreefp) {
+		valfreefp(((OAGHashEntry *)e)->val);
+	}
+	if (r_val) {
+		*r_val = ((OAGHashEntry *)e)->val;
+	}
+
+	ghash_oa_remove_index(gh, slot_index);
+	return true;
+}
+
+/**
+ * Open addressing version of #ghash_pop, \a r_val is NULL for GSet.
+ */
+static bool ghash_oa_pop(GHash *gh, GHashIterState *state, void **r_key, void **r_val)
+{
+	unsigned int slot_index = state->curr_bucket;
+
+	if (gh->nentries == 0) {
+		return false;
+	}
+
+	if (slot_index >= gh->nbuckets) {
+		slot_index = 0;
+	}
+	while (ghash_oa_entry(gh, slot_index)->hash == 0) {
+		slot_index = (slot_index + 1) & (gh->nbuckets - 1);
+	}
+
+	OAEntry *e = ghash_oa_entry(gh, slot_index);
+	*r_key = e->key;
+	if (r_val) {
+		*r_val = ((OAGHashEntry *)e)->val;
+	}
+
+	ghash_oa_remove_index(gh, slot_index);
+
+	state->curr_bucket = slot_index;
+	return true;
+}
+
+static void ghash_oa_free_cb(
+        GHash *gh,
+        GHashKeyFreeFP keyfreefp, GHashValFreeFP valfreefp)
+{
+	for (unsigned int i = 0; i < gh->nbuckets; i++) {
+		OAEntry *e = ghash_oa_entry(gh, i);
+
+		if (e->hash) {
+			if (keyfreefp) {
+				keyfreefp(e->key);
+			}
+			if (valfreefp) {
+				valfreefp(((OAGHashEntry *)e)->val);
+			}
+		}
+	}
+}
+
+static GHash *ghash_oa_copy(GHash *gh, GHashKeyCopyFP keycopyfp, GHashValCopyFP valcopyfp)
+{
+	const size_t entries_size = GHASH_ENTRY_SIZE(gh->flag & GHASH_FLAG_IS_GSET) * gh->nbuckets;
+	GHash *gh_new = MEM_mallocN(sizeof(*gh_new), __func__);
+
+	*gh_new = *gh;
+	gh_new->oa_entries = MEM_mallocN(entries_size, __func__);
+	memcpy(gh_new->oa_entries, gh->oa_entries, entries_size);
+
+	if (keycopyfp || valcopyfp) {
+		for (unsigned int i = 0; i < gh_new->nbuckets; i++) {
+			OAEntry *e = ghash_oa_entry(gh_new, i);
+
+			if (e->hash) {
+				if (keycopyfp) {
+					e->key = keycopyfp(e->key);
+				}
+				if (valcopyfp) {
+					((OAGHashEntry *)e)->val = valcopyfp(((OAGHashEntry *)e)->val);
+				}
+			}
+		}
+	}
+
+	return gh_new;
+}
+
+/**
+ * Step the iterator to the next used slot, from the one after ghi->curBucket.
+ */
+static void ghash_oa_iterator_step(GHashIterator *ghi)
+{
+	GHash *gh = ghi->gh;
+
+	ghi->curEntry = NULL;
+	while (++ghi->curBucket < gh->nbuckets) {
+		OAEntry *e = ghash_oa_entry(gh, ghi->curBucket);
+		if (e->hash) {
+			ghi->curEntry = (Entry *)e;
+			break;
+		}
+	}
+}
+
+/**
+ * Move all entries to chaining or open addressing storage.
+ */
+static void ghash_storage_set(GHash *gh, const bool use_open_addressing)
+{
+	const bool is_gset = (gh->flag & GHASH_FLAG_IS_GSET) != 0;
+	const unsigned int nentries = gh->nentries;
+
+	if (use_open_addressing) {
+		Entry **buckets = gh->buckets;
+		const unsigned int nbuckets = gh->nbuckets;
+
+		ghash_oa_reset(gh, ghash_buckets_reserved(gh));
+		ghash_oa_expand(gh, nentries, false);
+
+		for (unsigned int i = 0; i < nbuckets; i++) {
+			for (Entry *e = buckets[i]; e; e = e->next) {
+				ghash_oa_insert_entry(gh, ghash_oa_keyhash(gh, e->key), e->key,
+				                      is_gset ? NULL : ((GHashEntry *)e)->val);
+			}
+		}
+		gh->nentries = nentries;
+
+		MEM_freeN(buckets);
+		gh->buckets = NULL;
+		BLI_mempool_destroy(gh->entrypool);
+		gh->entrypool = NULL;
+
+		gh->flag |= GHASH_FLAG_OPEN_ADDRESSING;
+	}
+	else {
+		OAEntry *entries = gh->oa_entries;
+		const unsigned int nslots = gh->nbuckets;
+		const unsigned int nentries_reserve =
+		        (gh->oa_bit_min > GHASH_OA_BIT_MIN) ? GHASH_LIMIT_GROW(1u << gh->oa_bit_min) : 0;
+
+		gh->oa_entries = NULL;
+		ghash_buckets_reset(gh, nentries_reserve);
+		ghash_buckets_expand(gh, nentries, false);
+		gh->entrypool = BLI_mempool_create(GHASH_ENTRY_SIZE(is_gset), 64, 64, BLI_MEMPOOL_NOP);
+
+		for (unsigned int i = 0; i < nslots; i++) {
+			OAEntry *e = (OAEntry *)((char *)entries + (size_t)i * GHASH_ENTRY_SIZE(is_gset));
+			if (e->hash) {
+				const unsigned int bucket_index = ghash_bucket_index(gh, ghash_keyhash(gh, e->key));
+				Entry *e_new = BLI_mempool_alloc(gh->entrypool);
+
+				e_new->key = e->key;
+				if (!is_gset) {
+					((GHashEntry *)e_new)->val = ((OAGHashEntry *)e)->val;
+				}
+				e_new->next = gh->buckets[bucket_index];
+				gh->buckets[bucket_index] = e_new;
+			}
+		}
+		gh->nentries = nentries;
+
+		MEM_freeN(entries);
+
+		gh->flag &= ~(unsigned int)GHASH_FLAG_OPEN_ADDRESSING;
+	}
+}
+
+/** \} */
+
+
+/** \name Internal Lookup, Insert & Remove API
+ * \{ */
+
 /**
  * Internal lookup function.
  * Takes hash and bucket_index arguments to avoid calling #ghash_keyhash and #ghash_bucket_index multiple times.
@@ -424,6 +951,10 @@ BLI_INLINE Entry *ghash_lookup_entry_prev_ex(
  */
 BLI_INLINE Entry *ghash_lookup_entry(GHash *gh, const void *key)
 {
+	if (gh->flag & GHASH_FLAG_OPEN_ADDRESSING) {
+		return (Entry *)ghash_oa_lookup_entry(gh, key);
+	}
+
 	const unsigned int hash = ghash_keyhash(gh, key);
 	const unsigned int bucket_index = ghash_bucket_index(gh, hash);
 	return ghash_lookup_entry_ex(gh, key, bucket_index);
@@ -439,6 +970,8 @@ static GHash *ghash_new(GHashHashFP hashfp, GHashCmpFP cmpfp, const char *info,
 
 	gh->buckets = NULL;
 	gh->flag = flag;
+	gh->oa_entries = NULL;
+	gh->oa_bit = gh->oa_bit_min = GHASH_OA_BIT_MIN;
 
 	ghash_buckets_reset(gh, nentries_reserve);
 	gh->entrypool = BLI_mempool_create(GHASH_ENTRY_SIZE(flag & GHASH_FLAG_IS_GSET), 64, 64, BLI_MEMPOOL_NOP);
@@ -502,6 +1035,12 @@ BLI_INLINE void ghash_insert_ex_keyonly(
 
 BLI_INLINE void ghash_insert(GHash *gh, void *key, void *val)
 {
+	if (gh->flag & GHASH_FLAG_OPEN_ADDRESSING) {
+		BLI_assert(!(gh->flag & GHASH_FLAG_IS_GSET));
+		ghash_oa_insert_ex(gh, key, val, ghash_oa_keyhash(gh, key));
+		return;
+	}
+
 	const unsigned int hash = ghash_keyhash(gh, key);
 	const unsigned int bucket_index = ghash_bucket_index(gh, hash);
 
@@ -512,12 +1051,16 @@ BLI_INLINE bool ghash_insert_safe(
         GHash *gh, void *key, void *val, const bool override,
         GHashKeyFreeFP keyfreefp, GHashValFreeFP valfreefp)
 {
+	BLI_assert(!(gh->flag & GHASH_FLAG_IS_GSET));
+
+	if (gh->flag & GHASH_FLAG_OPEN_ADDRESSING) {
+		return ghash_oa_insert_safe(gh, key, val, override, keyfreefp, valfreefp);
+	}
+
 	const unsigned int hash = ghash_keyhash(gh, key);
 	const unsigned int bucket_index = ghash_bucket_index(gh, hash);
 	GHashEntry *e = (GHashEntry *)ghash_lookup_entry_ex(gh, key, bucket_index);
 
-	BLI_assert(!(gh->flag & GHASH_FLAG_IS_GSET));
-
 	if (e) {
 		if (override) {
 			if (keyfreefp) {
@@ -541,12 +1084,16 @@ BLI_INLINE bool ghash_insert_safe_keyonly(
         GHash *gh, void *key, const bool override,
         GHashKeyFreeFP keyfreefp)
 {
+	BLI_assert((gh->flag & GHASH_FLAG_IS_GSET) != 0);
+
+	if (gh->flag & GHASH_FLAG_OPEN_ADDRESSING) {
+		return ghash_oa_insert_safe(gh, key, NULL, override, keyfreefp, NULL);
+	}
+
 	const unsigned int hash = ghash_keyhash(gh, key);
 	const unsigned int bucket_index = ghash_bucket_index(gh, hash);
 	Entry *e = ghash_lookup_entry_ex(gh, key, bucket_index);
 
-	BLI_assert((gh->flag & GHASH_FLAG_IS_GSET) != 0);
-
 	if (e) {
 		if (override) {
 			if (keyfreefp) {
@@ -631,6 +1178,11 @@ static void ghash_free_cb(
 	BLI_assert(keyfreefp  || valfreefp);
 	BLI_assert(!valfreefp || !(gh->flag & GHASH_FLAG_IS_GSET));
 
+	if (gh->flag & GHASH_FLAG_OPEN_ADDRESSING) {
+		ghash_oa_free_cb(gh, keyfreefp, valfreefp);
+		return;
+	}
+
 	for (i = 0; i < gh->nbuckets; i++) {
 		Entry *e;
 
@@ -657,6 +1209,10 @@ static GHash *ghash_copy(GHash *gh, GHashKeyCopyFP keycopyfp, GHashValCopyFP val
 
 	BLI_assert(!valcopyfp || !(gh->flag & GHASH_FLAG_IS_GSET));
 
+	if (gh->flag & GHASH_FLAG_OPEN_ADDRESSING) {
+		return ghash_oa_copy(gh, keycopyfp, valcopyfp);
+	}
+
 	gh_new = ghash_new(gh->hashfp, gh->cmpfp, __func__, 0, gh->flag);
 	ghash_buckets_expand(gh_new, reserve_nentries_new, false);
 
@@ -726,6 +1282,12 @@ GHash *BLI_ghash_copy(GHash *gh, GHashKeyCopyFP keycopyfp, GHashValCopyFP valcop
  */
 void BLI_ghash_reserve(GHash *gh, const unsigned int nentries_reserve)
 {
+	if (gh->flag & GHASH_FLAG_OPEN_ADDRESSING) {
+		ghash_oa_expand(gh, nentries_reserve, true);
+		ghash_oa_contract(gh, nentries_reserve, true, false);
+		return;
+	}
+
 	ghash_buckets_expand(gh, nentries_reserve, true);
 	ghash_buckets_contract(gh, nentries_reserve, true, false);
 }
@@ -821,6 +1383,10 @@ void **BLI_ghash_lookup_p(GHash *gh, const void *key)
  */
 bool BLI_ghash_ensure_p(GHash *gh, void *key, void ***r_val)
 {
+	if (gh->flag & GHASH_FLAG_OPEN_ADDRESSING) {
+		return ghash_oa_ensure_p_ex(gh, key, NULL, r_val);
+	}
+
 	const unsigned int hash = ghash_keyhash(gh, key);
 	const unsigned int bucket_index = ghash_bucket_index(gh, hash);
 	GHashEntry *e = (GHashEntry *)ghash_lookup_entry_ex(gh, key, bucket_index);
@@ -844,6 +1410,10 @@ bool BLI_ghash_ensure_p(GHash *gh, void *key, void ***r_val)
 bool BLI_ghash_ensure_p_ex(
         GHash *gh, const void *key, void ***r_key, void ***r_val)
 {
+	if (gh->flag & GHASH_FLAG_OPEN_ADDRESSING) {
+		return ghash_oa_ensure_p_ex(gh, key, r_key, r_val);
+	}
+
 	const unsigned int hash = ghash_keyhash(gh, key);
 	const unsigned int bucket_index = ghash_bucket_index(gh, hash);
 	GHashEntry *e = (GHashEntry *)ghash_lookup_entry_ex(gh, key, bucket_index);
@@ -871,6 +1441,10 @@ bool BLI_ghash_ensure_p_ex(
  */
 bool BLI_ghash_remove(GHash *gh, const void *key, GHashKeyFreeFP keyfreefp, GHashValFreeFP valfreefp)
 {
+	if (gh->flag & GHASH_FLAG_OPEN_ADDRESSING) {
+		return ghash_oa_remove(gh, key, keyfreefp, valfreefp, NULL);
+	}
+
 	const unsigned int hash = ghash_keyhash(gh, key);
 	const unsigned int bucket_index = ghash_bucket_index(gh, hash);
 	Entry *e = ghash_remove_ex(gh, key, keyfreefp, valfreefp, bucket_index);
@@ -894,10 +1468,16 @@ bool BLI_ghash_remove(GHash *gh, const void *key, GHashKeyFreeFP keyfreefp, GHas
  */
 void *BLI_ghash_popkey(GHash *gh, const void *key, GHashKeyFreeFP keyfreefp)
 {
+	BLI_assert(!(gh->flag & GHASH_FLAG_IS_GSET));
+
+	if (gh->flag & GHASH_FLAG_OPEN_ADDRESSING) {
+		void *val;
+		return ghash_oa_remove(gh, key, keyfreefp, NULL, &val) ? val : NULL;
+	}
+
 	const unsigned int hash = ghash_keyhash(gh, key);
 	const unsigned int bucket_index = ghash_bucket_index(gh, hash);
 	GHashEntry *e = (GHashEntry *)ghash_remove_ex(gh, key, keyfreefp, NULL, bucket_index);
-	BLI_assert(!(gh->flag & GHASH_FLAG_IS_GSET));
 	if (e) {
 		void *val = e->val;
 		BLI_mempool_free(gh->entrypool, e);
@@ -928,10 +1508,18 @@ bool BLI_ghash_pop(
         GHash *gh, GHashIterState *state,
         void **r_key, void **r_val)
 {
-	GHashEntry *e = (GHashEntry *)ghash_pop(gh, state);
-
 	BLI_assert(!(gh->flag & GHASH_FLAG_IS_GSET));
 
+	if (gh->flag & GHASH_FLAG_OPEN_ADDRESSING) {
+		if (ghash_oa_pop(gh, state, r_key, r_val)) {
+			return true;
+		}
+		*r_key = *r_val = NULL;
+		return false;
+	}
+
+	GHashEntry *e = (GHashEntry *)ghash_pop(gh, state);
+
 	if (e) {
 		*r_key = e->e.key;
 		*r_val = e->val;
@@ -958,6 +1546,11 @@ void BLI_ghash_clear_ex(GHash *gh, GHashKeyFreeFP keyfreefp, GHashValFreeFP valf
 	if (keyfreefp || valfreefp)
 		ghash_free_cb(gh, keyfreefp, valfreefp);
 
+	if (gh->flag & GHASH_FLAG_OPEN_ADDRESSING) {
+		ghash_oa_reset(gh, nentries_reserve);
+		return;
+	}
+
 	ghash_buckets_reset(gh, nentries_reserve);
 	BLI_mempool_clear_ex(gh->entrypool, nentries_reserve ? (int)nentries_reserve : -1);
 }
@@ -979,20 +1572,31 @@ void BLI_ghash_clear(GHash *gh, GHashKeyFreeFP keyfreefp, GHashValFreeFP valfree
  */
 void BLI_ghash_free(GHash *gh, GHashKeyFreeFP keyfreefp, GHashValFreeFP valfreefp)
 {
-	BLI_assert((int)gh->nentries == BLI_mempool_count(gh->entrypool));
 	if (keyfreefp || valfreefp)
 		ghash_free_cb(gh, keyfreefp, valfreefp);
 
-	MEM_freeN(gh->buckets);
-	BLI_mempool_destroy(gh->entrypool);
+	if (gh->flag & GHASH_FLAG_OPEN_ADDRESSING) {
+		MEM_freeN(gh->oa_entries);
+	}
+	else {
+		BLI_assert((int)gh->nentries == BLI_mempool_count(gh->entrypool));
+		MEM_freeN(gh->buckets);
+		BLI_mempool_destroy(gh->entrypool);
+	}
 	MEM_freeN(gh);
 }
 
 /**
  * Sets a GHash flag.
+ *
+ * \note Setting #GHASH_FLAG_OPEN_ADDRESSING moves existing entries to the new storage,
+ * it's best done right after creating \a gh.
  */
 void BLI_ghash_flag_set(GHash *gh, unsigned int flag)
 {
+	if ((flag & GHASH_FLAG_OPEN_ADDRESSING) && !(gh->flag & GHASH_FLAG_OPEN_ADDRESSING)) {
+		ghash_storage_set(gh, true);
+	}
 	gh->flag |= flag;
 }
 
@@ -1001,6 +1605,9 @@ void BLI_ghash_flag_set(GHash *gh, unsigned int flag)
  */
 void BLI_ghash_flag_clear(GHash *gh, unsigned int flag)
 {
+	if ((flag & GHASH_FLAG_OPEN_ADDRESSING) && (gh->flag & GHASH_FLAG_OPEN_ADDRESSING)) {
+		ghash_storage_set(gh, false);
+	}
 	gh->flag &= ~flag;
 }
 
@@ -1041,6 +1648,12 @@ void BLI_ghashIterator_init(GHashIterator *ghi, GHash *gh)
 	ghi->gh = gh;
 	ghi->curEntry = NULL;
 	ghi->curBucket = UINT_MAX;  /* wraps to zero */
+	if (gh->flag & GHASH_FLAG_OPEN_ADDRESSING) {
+		if (gh->nentries) {
+			ghash_oa_iterator_step(ghi);
+		}
+		return;
+	}
 	if (gh->nentries) {
 		do {
 			ghi->curBucket++;
@@ -1058,6 +1671,10 @@ void BLI_ghashIterator_init(GHashIterator *ghi, GHash *gh)
  */
 void BLI_ghashIterator_step(GHashIterator *ghi)
 {
+	if (ghi->curEntry && (ghi->gh->flag & GHASH_FLAG_OPEN_ADDRESSING)) {
+		ghash_oa_iterator_step(ghi);
+		return;
+	}
 	if (ghi->curEntry) {
 		ghi->curEntry = ghi->curEntry->next;
 		while (!ghi->curEntry) {
@@ -1378,6 +1995,11 @@ unsigned int BLI_gset_size(GSet *gs)
  */
 void BLI_gset_insert(GSet *gs, void *key)
 {
+	if (((GHash *)gs)->flag & GHASH_FLAG_OPEN_ADDRESSING) {
+		ghash_oa_insert_ex((GHash *)gs, key, NULL, ghash_oa_keyhash((GHash *)gs, key));
+		return;
+	}
+
 	const unsigned int hash = ghash_keyhash((GHash *)gs, key);
 	const unsigned int bucket_index = ghash_bucket_index((GHash *)gs, hash);
 	ghash_insert_ex_keyonly((GHash *)gs, key, bucket_index);
@@ -1402,6 +2024,10 @@ bool BLI_gset_add(GSet *gs, void *key)
  */
 bool BLI_gset_ensure_p_ex(GSet *gs, const void *key, void ***r_key)
 {
+	if (((GHash *)gs)->flag & GHASH_FLAG_OPEN_ADDRESSING) {
+		return ghash_oa_ensure_p_ex((GHash *)gs, key, r_key, NULL);
+	}
+
 	const unsigned int hash = ghash_keyhash((GHash *)gs, key);
 	const unsigned int bucket_index = ghash_bucket_index((GHash *)gs, hash);
 	GSetEntry *e = (GSetEntry *)ghash_lookup_entry_ex((GHash *)gs, key, bucket_index);
@@ -1451,6 +2077,14 @@ bool BLI_gset_pop(
         GSet *gs, GSetIterState *state,
         void **r_key)
 {
+	if (((GHash *)gs)->flag & GHASH_FLAG_OPEN_ADDRESSING) {
+		if (ghash_oa_pop((GHash *)gs, (GHashIterState *)state, r_key, NULL)) {
+			return true;
+		}
+		*r_key = NULL;
+		return false;
+	}
+
 	GSetEntry *e = (GSetEntry *)ghash_pop((GHash *)gs, (GHashIterState *)state);
 
 	if (e) {
@@ -1484,12 +2118,12 @@ void BLI_gset_free(GSet *gs, GSetKeyFreeFP keyfreefp)
 
 void BLI_gset_flag_set(GSet *gs, unsigned int flag)
 {
-	((GHash *)gs)->flag |= flag;
+	BLI_ghash_flag_set((GHash *)gs, flag);
 }
 
 void BLI_gset_flag_clear(GSet *gs, unsigned int flag)
 {
-	((GHash *)gs)->flag &= ~flag;
+	BLI_ghash_flag_clear((GHash *)gs, flag);
 }
 
 /** \} */
@@ -1586,18 +2220,32 @@ double BLI_ghash_calc_quality_ex(
 		*r_biggest_bucket = 0;
 	}
 
+	/* Number of entries per bucket, for open addressing these are the entries having a slot as home. */
+	unsigned int *bucket_counts = MEM_callocN(sizeof(*bucket_counts) * gh->nbuckets, __func__);
+	if (gh->flag & GHASH_FLAG_OPEN_ADDRESSING) {
+		for (i = 0; i < gh->nbuckets; i++) {
+			OAEntry *e = ghash_oa_entry(gh, i);
+			if (e->hash) {
+				bucket_counts[ghash_oa_slot_index(gh, (unsigned int)e->hash)]++;
+			}
+		}
+	}
+	else {
+		for (i = 0; i < gh->nbuckets; i++) {
+			for (Entry *e = gh->buckets[i]; e; e = e->next) {
+				bucket_counts[i]++;
+			}
+		}
+	}
+
 	if (r_variance) {
 		/* We already know our mean (i.e. load factor), easy to compute variance.
 		 * See https://en.wikipedia.org/wiki/Algorithms_for_calculating_variance#Two-pass_algorithm
 		 */
 		double sum = 0.0;
 		for (i = 0; i < gh->nbuckets; i++) {
-			int count = 0;
-			Entry *e;
-			for (e = gh->buckets[i]; e; e = e->next) {
-				count++;
-			}
-			sum += ((double)count - mean) * ((double)count - mean);
+			const double count = (double)bucket_counts[i];
+			sum += (count - mean) * (count - mean);
 		}
 		*r_variance = sum / (double)(gh->nbuckets - 1);
 	}
@@ -1609,11 +2257,7 @@ double BLI_ghash_calc_quality_ex(
 		uint64_t sum_empty = 0;
 
 		for (i = 0; i < gh->nbuckets; i++) {
-			uint64_t count = 0;
-			Entry *e;
-			for (e = gh->buckets[i]; e; e = e->next) {
-				count++;
-			}
+			const uint64_t count = bucket_counts[i];
 			if (r_biggest_bucket) {
 				*r_biggest_bucket = max_ii(*r_biggest_bucket, (int)count);
 			}
@@ -1631,6 +2275,7 @@ double BLI_ghash_calc_quality_ex(
 		if (r_prop_empty_buckets) {
 			*r_prop_empty_buckets = (double)sum_empty / (double)gh->nbuckets;
 		}
+		MEM_freeN(bucket_counts);
 		return ((double)sum * (double)gh->nbuckets /
 		        ((double)gh->nentries * (gh->nentries + 2 * gh->nbuckets - 1)));
 	}
@@ -276,6 +276,7 @@ void BLI_insertlinkafter(ListBase *listbase, void *vprevlink, void *vnewlink)
 	if (listbase->first == NULL) {
 		listbase->first = newlink;
 		listbase->last = newlink;
+		newlink->next = newlink->prev = NULL;
 		return;
 	}
 	
@@ -317,6 +318,7 @@ void BLI_insertlinkbefore(ListBase *listbase, void *vnextlink, void *vnewlink)
 	if (listbase->first == NULL) {
 		listbase->first = newlink;
 		listbase->last = newlink;
+		newlink->next = newlink->prev = NULL;
 		return;
 	}
 	
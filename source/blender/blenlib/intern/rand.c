@@ -255,9 +255,22 @@ void BLI_rng_shuffle_array(RNG *rng, void *data, unsigned int elem_size_i, unsig
  */
 void BLI_rng_skip(RNG *rng, int n)
 {
-	while (n--) {
-		rng_step(rng);
+	/* Jump ahead in O(log n): n steps of X = a * X + c combine into a single
+	 * step with multiplier a^n and addend c * (a^(n-1) + ... + a + 1). */
+	uint64_t cur_mult = MULTIPLIER, cur_add = ADDEND;
+	uint64_t acc_mult = 1, acc_add = 0;
+
+	while (n > 0) {
+		if (n & 1) {
+			acc_mult = acc_mult * cur_mult;
+			acc_add = acc_add * cur_mult + cur_add;
+		}
+		cur_add = (cur_mult + 1) * cur_add;
+		cur_mult = cur_mult * cur_mult;
+		n >>= 1;
 	}
+
+	rng->X = (acc_mult * rng->X + acc_add) & MASK;
 }
 
 /***/
@@ -280,6 +293,11 @@ float BLI_frand(void)
 	return BLI_rng_get_float(&theBLI_rng);
 }
 
+void BLI_rand_skip(int n)
+{
+	BLI_rng_skip(&theBLI_rng, n);
+}
+
 void BLI_frand_unit_v3(float v[3])
 {
 	BLI_rng_get_float_unit_v3(&theBLI_rng, v);
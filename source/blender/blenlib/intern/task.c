@@ -25,6 +25,7 @@
  */
 
 #include <stdlib.h>
+#include <float.h>
 
 #include "MEM_guardedalloc.h"
 
@@ -48,11 +49,12 @@
  */
 #define MEMPOOL_SIZE 256
 
-/* Number of tasks which are pushed directly to local thread queue.
+/* Number of tasks which can be pushed to the deque of a thread.
  *
- * This allows thread to fetch next task without locking the whole queue.
+ * This allows thread to fetch next task without locking the whole queue,
+ * see TaskDeque for details.
  */
-#define LOCALQUEUE_SIZE 1
+#define TASK_DEQUE_SIZE 256
 
 #ifndef NDEBUG
 #  define ASSERT_THREAD_ID(scheduler, thread_id)                              \
@@ -82,6 +84,13 @@ typedef struct Task {
 	bool free_taskdata;
 	TaskFreeFunction freedata;
 	TaskPool *pool;
+	/* Tasks with higher value are picked up first. FLT_MAX and -FLT_MAX are
+	 * used for TASK_PRIORITY_HIGH and TASK_PRIORITY_LOW, which are kept in the
+	 * scheduler queue list, other values are kept in the TaskHeap.
+	 */
+	float priority;
+	/* Push order, used to pick up tasks with equal priority oldest first. */
+	unsigned int order;
 } Task;
 
 /* This is a per-thread storage of pre-allocated tasks.
@@ -130,16 +139,50 @@ typedef struct TaskMemPoolStats {
 
 typedef struct TaskThreadLocalStorage {
 	TaskMemPool task_mempool;
-	int num_local_queue;
-	Task *local_queue[LOCALQUEUE_SIZE];
 } TaskThreadLocalStorage;
 
+/* Per-thread double-ended queue of tasks.
+ *
+ * Tasks pushed from a scheduler thread go to the bottom of its own deque, and
+ * the thread pops them from there, most recently pushed first, so it keeps
+ * working on data which is likely still in its cache. Idle threads steal tasks
+ * from the top, oldest ones first, which are usually the biggest chunks of
+ * work left.
+ *
+ * This way threads only go to the shared scheduler queue when they have no
+ * work left nearby, and the deque lock is only contended by stealing threads.
+ * It is never held while running a task.
+ */
+typedef struct TaskDeque {
+	SpinLock lock;
+	/* Ring buffer, top is the index of the oldest task. */
+	Task *tasks[TASK_DEQUE_SIZE];
+	int top;
+	/* Can be read without lock, as a hint whether there is anything to steal. */
+	volatile int num_tasks;
+} TaskDeque;
+
+/* Binary max-heap of tasks pushed with a numeric priority, so pushing and
+ * popping does not get slower as the number of queued tasks grows.
+ */
+typedef struct TaskHeap {
+	Task **tasks;
+	int num_tasks, max_tasks;
+	unsigned int next_order;
+} TaskHeap;
+
 struct TaskPool {
 	TaskScheduler *scheduler;
 
+	/* Number of pushed tasks which are not finished yet. Only modified with
+	 * atomics, the mutex is used to wait for it to become zero, see
+	 * task_pool_num_decrease().
+	 */
 	volatile size_t num;
 	ThreadMutex num_mutex;
 	ThreadCondition num_cond;
+	/* Number of threads waiting for new tasks of this pool in num_cond. */
+	unsigned int num_waiters;
 
 	void *userdata;
 	ThreadMutex user_mutex;
@@ -150,6 +193,10 @@ struct TaskPool {
 	volatile bool is_suspended;
 	ListBase suspended_queue;
 	size_t num_suspended;
+	/* Suspended queue has tasks pushed with a numeric priority, which go to
+	 * the scheduler heap instead of its queue list.
+	 */
+	bool suspended_has_ordered;
 
 	/* If set, this pool may never be work_and_wait'ed, which means TaskScheduler
 	 * has to use its special background fallback thread in case we are in
@@ -183,9 +230,16 @@ struct TaskScheduler {
 	int num_threads;
 	bool background_thread_only;
 
+	/* High priority tasks at the head and low priority ones at the tail. */
 	ListBase queue;
+	/* Tasks with a numeric priority, run after high and before low priority
+	 * ones from the queue. Also protected by queue_mutex.
+	 */
+	TaskHeap ordered_queue;
 	ThreadMutex queue_mutex;
 	ThreadCondition queue_cond;
+	/* Number of threads waiting for tasks in queue_cond. */
+	unsigned int num_sleeping_threads;
 
 	volatile bool do_exit;
 
@@ -197,6 +251,7 @@ typedef struct TaskThread {
 	TaskScheduler *scheduler;
 	int id;
 	TaskThreadLocalStorage tls;
+	TaskDeque deque;
 } TaskThread;
 
 /* Helper */
@@ -299,17 +354,338 @@ static void task_free(TaskPool *pool, Task *task, const int thread_id)
 	}
 }
 
+/* Task Deque */
+
+static void task_deque_init(TaskDeque *deque)
+{
+	BLI_spin_init(&deque->lock);
+	deque->top = 0;
+	deque->num_tasks = 0;
+}
+
+BLI_INLINE Task *task_deque_get(TaskDeque *deque, const int index)
+{
+	return deque->tasks[(deque->top + index) % TASK_DEQUE_SIZE];
+}
+
+/* Push task to the bottom of the deque, returns false if the deque is full. */
+static bool task_deque_push(TaskDeque *deque, Task *task)
+{
+	bool pushed = false;
+
+	BLI_spin_lock(&deque->lock);
+	if (deque->num_tasks < TASK_DEQUE_SIZE) {
+		deque->tasks[(deque->top + deque->num_tasks) % TASK_DEQUE_SIZE] = task;
+		deque->num_tasks++;
+		pushed = true;
+	}
+	BLI_spin_unlock(&deque->lock);
+
+	return pushed;
+}
+
+/* Remove task at the given index (counted from the top), keeping order of
+ * the remaining ones. Must be called with the lock held.
+ */
+static Task *task_deque_remove(TaskDeque *deque, const int index)
+{
+	Task *task = task_deque_get(deque, index);
+
+	if (index == 0) {
+		deque->top = (deque->top + 1) % TASK_DEQUE_SIZE;
+	}
+	else {
+		for (int i = index; i < deque->num_tasks - 1; i++) {
+			deque->tasks[(deque->top + i) % TASK_DEQUE_SIZE] = task_deque_get(deque, i + 1);
+		}
+	}
+	deque->num_tasks--;
+
+	return task;
+}
+
+BLI_INLINE bool task_deque_task_match(Task *task, TaskPool *pool, const bool background_only)
+{
+	if (pool != NULL) {
+		return task->pool == pool;
+	}
+	return !background_only || task->pool->run_in_background;
+}
+
+/* Pop the most recently pushed task, used by the thread owning the deque.
+ * When pool is given only tasks from this pool are considered.
+ */
+static Task *task_deque_pop(TaskDeque *deque, TaskPool *pool)
+{
+	Task *task = NULL;
+
+	if (deque->num_tasks == 0) {
+		return NULL;
+	}
+
+	BLI_spin_lock(&deque->lock);
+	for (int i = deque->num_tasks; i--; ) {
+		if (task_deque_task_match(task_deque_get(deque, i), pool, false)) {
+			task = task_deque_remove(deque, i);
+			break;
+		}
+	}
+	BLI_spin_unlock(&deque->lock);
+
+	return task;
+}
+
+/* Steal the oldest task, used by other threads than the deque owner. */
+static Task *task_deque_steal(TaskDeque *deque, TaskPool *pool, const bool background_only)
+{
+	Task *task = NULL;
+
+	if (deque->num_tasks == 0) {
+		return NULL;
+	}
+
+	BLI_spin_lock(&deque->lock);
+	for (int i = 0; i < deque->num_tasks; i++) {
+		if (task_deque_task_match(task_deque_get(deque, i), pool, background_only)) {
+			task = task_deque_remove(deque, i);
+			break;
+		}
+	}
+	BLI_spin_unlock(&deque->lock);
+
+	return task;
+}
+
+static bool task_deque_has_tasks(TaskDeque *deque, const bool background_only)
+{
+	bool has_tasks = false;
+
+	if (deque->num_tasks == 0) {
+		return false;
+	}
+	else if (!background_only) {
+		return true;
+	}
+
+	BLI_spin_lock(&deque->lock);
+	for (int i = 0; i < deque->num_tasks; i++) {
+		if (task_deque_task_match(task_deque_get(deque, i), NULL, true)) {
+			has_tasks = true;
+			break;
+		}
+	}
+	BLI_spin_unlock(&deque->lock);
+
+	return has_tasks;
+}
+
+/* Remove all tasks of the pool from the deque, returns number of removed tasks. */
+static size_t task_deque_clear(TaskDeque *deque, TaskPool *pool)
+{
+	size_t done = 0;
+
+	BLI_spin_lock(&deque->lock);
+	for (int i = deque->num_tasks; i--; ) {
+		Task *task = task_deque_get(deque, i);
+		if (pool == NULL || task->pool == pool) {
+			task_deque_remove(deque, i);
+			task_data_free(task, (pool != NULL) ? pool->thread_id : 0);
+			MEM_freeN(task);
+			done++;
+		}
+	}
+	BLI_spin_unlock(&deque->lock);
+
+	return done;
+}
+
+static void task_deque_end(TaskDeque *deque)
+{
+	task_deque_clear(deque, NULL);
+	BLI_spin_end(&deque->lock);
+}
+
+/* Task Heap */
+
+static void task_heap_init(TaskHeap *heap)
+{
+	heap->tasks = NULL;
+	heap->num_tasks = 0;
+	heap->max_tasks = 0;
+	heap->next_order = 0;
+}
+
+/* Whether task a is to be picked up before task b. */
+BLI_INLINE bool task_heap_before(const Task *a, const Task *b)
+{
+	if (a->priority != b->priority) {
+		return a->priority > b->priority;
+	}
+	/* Wraps around, so compare the difference. */
+	return (int)(a->order - b->order) < 0;
+}
+
+static void task_heap_sift_up(TaskHeap *heap, int index)
+{
+	Task *task = heap->tasks[index];
+
+	while (index > 0) {
+		const int parent = (index - 1) / 2;
+		if (!task_heap_before(task, heap->tasks[parent])) {
+			break;
+		}
+		heap->tasks[index] = heap->tasks[parent];
+		index = parent;
+	}
+	heap->tasks[index] = task;
+}
+
+static void task_heap_sift_down(TaskHeap *heap, int index)
+{
+	Task *task = heap->tasks[index];
+
+	while (true) {
+		int child = index * 2 + 1;
+		if (child >= heap->num_tasks) {
+			break;
+		}
+		if (child + 1 < heap->num_tasks && task_heap_before(heap->tasks[child + 1], heap->tasks[child])) {
+			child++;
+		}
+		if (!task_heap_before(heap->tasks[child], task)) {
+			break;
+		}
+		heap->tasks[index] = heap->tasks[child];
+		index = child;
+	}
+	heap->tasks[index] = task;
+}
+
+static void task_heap_push(TaskHeap *heap, Task *task)
+{
+	if (heap->num_tasks == heap->max_tasks) {
+		heap->max_tasks = max_ii(heap->max_tasks * 2, 64);
+		heap->tasks = MEM_reallocN_id(heap->tasks, sizeof(Task *) * heap->max_tasks, "TaskHeap tasks");
+	}
+
+	task->order = heap->next_order++;
+	heap->tasks[heap->num_tasks++] = task;
+	task_heap_sift_up(heap, heap->num_tasks - 1);
+}
+
+static Task *task_heap_remove(TaskHeap *heap, const int index)
+{
+	Task *task = heap->tasks[index];
+
+	heap->num_tasks--;
+	if (index != heap->num_tasks) {
+		heap->tasks[index] = heap->tasks[heap->num_tasks];
+		task_heap_sift_down(heap, index);
+		task_heap_sift_up(heap, index);
+	}
+
+	return task;
+}
+
+/* Pop the most important task matching pool (see task_deque_task_match()).
+ * Only when the top task belongs to another pool all tasks are searched.
+ */
+static Task *task_heap_pop(TaskHeap *heap, TaskPool *pool, const bool background_only)
+{
+	int best = -1;
+
+	if (heap->num_tasks == 0) {
+		return NULL;
+	}
+	else if (task_deque_task_match(heap->tasks[0], pool, background_only)) {
+		return task_heap_remove(heap, 0);
+	}
+
+	for (int i = 1; i < heap->num_tasks; i++) {
+		if (task_deque_task_match(heap->tasks[i], pool, background_only) &&
+		    (best == -1 || task_heap_before(heap->tasks[i], heap->tasks[best])))
+		{
+			best = i;
+		}
+	}
+
+	return (best != -1) ? task_heap_remove(heap, best) : NULL;
+}
+
+static bool task_heap_has_tasks(TaskHeap *heap, const bool background_only)
+{
+	if (heap->num_tasks == 0) {
+		return false;
+	}
+	else if (!background_only) {
+		return true;
+	}
+
+	for (int i = 0; i < heap->num_tasks; i++) {
+		if (task_deque_task_match(heap->tasks[i], NULL, true)) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/* Remove all tasks of the pool from the heap, returns number of removed tasks. */
+static size_t task_heap_clear(TaskHeap *heap, TaskPool *pool)
+{
+	size_t done = 0;
+	int num_tasks = 0;
+
+	for (int i = 0; i < heap->num_tasks; i++) {
+		Task *task = heap->tasks[i];
+		if (pool == NULL || task->pool == pool) {
+			task_data_free(task, (pool != NULL) ? pool->thread_id : 0);
+			MEM_freeN(task);
+			done++;
+		}
+		else {
+			heap->tasks[num_tasks++] = task;
+		}
+	}
+
+	if (done != 0) {
+		heap->num_tasks = num_tasks;
+		for (int i = num_tasks / 2; i--; ) {
+			task_heap_sift_down(heap, i);
+		}
+	}
+
+	return done;
+}
+
+static void task_heap_end(TaskHeap *heap)
+{
+	task_heap_clear(heap, NULL);
+	MEM_SAFE_FREE(heap->tasks);
+}
+
 /* Task Scheduler */
 
 static void task_pool_num_decrease(TaskPool *pool, size_t done)
 {
-	BLI_mutex_lock(&pool->num_mutex);
+	size_t num = pool->num;
+
+	BLI_assert(num >= done);
 
-	BLI_assert(pool->num >= done);
+	/* Only the last tasks are counted down with the lock held, once the pool
+	 * is seen empty by a waiting thread it can be freed right away.
+	 */
+	while (num > done) {
+		const size_t num_prev = atomic_cas_z((size_t *)&pool->num, num, num - done);
+		if (num_prev == num) {
+			return;
+		}
+		num = num_prev;
+	}
 
-	pool->num -= done;
+	BLI_mutex_lock(&pool->num_mutex);
 
-	if (pool->num == 0)
+	if (atomic_sub_and_fetch_z((size_t *)&pool->num, done) == 0)
 		BLI_condition_notify_all(&pool->num_cond);
 
 	BLI_mutex_unlock(&pool->num_mutex);
@@ -317,86 +693,152 @@ static void task_pool_num_decrease(TaskPool *pool, size_t done)
 
 static void task_pool_num_increase(TaskPool *pool, size_t new)
 {
-	BLI_mutex_lock(&pool->num_mutex);
+	atomic_add_and_fetch_z((size_t *)&pool->num, new);
+}
 
-	pool->num += new;
-	BLI_condition_notify_all(&pool->num_cond);
+/* Wake up threads waiting in BLI_task_pool_work_and_wait(), so they can help
+ * with the newly pushed tasks.
+ */
+static void task_pool_notify_waiters(TaskPool *pool)
+{
+	/* Atomic read acts as a barrier, so either the waiting thread sees the
+	 * new task when checking for work, or we see it waiting.
+	 */
+	if (atomic_add_and_fetch_u(&pool->num_waiters, 0) != 0) {
+		BLI_mutex_lock(&pool->num_mutex);
+		BLI_condition_notify_all(&pool->num_cond);
+		BLI_mutex_unlock(&pool->num_mutex);
+	}
+}
 
-	BLI_mutex_unlock(&pool->num_mutex);
+/* Find task in the scheduler queue, must be called with queue_mutex held.
+ * High priority tasks from the list go first, then the ones from the heap,
+ * and low priority tasks from the list last.
+ */
+static Task *task_scheduler_queue_pop(TaskScheduler *scheduler, TaskPool *pool, const bool background_only)
+{
+	Task *task, *ordered_task;
+
+	for (task = scheduler->queue.first; task != NULL; task = task->next) {
+		if (task_deque_task_match(task, pool, background_only)) {
+			break;
+		}
+	}
+
+	if (task == NULL || task->priority != FLT_MAX) {
+		ordered_task = task_heap_pop(&scheduler->ordered_queue, pool, background_only);
+		if (ordered_task != NULL) {
+			return ordered_task;
+		}
+	}
+
+	if (task != NULL) {
+		BLI_remlink(&scheduler->queue, task);
+	}
+
+	return task;
 }
 
-static bool task_scheduler_thread_wait_pop(TaskScheduler *scheduler, Task **task)
+/* Get next task to run for the given thread: first from its own deque, then
+ * from the scheduler queue, and finally stolen from other threads, starting
+ * with the neighbor ones. When pool is given only its tasks are considered,
+ * running tasks from other pools in BLI_task_pool_work_and_wait() could lead
+ * to deadlocks.
+ */
+static Task *task_scheduler_get_task(TaskScheduler *scheduler, const int thread_id,
+                                     TaskPool *pool, const bool use_deque)
 {
-	bool found_task = false;
-	BLI_mutex_lock(&scheduler->queue_mutex);
+	const bool background_only = (pool == NULL) && scheduler->background_thread_only;
+	const int num_deques = scheduler->num_threads + 1;
+	Task *task;
 
-	while (!scheduler->queue.first && !scheduler->do_exit)
-		BLI_condition_wait(&scheduler->queue_cond, &scheduler->queue_mutex);
+	if (use_deque) {
+		task = task_deque_pop(&scheduler->task_threads[thread_id].deque, pool);
+		if (task != NULL) {
+			return task;
+		}
+	}
 
-	do {
-		Task *current_task;
+	if (scheduler->queue.first != NULL || scheduler->ordered_queue.num_tasks != 0) {
+		BLI_mutex_lock(&scheduler->queue_mutex);
+		task = task_scheduler_queue_pop(scheduler, pool, background_only);
+		BLI_mutex_unlock(&scheduler->queue_mutex);
+		if (task != NULL) {
+			return task;
+		}
+	}
 
-		/* Assuming we can only have a void queue in 'exit' case here seems logical (we should only be here after
-		 * our worker thread has been woken up from a condition_wait(), which only happens after a new task was
-		 * added to the queue), but it is wrong.
-		 * Waiting on condition may wake up the thread even if condition is not signaled (spurious wake-ups), and some
-		 * race condition may also empty the queue **after** condition has been signaled, but **before** awoken thread
-		 * reaches this point...
-		 * See http://stackoverflow.com/questions/8594591
-		 *
-		 * So we only abort here if do_exit is set.
-		 */
-		if (scheduler->do_exit) {
-			BLI_mutex_unlock(&scheduler->queue_mutex);
-			return false;
+	for (int i = 1; i < num_deques; i++) {
+		TaskDeque *deque = &scheduler->task_threads[(thread_id + i) % num_deques].deque;
+		task = task_deque_steal(deque, pool, background_only);
+		if (task != NULL) {
+			return task;
 		}
+	}
 
-		for (current_task = scheduler->queue.first;
-		     current_task != NULL;
-		     current_task = current_task->next)
-		{
-			TaskPool *pool = current_task->pool;
+	return NULL;
+}
 
-			if (scheduler->background_thread_only && !pool->run_in_background) {
-				continue;
-			}
+/* Check whether there are any tasks a worker thread could pick up, must be
+ * called with queue_mutex held.
+ */
+static bool task_scheduler_has_tasks(TaskScheduler *scheduler)
+{
+	const bool background_only = scheduler->background_thread_only;
 
-			*task = current_task;
-			found_task = true;
-			BLI_remlink(&scheduler->queue, *task);
-			break;
+	for (Task *task = scheduler->queue.first; task != NULL; task = task->next) {
+		if (task_deque_task_match(task, NULL, background_only)) {
+			return true;
 		}
-		if (!found_task)
-			BLI_condition_wait(&scheduler->queue_cond, &scheduler->queue_mutex);
-	} while (!found_task);
+	}
 
-	BLI_mutex_unlock(&scheduler->queue_mutex);
+	if (task_heap_has_tasks(&scheduler->ordered_queue, background_only)) {
+		return true;
+	}
+
+	for (int i = 0; i < scheduler->num_threads + 1; i++) {
+		if (task_deque_has_tasks(&scheduler->task_threads[i].deque, background_only)) {
+			return true;
+		}
+	}
 
-	return true;
+	return false;
 }
 
-BLI_INLINE void handle_local_queue(TaskThreadLocalStorage *tls,
-                                   const int thread_id)
+static bool task_scheduler_thread_wait_pop(TaskScheduler *scheduler, const int thread_id, Task **task)
 {
-	while (tls->num_local_queue > 0) {
-		/* We pop task from queue before handling it so handler of the task can
-		 * push next job to the local queue.
-		 */
-		tls->num_local_queue--;
-		Task *local_task = tls->local_queue[tls->num_local_queue];
-		/* TODO(sergey): Double-check work_and_wait() doesn't handle other's
-		 * pool tasks.
+	while (!scheduler->do_exit) {
+		*task = task_scheduler_get_task(scheduler, thread_id, NULL, true);
+		if (*task != NULL) {
+			return true;
+		}
+
+		BLI_mutex_lock(&scheduler->queue_mutex);
+
+		/* Announce we are going to sleep before checking for tasks one more
+		 * time, so a task pushed to a deque meanwhile is not missed (pushing
+		 * thread only wakes up others when it sees sleeping threads).
+		 *
+		 * Waiting on condition may also wake up the thread even if condition
+		 * is not signaled (spurious wake-ups), or another thread may steal the
+		 * task first, so we just try again after waking up.
+		 * See http://stackoverflow.com/questions/8594591
 		 */
-		TaskPool *local_pool = local_task->pool;
-		local_task->run(local_pool, local_task->taskdata, thread_id);
-		task_free(local_pool, local_task, thread_id);
+		atomic_add_and_fetch_u(&scheduler->num_sleeping_threads, 1);
+		if (!scheduler->do_exit && !task_scheduler_has_tasks(scheduler)) {
+			BLI_condition_wait(&scheduler->queue_cond, &scheduler->queue_mutex);
+		}
+		atomic_sub_and_fetch_u(&scheduler->num_sleeping_threads, 1);
+
+		BLI_mutex_unlock(&scheduler->queue_mutex);
 	}
+
+	return false;
 }
 
 static void *task_scheduler_thread_run(void *thread_p)
 {
 	TaskThread *thread = (TaskThread *) thread_p;
-	TaskThreadLocalStorage *tls = &thread->tls;
 	TaskScheduler *scheduler = thread->scheduler;
 	int thread_id = thread->id;
 	Task *task;
@@ -404,7 +846,7 @@ static void *task_scheduler_thread_run(void *thread_p)
 	pthread_setspecific(scheduler->tls_id_key, thread);
 
 	/* keep popping off tasks */
-	while (task_scheduler_thread_wait_pop(scheduler, &task)) {
+	while (task_scheduler_thread_wait_pop(scheduler, thread_id, &task)) {
 		TaskPool *pool = task->pool;
 
 		/* run task */
@@ -413,9 +855,6 @@ static void *task_scheduler_thread_run(void *thread_p)
 		/* delete task */
 		task_free(pool, task, thread_id);
 
-		/* Handle all tasks from local queue. */
-		handle_local_queue(tls, thread_id);
-
 		/* notify pool task was done */
 		task_pool_num_decrease(pool, 1);
 	}
@@ -432,6 +871,7 @@ TaskScheduler *BLI_task_scheduler_create(int num_threads)
 	scheduler->do_exit = false;
 
 	BLI_listbase_clear(&scheduler->queue);
+	task_heap_init(&scheduler->ordered_queue);
 	BLI_mutex_init(&scheduler->queue_mutex);
 	BLI_condition_init(&scheduler->queue_cond);
 
@@ -452,8 +892,16 @@ TaskScheduler *BLI_task_scheduler_create(int num_threads)
 	scheduler->task_threads = MEM_mallocN(sizeof(TaskThread) * (num_threads + 1),
 	                                      "TaskScheduler task threads");
 
-	/* Initialize TLS for main thread. */
-	initialize_task_tls(&scheduler->task_threads[0].tls);
+	/* Initialize TLS and deques for all threads including main one, before
+	 * launching any thread, since threads steal tasks from each other.
+	 */
+	for (int i = 0; i < num_threads + 1; i++) {
+		TaskThread *thread = &scheduler->task_threads[i];
+		thread->scheduler = scheduler;
+		thread->id = i;
+		initialize_task_tls(&thread->tls);
+		task_deque_init(&thread->deque);
+	}
 
 	pthread_key_create(&scheduler->tls_id_key, NULL);
 
@@ -466,9 +914,6 @@ TaskScheduler *BLI_task_scheduler_create(int num_threads)
 
 		for (i = 0; i < num_threads; i++) {
 			TaskThread *thread = &scheduler->task_threads[i + 1];
-			thread->scheduler = scheduler;
-			thread->id = i + 1;
-			initialize_task_tls(&thread->tls);
 
 			if (pthread_create(&scheduler->threads[i], NULL, task_scheduler_thread_run, thread) != 0) {
 				fprintf(stderr, "TaskScheduler failed to launch thread %d/%d\n", i, num_threads);
@@ -508,6 +953,8 @@ void BLI_task_scheduler_free(TaskScheduler *scheduler)
 		for (int i = 0; i < scheduler->num_threads + 1; ++i) {
 			TaskThreadLocalStorage *tls = &scheduler->task_threads[i].tls;
 			free_task_tls(tls);
+			/* Also deletes leftover tasks. */
+			task_deque_end(&scheduler->task_threads[i].deque);
 		}
 
 		MEM_freeN(scheduler->task_threads);
@@ -518,6 +965,7 @@ void BLI_task_scheduler_free(TaskScheduler *scheduler)
 		task_data_free(task, 0);
 	}
 	BLI_freelistN(&scheduler->queue);
+	task_heap_end(&scheduler->ordered_queue);
 
 	/* delete mutex/condition */
 	BLI_mutex_end(&scheduler->queue_mutex);
@@ -531,20 +979,37 @@ int BLI_task_scheduler_num_threads(TaskScheduler *scheduler)
 	return scheduler->num_threads + 1;
 }
 
-static void task_scheduler_push(TaskScheduler *scheduler, Task *task, TaskPriority priority)
+/* Push task to the deque of the given thread, or to the shared queue when
+ * thread_id is -1 or the deque is full.
+ */
+static void task_scheduler_push(TaskScheduler *scheduler, Task *task, const int thread_id)
 {
-	task_pool_num_increase(task->pool, 1);
+	TaskPool *pool = task->pool;
 
-	/* add task to queue */
-	BLI_mutex_lock(&scheduler->queue_mutex);
+	task_pool_num_increase(pool, 1);
 
-	if (priority == TASK_PRIORITY_HIGH)
-		BLI_addhead(&scheduler->queue, task);
-	else
-		BLI_addtail(&scheduler->queue, task);
+	if (thread_id == -1 || !task_deque_push(&scheduler->task_threads[thread_id].deque, task)) {
+		/* add task to queue */
+		BLI_mutex_lock(&scheduler->queue_mutex);
 
-	BLI_condition_notify_one(&scheduler->queue_cond);
-	BLI_mutex_unlock(&scheduler->queue_mutex);
+		if (task->priority == FLT_MAX)
+			BLI_addhead(&scheduler->queue, task);
+		else if (task->priority == -FLT_MAX)
+			BLI_addtail(&scheduler->queue, task);
+		else
+			task_heap_push(&scheduler->ordered_queue, task);
+
+		BLI_condition_notify_one(&scheduler->queue_cond);
+		BLI_mutex_unlock(&scheduler->queue_mutex);
+	}
+	else if (atomic_add_and_fetch_u(&scheduler->num_sleeping_threads, 0) != 0) {
+		/* Wake up a thread to steal the task, see task_scheduler_thread_wait_pop(). */
+		BLI_mutex_lock(&scheduler->queue_mutex);
+		BLI_condition_notify_one(&scheduler->queue_cond);
+		BLI_mutex_unlock(&scheduler->queue_mutex);
+	}
+
+	task_pool_notify_waiters(pool);
 }
 
 static void task_scheduler_clear(TaskScheduler *scheduler, TaskPool *pool)
@@ -566,8 +1031,14 @@ static void task_scheduler_clear(TaskScheduler *scheduler, TaskPool *pool)
 		}
 	}
 
+	done += task_heap_clear(&scheduler->ordered_queue, pool);
+
 	BLI_mutex_unlock(&scheduler->queue_mutex);
 
+	for (int i = 0; i < scheduler->num_threads + 1; i++) {
+		done += task_deque_clear(&scheduler->task_threads[i].deque, pool);
+	}
+
 	/* notify done */
 	task_pool_num_decrease(pool, done);
 }
@@ -595,11 +1066,13 @@ static TaskPool *task_pool_create_ex(TaskScheduler *scheduler,
 
 	pool->scheduler = scheduler;
 	pool->num = 0;
+	pool->num_waiters = 0;
 	pool->do_cancel = false;
 	pool->do_work = false;
 	pool->is_suspended = is_suspended;
 	pool->num_suspended = 0;
 	pool->suspended_queue.first = pool->suspended_queue.last = NULL;
+	pool->suspended_has_ordered = false;
 	pool->run_in_background = is_background;
 	pool->use_local_tls = false;
 
@@ -716,7 +1189,7 @@ void BLI_task_pool_free(TaskPool *pool)
 
 static void task_pool_push(
         TaskPool *pool, TaskRunFunction run, void *taskdata,
-        bool free_taskdata, TaskFreeFunction freedata, TaskPriority priority,
+        bool free_taskdata, TaskFreeFunction freedata, float priority,
         int thread_id)
 {
 	Task *task = task_alloc(pool, thread_id);
@@ -726,34 +1199,45 @@ static void task_pool_push(
 	task->free_taskdata = free_taskdata;
 	task->freedata = freedata;
 	task->pool = pool;
+	task->priority = priority;
 
 	if (pool->is_suspended) {
 		BLI_addhead(&pool->suspended_queue, task);
 		atomic_fetch_and_add_z(&pool->num_suspended, 1);
+		if (!ELEM(priority, FLT_MAX, -FLT_MAX)) {
+			pool->suspended_has_ordered = true;
+		}
 		return;
 	}
 
+	/* Tasks pushed from scheduler threads go to their own deque. Tasks with
+	 * a numeric priority always go to the shared queue, since it is the only
+	 * place where they are ordered against each other. Pools owned by other
+	 * threads can not use the deque of the main thread they identify with.
+	 */
 	if (thread_id != -1 &&
-	    (thread_id != pool->thread_id || pool->do_work))
+	    (priority == FLT_MAX) &&
+	    !(pool->use_local_tls && thread_id == 0))
 	{
 		ASSERT_THREAD_ID(pool->scheduler, thread_id);
-
-		TaskThreadLocalStorage *tls = get_task_tls(pool, thread_id);
-		if (tls->num_local_queue < LOCALQUEUE_SIZE) {
-			tls->local_queue[tls->num_local_queue] = task;
-			tls->num_local_queue++;
-			return;
-		}
+		task_scheduler_push(pool->scheduler, task, thread_id);
+	}
+	else {
+		task_scheduler_push(pool->scheduler, task, -1);
 	}
+}
 
-	task_scheduler_push(pool->scheduler, task, priority);
+BLI_INLINE float task_priority_value(TaskPriority priority)
+{
+	return (priority == TASK_PRIORITY_HIGH) ? FLT_MAX : -FLT_MAX;
 }
 
 void BLI_task_pool_push_ex(
         TaskPool *pool, TaskRunFunction run, void *taskdata,
         bool free_taskdata, TaskFreeFunction freedata, TaskPriority priority)
 {
-	task_pool_push(pool, run, taskdata, free_taskdata, freedata, priority, -1);
+	task_pool_push(pool, run, taskdata, free_taskdata, freedata,
+	               task_priority_value(priority), -1);
 }
 
 void BLI_task_pool_push(
@@ -765,19 +1249,48 @@ void BLI_task_pool_push(
 void BLI_task_pool_push_from_thread(TaskPool *pool, TaskRunFunction run,
         void *taskdata, bool free_taskdata, TaskPriority priority, int thread_id)
 {
+	task_pool_push(pool, run, taskdata, free_taskdata, NULL,
+	               task_priority_value(priority), thread_id);
+}
+
+/**
+ * Push task with a numeric priority, tasks with higher value are started
+ * first. Tasks pushed with #TASK_PRIORITY_HIGH are still started before any
+ * of these, and #TASK_PRIORITY_LOW ones after.
+ *
+ * \param thread_id: ID of the scheduler thread the task is pushed from,
+ * or -1 when not known (same as #BLI_task_pool_push_from_thread).
+ */
+void BLI_task_pool_push_ordered(TaskPool *pool, TaskRunFunction run,
+        void *taskdata, bool free_taskdata, float priority, int thread_id)
+{
+	BLI_assert(priority > -FLT_MAX && priority < FLT_MAX);
 	task_pool_push(pool, run, taskdata, free_taskdata, NULL, priority, thread_id);
 }
 
 void BLI_task_pool_work_and_wait(TaskPool *pool)
 {
-	TaskThreadLocalStorage *tls = get_task_tls(pool, pool->thread_id);
 	TaskScheduler *scheduler = pool->scheduler;
+	const int thread_id = pool->thread_id;
+	const bool use_deque = !pool->use_local_tls;
 
 	if (atomic_fetch_and_and_uint8((uint8_t *)&pool->is_suspended, 0)) {
 		if (pool->num_suspended) {
 			task_pool_num_increase(pool, pool->num_suspended);
+
 			BLI_mutex_lock(&scheduler->queue_mutex);
 
+			if (pool->suspended_has_ordered) {
+				Task *task, *task_prev;
+				/* Suspended tasks were pushed to the head, go in push order. */
+				for (task = pool->suspended_queue.last; task != NULL; task = task_prev) {
+					task_prev = task->prev;
+					if (!ELEM(task->priority, FLT_MAX, -FLT_MAX)) {
+						BLI_remlink(&pool->suspended_queue, task);
+						task_heap_push(&scheduler->ordered_queue, task);
+					}
+				}
+			}
 			BLI_movelisttolist(&scheduler->queue, &pool->suspended_queue);
 
 			BLI_condition_notify_all(&scheduler->queue_cond);
@@ -789,56 +1302,47 @@ void BLI_task_pool_work_and_wait(TaskPool *pool)
 
 	ASSERT_THREAD_ID(pool->scheduler, pool->thread_id);
 
-	BLI_mutex_lock(&pool->num_mutex);
-
-	while (pool->num != 0) {
-		Task *task, *work_task = NULL;
-		bool found_task = false;
-
-		BLI_mutex_unlock(&pool->num_mutex);
-
-		BLI_mutex_lock(&scheduler->queue_mutex);
-
+	while (true) {
 		/* find task from this pool. if we get a task from another pool,
 		 * we can get into deadlock */
+		Task *task = task_scheduler_get_task(scheduler, thread_id, pool, use_deque);
+
+		if (task == NULL) {
+			BLI_mutex_lock(&pool->num_mutex);
 
-		for (task = scheduler->queue.first; task; task = task->next) {
-			if (task->pool == pool) {
-				work_task = task;
-				found_task = true;
-				BLI_remlink(&scheduler->queue, task);
+			if (pool->num == 0) {
+				BLI_mutex_unlock(&pool->num_mutex);
 				break;
 			}
-		}
 
-		BLI_mutex_unlock(&scheduler->queue_mutex);
-
-		/* if found task, do it, otherwise wait until other tasks are done */
-		if (found_task) {
-			/* run task */
-			work_task->run(pool, work_task->taskdata, pool->thread_id);
-
-			/* delete task */
-			task_free(pool, task, pool->thread_id);
+			/* Check once more after announcing we are waiting, so a task
+			 * pushed meanwhile is not missed (see task_pool_notify_waiters()),
+			 * otherwise wait until new tasks are pushed or other threads are
+			 * done with the remaining ones.
+			 */
+			atomic_add_and_fetch_u(&pool->num_waiters, 1);
+			task = task_scheduler_get_task(scheduler, thread_id, pool, use_deque);
+			if (task == NULL) {
+				BLI_condition_wait(&pool->num_cond, &pool->num_mutex);
+			}
+			atomic_sub_and_fetch_u(&pool->num_waiters, 1);
 
-			/* Handle all tasks from local queue. */
-			handle_local_queue(tls, pool->thread_id);
+			BLI_mutex_unlock(&pool->num_mutex);
 
-			/* notify pool task was done */
-			task_pool_num_decrease(pool, 1);
+			if (task == NULL) {
+				continue;
+			}
 		}
 
-		BLI_mutex_lock(&pool->num_mutex);
-		if (pool->num == 0)
-			break;
-
-		if (!found_task)
-			BLI_condition_wait(&pool->num_cond, &pool->num_mutex);
-	}
+		/* run task */
+		task->run(pool, task->taskdata, thread_id);
 
-	BLI_mutex_unlock(&pool->num_mutex);
+		/* delete task */
+		task_free(pool, task, thread_id);
 
-	handle_local_queue(tls, pool->thread_id);
+		/* notify pool task was done */
+		task_pool_num_decrease(pool, 1);
+	}
 }
 
 void BLI_task_pool_cancel(TaskPool *pool)
@@ -1141,6 +1645,333 @@ void BLI_task_parallel_range_finalize(
 	            use_threading, use_dynamic_scheduling);
 }
 
+/* Parallel for, reduce and scan routines
+ *
+ * Unlike BLI_task_parallel_range(), callbacks are given whole sub-ranges, and
+ * the range is split lazily: a task keeps on running chunks of 'grain'
+ * iterations from its range, and only gives away the upper half of what is
+ * left when its thread's deque is empty, that is when other threads took all
+ * the work it had to share. So the range is only split as much as needed to
+ * keep all threads busy, whatever the cost of the iterations is, and callers
+ * do not have to decide whether threading is worth it.
+ */
+
+/* Minimal number of iterations in a chunk, when not given by the caller.
+ * Suits callbacks doing very little work per iteration.
+ */
+#define PARALLEL_FOR_MIN_GRAIN_DEFAULT 256
+
+/* Number of blocks per thread for scans, which need fixed blocks. */
+#define PARALLEL_SCAN_BLOCKS_PER_THREAD 4
+
+/* Accumulators are padded to avoid false sharing between threads. */
+#define PARALLEL_ACCUM_ALIGN 64
+
+typedef struct ParallelForState {
+	void *userdata;
+	TaskParallelForFunc func;
+	TaskParallelReduceFunc func_reduce;
+
+	/* Per-thread accumulators of reductions. */
+	char *accum_array;
+	size_t accum_stride;
+
+	int grain;
+} ParallelForState;
+
+typedef struct ParallelForRange {
+	int start, stop;
+} ParallelForRange;
+
+static int parallel_for_grain(const int len, const int num_threads, const int min_grain)
+{
+	const int grain = (min_grain > 0) ? min_grain : PARALLEL_FOR_MIN_GRAIN_DEFAULT;
+	/* Bigger chunks for big ranges, checking the deque is cheap but not free. */
+	return max_ii(grain, len / (num_threads * 64));
+}
+
+static bool parallel_for_use_threading(TaskScheduler *scheduler, const int len, const int grain)
+{
+	return !scheduler->background_thread_only && (len > grain);
+}
+
+BLI_INLINE void parallel_for_run(
+        ParallelForState *state, const int start, const int stop, const int thread_id)
+{
+	if (state->func_reduce) {
+		state->func_reduce(state->userdata, state->accum_array + state->accum_stride * (size_t)thread_id,
+		                   start, stop);
+	}
+	else {
+		state->func(state->userdata, start, stop, thread_id);
+	}
+}
+
+static void parallel_for_func(TaskPool * __restrict pool, void *taskdata, int thread_id);
+
+/* Deque tasks pushed by the calling thread go to, NULL when they go to the
+ * shared queue. This is the case for threads not managed by the scheduler,
+ * like workers of another scheduler, which identify themselves as thread 0.
+ */
+static TaskDeque *parallel_for_thread_deque(TaskPool *pool, const int thread_id)
+{
+	TaskScheduler *scheduler = pool->scheduler;
+	TaskThread *thread = pthread_getspecific(scheduler->tls_id_key);
+
+	if (thread == NULL) {
+		return BLI_thread_is_main() ? &scheduler->task_threads[0].deque : NULL;
+	}
+
+	BLI_assert(thread->id == thread_id);
+	return (thread->id == thread_id) ? &thread->deque : NULL;
+}
+
+static void parallel_for_push(TaskPool *pool, const int start, const int stop, const int thread_id)
+{
+	ParallelForRange *range = MEM_mallocN(sizeof(*range), __func__);
+	range->start = start;
+	range->stop = stop;
+	BLI_task_pool_push_from_thread(pool, parallel_for_func, range, true, TASK_PRIORITY_HIGH, thread_id);
+}
+
+static void parallel_for_func(TaskPool * __restrict pool, void *taskdata, int thread_id)
+{
+	ParallelForState *state = BLI_task_pool_userdata(pool);
+	const ParallelForRange *range = taskdata;
+	TaskDeque *deque = parallel_for_thread_deque(pool, thread_id);
+	int start = range->start, stop = range->stop;
+
+	while (stop - start > state->grain) {
+		/* Without a deque to watch, split in halves down to the grain size. */
+		if (deque == NULL || deque->num_tasks == 0) {
+			/* Everything we pushed was taken, share the upper half of what is left. */
+			const int mid = start + (stop - start) / 2;
+			parallel_for_push(pool, mid, stop, thread_id);
+			stop = mid;
+		}
+		else {
+			parallel_for_run(state, start, start + state->grain, thread_id);
+			start += state->grain;
+		}
+	}
+
+	parallel_for_run(state, start, stop, thread_id);
+}
+
+static void task_parallel_for_ex(
+        TaskScheduler *scheduler, ParallelForState *state, const int start, const int stop)
+{
+	TaskPool *pool = BLI_task_pool_create(scheduler, state);
+
+	parallel_for_push(pool, start, stop, pool->thread_id);
+
+	BLI_task_pool_work_and_wait(pool);
+	BLI_task_pool_free(pool);
+}
+
+/**
+ * Parallel for loop, splitting the range adaptively (see above).
+ *
+ * \param start First index to process.
+ * \param stop Index to stop looping (excluded).
+ * \param userdata Common userdata passed to all instances of \a func.
+ * \param func Callback function, called with sub-ranges of the whole range.
+ * \param min_grain Minimal number of iterations worth running in a separate task,
+ * the whole range is processed from the calling thread when not bigger than that.
+ * Zero to use a default suitable for cheap iterations.
+ */
+void BLI_task_parallel_for(
+        int start, int stop,
+        void *userdata,
+        TaskParallelForFunc func,
+        const int min_grain)
+{
+	TaskScheduler *scheduler;
+	ParallelForState state;
+
+	if (start >= stop) {
+		return;
+	}
+
+	scheduler = BLI_task_scheduler_get();
+	state.grain = parallel_for_grain(stop - start, BLI_task_scheduler_num_threads(scheduler), min_grain);
+
+	if (!parallel_for_use_threading(scheduler, stop - start, state.grain)) {
+		func(userdata, start, stop, 0);
+		return;
+	}
+
+	state.userdata = userdata;
+	state.func = func;
+	state.func_reduce = NULL;
+	state.accum_array = NULL;
+	state.accum_stride = 0;
+
+	task_parallel_for_ex(scheduler, &state, start, stop);
+}
+
+/**
+ * Parallel reduction: every thread accumulates the sub-ranges it runs into its own copy of \a accum,
+ * those are joined into \a accum at the end, in no particular order.
+ *
+ * \param accum Accumulator, of \a accum_size bytes, holding the identity value of the reduction
+ * (e.g. zero for a sum), and the result once done.
+ * \param func Callback function accumulating a sub-range into the given accumulator.
+ * \param join Callback function joining the second accumulator into the first one.
+ * \param min_grain See #BLI_task_parallel_for.
+ */
+void BLI_task_parallel_reduce(
+        int start, int stop,
+        void *userdata,
+        void *accum,
+        const size_t accum_size,
+        TaskParallelReduceFunc func,
+        TaskParallelJoinFunc join,
+        const int min_grain)
+{
+	TaskScheduler *scheduler;
+	ParallelForState state;
+	int num_threads;
+
+	if (start >= stop) {
+		return;
+	}
+
+	scheduler = BLI_task_scheduler_get();
+	num_threads = BLI_task_scheduler_num_threads(scheduler);
+	state.grain = parallel_for_grain(stop - start, num_threads, min_grain);
+
+	if (!parallel_for_use_threading(scheduler, stop - start, state.grain)) {
+		func(userdata, accum, start, stop);
+		return;
+	}
+
+	state.userdata = userdata;
+	state.func = NULL;
+	state.func_reduce = func;
+	state.accum_stride = (accum_size + PARALLEL_ACCUM_ALIGN - 1) & ~(size_t)(PARALLEL_ACCUM_ALIGN - 1);
+	state.accum_array = MALLOCA(state.accum_stride * (size_t)num_threads);
+
+	for (int i = 0; i < num_threads; i++) {
+		memcpy(state.accum_array + state.accum_stride * (size_t)i, accum, accum_size);
+	}
+
+	task_parallel_for_ex(scheduler, &state, start, stop);
+
+	for (int i = 0; i < num_threads; i++) {
+		join(userdata, accum, state.accum_array + state.accum_stride * (size_t)i);
+	}
+
+	MALLOCA_FREE(state.accum_array, state.accum_stride * (size_t)num_threads);
+}
+
+typedef struct ParallelScanState {
+	void *userdata;
+	TaskParallelScanFunc func;
+
+	char *accum_array;
+	size_t accum_stride;
+
+	int start, len, num_blocks;
+	bool is_final;
+} ParallelScanState;
+
+static void parallel_scan_func(TaskPool * __restrict pool, void *taskdata, int UNUSED(thread_id))
+{
+	ParallelScanState *state = BLI_task_pool_userdata(pool);
+	const int block = GET_INT_FROM_POINTER(taskdata);
+	/* 64 bits to avoid overflows with big ranges. */
+	const int block_start = state->start + (int)(((int64_t)state->len * block) / state->num_blocks);
+	const int block_stop = state->start + (int)(((int64_t)state->len * (block + 1)) / state->num_blocks);
+
+	state->func(state->userdata, state->accum_array + state->accum_stride * (size_t)block,
+	            block_start, block_stop, state->is_final);
+}
+
+static void parallel_scan_pass(TaskScheduler *scheduler, ParallelScanState *state, const bool is_final)
+{
+	TaskPool *pool = BLI_task_pool_create(scheduler, state);
+
+	state->is_final = is_final;
+	for (int i = 0; i < state->num_blocks; i++) {
+		BLI_task_pool_push_from_thread(pool, parallel_scan_func, SET_INT_IN_POINTER(i), false,
+		                               TASK_PRIORITY_HIGH, pool->thread_id);
+	}
+
+	BLI_task_pool_work_and_wait(pool);
+	BLI_task_pool_free(pool);
+}
+
+/**
+ * Parallel scan (prefix sum and the like), done in two passes over fixed blocks of the range.
+ * The first one only accumulates each block, then accumulators are scanned from the calling thread,
+ * and the second pass runs every block again starting from the accumulated value of the blocks before it.
+ *
+ * \param accum Accumulator, of \a accum_size bytes, holding the identity value of the scan
+ * (e.g. zero for a sum), and the total once done.
+ * \param func Callback function accumulating a sub-range into the given accumulator,
+ * it must also write the output when \a is_final is set.
+ * Single-threaded case only calls it once for the whole range, with \a is_final set.
+ * \param join Callback function joining the second accumulator into the first one.
+ * \param min_grain See #BLI_task_parallel_for.
+ */
+void BLI_task_parallel_scan(
+        int start, int stop,
+        void *userdata,
+        void *accum,
+        const size_t accum_size,
+        TaskParallelScanFunc func,
+        TaskParallelJoinFunc join,
+        const int min_grain)
+{
+	TaskScheduler *scheduler;
+	ParallelScanState state;
+	void *accum_block;
+	int num_threads, grain;
+
+	if (start >= stop) {
+		return;
+	}
+
+	scheduler = BLI_task_scheduler_get();
+	num_threads = BLI_task_scheduler_num_threads(scheduler);
+	grain = parallel_for_grain(stop - start, num_threads, min_grain);
+
+	if (!parallel_for_use_threading(scheduler, stop - start, grain)) {
+		func(userdata, accum, start, stop, true);
+		return;
+	}
+
+	state.userdata = userdata;
+	state.func = func;
+	state.start = start;
+	state.len = stop - start;
+	state.num_blocks = min_ii(num_threads * PARALLEL_SCAN_BLOCKS_PER_THREAD, state.len / grain);
+	state.num_blocks = max_ii(state.num_blocks, 2);
+	state.accum_stride = (accum_size + PARALLEL_ACCUM_ALIGN - 1) & ~(size_t)(PARALLEL_ACCUM_ALIGN - 1);
+	state.accum_array = MALLOCA(state.accum_stride * (size_t)state.num_blocks);
+	accum_block = MALLOCA(accum_size);
+
+	for (int i = 0; i < state.num_blocks; i++) {
+		memcpy(state.accum_array + state.accum_stride * (size_t)i, accum, accum_size);
+	}
+
+	parallel_scan_pass(scheduler, &state, false);
+
+	/* Exclusive scan of the block accumulators, accum ends up with the total. */
+	for (int i = 0; i < state.num_blocks; i++) {
+		char *accum_i = state.accum_array + state.accum_stride * (size_t)i;
+		memcpy(accum_block, accum_i, accum_size);
+		memcpy(accum_i, accum, accum_size);
+		join(userdata, accum, accum_block);
+	}
+
+	parallel_scan_pass(scheduler, &state, true);
+
+	MALLOCA_FREE(accum_block, accum_size);
+	MALLOCA_FREE(state.accum_array, state.accum_stride * (size_t)state.num_blocks);
+}
+
 #undef MALLOCA
 #undef MALLOCA_FREE
 
@@ -77,6 +77,8 @@ typedef enum eBLOReadSkip {
 	BLO_READ_SKIP_NONE          = 0,
 	BLO_READ_SKIP_USERDEF       = (1 << 0),
 	BLO_READ_SKIP_DATA          = (1 << 1),
+	/* Undo only: keep unchanged data-blocks of old main instead of reading them. */
+	BLO_READ_SKIP_UNCHANGED     = (1 << 2),
 } eBLOReadSkip;
 #define BLO_READ_SKIP_ALL \
 	(BLO_READ_SKIP_USERDEF | BLO_READ_SKIP_DATA)
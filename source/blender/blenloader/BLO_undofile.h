@@ -33,10 +33,14 @@
  *  \ingroup blenloader
  */
 
+struct MemFileBuffer;
+
 typedef struct {
 	void *next, *prev;
 	
-	char *buf;
+	/* chunk contents, shared with all chunks of the same contents in all memfiles */
+	struct MemFileBuffer *buffer;
+	/* ident: same contents as the chunk at the same position in the previous memfile */
 	unsigned int ident, size;
 	
 } MemFileChunk;
@@ -46,12 +50,21 @@ typedef struct MemFile {
 	unsigned int size;
 } MemFile;
 
+struct ID;
+
 /* actually only used writefile.c */
 extern void memfile_chunk_add(MemFile *compare, MemFile *current, const char *buf, unsigned int size);
 
+/* actually only used readfile.c, implemented in writefile.c */
+typedef bool (*MemFileCompareFn)(void *userdata, const void *data, int data_len);
+extern bool memfile_id_write_compare(MemFile *memfile, struct ID *id, MemFileCompareFn compare_fn, void *userdata);
+
 /* exports */
 extern void BLO_memfile_free(MemFile *memfile);
 extern void BLO_memfile_merge(MemFile *first, MemFile *second);
+extern const char *BLO_memfile_chunk_data(MemFileChunk *chunk);
+extern void BLO_memfile_compress_cold(MemFile **memfiles_hot, int memfiles_hot_len);
+extern void BLO_memfile_uncompress(MemFile *memfile);
 
 #endif
 
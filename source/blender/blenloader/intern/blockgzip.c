@@ -0,0 +1,529 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ */
+
+/** \file blender/blenloader/intern/blockgzip.c
+ *  \ingroup blenloader
+ *
+ * Multi-threaded reading and writing of block compressed gzip files.
+ *
+ * Blocks are processed in batches of one block per thread. While the tasks
+ * (de)compress one batch, the calling thread fills or consumes the other one,
+ * so file I/O and serialization overlap with the compression.
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "zlib.h"
+
+#ifdef WIN32
+#  include <io.h>
+#  include "BLI_winstuff.h"
+#else
+#  include <unistd.h>
+#endif
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_utildefines.h"
+#include "BLI_fileops.h"
+#include "BLI_task.h"
+#include "BLI_threads.h"
+
+#include "blockgzip.h"
+
+/* Size of uncompressed data in a block. */
+#define BLOCK_SIZE (1 << 20)
+
+/* Gzip member header with FEXTRA flag and a single 'BL' subfield,
+ * which holds total size of the member. */
+#define BLOCK_HEADER_SIZE 20
+#define BLOCK_TRAILER_SIZE 8
+#define BLOCK_XLEN 8
+#define BLOCK_SLEN 4
+
+#define GZIP_FLAG_FEXTRA 4
+#define GZIP_OS_UNKNOWN 255
+
+typedef struct GzipBlock {
+	/* Uncompressed data. */
+	unsigned char *data;
+	unsigned int data_len;
+	/* Compressed gzip member, including header and trailer. */
+	unsigned char *member;
+	unsigned int member_len;
+	unsigned int member_alloc;
+
+	int level;
+	bool error;
+} GzipBlock;
+
+static unsigned int blockgzip_member_max_size(void)
+{
+	return BLOCK_HEADER_SIZE + (unsigned int)compressBound(BLOCK_SIZE) + BLOCK_TRAILER_SIZE;
+}
+
+static void blockgzip_put_uint16(unsigned char *buf, unsigned int value)
+{
+	buf[0] = (unsigned char)(value & 0xff);
+	buf[1] = (unsigned char)((value >> 8) & 0xff);
+}
+
+static void blockgzip_put_uint32(unsigned char *buf, unsigned int value)
+{
+	blockgzip_put_uint16(buf, value & 0xffff);
+	blockgzip_put_uint16(buf + 2, value >> 16);
+}
+
+static unsigned int blockgzip_get_uint16(const unsigned char *buf)
+{
+	return (unsigned int)buf[0] | ((unsigned int)buf[1] << 8);
+}
+
+static unsigned int blockgzip_get_uint32(const unsigned char *buf)
+{
+	return blockgzip_get_uint16(buf) | (blockgzip_get_uint16(buf + 2) << 16);
+}
+
+static void blockgzip_header_write(unsigned char *header, unsigned int member_len)
+{
+	header[0] = 0x1f;
+	header[1] = 0x8b;
+	header[2] = Z_DEFLATED;
+	header[3] = GZIP_FLAG_FEXTRA;
+	blockgzip_put_uint32(header + 4, 0);  /* mtime */
+	header[8] = 0;  /* extra flags */
+	header[9] = GZIP_OS_UNKNOWN;
+	blockgzip_put_uint16(header + 10, BLOCK_XLEN);
+	header[12] = 'B';
+	header[13] = 'L';
+	blockgzip_put_uint16(header + 14, BLOCK_SLEN);
+	blockgzip_put_uint32(header + 16, member_len);
+}
+
+/* \return Total size of the member, or 0 if the header was not written by this module. */
+static unsigned int blockgzip_header_read(const unsigned char *header)
+{
+	if (header[0] != 0x1f || header[1] != 0x8b || header[2] != Z_DEFLATED ||
+	    header[3] != GZIP_FLAG_FEXTRA ||
+	    blockgzip_get_uint16(header + 10) != BLOCK_XLEN ||
+	    header[12] != 'B' || header[13] != 'L' ||
+	    blockgzip_get_uint16(header + 14) != BLOCK_SLEN)
+	{
+		return 0;
+	}
+
+	const unsigned int member_len = blockgzip_get_uint32(header + 16);
+	if (member_len < BLOCK_HEADER_SIZE + BLOCK_TRAILER_SIZE ||
+	    member_len > blockgzip_member_max_size())
+	{
+		return 0;
+	}
+	return member_len;
+}
+
+static void blockgzip_compress_task(TaskPool *__restrict UNUSED(pool), void *taskdata, int UNUSED(threadid))
+{
+	GzipBlock *block = taskdata;
+	z_stream strm = {NULL};
+
+	if (block->member == NULL) {
+		block->member_alloc = blockgzip_member_max_size();
+		block->member = MEM_mallocN(block->member_alloc, "blockgzip member");
+	}
+
+	if (deflateInit2(&strm, block->level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+		block->error = true;
+		return;
+	}
+
+	strm.next_in = block->data;
+	strm.avail_in = block->data_len;
+	strm.next_out = block->member + BLOCK_HEADER_SIZE;
+	strm.avail_out = block->member_alloc - BLOCK_HEADER_SIZE - BLOCK_TRAILER_SIZE;
+
+	const int ret = deflate(&strm, Z_FINISH);
+	deflateEnd(&strm);
+
+	if (ret != Z_STREAM_END) {
+		block->error = true;
+		return;
+	}
+
+	block->member_len = BLOCK_HEADER_SIZE + (unsigned int)strm.total_out + BLOCK_TRAILER_SIZE;
+	blockgzip_header_write(block->member, block->member_len);
+
+	unsigned char *trailer = block->member + block->member_len - BLOCK_TRAILER_SIZE;
+	blockgzip_put_uint32(trailer, (unsigned int)crc32(crc32(0L, Z_NULL, 0), block->data, block->data_len));
+	blockgzip_put_uint32(trailer + 4, block->data_len);
+}
+
+static void blockgzip_decompress_task(TaskPool *__restrict UNUSED(pool), void *taskdata, int UNUSED(threadid))
+{
+	GzipBlock *block = taskdata;
+	const unsigned char *trailer = block->member + block->member_len - BLOCK_TRAILER_SIZE;
+	const unsigned int crc = blockgzip_get_uint32(trailer);
+	const unsigned int data_len = blockgzip_get_uint32(trailer + 4);
+	z_stream strm = {NULL};
+
+	if (data_len > BLOCK_SIZE) {
+		block->error = true;
+		return;
+	}
+
+	if (block->data == NULL) {
+		block->data = MEM_mallocN(BLOCK_SIZE, "blockgzip data");
+	}
+
+	if (inflateInit2(&strm, -MAX_WBITS) != Z_OK) {
+		block->error = true;
+		return;
+	}
+
+	strm.next_in = block->member + BLOCK_HEADER_SIZE;
+	strm.avail_in = block->member_len - BLOCK_HEADER_SIZE - BLOCK_TRAILER_SIZE;
+	strm.next_out = block->data;
+	strm.avail_out = BLOCK_SIZE;
+
+	const int ret = inflate(&strm, Z_FINISH);
+	inflateEnd(&strm);
+
+	if (ret != Z_STREAM_END || strm.total_out != data_len ||
+	    crc32(crc32(0L, Z_NULL, 0), block->data, data_len) != crc)
+	{
+		block->error = true;
+		return;
+	}
+
+	block->data_len = data_len;
+}
+
+static GzipBlock *blockgzip_blocks_new(int *r_batch_size)
+{
+	const int batch_size = MAX2(BLI_task_scheduler_num_threads(BLI_task_scheduler_get()), 1);
+
+	*r_batch_size = batch_size;
+	return MEM_callocN(sizeof(GzipBlock) * 2 * batch_size, "blockgzip blocks");
+}
+
+static void blockgzip_blocks_free(GzipBlock *blocks, int batch_size)
+{
+	for (int i = 0; i < 2 * batch_size; i++) {
+		MEM_SAFE_FREE(blocks[i].data);
+		MEM_SAFE_FREE(blocks[i].member);
+	}
+	MEM_freeN(blocks);
+}
+
+/* -------------------------------------------------------------------- */
+/** \name Writing
+ * \{ */
+
+struct BlockGzipWriter {
+	int file;
+	int level;
+	TaskPool *pool;
+
+	/* Two batches of blocks, one being filled while the other is compressed. */
+	GzipBlock *blocks;
+	int batch_size;
+	int batch_fill, num_filled;
+	int batch_pending, num_pending;
+
+	bool error;
+};
+
+BlockGzipWriter *blo_blockgzip_writer_open(const char *filepath, int level)
+{
+	const int file = BLI_open(filepath, O_BINARY + O_WRONLY + O_CREAT + O_TRUNC, 0666);
+
+	if (file == -1) {
+		return NULL;
+	}
+
+	BlockGzipWriter *writer = MEM_callocN(sizeof(*writer), __func__);
+	writer->file = file;
+	writer->level = CLAMPIS(level, BLOCKGZIP_LEVEL_MIN, BLOCKGZIP_LEVEL_MAX);
+	writer->pool = BLI_task_pool_create(BLI_task_scheduler_get(), NULL);
+	writer->blocks = blockgzip_blocks_new(&writer->batch_size);
+	writer->batch_pending = -1;
+
+	return writer;
+}
+
+static void blockgzip_writer_write_pending(BlockGzipWriter *writer)
+{
+	GzipBlock *batch = &writer->blocks[writer->batch_pending * writer->batch_size];
+
+	for (int i = 0; i < writer->num_pending; i++) {
+		GzipBlock *block = &batch[i];
+		if (block->error) {
+			writer->error = true;
+		}
+		else if (!writer->error &&
+		         write(writer->file, block->member, block->member_len) != (int)block->member_len)
+		{
+			writer->error = true;
+		}
+		block->data_len = 0;
+	}
+
+	writer->batch_pending = -1;
+	writer->num_pending = 0;
+}
+
+/* Write out the previous batch once compressed, and start compressing the one being filled. */
+static void blockgzip_writer_submit(BlockGzipWriter *writer, int num_blocks)
+{
+	BLI_task_pool_work_and_wait(writer->pool);
+
+	if (writer->batch_pending != -1) {
+		blockgzip_writer_write_pending(writer);
+	}
+
+	GzipBlock *batch = &writer->blocks[writer->batch_fill * writer->batch_size];
+	for (int i = 0; i < num_blocks; i++) {
+		batch[i].level = writer->level;
+		batch[i].error = false;
+		BLI_task_pool_push(writer->pool, blockgzip_compress_task, &batch[i], false, TASK_PRIORITY_HIGH);
+	}
+
+	if (num_blocks != 0) {
+		writer->batch_pending = writer->batch_fill;
+		writer->num_pending = num_blocks;
+	}
+
+	writer->batch_fill ^= 1;
+	writer->num_filled = 0;
+}
+
+size_t blo_blockgzip_write(BlockGzipWriter *writer, const void *data, size_t data_len)
+{
+	const unsigned char *src = data;
+	size_t len = data_len;
+
+	while (len != 0 && !writer->error) {
+		GzipBlock *block = &writer->blocks[writer->batch_fill * writer->batch_size + writer->num_filled];
+
+		if (block->data == NULL) {
+			block->data = MEM_mallocN(BLOCK_SIZE, "blockgzip data");
+		}
+
+		const unsigned int copy_len = (unsigned int)MIN2(len, (size_t)(BLOCK_SIZE - block->data_len));
+		memcpy(block->data + block->data_len, src, copy_len);
+		block->data_len += copy_len;
+		src += copy_len;
+		len -= copy_len;
+
+		if (block->data_len == BLOCK_SIZE) {
+			if (++writer->num_filled == writer->batch_size) {
+				blockgzip_writer_submit(writer, writer->num_filled);
+			}
+		}
+	}
+
+	return writer->error ? 0 : data_len;
+}
+
+bool blo_blockgzip_writer_close(BlockGzipWriter *writer)
+{
+	GzipBlock *block = &writer->blocks[writer->batch_fill * writer->batch_size + writer->num_filled];
+	const int num_blocks = writer->num_filled + (block->data_len != 0 ? 1 : 0);
+
+	blockgzip_writer_submit(writer, num_blocks);
+	BLI_task_pool_work_and_wait(writer->pool);
+	if (writer->batch_pending != -1) {
+		blockgzip_writer_write_pending(writer);
+	}
+
+	bool ok = !writer->error;
+	if (close(writer->file) == -1) {
+		ok = false;
+	}
+
+	BLI_task_pool_free(writer->pool);
+	blockgzip_blocks_free(writer->blocks, writer->batch_size);
+	MEM_freeN(writer);
+
+	return ok;
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Reading
+ * \{ */
+
+struct BlockGzipReader {
+	int file;
+	TaskPool *pool;
+
+	/* Two batches of blocks, one being read from while the other is decompressed. */
+	GzipBlock *blocks;
+	int batch_size;
+	int num_blocks[2];
+	int batch_read;
+
+	/* Read position in the current batch. */
+	int block;
+	unsigned int offset;
+
+	bool error;
+};
+
+/* Load compressed blocks of a batch from the file and start decompressing them. */
+static void blockgzip_reader_load(BlockGzipReader *reader, int batch_index)
+{
+	GzipBlock *batch = &reader->blocks[batch_index * reader->batch_size];
+	int num_blocks = 0;
+
+	while (num_blocks < reader->batch_size) {
+		GzipBlock *block = &batch[num_blocks];
+		unsigned char header[BLOCK_HEADER_SIZE];
+		const int header_len = read(reader->file, header, BLOCK_HEADER_SIZE);
+
+		if (header_len == 0) {
+			/* End of file. */
+			break;
+		}
+
+		const unsigned int member_len = (header_len == BLOCK_HEADER_SIZE) ? blockgzip_header_read(header) : 0;
+		if (member_len == 0) {
+			reader->error = true;
+			break;
+		}
+
+		if (block->member_alloc < member_len) {
+			MEM_SAFE_FREE(block->member);
+			block->member_alloc = blockgzip_member_max_size();
+			block->member = MEM_mallocN(block->member_alloc, "blockgzip member");
+		}
+
+		memcpy(block->member, header, BLOCK_HEADER_SIZE);
+		const int body_len = (int)(member_len - BLOCK_HEADER_SIZE);
+		if (read(reader->file, block->member + BLOCK_HEADER_SIZE, body_len) != body_len) {
+			reader->error = true;
+			break;
+		}
+
+		block->member_len = member_len;
+		block->data_len = 0;
+		block->error = false;
+		BLI_task_pool_push(reader->pool, blockgzip_decompress_task, block, false, TASK_PRIORITY_HIGH);
+		num_blocks++;
+	}
+
+	reader->num_blocks[batch_index] = num_blocks;
+}
+
+BlockGzipReader *blo_blockgzip_reader_open(const char *filepath)
+{
+	const int file = BLI_open(filepath, O_BINARY | O_RDONLY, 0);
+
+	if (file == -1) {
+		return NULL;
+	}
+
+	unsigned char header[BLOCK_HEADER_SIZE];
+	if (read(file, header, BLOCK_HEADER_SIZE) != BLOCK_HEADER_SIZE ||
+	    blockgzip_header_read(header) == 0 ||
+	    lseek(file, 0, SEEK_SET) != 0)
+	{
+		close(file);
+		return NULL;
+	}
+
+	BlockGzipReader *reader = MEM_callocN(sizeof(*reader), __func__);
+	reader->file = file;
+	reader->pool = BLI_task_pool_create(BLI_task_scheduler_get(), NULL);
+	reader->blocks = blockgzip_blocks_new(&reader->batch_size);
+
+	blockgzip_reader_load(reader, 0);
+	BLI_task_pool_work_and_wait(reader->pool);
+	if (!reader->error) {
+		blockgzip_reader_load(reader, 1);
+	}
+
+	return reader;
+}
+
+/* Switch to the next batch, and start loading the one after it. */
+static bool blockgzip_reader_next_batch(BlockGzipReader *reader)
+{
+	BLI_task_pool_work_and_wait(reader->pool);
+
+	reader->batch_read ^= 1;
+	reader->block = 0;
+	reader->offset = 0;
+
+	if (reader->num_blocks[reader->batch_read] == 0) {
+		return false;
+	}
+
+	if (!reader->error) {
+		blockgzip_reader_load(reader, reader->batch_read ^ 1);
+	}
+	return true;
+}
+
+int blo_blockgzip_read(BlockGzipReader *reader, void *buffer, unsigned int size)
+{
+	unsigned char *dst = buffer;
+	unsigned int read_len = 0;
+
+	while (read_len < size && !reader->error) {
+		if (reader->block == reader->num_blocks[reader->batch_read]) {
+			if (reader->num_blocks[reader->batch_read] == 0 || !blockgzip_reader_next_batch(reader)) {
+				break;
+			}
+			continue;
+		}
+
+		GzipBlock *block = &reader->blocks[reader->batch_read * reader->batch_size + reader->block];
+		if (block->error) {
+			reader->error = true;
+			break;
+		}
+
+		const unsigned int copy_len = MIN2(size - read_len, block->data_len - reader->offset);
+		memcpy(dst + read_len, block->data + reader->offset, copy_len);
+		read_len += copy_len;
+		reader->offset += copy_len;
+
+		if (reader->offset == block->data_len) {
+			reader->block++;
+			reader->offset = 0;
+		}
+	}
+
+	return reader->error ? EOF : (int)read_len;
+}
+
+void blo_blockgzip_reader_close(BlockGzipReader *reader)
+{
+	BLI_task_pool_work_and_wait(reader->pool);
+	BLI_task_pool_free(reader->pool);
+	close(reader->file);
+	blockgzip_blocks_free(reader->blocks, reader->batch_size);
+	MEM_freeN(reader);
+}
+
+/** \} */
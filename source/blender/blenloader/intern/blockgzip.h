@@ -0,0 +1,56 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ */
+
+/** \file blender/blenloader/intern/blockgzip.h
+ *  \ingroup blenloader
+ */
+
+#ifndef __BLOCKGZIP_H__
+#define __BLOCKGZIP_H__
+
+/* Block compressed gzip files.
+ *
+ * Data is split in blocks of fixed size, each stored as a separate gzip member.
+ * Concatenated members are still a valid gzip stream, so files can be read by
+ * zlib and older versions of Blender. The gzip header of every member holds an
+ * extra field with the compressed size of the member, which allows to find the
+ * blocks without decompressing them, so they can be (de)compressed in parallel.
+ */
+
+typedef struct BlockGzipWriter BlockGzipWriter;
+typedef struct BlockGzipReader BlockGzipReader;
+
+/* Compression levels, as in zlib. */
+#define BLOCKGZIP_LEVEL_MIN     1
+#define BLOCKGZIP_LEVEL_MAX     9
+#define BLOCKGZIP_LEVEL_DEFAULT 1
+
+BlockGzipWriter *blo_blockgzip_writer_open(const char *filepath, int level);
+size_t blo_blockgzip_write(BlockGzipWriter *writer, const void *data, size_t data_len);
+/* Returns false if writing of any block failed. */
+bool blo_blockgzip_writer_close(BlockGzipWriter *writer);
+
+/* Returns NULL if the file can't be opened or was not written with block compression. */
+BlockGzipReader *blo_blockgzip_reader_open(const char *filepath);
+/* Returns number of bytes read, 0 at end of file or EOF on error. */
+int blo_blockgzip_read(BlockGzipReader *reader, void *buffer, unsigned int size);
+void blo_blockgzip_reader_close(BlockGzipReader *reader);
+
+#endif  /* __BLOCKGZIP_H__ */
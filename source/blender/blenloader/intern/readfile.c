@@ -45,6 +45,14 @@
 #include "BLI_utildefines.h"
 #ifndef WIN32
 #  include <unistd.h> // for read close
+#  include <sys/mman.h> // for mmap
+#  include <sys/stat.h> // for fstat
+#  if defined(__linux__)
+#    include <sys/vfs.h> // for fstatfs
+#  elif defined(__APPLE__) || defined(__FreeBSD__)
+#    include <sys/param.h>
+#    include <sys/mount.h> // for fstatfs
+#  endif
 #else
 #  include <io.h> // for open close read
 #  include "winsock2.h"
@@ -109,6 +117,7 @@
 #include "BLI_math.h"
 #include "BLI_threads.h"
 #include "BLI_mempool.h"
+#include "BLI_ghash.h"
 
 #include "BLT_translation.h"
 
@@ -159,6 +168,7 @@
 #include "RE_engine.h"
 
 #include "readfile.h"
+#include "blockgzip.h"
 
 
 #include <errno.h>
@@ -219,19 +229,30 @@
 /* Use GHash for restoring pointers by name */
 #define USE_GHASH_RESTORE_POINTER
 
+/* Map uncompressed files in memory, so bhead data can be used without copying it.
+ * Windows only has mmap emulation, which is not thread-safe. */
+#ifndef WIN32
+#  define USE_MMAP
+#endif
+
 /***/
 
 typedef struct OldNew {
 	const void *old;
 	void *newp;
 	int nr;
+	int slot;  /* map slot of the entry, used to clear the map */
 } OldNew;
 
 typedef struct OldNewMap {
 	OldNew *entries;
 	int nentries, entriessize;
-	bool sorted;
 	int lasthit;
+
+	/* Open addressing hash table of indices into entries, for lookups
+	 * which don't follow the order data was written in. */
+	int *map;
+	unsigned int map_mask;
 } OldNewMap;
 
 
@@ -274,33 +295,59 @@ static const char *library_parent_filepath(Library *lib)
 	return lib->parent ? lib->parent->filepath : "<direct>";
 }
 
+/* Map has twice the slots of the entries array capacity, so is never more than half full. */
+#define OLDNEWMAP_MAP_SIZE(onm) ((unsigned int)(onm)->entriessize * 2)
+#define OLDNEWMAP_EMPTY -1
+#define OLDNEWMAP_PERTURB_SHIFT 5
+
+/* Iterate over the slots a key may be stored in, see Python's dict for details on probing. */
+#define OLDNEWMAP_ITER_SLOTS(onm, addr, slot) \
+	for (unsigned int _hash = BLI_ghashutil_ptrhash(addr), \
+	                  _perturb = _hash, \
+	                  slot = _hash & (onm)->map_mask; \
+	     ; \
+	     _perturb >>= OLDNEWMAP_PERTURB_SHIFT, \
+	     slot = (5 * slot + 1 + _perturb) & (onm)->map_mask)
+
+static void oldnewmap_map_insert(OldNewMap *onm, const void *addr, int index)
+{
+	OLDNEWMAP_ITER_SLOTS(onm, addr, slot) {
+		const int stored_index = onm->map[slot];
+		/* Duplicate old addresses point to the last inserted entry. */
+		if (stored_index == OLDNEWMAP_EMPTY || onm->entries[stored_index].old == addr) {
+			onm->map[slot] = index;
+			onm->entries[index].slot = (int)slot;
+			return;
+		}
+	}
+}
+
+static void oldnewmap_map_rebuild(OldNewMap *onm)
+{
+	const unsigned int map_size = OLDNEWMAP_MAP_SIZE(onm);
+	int i;
+
+	MEM_SAFE_FREE(onm->map);
+	onm->map = MEM_mallocN(sizeof(*onm->map) * map_size, "OldNewMap.map");
+	onm->map_mask = map_size - 1;
+	memset(onm->map, 0xff, sizeof(*onm->map) * map_size);  /* OLDNEWMAP_EMPTY */
+
+	for (i = 0; i < onm->nentries; i++) {
+		oldnewmap_map_insert(onm, onm->entries[i].old, i);
+	}
+}
+
 static OldNewMap *oldnewmap_new(void) 
 {
 	OldNewMap *onm= MEM_callocN(sizeof(*onm), "OldNewMap");
 	
 	onm->entriessize = 1024;
 	onm->entries = MEM_mallocN(sizeof(*onm->entries)*onm->entriessize, "OldNewMap.entries");
+	oldnewmap_map_rebuild(onm);
 	
 	return onm;
 }
 
-static int verg_oldnewmap(const void *v1, const void *v2)
-{
-	const struct OldNew *x1=v1, *x2=v2;
-	
-	if (x1->old > x2->old) return 1;
-	else if (x1->old < x2->old) return -1;
-	return 0;
-}
-
-
-static void oldnewmap_sort(FileData *fd) 
-{
-	BLI_assert(fd->libmap->sorted == false);
-	qsort(fd->libmap->entries, fd->libmap->nentries, sizeof(OldNew), verg_oldnewmap);
-	fd->libmap->sorted = 1;
-}
-
 /* nr is zero for data, and ID code for libdata */
 static void oldnewmap_insert(OldNewMap *onm, const void *oldaddr, void *newaddr, int nr)
 {
@@ -311,12 +358,14 @@ static void oldnewmap_insert(OldNewMap *onm, const void *oldaddr, void *newaddr,
 	if (UNLIKELY(onm->nentries == onm->entriessize)) {
 		onm->entriessize *= 2;
 		onm->entries = MEM_reallocN(onm->entries, sizeof(*onm->entries) * onm->entriessize);
+		oldnewmap_map_rebuild(onm);
 	}
 
-	entry = &onm->entries[onm->nentries++];
+	entry = &onm->entries[onm->nentries];
 	entry->old = oldaddr;
 	entry->newp = newaddr;
 	entry->nr = nr;
+	oldnewmap_map_insert(onm, oldaddr, onm->nentries++);
 }
 
 void blo_do_versions_oldnewmap_insert(OldNewMap *onm, const void *oldaddr, void *newaddr, int nr)
@@ -325,53 +374,21 @@ void blo_do_versions_oldnewmap_insert(OldNewMap *onm, const void *oldaddr, void
 }
 
 /**
- * Do a full search (no state).
- *
- * \param lasthit: Use as a reference position to avoid a full search
- * from either end of the array, giving more efficient lookups.
+ * Hash lookup (no state).
  *
- * \note This would seem an ideal case for hash or btree lookups.
- * However the data is written in-order, using the \a lasthit will normally avoid calling this function.
- * Creating a btree/hash structure adds overhead for the common-case to optimize the corner-case
- * (since most entries will never be retrieved).
- * So just keep full lookups as a fall-back.
+ * \return Index of the entry, or -1 when not found.
  */
-static int oldnewmap_lookup_entry_full(const OldNewMap *onm, const void *addr, int lasthit)
+static int oldnewmap_lookup_entry_full(const OldNewMap *onm, const void *addr)
 {
-	const int nentries = onm->nentries;
-	const OldNew *entries = onm->entries;
-	int i;
-
-	/* search relative to lasthit where possible */
-	if (lasthit >= 0 && lasthit < nentries) {
-
-		/* search forwards */
-		i = lasthit;
-		while (++i != nentries) {
-			if (entries[i].old == addr) {
-				return i;
-			}
+	OLDNEWMAP_ITER_SLOTS(onm, addr, slot) {
+		const int stored_index = onm->map[slot];
+		if (stored_index == OLDNEWMAP_EMPTY) {
+			return -1;
 		}
-
-		/* search backwards */
-		i = lasthit + 1;
-		while (i--) {
-			if (entries[i].old == addr) {
-				return i;
-			}
+		if (onm->entries[stored_index].old == addr) {
+			return stored_index;
 		}
 	}
-	else {
-		/* search backwards (full) */
-		i = nentries;
-		while (i--) {
-			if (entries[i].old == addr) {
-				return i;
-			}
-		}
-	}
-
-	return -1;
 }
 
 static void *oldnewmap_lookup_and_inc(OldNewMap *onm, const void *addr, bool increase_users)
@@ -380,6 +397,8 @@ static void *oldnewmap_lookup_and_inc(OldNewMap *onm, const void *addr, bool inc
 	
 	if (addr == NULL) return NULL;
 	
+	/* Data is mostly linked in the same order as it was written,
+	 * so the entry after the last one found is checked first. */
 	if (onm->lasthit < onm->nentries-1) {
 		OldNew *entry = &onm->entries[++onm->lasthit];
 		
@@ -390,7 +409,7 @@ static void *oldnewmap_lookup_and_inc(OldNewMap *onm, const void *addr, bool inc
 		}
 	}
 	
-	i = oldnewmap_lookup_entry_full(onm, addr, onm->lasthit);
+	i = oldnewmap_lookup_entry_full(onm, addr);
 	if (i != -1) {
 		OldNew *entry = &onm->entries[i];
 		BLI_assert(entry->old == addr);
@@ -410,28 +429,13 @@ static void *oldnewmap_liblookup(OldNewMap *onm, const void *addr, const void *l
 		return NULL;
 	}
 
-	/* lasthit works fine for non-libdata, linking there is done in same sequence as writing */
-	if (onm->sorted) {
-		const OldNew entry_s = {.old = addr};
-		OldNew *entry = bsearch(&entry_s, onm->entries, onm->nentries, sizeof(OldNew), verg_oldnewmap);
-		if (entry) {
-			ID *id = entry->newp;
-
-			if (id && (!lib || id->lib)) {
-				return id;
-			}
-		}
-	}
-	else {
-		/* note, this can be a bottle neck when loading some files */
-		const int i = oldnewmap_lookup_entry_full(onm, addr, -1);
-		if (i != -1) {
-			OldNew *entry = &onm->entries[i];
-			ID *id = entry->newp;
-			BLI_assert(entry->old == addr);
-			if (id && (!lib || id->lib)) {
-				return id;
-			}
+	const int i = oldnewmap_lookup_entry_full(onm, addr);
+	if (i != -1) {
+		OldNew *entry = &onm->entries[i];
+		ID *id = entry->newp;
+		BLI_assert(entry->old == addr);
+		if (id && (!lib || id->lib)) {
+			return id;
 		}
 	}
 
@@ -453,6 +457,14 @@ static void oldnewmap_free_unused(OldNewMap *onm)
 
 static void oldnewmap_clear(OldNewMap *onm) 
 {
+	int i;
+
+	/* The map keeps its largest size while it's cleared for every ID,
+	 * so only reset the slots that are in use. */
+	for (i = 0; i < onm->nentries; i++) {
+		onm->map[onm->entries[i].slot] = OLDNEWMAP_EMPTY;
+	}
+
 	onm->nentries = 0;
 	onm->lasthit = 0;
 }
@@ -460,6 +472,7 @@ static void oldnewmap_clear(OldNewMap *onm)
 static void oldnewmap_free(OldNewMap *onm) 
 {
 	MEM_freeN(onm->entries);
+	MEM_freeN(onm->map);
 	MEM_freeN(onm);
 }
 
@@ -787,10 +800,31 @@ static BHeadN *get_bhead(FileData *fd)
 			/* bhead now contains the (converted) bhead structure. Now read
 			 * the associated data and put everything in a BHeadN (creative naming !)
 			 */
-			if (!fd->eof) {
+			if (fd->eof) {
+				/* pass */
+			}
+#ifdef USE_MMAP
+			else if (fd->mmap && (fd->flags & (FD_FLAGS_SWITCH_ENDIAN | FD_FLAGS_POINTSIZE_DIFFERS)) == 0) {
+				/* Data is used as-is, so point to it in the mapped file instead of copying. */
+				if ((size_t)bhead.len <= fd->mmap_size - fd->mmap_seek) {
+					new_bhead = MEM_mallocN(sizeof(BHeadN), "new_bhead");
+					new_bhead->next = new_bhead->prev = NULL;
+					new_bhead->mmap_data = fd->mmap + fd->mmap_seek;
+					new_bhead->bhead = bhead;
+
+					fd->mmap_seek += bhead.len;
+					fd->seek += bhead.len;
+				}
+				else {
+					fd->eof = 1;
+				}
+			}
+#endif
+			else {
 				new_bhead = MEM_mallocN(sizeof(BHeadN) + bhead.len, "new_bhead");
 				if (new_bhead) {
 					new_bhead->next = new_bhead->prev = NULL;
+					new_bhead->mmap_data = NULL;
 					new_bhead->bhead = bhead;
 					
 					readsize = fd->read(fd, new_bhead + 1, bhead.len);
@@ -875,7 +909,17 @@ BHead *blo_nextbhead(FileData *fd, BHead *thisblock)
 /* Warning! Caller's responsability to ensure given bhead **is** and ID one! */
 const char *bhead_id_name(const FileData *fd, const BHead *bhead)
 {
-	return (const char *)POINTER_OFFSET(bhead, sizeof(*bhead) + fd->id_name_offs);
+	return (const char *)POINTER_OFFSET(bhead_data((BHead *)bhead), fd->id_name_offs);
+}
+
+void *bhead_data(BHead *bhead)
+{
+	BHeadN *bheadn = (BHeadN *)POINTER_OFFSET(bhead, -offsetof(BHeadN, bhead));
+
+	if (bheadn->mmap_data) {
+		return (void *)bheadn->mmap_data;
+	}
+	return bhead + 1;
 }
 
 static void decode_blender_header(FileData *fd)
@@ -929,7 +973,7 @@ static bool read_file_dna(FileData *fd, const char **r_error_message)
 		if (bhead->code == DNA1) {
 			const bool do_endian_swap = (fd->flags & FD_FLAGS_SWITCH_ENDIAN) != 0;
 			
-			fd->filesdna = DNA_sdna_from_data(&bhead[1], bhead->len, do_endian_swap, true, r_error_message);
+			fd->filesdna = DNA_sdna_from_data(bhead_data(bhead), bhead->len, do_endian_swap, true, r_error_message);
 			if (fd->filesdna) {
 				fd->compflags = DNA_struct_get_compareflags(fd->filesdna, fd->memsdna);
 				/* used to retrieve ID names from (bhead+1) */
@@ -958,7 +1002,7 @@ static int *read_file_thumbnail(FileData *fd)
 	for (bhead = blo_firstbhead(fd); bhead; bhead = blo_nextbhead(fd, bhead)) {
 		if (bhead->code == TEST) {
 			const bool do_endian_swap = (fd->flags & FD_FLAGS_SWITCH_ENDIAN) != 0;
-			int *data = (int *)(bhead + 1);
+			int *data = (int *)bhead_data(bhead);
 
 			if (bhead->len < (2 * sizeof(int))) {
 				break;
@@ -1013,6 +1057,105 @@ static int fd_read_gzip_from_file(FileData *filedata, void *buffer, unsigned int
 	return (readsize);
 }
 
+static int fd_read_blockgzip_from_file(FileData *filedata, void *buffer, unsigned int size)
+{
+	int readsize = blo_blockgzip_read(filedata->blockgzfiledes, buffer, size);
+
+	if (readsize >= 0) {
+		filedata->seek += readsize;
+	}
+
+	return readsize;
+}
+
+#ifdef USE_MMAP
+static int fd_read_from_mmap(FileData *filedata, void *buffer, unsigned int size)
+{
+	/* don't read more bytes then there are available in the file */
+	const size_t readsize = MIN2((size_t)size, filedata->mmap_size - filedata->mmap_seek);
+
+	memcpy(buffer, filedata->mmap + filedata->mmap_seek, readsize);
+	filedata->mmap_seek += readsize;
+	filedata->seek += (int)readsize;
+
+	return (int)readsize;
+}
+
+/* Files on network and FUSE file systems can be changed by other machines
+ * while they are mapped, these are read with read() instead. */
+static bool blo_mmap_file_is_local(int file)
+{
+#if defined(__linux__)
+	struct statfs fs;
+
+	if (fstatfs(file, &fs) != 0) {
+		return false;
+	}
+
+	switch ((unsigned int)fs.f_type) {
+		case 0x6969:      /* NFS_SUPER_MAGIC */
+		case 0x517B:      /* SMB_SUPER_MAGIC */
+		case 0xFF534D42:  /* CIFS_MAGIC_NUMBER */
+		case 0xFE534D42:  /* SMB2_MAGIC_NUMBER */
+		case 0x65735546:  /* FUSE_SUPER_MAGIC */
+		case 0x564C:      /* NCP_SUPER_MAGIC */
+		case 0x6B414653:  /* AFS_FS_MAGIC */
+			return false;
+		default:
+			return true;
+	}
+#elif defined(__APPLE__) || defined(__FreeBSD__)
+	struct statfs fs;
+
+	return (fstatfs(file, &fs) == 0) && (fs.f_flags & MNT_LOCAL);
+#else
+	UNUSED_VARS(file);
+	return true;
+#endif
+}
+
+/* Map an uncompressed blend file in memory, returns NULL for other files.
+ *
+ * The mapping is private (copy-on-write), so changes to the file made while
+ * it is read are not seen as long as the pages were already read. A local
+ * file truncated by another process while it is read still raises SIGBUS
+ * when accessing the missing pages, there is no portable way to prevent this.
+ * Blender itself saves to a temporary file which is then renamed, which keeps
+ * the mapped file intact. */
+static const char *blo_mmap_file(const char *filepath, size_t *r_size)
+{
+	char header[SIZEOFBLENDERHEADER];
+	struct stat st;
+	void *mem = NULL;
+	int file;
+
+	file = BLI_open(filepath, O_BINARY | O_RDONLY, 0);
+	if (file == -1) {
+		return NULL;
+	}
+
+	if (read(file, header, sizeof(header)) == sizeof(header) &&
+	    STREQLEN(header, "BLENDER", 7) &&
+	    fstat(file, &st) == 0 &&
+	    st.st_size > 0 && (uint64_t)st.st_size <= SIZE_MAX &&
+	    blo_mmap_file_is_local(file))
+	{
+		mem = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+		if (mem == MAP_FAILED) {
+			mem = NULL;
+		}
+		else {
+			*r_size = (size_t)st.st_size;
+		}
+	}
+
+	/* The mapping stays valid after closing the file. */
+	close(file);
+
+	return mem;
+}
+#endif
+
 static int fd_read_from_memory(FileData *filedata, void *buffer, unsigned int size)
 {
 	/* don't read more bytes then there are available in the buffer */
@@ -1071,7 +1214,7 @@ static int fd_read_from_memfile(FileData *filedata, void *buffer, unsigned int s
 			if (chunkoffset+readsize > chunk->size)
 				readsize= chunk->size-chunkoffset;
 			
-			memcpy(POINTER_OFFSET(buffer, totread), chunk->buf + chunkoffset, readsize);
+			memcpy(POINTER_OFFSET(buffer, totread), BLO_memfile_chunk_data(chunk) + chunkoffset, readsize);
 			totread += readsize;
 			filedata->seek += readsize;
 			seek += readsize;
@@ -1126,7 +1269,38 @@ static FileData *blo_decode_and_check(FileData *fd, ReportList *reports)
 /* on each new library added, it now checks for the current FileData and expands relativeness */
 FileData *blo_openblenderfile(const char *filepath, ReportList *reports)
 {
+	BlockGzipReader *blockgzfile;
 	gzFile gzfile;
+
+	/* Files compressed in blocks are decompressed in parallel. */
+	blockgzfile = blo_blockgzip_reader_open(filepath);
+	if (blockgzfile != NULL) {
+		FileData *fd = filedata_new();
+		fd->blockgzfiledes = blockgzfile;
+		fd->read = fd_read_blockgzip_from_file;
+
+		BLI_strncpy(fd->relabase, filepath, sizeof(fd->relabase));
+
+		return blo_decode_and_check(fd, reports);
+	}
+
+#ifdef USE_MMAP
+	{
+		size_t mmap_size;
+		const char *mmap_data = blo_mmap_file(filepath, &mmap_size);
+		if (mmap_data != NULL) {
+			FileData *fd = filedata_new();
+			fd->mmap = mmap_data;
+			fd->mmap_size = mmap_size;
+			fd->read = fd_read_from_mmap;
+
+			BLI_strncpy(fd->relabase, filepath, sizeof(fd->relabase));
+
+			return blo_decode_and_check(fd, reports);
+		}
+	}
+#endif
+
 	errno = 0;
 	gzfile = BLI_gzopen(filepath, "rb");
 	
@@ -1176,25 +1350,31 @@ static FileData *blo_openblenderfile_minimal(const char *filepath)
 
 static int fd_read_gzip_from_memory(FileData *filedata, void *buffer, unsigned int size)
 {
-	int err;
+	int err, readsize;
 
 	filedata->strm.next_out = (Bytef *) buffer;
 	filedata->strm.avail_out = size;
 
-	// Inflate another chunk.
-	err = inflate (&filedata->strm, Z_SYNC_FLUSH);
+	while (filedata->strm.avail_out != 0) {
+		// Inflate another chunk.
+		err = inflate (&filedata->strm, Z_SYNC_FLUSH);
 
-	if (err == Z_STREAM_END) {
-		return 0;
-	}
-	else if (err != Z_OK) {
-		printf("fd_read_gzip_from_memory: zlib error\n");
-		return 0;
+		if (err == Z_STREAM_END) {
+			/* Block compressed files consist of multiple gzip members. */
+			if (filedata->strm.avail_in == 0 || inflateReset(&filedata->strm) != Z_OK) {
+				break;
+			}
+		}
+		else if (err != Z_OK) {
+			printf("fd_read_gzip_from_memory: zlib error\n");
+			return 0;
+		}
 	}
 
-	filedata->seek += size;
+	readsize = (int)(size - filedata->strm.avail_out);
+	filedata->seek += readsize;
 
-	return (size);
+	return (readsize);
 }
 
 static int fd_read_gzip_from_memory_init(FileData *fd)
@@ -1253,6 +1433,9 @@ FileData *blo_openblendermemfile(MemFile *memfile, ReportList *reports)
 		FileData *fd = filedata_new();
 		fd->memfile = memfile;
 		
+		/* uncompress all data in parallel upfront, instead of chunk by chunk while reading */
+		BLO_memfile_uncompress(memfile);
+		
 		fd->read = fd_read_from_memfile;
 		fd->flags |= FD_FLAGS_NOT_MY_BUFFER;
 		
@@ -1271,6 +1454,10 @@ void blo_freefiledata(FileData *fd)
 		if (fd->gzfiledes != NULL) {
 			gzclose(fd->gzfiledes);
 		}
+
+		if (fd->blockgzfiledes != NULL) {
+			blo_blockgzip_reader_close(fd->blockgzfiledes);
+		}
 		
 		if (fd->strm.next_in) {
 			if (inflateEnd(&fd->strm) != Z_OK) {
@@ -1286,6 +1473,13 @@ void blo_freefiledata(FileData *fd)
 		// Free all BHeadN data blocks
 		BLI_freelistN(&fd->listbase);
 
+#ifdef USE_MMAP
+		/* after the bheads, which may point into it */
+		if (fd->mmap) {
+			munmap((void *)fd->mmap, fd->mmap_size);
+		}
+#endif
+
 		if (fd->filesdna)
 			DNA_sdna_free(fd->filesdna);
 		if (fd->compflags)
@@ -1303,6 +1497,8 @@ void blo_freefiledata(FileData *fd)
 			oldnewmap_free(fd->soundmap);
 		if (fd->packedmap)
 			oldnewmap_free(fd->packedmap);
+		if (fd->meshmap)
+			oldnewmap_free(fd->meshmap);
 		if (fd->libmap && !(fd->flags & FD_FLAGS_NOT_MY_LIBMAP))
 			oldnewmap_free(fd->libmap);
 		if (fd->bheadmap)
@@ -1541,9 +1737,7 @@ static void change_idid_adr_fd(FileData *fd, const void *old, void *new)
 {
 	int i;
 	
-	/* use a binary search if we have a sorted libmap, for now it's not needed. */
-	BLI_assert(fd->libmap->sorted == false);
-
+	/* lookup is by new address, so the map can't be used here */
 	for (i = 0; i < fd->libmap->nentries; i++) {
 		OldNew *entry = &fd->libmap->entries[i];
 		
@@ -1835,6 +2029,31 @@ void blo_end_packed_pointer_map(FileData *fd, Main *oldmain)
 		lib->packedfile = newpackedadr(fd, lib->packedfile);
 }
 
+/* undo file support: lookup of old main meshes which may be kept as-is, when unchanged */
+void blo_make_mesh_pointer_map(FileData *fd, Main *oldmain)
+{
+	GSet *sculpt_meshes = BLI_gset_ptr_new(__func__);
+	Object *ob;
+	Mesh *me;
+	
+	fd->meshmap = oldnewmap_new();
+	
+	/* sculpt sessions may write back into the mesh when freed with old main */
+	for (ob = oldmain->object.first; ob; ob = ob->id.next) {
+		if (ob->sculpt && ob->type == OB_MESH && ob->data) {
+			BLI_gset_add(sculpt_meshes, ob->data);
+		}
+	}
+	
+	for (me = oldmain->mesh.first; me; me = me->id.next) {
+		if (me->edit_btmesh == NULL && !BLI_gset_haskey(sculpt_meshes, me)) {
+			oldnewmap_insert(fd->meshmap, me, me, 0);
+		}
+	}
+	
+	BLI_gset_free(sculpt_meshes, NULL);
+}
+
 
 /* undo file support: add all library pointers in lookup */
 void blo_add_library_pointer_map(ListBase *old_mainlist, FileData *fd)
@@ -1863,7 +2082,7 @@ static void switch_endian_structs(const struct SDNA *filesdna, BHead *bhead)
 	int blocksize, nblocks;
 	char *data;
 	
-	data = (char *)(bhead+1);
+	data = bhead_data(bhead);
 	blocksize = filesdna->typelens[ filesdna->structs[bhead->SDNAnr][0] ];
 	
 	nblocks = bhead->nr;
@@ -1885,12 +2104,12 @@ static void *read_struct(FileData *fd, BHead *bh, const char *blockname)
 		
 		if (fd->compflags[bh->SDNAnr] != SDNA_CMP_REMOVED) {
 			if (fd->compflags[bh->SDNAnr] == SDNA_CMP_NOT_EQUAL) {
-				temp = DNA_struct_reconstruct(fd->memsdna, fd->filesdna, fd->compflags, bh->SDNAnr, bh->nr, (bh+1));
+				temp = DNA_struct_reconstruct(fd->memsdna, fd->filesdna, fd->compflags, bh->SDNAnr, bh->nr, bhead_data(bh));
 			}
 			else {
 				/* SDNA_CMP_EQUAL */
 				temp = MEM_mallocN(bh->len, blockname);
-				memcpy(temp, (bh+1), bh->len);
+				memcpy(temp, bhead_data(bh), bh->len);
 			}
 		}
 	}
@@ -4360,7 +4579,7 @@ static void direct_link_particlesystems(FileData *fd, ListBase *particles)
 		}
 
 		psys->tree = NULL;
-		psys->bvhtree = NULL;
+		psys->sphgrid = NULL;
 	}
 	return;
 }
@@ -8124,6 +8343,119 @@ static BHead *read_data_into_oldnewmap(FileData *fd, BHead *bhead, const char *a
 	return bhead;
 }
 
+/* Compares data written for an old main ID with the blocks of the memfile being read. */
+typedef struct UndoReuseCompare {
+	FileData *fd;
+	BHead *bhead_id;
+	BHead *bhead;
+	/* position in bhead, including the header itself */
+	size_t offset;
+} UndoReuseCompare;
+
+static bool read_libblock_undo_compare_cb(void *userdata, const void *data, int data_len)
+{
+	UndoReuseCompare *cmp = userdata;
+	const char *cdata = data;
+	
+	while (data_len > 0) {
+		const size_t bhead_size = sizeof(BHead) + (size_t)cmp->bhead->len;
+		const char *bhead_mem;
+		size_t len;
+		
+		if (cmp->offset == bhead_size) {
+			/* only the data of the ID itself follows */
+			cmp->bhead = blo_nextbhead(cmp->fd, cmp->bhead);
+			cmp->offset = 0;
+			if (cmp->bhead == NULL || cmp->bhead->code != DATA) {
+				return false;
+			}
+			continue;
+		}
+		
+		if (cmp->offset < sizeof(BHead)) {
+			bhead_mem = (const char *)cmp->bhead + cmp->offset;
+			len = sizeof(BHead) - cmp->offset;
+		}
+		else if (cmp->bhead == cmp->bhead_id && cmp->offset < sizeof(BHead) + offsetof(ID, name)) {
+			/* ID list pointers change with the neighbors in the list and are not read, ignore them */
+			bhead_mem = NULL;
+			len = sizeof(BHead) + offsetof(ID, name) - cmp->offset;
+		}
+		else {
+			bhead_mem = (const char *)bhead_data(cmp->bhead) + (cmp->offset - sizeof(BHead));
+			len = bhead_size - cmp->offset;
+		}
+		len = MIN2(len, (size_t)data_len);
+		
+		if (bhead_mem && memcmp(bhead_mem, cdata, len) != 0) {
+			return false;
+		}
+		
+		cmp->offset += len;
+		cdata += len;
+		data_len -= (int)len;
+	}
+	
+	return true;
+}
+
+/**
+ * Undo support: when the ID of \a bhead is still in old main and unchanged, move it over to \a main
+ * instead of reading it again, meshes only for now since they hold most of the data.
+ *
+ * \return false when the ID has to be read, otherwise \a r_bhead is the block following the ID and its data.
+ */
+static bool read_libblock_undo_reuse(
+        FileData *fd, Main *main, BHead *bhead, const short tag, ID **r_id, BHead **r_bhead)
+{
+	Main *oldmain = fd->old_mainlist->first;
+	UndoReuseCompare cmp;
+	BHead *bhead_next;
+	ID *id;
+	
+	if (bhead->code != ID_ME || main->curlib != NULL) {
+		return false;
+	}
+	
+	/* is there a mesh at that address in old main, which can be kept */
+	id = oldnewmap_lookup_and_inc(fd->meshmap, bhead->old, true);
+	if (id == NULL) {
+		return false;
+	}
+	
+	/* its current state, written for undo, has to match exactly the data of the step being read */
+	cmp.fd = fd;
+	cmp.bhead_id = bhead;
+	cmp.bhead = bhead;
+	cmp.offset = 0;
+	if (!memfile_id_write_compare(fd->memfile, id, read_libblock_undo_compare_cb, &cmp) ||
+	    cmp.offset != sizeof(BHead) + (size_t)cmp.bhead->len)
+	{
+		return false;
+	}
+	bhead_next = blo_nextbhead(fd, cmp.bhead);
+	if (bhead_next && bhead_next->code == DATA) {
+		return false;
+	}
+	
+	BLI_remlink(&oldmain->mesh, id);
+	BLI_addtail(which_libbase(main, ID_ME), id);
+	oldnewmap_insert(fd->libmap, bhead->old, id, bhead->code);
+	
+	/* ID pointers are the same as in the file, so it is linked like a newly read one */
+	id->tag = tag | LIB_TAG_NEED_LINK;
+	id->lib = main->curlib;
+	id->us = ID_FAKE_USERS(id);
+	id->newid = NULL;
+	
+	if (r_id) {
+		*r_id = id;
+	}
+	
+	*r_bhead = bhead_next;
+	return true;
+}
+
 static BHead *read_libblock(FileData *fd, Main *main, BHead *bhead, const short tag, ID **r_id)
 {
 	/* this routine reads a libblock and its direct data. Use link functions to connect it all
@@ -8200,6 +8532,13 @@ static BHead *read_libblock(FileData *fd, Main *main, BHead *bhead, const short
 		}
 	}
 
+	if (fd->meshmap) {
+		BHead *bhead_next;
+		if (read_libblock_undo_reuse(fd, main, bhead, tag, r_id, &bhead_next)) {
+			return bhead_next;
+		}
+	}
+
 	/* read libblock */
 	id = read_struct(fd, bhead, "lib block");
 
@@ -8505,8 +8844,6 @@ static void do_versions_after_linking(Main *main)
 
 static void lib_link_all(FileData *fd, Main *main)
 {
-	oldnewmap_sort(fd);
-	
 	/* No load UI for undo memfiles */
 	if (fd->memfile == NULL) {
 		lib_link_windowmanager(fd, main);
@@ -61,6 +61,11 @@ typedef struct FileData {
 	// variables needed for reading from file
 	int filedes;
 	gzFile gzfiledes;
+	struct BlockGzipReader *blockgzfiledes;
+
+	// uncompressed file mapped in memory, bhead data may point into it
+	const char *mmap;
+	size_t mmap_size, mmap_seek;
 
 	// now only in use for library appending
 	char relabase[FILE_MAX];
@@ -90,6 +95,7 @@ typedef struct FileData {
 	struct OldNewMap *movieclipmap;
 	struct OldNewMap *soundmap;
 	struct OldNewMap *packedmap;
+	struct OldNewMap *meshmap;
 	
 	struct BHeadSort *bheadmap;
 	int tot_bheadmap;
@@ -109,6 +115,8 @@ typedef struct FileData {
 
 typedef struct BHeadN {
 	struct BHeadN *next, *prev;
+	/* Data in the mapped file, NULL when it directly follows bhead. */
+	const void *mmap_data;
 	struct BHead bhead;
 } BHeadN;
 
@@ -144,6 +152,7 @@ void blo_make_sound_pointer_map(FileData *fd, Main *oldmain);
 void blo_end_sound_pointer_map(FileData *fd, Main *oldmain);
 void blo_make_packed_pointer_map(FileData *fd, Main *oldmain);
 void blo_end_packed_pointer_map(FileData *fd, Main *oldmain);
+void blo_make_mesh_pointer_map(FileData *fd, Main *oldmain);
 void blo_add_library_pointer_map(ListBase *old_mainlist, FileData *fd);
 
 void blo_freefiledata(FileData *fd);
@@ -153,6 +162,7 @@ BHead *blo_nextbhead(FileData *fd, BHead *thisblock);
 BHead *blo_prevbhead(FileData *fd, BHead *thisblock);
 
 const char *bhead_id_name(const FileData *fd, const BHead *bhead);
+void *bhead_data(BHead *bhead);
 
 /* do versions stuff */
 
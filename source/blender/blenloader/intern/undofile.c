@@ -35,24 +35,171 @@
 #include <stdio.h>
 #include <math.h>
 
+#include "zlib.h"
+
 #include "MEM_guardedalloc.h"
 
 #include "DNA_listBase.h"
 
 #include "BLI_blenlib.h"
+#include "BLI_ghash.h"
+#include "BLI_hash_mm2a.h"
+#include "BLI_task.h"
 
 #include "BLO_undofile.h"
 
 /* **************** support for memory-write, for undo buffers *************** */
 
+/* Chunk contents are stored once for all undo steps, buffers are looked up by
+ * their contents, so unchanged data is shared even when it moved in the file.
+ * Buffers which are not used by the most recent steps can be compressed, they
+ * are uncompressed again when an undo step using them is read or written. */
+
+/* Buffers smaller than this are not worth compressing. */
+#define MEMFILE_COMPRESS_MIN_SIZE 1024
+
+typedef struct MemFileBuffer {
+	/* NULL while compressed */
+	char *data;
+	char *data_compressed;
+	unsigned int size, size_compressed;
+	unsigned int hash;
+	/* number of chunks using the buffer */
+	int users;
+	/* compression didn't reduce size, don't try again */
+	bool is_incompressible;
+	/* temporary tag used by compress/uncompress */
+	bool tag;
+} MemFileBuffer;
+
+/* all buffers in use, by contents (buffers are both key and value) */
+static GHash *memfile_buffers = NULL;
+
+static void memfile_buffer_uncompress(MemFileBuffer *buffer)
+{
+	uLongf size = buffer->size;
+	
+	BLI_assert(buffer->data == NULL);
+	
+	buffer->data = MEM_mallocN(buffer->size, "Chunk buffer");
+	if (uncompress((Bytef *)buffer->data, &size,
+	               (const Bytef *)buffer->data_compressed, buffer->size_compressed) != Z_OK ||
+	    size != buffer->size)
+	{
+		/* should never happen, data was compressed by us */
+		BLI_assert(0);
+		memset(buffer->data, 0, buffer->size);
+	}
+	MEM_freeN(buffer->data_compressed);
+	buffer->data_compressed = NULL;
+	buffer->size_compressed = 0;
+}
+
+static void memfile_buffer_compress(MemFileBuffer *buffer)
+{
+	uLongf size_compressed = compressBound(buffer->size);
+	char *data_compressed = MEM_mallocN(size_compressed, "Chunk buffer compressed");
+	
+	/* only keep result when it saves a reasonable amount of memory */
+	if (compress2((Bytef *)data_compressed, &size_compressed,
+	              (const Bytef *)buffer->data, buffer->size, Z_BEST_SPEED) == Z_OK &&
+	    size_compressed < buffer->size - buffer->size / 8)
+	{
+		buffer->data_compressed = MEM_reallocN(data_compressed, size_compressed);
+		buffer->size_compressed = (unsigned int)size_compressed;
+		MEM_freeN(buffer->data);
+		buffer->data = NULL;
+	}
+	else {
+		MEM_freeN(data_compressed);
+		buffer->is_incompressible = true;
+	}
+}
+
+static const char *memfile_buffer_data(MemFileBuffer *buffer)
+{
+	if (buffer->data == NULL) {
+		memfile_buffer_uncompress(buffer);
+	}
+	return buffer->data;
+}
+
+static unsigned int memfile_buffer_hash(const void *key)
+{
+	return ((const MemFileBuffer *)key)->hash;
+}
+
+static bool memfile_buffer_cmp(const void *a, const void *b)
+{
+	MemFileBuffer *buffer_a = (MemFileBuffer *)a;
+	MemFileBuffer *buffer_b = (MemFileBuffer *)b;
+	
+	if (buffer_a == buffer_b) {
+		return false;
+	}
+	if (buffer_a->hash != buffer_b->hash || buffer_a->size != buffer_b->size) {
+		return true;
+	}
+	return memcmp(memfile_buffer_data(buffer_a), memfile_buffer_data(buffer_b), buffer_a->size) != 0;
+}
+
+static MemFileBuffer *memfile_buffer_lookup(const char *buf, unsigned int size, unsigned int hash)
+{
+	MemFileBuffer key = {NULL};
+	
+	if (memfile_buffers == NULL) {
+		return NULL;
+	}
+	
+	key.data = (char *)buf;
+	key.size = size;
+	key.hash = hash;
+	return BLI_ghash_lookup(memfile_buffers, &key);
+}
+
+static MemFileBuffer *memfile_buffer_new(const char *buf, unsigned int size, unsigned int hash)
+{
+	MemFileBuffer *buffer = MEM_callocN(sizeof(MemFileBuffer), "MemFileBuffer");
+	
+	buffer->data = MEM_mallocN(size, "Chunk buffer");
+	memcpy(buffer->data, buf, size);
+	buffer->size = size;
+	buffer->hash = hash;
+	
+	if (memfile_buffers == NULL) {
+		memfile_buffers = BLI_ghash_new(memfile_buffer_hash, memfile_buffer_cmp, __func__);
+	}
+	BLI_ghash_insert(memfile_buffers, buffer, buffer);
+	
+	return buffer;
+}
+
+static void memfile_buffer_release(MemFileBuffer *buffer)
+{
+	BLI_assert(buffer->users > 0);
+	
+	if (--buffer->users > 0) {
+		return;
+	}
+	
+	BLI_ghash_remove(memfile_buffers, buffer, NULL, NULL);
+	if (BLI_ghash_size(memfile_buffers) == 0) {
+		BLI_ghash_free(memfile_buffers, NULL, NULL);
+		memfile_buffers = NULL;
+	}
+	
+	MEM_SAFE_FREE(buffer->data);
+	MEM_SAFE_FREE(buffer->data_compressed);
+	MEM_freeN(buffer);
+}
+
 /* not memfile itself */
 void BLO_memfile_free(MemFile *memfile)
 {
 	MemFileChunk *chunk;
 	
 	while ((chunk = BLI_pophead(&memfile->chunks))) {
-		if (chunk->ident == 0)
-			MEM_freeN(chunk->buf);
+		memfile_buffer_release(chunk->buffer);
 		MEM_freeN(chunk);
 	}
 	memfile->size = 0;
@@ -60,30 +207,104 @@ void BLO_memfile_free(MemFile *memfile)
 
 /* to keep list of memfiles consistent, 'first' is always first in list */
 /* result is that 'first' is being freed */
-void BLO_memfile_merge(MemFile *first, MemFile *second)
+void BLO_memfile_merge(MemFile *first, MemFile *UNUSED(second))
 {
-	MemFileChunk *fc, *sc;
+	/* buffers are reference counted, so 'second' keeps the ones it shares with 'first' */
+	BLO_memfile_free(first);
+}
+
+/* Returns contents of the chunk, uncompressing it when needed. */
+const char *BLO_memfile_chunk_data(MemFileChunk *chunk)
+{
+	return memfile_buffer_data(chunk->buffer);
+}
+
+static void memfile_buffer_compress_cb(void *userdata, const int index)
+{
+	MemFileBuffer **buffers = userdata;
+	memfile_buffer_compress(buffers[index]);
+}
+
+static void memfile_buffer_uncompress_cb(void *userdata, const int index)
+{
+	MemFileBuffer **buffers = userdata;
+	memfile_buffer_uncompress(buffers[index]);
+}
+
+/* Compress all buffers not used by the given memfiles, typically the most recent undo steps. */
+void BLO_memfile_compress_cold(MemFile **memfiles_hot, int memfiles_hot_len)
+{
+	MemFileBuffer **buffers;
+	MemFileChunk *chunk;
+	GHashIterator gh_iter;
+	int buffers_len = 0;
+	int i;
+	
+	if (memfile_buffers == NULL) {
+		return;
+	}
 	
-	fc = first->chunks.first;
-	sc = second->chunks.first;
-	while (fc || sc) {
-		if (fc && sc) {
-			if (sc->ident) {
-				sc->ident = 0;
-				fc->ident = 1;
+	for (i = 0; i < memfiles_hot_len; i++) {
+		if (memfiles_hot[i]) {
+			for (chunk = memfiles_hot[i]->chunks.first; chunk; chunk = chunk->next) {
+				chunk->buffer->tag = true;
 			}
 		}
-		if (fc) fc = fc->next;
-		if (sc) sc = sc->next;
 	}
 	
-	BLO_memfile_free(first);
+	buffers = MEM_mallocN(sizeof(*buffers) * BLI_ghash_size(memfile_buffers), __func__);
+	GHASH_ITER (gh_iter, memfile_buffers) {
+		MemFileBuffer *buffer = BLI_ghashIterator_getValue(&gh_iter);
+		if (!buffer->tag && buffer->data && !buffer->is_incompressible &&
+		    buffer->size >= MEMFILE_COMPRESS_MIN_SIZE)
+		{
+			buffers[buffers_len++] = buffer;
+		}
+		buffer->tag = false;
+	}
+	
+	BLI_task_parallel_range(0, buffers_len, buffers, memfile_buffer_compress_cb, buffers_len > 1);
+	
+	MEM_freeN(buffers);
+}
+
+/* Uncompress all buffers used by memfile, so it can be read without further overhead. */
+void BLO_memfile_uncompress(MemFile *memfile)
+{
+	MemFileBuffer **buffers;
+	MemFileChunk *chunk;
+	int buffers_len = 0;
+	
+	for (chunk = memfile->chunks.first; chunk; chunk = chunk->next) {
+		if (chunk->buffer->data == NULL && !chunk->buffer->tag) {
+			chunk->buffer->tag = true;
+			buffers_len++;
+		}
+	}
+	
+	if (buffers_len == 0) {
+		return;
+	}
+	
+	buffers = MEM_mallocN(sizeof(*buffers) * buffers_len, __func__);
+	buffers_len = 0;
+	for (chunk = memfile->chunks.first; chunk; chunk = chunk->next) {
+		if (chunk->buffer->tag) {
+			chunk->buffer->tag = false;
+			buffers[buffers_len++] = chunk->buffer;
+		}
+	}
+	
+	BLI_task_parallel_range(0, buffers_len, buffers, memfile_buffer_uncompress_cb, buffers_len > 1);
+	
+	MEM_freeN(buffers);
 }
 
 void memfile_chunk_add(MemFile *compare, MemFile *current, const char *buf, unsigned int size)
 {
 	static MemFileChunk *compchunk = NULL;
 	MemFileChunk *curchunk;
+	MemFileBuffer *buffer = NULL;
 	
 	/* this function inits when compare != NULL or when current == NULL  */
 	if (compare) {
@@ -97,26 +318,31 @@ void memfile_chunk_add(MemFile *compare, MemFile *current, const char *buf, unsi
 	
 	curchunk = MEM_mallocN(sizeof(MemFileChunk), "MemFileChunk");
 	curchunk->size = size;
-	curchunk->buf = NULL;
 	curchunk->ident = 0;
 	BLI_addtail(&current->chunks, curchunk);
 	
-	/* we compare compchunk with buf */
+	/* we compare compchunk with buf, the common case of unchanged data */
 	if (compchunk) {
 		if (compchunk->size == curchunk->size) {
-			if (memcmp(compchunk->buf, buf, size) == 0) {
-				curchunk->buf = compchunk->buf;
+			if (memcmp(memfile_buffer_data(compchunk->buffer), buf, size) == 0) {
+				buffer = compchunk->buffer;
 				curchunk->ident = 1;
 			}
 		}
 		compchunk = compchunk->next;
 	}
 	
-	/* not equal... */
-	if (curchunk->buf == NULL) {
-		curchunk->buf = MEM_mallocN(size, "Chunk buffer");
-		memcpy(curchunk->buf, buf, size);
-		current->size += size;
+	/* not equal... look for the same contents anywhere in the undo stack */
+	if (buffer == NULL) {
+		const unsigned int hash = BLI_hash_mm2((const unsigned char *)buf, size, 0);
+		
+		buffer = memfile_buffer_lookup(buf, size, hash);
+		if (buffer == NULL) {
+			buffer = memfile_buffer_new(buf, size, hash);
+			current->size += size;
+		}
 	}
+	
+	buffer->users++;
+	curchunk->buffer = buffer;
 }
-
@@ -154,6 +154,8 @@
 #include "BLI_blenlib.h"
 #include "BLI_linklist.h"
 #include "BLI_mempool.h"
+#include "BLI_task.h"
+#include "BLI_threads.h"
 
 #include "BKE_action.h"
 #include "BKE_blender_version.h"
@@ -184,6 +186,7 @@
 #include "BLO_blend_defs.h"
 
 #include "readfile.h"
+#include "blockgzip.h"
 
 /* for SDNA_TYPE_FROM_STRUCT() macro */
 #include "dna_type_offsets.h"
@@ -215,7 +218,7 @@ struct WriteWrap {
 	/* internal */
 	union {
 		int file_handle;
-		gzFile gz_handle;
+		BlockGzipWriter *gz_handle;
 	} _user_data;
 };
 
@@ -253,11 +256,12 @@ static size_t ww_write_none(WriteWrap *ww, const char *buf, size_t buf_len)
 
 static bool ww_open_zlib(WriteWrap *ww, const char *filepath)
 {
-	gzFile file;
+	BlockGzipWriter *file;
 
-	file = BLI_gzopen(filepath, "wb1");
+	/* Blocks are compressed in parallel, see blockgzip.h. */
+	file = blo_blockgzip_writer_open(filepath, U.file_compress_level);
 
-	if (file != Z_NULL) {
+	if (file != NULL) {
 		FILE_HANDLE(ww) = file;
 		return true;
 	}
@@ -267,11 +271,11 @@ static bool ww_open_zlib(WriteWrap *ww, const char *filepath)
 }
 static bool ww_close_zlib(WriteWrap *ww)
 {
-	return (gzclose(FILE_HANDLE(ww)) == Z_OK);
+	return blo_blockgzip_writer_close(FILE_HANDLE(ww));
 }
 static size_t ww_write_zlib(WriteWrap *ww, const char *buf, size_t buf_len)
 {
-	return gzwrite(FILE_HANDLE(ww), buf, buf_len);
+	return blo_blockgzip_write(FILE_HANDLE(ww), buf, buf_len);
 }
 #undef FILE_HANDLE
 
@@ -303,12 +307,29 @@ static void ww_handle_init(eWriteWrapType ww_type, WriteWrap *r_ww)
 
 
 
+/* Writes of a single ID, done on a worker thread and replayed in order,
+ * see write_id_list(). */
+typedef struct WriteRecord {
+	unsigned char *data;
+	size_t data_len, data_alloc;
+	/* Length of every mywrite() call, so they can be repeated exactly. */
+	int *calls;
+	int calls_len, calls_alloc;
+} WriteRecord;
+
 typedef struct {
 	const struct SDNA *sdna;
 
 	unsigned char *buf;
 	MemFile *compare, *current;
 
+	/* When set, mywrite() only records the data. */
+	WriteRecord *record;
+
+	/* When set, mywrite() only compares the data, see memfile_id_write_compare(). */
+	MemFileCompareFn compare_fn;
+	void *compare_userdata;
+
 	int tot, count;
 	bool error;
 
@@ -362,6 +383,28 @@ static void writedata_free(WriteData *wd)
 	MEM_freeN(wd);
 }
 
+static void writerecord_add(WriteRecord *record, const void *adr, int len)
+{
+	if (record->data_len + (size_t)len > record->data_alloc) {
+		record->data_alloc = MAX2(record->data_alloc * 2, record->data_len + (size_t)len);
+		record->data = MEM_reallocN(record->data, record->data_alloc);
+	}
+	if (record->calls_len == record->calls_alloc) {
+		record->calls_alloc = MAX2(record->calls_alloc * 2, 64);
+		record->calls = MEM_reallocN(record->calls, sizeof(*record->calls) * record->calls_alloc);
+	}
+
+	memcpy(record->data + record->data_len, adr, (size_t)len);
+	record->data_len += (size_t)len;
+	record->calls[record->calls_len++] = len;
+}
+
+static void writerecord_free(WriteRecord *record)
+{
+	MEM_SAFE_FREE(record->data);
+	MEM_SAFE_FREE(record->calls);
+}
+
 /***/
 
 /**
@@ -395,6 +438,19 @@ static void mywrite(WriteData *wd, const void *adr, int len)
 
 	wd->tot += len;
 
+	if (wd->record) {
+		writerecord_add(wd->record, adr, len);
+		return;
+	}
+
+	if (wd->compare_fn) {
+		if (!wd->compare_fn(wd->compare_userdata, adr, len)) {
+			/* no need to look any further */
+			wd->error = true;
+		}
+		return;
+	}
+
 	/* if we have a single big chunk, write existing data in
 	 * buffer and write out big chunk in smaller pieces */
 	if (len > MYWRITE_MAX_CHUNK) {
@@ -3800,6 +3856,228 @@ static void write_thumb(WriteData *wd, const BlendThumbnail *thumb)
 }
 
 /* if MemFile * there's filesave to memory */
+static void write_id(WriteData *wd, ID *id)
+{
+	switch ((ID_Type)GS(id->name)) {
+		case ID_WM:
+			write_windowmanager(wd, (wmWindowManager *)id);
+			break;
+		case ID_SCR:
+			write_screen(wd, (bScreen *)id);
+			break;
+		case ID_MC:
+			write_movieclip(wd, (MovieClip *)id);
+			break;
+		case ID_MSK:
+			write_mask(wd, (Mask *)id);
+			break;
+		case ID_SCE:
+			write_scene(wd, (Scene *)id);
+			break;
+		case ID_CU:
+			write_curve(wd,(Curve *)id);
+			break;
+		case ID_MB:
+			write_mball(wd, (MetaBall *)id);
+			break;
+		case ID_IM:
+			write_image(wd, (Image *)id);
+			break;
+		case ID_CA:
+			write_camera(wd, (Camera *)id);
+			break;
+		case ID_LA:
+			write_lamp(wd, (Lamp *)id);
+			break;
+		case ID_LT:
+			write_lattice(wd, (Lattice *)id);
+			break;
+		case ID_VF:
+			write_vfont(wd, (VFont *)id);
+			break;
+		case ID_KE:
+			write_key(wd, (Key *)id);
+			break;
+		case ID_WO:
+			write_world(wd, (World *)id);
+			break;
+		case ID_TXT:
+			write_text(wd, (Text *)id);
+			break;
+		case ID_SPK:
+			write_speaker(wd, (Speaker *)id);
+			break;
+		case ID_SO:
+			write_sound(wd, (bSound *)id);
+			break;
+		case ID_GR:
+			write_group(wd, (Group *)id);
+			break;
+		case ID_AR:
+			write_armature(wd, (bArmature *)id);
+			break;
+		case ID_AC:
+			write_action(wd, (bAction *)id);
+			break;
+		case ID_OB:
+			write_object(wd, (Object *)id);
+			break;
+		case ID_MA:
+			write_material(wd, (Material *)id);
+			break;
+		case ID_TE:
+			write_texture(wd, (Tex *)id);
+			break;
+		case ID_ME:
+			write_mesh(wd, (Mesh *)id);
+			break;
+		case ID_PA:
+			write_particlesettings(wd, (ParticleSettings *)id);
+			break;
+		case ID_NT:
+			write_nodetree(wd, (bNodeTree *)id);
+			break;
+		case ID_BR:
+			write_brush(wd, (Brush *)id);
+			break;
+		case ID_PAL:
+			write_palette(wd, (Palette *)id);
+			break;
+		case ID_PC:
+			write_paintcurve(wd, (PaintCurve *)id);
+			break;
+		case ID_GD:
+			write_gpencil(wd, (bGPdata *)id);
+			break;
+		case ID_LS:
+			write_linestyle(wd, (FreestyleLineStyle *)id);
+			break;
+		case ID_CF:
+			write_cachefile(wd, (CacheFile *)id);
+			break;
+		case ID_LI:
+			/* Do nothing, handled by write_libraries() - and should never be reached. */
+			BLI_assert(0);
+			break;
+		case ID_IP:
+			/* Do nothing, deprecated. */
+			break;
+		default:
+			/* Should never be reached. */
+			BLI_assert(0);
+			break;
+	}
+}
+
+/**
+ * Write \a id as it would be for undo, but pass the data to \a compare_fn instead of storing it.
+ * Used to find data-blocks which did not change compared to an undo step.
+ *
+ * \return false as soon as \a compare_fn reports a difference.
+ */
+bool memfile_id_write_compare(MemFile *memfile, ID *id, MemFileCompareFn compare_fn, void *userdata)
+{
+	WriteData wd = {NULL};
+
+	wd.sdna = DNA_sdna_current_get();
+	/* Only used to know if this is an undo write, nothing is written to it. */
+	wd.current = memfile;
+	wd.compare_fn = compare_fn;
+	wd.compare_userdata = userdata;
+
+	write_id(&wd, id);
+
+	return !wd.error;
+}
+
+/* Number of IDs recorded at once per thread, bounds memory used by the records. */
+#define WRITE_IDS_PER_THREAD 4
+
+typedef struct WriteIDListData {
+	WriteData *wd;
+	ID **ids;
+	WriteData **id_wds;
+} WriteIDListData;
+
+static void write_id_record_cb(void *userdata, const int index)
+{
+	WriteIDListData *data = userdata;
+	write_id(data->id_wds[index], data->ids[index]);
+}
+
+/**
+ * Write IDs of a list, serializing them in parallel.
+ *
+ * Every ID is written into its own record, which are then passed to mywrite() in the
+ * order of the list, call by call. This gives the exact same output (and chunks for
+ * undo) as writing them one after the other.
+ */
+static void write_id_list(WriteData *wd, ID *id_first)
+{
+	const int num_threads = BLI_task_scheduler_num_threads(BLI_task_scheduler_get());
+	ID *id = id_first;
+
+	if (num_threads < 2 || id == NULL || id->next == NULL) {
+		for (; id; id = id->next) {
+			write_id(wd, id);
+		}
+		return;
+	}
+
+	const int max_ids = num_threads * WRITE_IDS_PER_THREAD;
+	ID **ids = MEM_mallocN(sizeof(*ids) * max_ids, __func__);
+	WriteData **id_wds = MEM_mallocN(sizeof(*id_wds) * max_ids, __func__);
+	WriteRecord *records = MEM_callocN(sizeof(*records) * max_ids, __func__);
+	WriteIDListData data = {wd, ids, id_wds};
+	int i;
+
+	for (i = 0; i < max_ids; i++) {
+		WriteData *id_wd = MEM_callocN(sizeof(*id_wd), __func__);
+		id_wd->sdna = wd->sdna;
+		/* Only used to know if this is an undo write, nothing is written to it. */
+		id_wd->current = wd->current;
+		id_wd->record = &records[i];
+#ifdef USE_BMESH_SAVE_AS_COMPAT
+		id_wd->use_mesh_compat = wd->use_mesh_compat;
+#endif
+		id_wds[i] = id_wd;
+	}
+
+	while (id && !wd->error) {
+		int num_ids = 0;
+		for (; id && num_ids < max_ids; id = id->next) {
+			ids[num_ids++] = id;
+		}
+
+		BLI_task_parallel_range(0, num_ids, &data, write_id_record_cb, true);
+
+		for (i = 0; i < num_ids; i++) {
+			WriteRecord *record = &records[i];
+			const unsigned char *adr = record->data;
+			int call;
+
+			for (call = 0; call < record->calls_len; call++) {
+				mywrite(wd, adr, record->calls[call]);
+				adr += record->calls[call];
+			}
+			if (id_wds[i]->error) {
+				wd->error = true;
+			}
+
+			record->data_len = 0;
+			record->calls_len = 0;
+		}
+	}
+
+	for (i = 0; i < max_ids; i++) {
+		writerecord_free(&records[i]);
+		MEM_freeN(id_wds[i]);
+	}
+	MEM_freeN(records);
+	MEM_freeN(id_wds);
+	MEM_freeN(ids);
+}
+
 static bool write_file_handle(
         Main *mainvar,
         WriteWrap *ww,
@@ -3851,117 +4129,7 @@ static bool write_file_handle(
 			continue;  /* Libraries are handled separately below. */
 		}
 
-		for (; id; id = id->next) {
-			switch ((ID_Type)GS(id->name)) {
-				case ID_WM:
-					write_windowmanager(wd, (wmWindowManager *)id);
-					break;
-				case ID_SCR:
-					write_screen(wd, (bScreen *)id);
-					break;
-				case ID_MC:
-					write_movieclip(wd, (MovieClip *)id);
-					break;
-				case ID_MSK:
-					write_mask(wd, (Mask *)id);
-					break;
-				case ID_SCE:
-					write_scene(wd, (Scene *)id);
-					break;
-				case ID_CU:
-					write_curve(wd,(Curve *)id);
-					break;
-				case ID_MB:
-					write_mball(wd, (MetaBall *)id);
-					break;
-				case ID_IM:
-					write_image(wd, (Image *)id);
-					break;
-				case ID_CA:
-					write_camera(wd, (Camera *)id);
-					break;
-				case ID_LA:
-					write_lamp(wd, (Lamp *)id);
-					break;
-				case ID_LT:
-					write_lattice(wd, (Lattice *)id);
-					break;
-				case ID_VF:
-					write_vfont(wd, (VFont *)id);
-					break;
-				case ID_KE:
-					write_key(wd, (Key *)id);
-					break;
-				case ID_WO:
-					write_world(wd, (World *)id);
-					break;
-				case ID_TXT:
-					write_text(wd, (Text *)id);
-					break;
-				case ID_SPK:
-					write_speaker(wd, (Speaker *)id);
-					break;
-				case ID_SO:
-					write_sound(wd, (bSound *)id);
-					break;
-				case ID_GR:
-					write_group(wd, (Group *)id);
-					break;
-				case ID_AR:
-					write_armature(wd, (bArmature *)id);
-					break;
-				case ID_AC:
-					write_action(wd, (bAction *)id);
-					break;
-				case ID_OB:
-					write_object(wd, (Object *)id);
-					break;
-				case ID_MA:
-					write_material(wd, (Material *)id);
-					break;
-				case ID_TE:
-					write_texture(wd, (Tex *)id);
-					break;
-				case ID_ME:
-					write_mesh(wd, (Mesh *)id);
-					break;
-				case ID_PA:
-					write_particlesettings(wd, (ParticleSettings *)id);
-					break;
-				case ID_NT:
-					write_nodetree(wd, (bNodeTree *)id);
-					break;
-				case ID_BR:
-					write_brush(wd, (Brush *)id);
-					break;
-				case ID_PAL:
-					write_palette(wd, (Palette *)id);
-					break;
-				case ID_PC:
-					write_paintcurve(wd, (PaintCurve *)id);
-					break;
-				case ID_GD:
-					write_gpencil(wd, (bGPdata *)id);
-					break;
-				case ID_LS:
-					write_linestyle(wd, (FreestyleLineStyle *)id);
-					break;
-				case ID_CF:
-					write_cachefile(wd, (CacheFile *)id);
-					break;
-				case ID_LI:
-					/* Do nothing, handled below - and should never be reached. */
-					BLI_assert(0);
-					break;
-				case ID_IP:
-					/* Do nothing, deprecated. */
-					break;
-				default:
-					/* Should never be reached. */
-					BLI_assert(0);
-					break;
-			}
-		}
+		write_id_list(wd, id);
 
 		mywrite_flush(wd);
 	}
@@ -87,6 +87,19 @@ void DEG_stats_simple(const struct Depsgraph *graph,
 
 void DEG_debug_graphviz(const struct Depsgraph *graph, FILE *stream, const char *label, bool show_eval);
 
+/* ************************************************ */
+/* Evaluation Profiling */
+
+/* Timings are only collected when G_DEBUG_DEPSGRAPH_PROFILE is enabled,
+ * reports describe the last evaluation of the graph.
+ */
+
+/* Print timings aggregated per ID and component, and the critical path. */
+void DEG_debug_profile_report(struct Depsgraph *graph, FILE *stream);
+
+/* Write timings in the Chrome Trace Event (JSON) format. */
+void DEG_debug_profile_chrome_trace(const struct Depsgraph *graph, FILE *stream);
+
 /* ************************************************ */
 
 /* Compare two dependency graphs. */
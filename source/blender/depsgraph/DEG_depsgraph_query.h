@@ -47,6 +47,13 @@ bool DEG_id_type_tagged(struct Main *bmain, short idtype);
 /* Get additional evaluation flags for the given ID. */
 short DEG_get_eval_flags_for_id(struct Depsgraph *graph, struct ID *id);
 
+/* Check whether evaluated state of the given ID at some frame only depends on
+ * that frame, and not on the state left by evaluation of previous frames
+ * (simulations, point caches). Such IDs can be evaluated for any frame in any
+ * order, for example from multiple threads when exporting caches.
+ */
+bool DEG_id_is_frame_independent(struct Depsgraph *graph, struct ID *id);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
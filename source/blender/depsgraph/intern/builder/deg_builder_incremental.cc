@@ -0,0 +1,500 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The Original Code is Copyright (C) 2016 Blender Foundation.
+ * All rights reserved.
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ */
+
+/** \file blender/depsgraph/intern/builder/deg_builder_incremental.cc
+ *  \ingroup depsgraph
+ *
+ * Incremental update of the graph relations.
+ *
+ * Instead of rebuilding the whole graph when relations of some objects are
+ * changed, nodes of those objects are removed together with all the relations
+ * they are involved in, and are built again. Relations between the rebuilt
+ * objects and the rest of the graph are restored by running relation builder
+ * for the objects which were connected to them, with a filter which only lets
+ * relations to the rebuilt objects through.
+ */
+
+#include "intern/builder/deg_builder_incremental.h"
+
+#include <utility>
+
+#include "MEM_guardedalloc.h"
+
+extern "C" {
+#include "DNA_modifier_types.h"
+#include "DNA_object_types.h"
+#include "DNA_object_force.h"
+#include "DNA_scene_types.h"
+
+#include "BLI_utildefines.h"
+#include "BLI_ghash.h"
+
+#include "BKE_main.h"
+#include "BKE_modifier.h"
+} /* extern "C" */
+
+#include "intern/builder/deg_builder.h"
+#include "intern/builder/deg_builder_cycle.h"
+#include "intern/builder/deg_builder_nodes.h"
+#include "intern/builder/deg_builder_relations.h"
+#include "intern/builder/deg_builder_transitive.h"
+
+#include "intern/nodes/deg_node.h"
+#include "intern/nodes/deg_node_component.h"
+#include "intern/nodes/deg_node_operation.h"
+
+#include "intern/depsgraph.h"
+#include "intern/depsgraph_types.h"
+#include "util/deg_util_foreach.h"
+
+namespace DEG {
+
+/* Updating more than this part of the graph is not worth it, building the
+ * graph from scratch is faster.
+ */
+#define INCREMENTAL_MAX_IDS_FACTOR 4
+
+enum {
+	NODE_UPSTREAM = 1,
+	NODE_DOWNSTREAM = 2,
+};
+
+typedef std::pair<Scene *, Base *> SceneBase;
+
+/* Other objects might depend on these ones without referencing them, such
+ * relations are only created when building the dependent objects, which are
+ * not known here.
+ */
+static bool deg_object_needs_full_rebuild(Object *ob)
+{
+	if (ob->pd != NULL && ob->pd->forcefield != 0) {
+		return true;
+	}
+	if (ob->rigidbody_object != NULL || ob->rigidbody_constraint != NULL) {
+		return true;
+	}
+	if (modifiers_findByType(ob, eModifierType_Collision) != NULL ||
+	    modifiers_findByType(ob, eModifierType_Smoke) != NULL ||
+	    modifiers_findByType(ob, eModifierType_DynamicPaint) != NULL)
+	{
+		return true;
+	}
+	return false;
+}
+
+/* Relations of non-object IDs are built by the objects which use them. IDs
+ * which are built from the scene level can not be handled incrementally.
+ */
+static bool deg_id_is_built_by_objects(const Scene *scene, const ID *id)
+{
+	if (id == (const ID *)scene->nodetree) {
+		return false;
+	}
+	switch (GS(id->name)) {
+		case ID_ME:
+		case ID_CU:
+		case ID_MB:
+		case ID_LT:
+		case ID_AR:
+		case ID_KE:
+		case ID_LA:
+		case ID_CA:
+		case ID_MA:
+		case ID_TE:
+		case ID_NT:
+			return true;
+		default:
+			return false;
+	}
+}
+
+static ID *deg_node_owner_id(DepsNode *node)
+{
+	if (node->type != DEPSNODE_TYPE_OPERATION) {
+		/* Time source, relations from it are always built by the target. */
+		return NULL;
+	}
+	return ((OperationDepsNode *)node)->owner->owner->id;
+}
+
+/* Collect objects which builders created relations to the given IDs.
+ * Non-object IDs on the way are crossed, since their relations are built
+ * from the objects which use them.
+ */
+static bool deg_collect_dependent_objects(const Scene *scene,
+                                          Depsgraph *graph,
+                                          GSet *ids,
+                                          GSet *r_objects)
+{
+	GSet *visited = BLI_gset_ptr_new(__func__);
+	vector<ID *> queue;
+	GSET_FOREACH_BEGIN(ID *, id, ids)
+	{
+		BLI_gset_add(visited, id);
+		queue.push_back(id);
+	}
+	GSET_FOREACH_END();
+
+	bool ok = true;
+	for (size_t i = 0; i < queue.size() && ok; ++i) {
+		IDDepsNode *id_node = graph->find_id_node(queue[i]);
+		if (id_node == NULL) {
+			continue;
+		}
+		GHASH_FOREACH_BEGIN(ComponentDepsNode *, comp_node, id_node->components)
+		{
+			foreach (OperationDepsNode *op_node, comp_node->operations) {
+				for (int j = 0; j < 2; ++j) {
+					const DepsNode::Relations &relations =
+					        (j == 0) ? op_node->inlinks : op_node->outlinks;
+					foreach (DepsRelation *rel, relations) {
+						ID *id = deg_node_owner_id((j == 0) ? rel->from : rel->to);
+						if (id == NULL || !BLI_gset_add(visited, id)) {
+							continue;
+						}
+						if (GS(id->name) == ID_OB) {
+							BLI_gset_add(r_objects, id);
+						}
+						else if (deg_id_is_built_by_objects(scene, id)) {
+							queue.push_back(id);
+						}
+						else {
+							ok = false;
+						}
+					}
+				}
+			}
+		}
+		GHASH_FOREACH_END();
+	}
+	BLI_gset_free(visited, NULL);
+	return ok;
+}
+
+/* Tag nodes from which given node can be reached, or which can be reached
+ * from it.
+ */
+static void deg_tag_reachable_nodes(OperationDepsNode *node, int flag)
+{
+	vector<OperationDepsNode *> stack;
+	stack.push_back(node);
+	while (!stack.empty()) {
+		OperationDepsNode *current = stack.back();
+		stack.pop_back();
+		const DepsNode::Relations &relations = (flag == NODE_UPSTREAM)
+		        ? current->inlinks
+		        : current->outlinks;
+		foreach (DepsRelation *rel, relations) {
+			DepsNode *other = (flag == NODE_UPSTREAM) ? rel->from : rel->to;
+			if (other->type != DEPSNODE_TYPE_OPERATION ||
+			    (rel->flag & DEPSREL_FLAG_CYCLIC) != 0 ||
+			    (other->done & flag) != 0)
+			{
+				continue;
+			}
+			other->done |= flag;
+			stack.push_back((OperationDepsNode *)other);
+		}
+	}
+}
+
+/* Relations which were redundant because of a path through the removed
+ * nodes are needed again. Their targets are to be reduced again.
+ */
+static void deg_restore_transitive_relations(Depsgraph *graph,
+                                             GSet *removed_ids,
+                                             const vector<OperationDepsNode *> &removed,
+                                             vector<OperationDepsNode *> *r_targets)
+{
+	foreach (OperationDepsNode *node, graph->operations) {
+		node->done = 0;
+	}
+	foreach (OperationDepsNode *node, removed) {
+		deg_tag_reachable_nodes(node, NODE_UPSTREAM);
+		deg_tag_reachable_nodes(node, NODE_DOWNSTREAM);
+	}
+	foreach (OperationDepsNode *node, graph->operations) {
+		if ((node->done & NODE_DOWNSTREAM) == 0 ||
+		    BLI_gset_haskey(removed_ids, deg_node_owner_id(node)))
+		{
+			continue;
+		}
+		bool restored = false;
+		foreach (DepsRelation *rel, node->inlinks) {
+			if ((rel->flag & DEPSREL_FLAG_TRANSITIVE) &&
+			    rel->from->type == DEPSNODE_TYPE_OPERATION &&
+			    (rel->from->done & NODE_UPSTREAM))
+			{
+				rel->flag &= ~DEPSREL_FLAG_TRANSITIVE;
+				restored = true;
+			}
+		}
+		if (restored) {
+			r_targets->push_back(node);
+		}
+	}
+}
+
+static void deg_unlink_node_relations(DepsNode *node)
+{
+	/* Copy, since unlinking modifies the lists. */
+	DepsNode::Relations relations = node->inlinks;
+	relations.insert(relations.end(), node->outlinks.begin(), node->outlinks.end());
+	foreach (DepsRelation *rel, relations) {
+		rel->unlink();
+		OBJECT_GUARDED_DELETE(rel, DepsRelation);
+	}
+}
+
+/* Remove node of the given ID together with all the relations it is
+ * involved in.
+ */
+static void deg_remove_id_subgraph(Depsgraph *graph,
+                                   IDDepsNode *id_node,
+                                   GSet *removed_operations)
+{
+	GHASH_FOREACH_BEGIN(ComponentDepsNode *, comp_node, id_node->components)
+	{
+		foreach (OperationDepsNode *op_node, comp_node->operations) {
+			deg_unlink_node_relations(op_node);
+			BLI_gset_remove(graph->entry_tags, op_node, NULL);
+			BLI_gset_add(removed_operations, op_node);
+		}
+		deg_unlink_node_relations(comp_node);
+	}
+	GHASH_FOREACH_END();
+	graph->remove_id_node(id_node->id);
+}
+
+static void deg_remove_operations(Depsgraph *graph, GSet *removed_operations)
+{
+	size_t num_operations = 0;
+	for (size_t i = 0; i < graph->operations.size(); ++i) {
+		OperationDepsNode *op_node = graph->operations[i];
+		if (!BLI_gset_haskey(removed_operations, op_node)) {
+			graph->operations[num_operations++] = op_node;
+		}
+	}
+	graph->operations.resize(num_operations);
+}
+
+bool deg_graph_build_incremental(Depsgraph *graph,
+                                 Main *bmain,
+                                 Scene *scene,
+                                 bool use_transitive_reduction)
+{
+	GSet *tagged_ids = graph->id_relations_tags;
+	if (graph->root_node == NULL) {
+		return false;
+	}
+
+	/* Only objects are rebuilt. Walking the main database also makes sure
+	 * none of the tagged IDs was freed since it was tagged.
+	 */
+	vector<Object *> objects;
+	LINKLIST_FOREACH (Object *, ob, &bmain->object) {
+		if (BLI_gset_haskey(tagged_ids, ob)) {
+			if (deg_object_needs_full_rebuild(ob)) {
+				return false;
+			}
+			objects.push_back(ob);
+		}
+	}
+	if (objects.size() != (size_t)BLI_gset_size(tagged_ids)) {
+		return false;
+	}
+
+	/* Objects which builders created relations to the tagged ones. */
+	GSet *dependent_objects = BLI_gset_ptr_new(__func__);
+	if (!deg_collect_dependent_objects(scene, graph, tagged_ids, dependent_objects) ||
+	    (objects.size() + BLI_gset_size(dependent_objects)) * INCREMENTAL_MAX_IDS_FACTOR >
+	    (size_t)BLI_ghash_size(graph->id_hash))
+	{
+		BLI_gset_free(dependent_objects, NULL);
+		return false;
+	}
+
+	/* Bases of the tagged objects, including the ones from set scenes. */
+	vector<SceneBase> bases;
+	for (Scene *sce = scene; sce != NULL; sce = sce->set) {
+		LINKLIST_FOREACH (Base *, base, &sce->base) {
+			if (BLI_gset_haskey(tagged_ids, base->object)) {
+				bases.push_back(SceneBase(sce, base));
+			}
+		}
+	}
+
+	/* 1) Remove nodes of the tagged objects. Objects which are not in the
+	 *    scene anymore, but which other objects still depend on are built
+	 *    again later on.
+	 */
+	vector<Object *> used_objects;
+	vector<OperationDepsNode *> removed;
+	GSet *removed_operations = BLI_gset_ptr_new(__func__);
+	foreach (Object *ob, objects) {
+		IDDepsNode *id_node = graph->find_id_node(&ob->id);
+		if (id_node == NULL) {
+			continue;
+		}
+		bool is_used = false;
+		GHASH_FOREACH_BEGIN(ComponentDepsNode *, comp_node, id_node->components)
+		{
+			foreach (OperationDepsNode *op_node, comp_node->operations) {
+				foreach (DepsRelation *rel, op_node->outlinks) {
+					if (deg_node_owner_id(rel->to) != &ob->id) {
+						is_used = true;
+					}
+				}
+				removed.push_back(op_node);
+			}
+		}
+		GHASH_FOREACH_END();
+		if (is_used) {
+			used_objects.push_back(ob);
+		}
+	}
+	vector<OperationDepsNode *> reduction_targets;
+	if (use_transitive_reduction) {
+		deg_restore_transitive_relations(graph, tagged_ids, removed, &reduction_targets);
+	}
+	foreach (Object *ob, objects) {
+		IDDepsNode *id_node = graph->find_id_node(&ob->id);
+		if (id_node != NULL) {
+			deg_remove_id_subgraph(graph, id_node, removed_operations);
+		}
+	}
+	deg_remove_operations(graph, removed_operations);
+	BLI_gset_free(removed_operations, NULL);
+
+	/* Remember IDs which are already in the graph, to know which ones were
+	 * added by the node builder.
+	 */
+	GSet *existing_ids = BLI_gset_ptr_new(__func__);
+	GHASH_FOREACH_BEGIN(IDDepsNode *, id_node, graph->id_hash)
+	{
+		BLI_gset_insert(existing_ids, id_node->id);
+	}
+	GHASH_FOREACH_END();
+	const size_t num_operations = graph->operations.size();
+
+	/* 2) Build nodes of the tagged objects, nodes of all other IDs are kept. */
+	DepsgraphNodeBuilder node_builder(bmain, graph);
+	node_builder.begin_build(bmain);
+	GSET_FOREACH_BEGIN(ID *, id, existing_ids)
+	{
+		id->tag |= LIB_TAG_DOIT;
+	}
+	GSET_FOREACH_END();
+	foreach (const SceneBase &scene_base, bases) {
+		node_builder.build_object(scene_base.first,
+		                          scene_base.second,
+		                          scene_base.second->object);
+	}
+	foreach (Object *ob, used_objects) {
+		node_builder.build_object(scene, NULL, ob);
+	}
+
+	/* IDs which relations are to be built: the tagged objects and all IDs
+	 * which were added to the graph together with them.
+	 */
+	GSet *filter_ids = BLI_gset_ptr_new(__func__);
+	vector<Object *> new_objects;
+	GHASH_FOREACH_BEGIN(IDDepsNode *, id_node, graph->id_hash)
+	{
+		ID *id = id_node->id;
+		if (!BLI_gset_haskey(existing_ids, id)) {
+			BLI_gset_insert(filter_ids, id);
+			if (GS(id->name) == ID_OB) {
+				new_objects.push_back((Object *)id);
+			}
+		}
+	}
+	GHASH_FOREACH_END();
+
+	/* 3) Build relations. Only relations of the rebuilt IDs pass the filter,
+	 *    relations between all other IDs are still in the graph.
+	 *
+	 * NOTE: Non-object IDs are not tagged, so builders of the objects which
+	 * use them walk into them again.
+	 */
+	DepsgraphRelationBuilder relation_builder(graph);
+	relation_builder.begin_build(bmain);
+	relation_builder.set_filter_ids(filter_ids);
+	GSET_FOREACH_BEGIN(ID *, id, existing_ids)
+	{
+		if (GS(id->name) == ID_OB && !BLI_gset_haskey(dependent_objects, id)) {
+			id->tag |= LIB_TAG_DOIT;
+		}
+	}
+	GSET_FOREACH_END();
+	foreach (const SceneBase &scene_base, bases) {
+		relation_builder.build_object(bmain,
+		                              scene_base.first,
+		                              scene_base.second->object);
+	}
+	foreach (Object *ob, new_objects) {
+		relation_builder.build_object(bmain, scene, ob);
+	}
+	GSET_FOREACH_BEGIN(Object *, ob, dependent_objects)
+	{
+		relation_builder.build_object(bmain, scene, ob);
+	}
+	GSET_FOREACH_END();
+
+	/* Custom data mask is accumulated from all the operations of an object. */
+	for (size_t i = num_operations; i < graph->operations.size(); ++i) {
+		OperationDepsNode *node = graph->operations[i];
+		ID *id = node->owner->owner->id;
+		if (GS(id->name) == ID_OB) {
+			Object *object = (Object *)id;
+			object->customdata_mask |= node->customdata_mask;
+		}
+	}
+
+	/* 4) Detect cycles, reduce relations of the new nodes and their direct
+	 *    children, and finalize as usual.
+	 */
+	deg_graph_detect_cycles(graph);
+	if (use_transitive_reduction) {
+		for (size_t i = num_operations; i < graph->operations.size(); ++i) {
+			OperationDepsNode *node = graph->operations[i];
+			reduction_targets.push_back(node);
+			foreach (DepsRelation *rel, node->outlinks) {
+				if (rel->to->type == DEPSNODE_TYPE_OPERATION &&
+				    !BLI_gset_haskey(filter_ids, deg_node_owner_id(rel->to)))
+				{
+					reduction_targets.push_back((OperationDepsNode *)rel->to);
+				}
+			}
+		}
+		deg_graph_transitive_reduction_update(graph, reduction_targets);
+	}
+	deg_graph_build_finalize(graph);
+
+	BLI_gset_free(filter_ids, NULL);
+	BLI_gset_free(existing_ids, NULL);
+	BLI_gset_free(dependent_objects, NULL);
+	return true;
+}
+
+}  // namespace DEG
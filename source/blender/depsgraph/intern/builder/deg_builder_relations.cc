@@ -41,6 +41,7 @@
 extern "C" {
 #include "BLI_blenlib.h"
 #include "BLI_utildefines.h"
+#include "BLI_ghash.h"
 
 #include "DNA_action_types.h"
 #include "DNA_anim_types.h"
@@ -159,10 +160,40 @@ RNAPathKey::RNAPathKey(ID *id, const char *path) :
 }
 
 DepsgraphRelationBuilder::DepsgraphRelationBuilder(Depsgraph *graph) :
-    m_graph(graph)
+    m_graph(graph),
+    m_filter_ids(NULL)
 {
 }
 
+void DepsgraphRelationBuilder::set_filter_ids(GSet *filter_ids)
+{
+	m_filter_ids = filter_ids;
+}
+
+static ID *deg_node_owner_id(DepsNode *node)
+{
+	switch (node->tclass) {
+		case DEPSNODE_CLASS_OPERATION:
+			return ((OperationDepsNode *)node)->owner->owner->id;
+		case DEPSNODE_CLASS_COMPONENT:
+			return ((ComponentDepsNode *)node)->owner->id;
+		default:
+			return NULL;
+	}
+}
+
+bool DepsgraphRelationBuilder::relation_is_filtered(DepsNode *node_from,
+                                                    DepsNode *node_to) const
+{
+	if (m_filter_ids == NULL) {
+		return false;
+	}
+	ID *id_from = deg_node_owner_id(node_from);
+	ID *id_to = deg_node_owner_id(node_to);
+	return !((id_from != NULL && BLI_gset_haskey(m_filter_ids, id_from)) ||
+	         (id_to != NULL && BLI_gset_haskey(m_filter_ids, id_to)));
+}
+
 RootDepsNode *DepsgraphRelationBuilder::find_node(const RootKey &key) const
 {
 	(void)key;
@@ -247,6 +278,9 @@ void DepsgraphRelationBuilder::add_time_relation(TimeSourceDepsNode *timesrc,
                                                  const char *description)
 {
 	if (timesrc && node_to) {
+		if (relation_is_filtered(timesrc, node_to)) {
+			return;
+		}
 		m_graph->add_new_relation(timesrc, node_to, DEPSREL_TYPE_TIME, description);
 	}
 	else {
@@ -264,6 +298,9 @@ void DepsgraphRelationBuilder::add_operation_relation(
         const char *description)
 {
 	if (node_from && node_to) {
+		if (relation_is_filtered(node_from, node_to)) {
+			return;
+		}
 		m_graph->add_new_relation(node_from, node_to, type, description);
 	}
 	else {
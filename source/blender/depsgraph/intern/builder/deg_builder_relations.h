@@ -50,6 +50,7 @@ struct bGPdata;
 struct CacheFile;
 struct ListBase;
 struct GHash;
+struct GSet;
 struct ID;
 struct FCurve;
 struct Group;
@@ -174,6 +175,12 @@ struct DepsgraphRelationBuilder
 
 	void begin_build(Main *bmain);
 
+	/* Only add relations which are connected to any of the given IDs.
+	 * Used by incremental updates, where relations between all the other IDs
+	 * are already in the graph. NULL means no filtering.
+	 */
+	void set_filter_ids(GSet *filter_ids);
+
 	template <typename KeyFrom, typename KeyTo>
 	void add_relation(const KeyFrom& key_from,
 	                  const KeyTo& key_to,
@@ -259,8 +266,11 @@ protected:
 
 	bool needs_animdata_node(ID *id);
 
+	bool relation_is_filtered(DepsNode *node_from, DepsNode *node_to) const;
+
 private:
 	Depsgraph *m_graph;
+	GSet *m_filter_ids;
 };
 
 struct DepsNodeHandle
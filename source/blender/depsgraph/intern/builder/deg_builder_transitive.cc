@@ -49,14 +49,19 @@ namespace DEG {
 /* Performs a transitive reduction to remove redundant relations.
  * https://en.wikipedia.org/wiki/Transitive_reduction
  *
+ * Redundant relations are not removed from the graph, but are marked with
+ * DEPSREL_FLAG_TRANSITIVE instead. This way the graph can be updated
+ * incrementally: when some nodes are removed, relations which were redundant
+ * because of paths through those nodes are brought back.
+ *
  * XXX The current implementation is somewhat naive and has O(V*E) worst case
  * runtime.
  * A more optimized algorithm can be implemented later, e.g.
  *
  *   http://www.sciencedirect.com/science/article/pii/0304397588900321/pdf?md5=3391e309b708b6f9cdedcd08f84f4afc&pid=1-s2.0-0304397588900321-main.pdf
  *
- * Care has to be taken to make sure the algorithm can handle the cyclic case
- * too! (unless we can to prevent this case early on).
+ * Cyclic relations are ignored when looking for paths, so relations are never
+ * considered redundant because of a path which is not respected by evaluation.
  */
 
 enum {
@@ -64,14 +69,25 @@ enum {
 	OP_REACHABLE = 2,
 };
 
-static void deg_graph_tag_paths_recursive(DepsNode *node)
+static bool deg_relation_is_path(const DepsRelation *rel)
+{
+	return rel->from->type == DEPSNODE_TYPE_OPERATION &&
+	       (rel->flag & DEPSREL_FLAG_CYCLIC) == 0;
+}
+
+static void deg_graph_tag_paths_recursive(DepsNode *node,
+                                          vector<DepsNode *> *r_visited)
 {
 	if (node->done & OP_VISITED) {
 		return;
 	}
 	node->done |= OP_VISITED;
+	r_visited->push_back(node);
 	foreach (DepsRelation *rel, node->inlinks) {
-		deg_graph_tag_paths_recursive(rel->from);
+		if (!deg_relation_is_path(rel)) {
+			continue;
+		}
+		deg_graph_tag_paths_recursive(rel->from, r_visited);
 		/* Do this only in inlinks loop, so the target node does not get
 		 * flagged.
 		 */
@@ -79,43 +95,64 @@ static void deg_graph_tag_paths_recursive(DepsNode *node)
 	}
 }
 
-void deg_graph_transitive_reduction(Depsgraph *graph)
+static void deg_graph_transitive_reduction_node(OperationDepsNode *target,
+                                                vector<DepsNode *> *visited)
 {
-	foreach (OperationDepsNode *target, graph->operations) {
-		/* Clear tags. */
-		foreach (OperationDepsNode *node, graph->operations) {
-			node->done = 0;
+	/* Mark nodes from which we can reach the target.
+	 * Start with children, so the target node and direct children are not
+	 * flagged.
+	 */
+	visited->clear();
+	target->done |= OP_VISITED;
+	visited->push_back(target);
+	foreach (DepsRelation *rel, target->inlinks) {
+		rel->flag &= ~DEPSREL_FLAG_TRANSITIVE;
+		if (deg_relation_is_path(rel)) {
+			deg_graph_tag_paths_recursive(rel->from, visited);
 		}
+	}
 
-		/* mark nodes from which we can reach the target
-		 * start with children, so the target node and direct children are not
-		 * flagged.
-		 */
-		target->done |= OP_VISITED;
-		foreach (DepsRelation *rel, target->inlinks) {
-			deg_graph_tag_paths_recursive(rel->from);
+	/* Mark redundant paths to the target. */
+	foreach (DepsRelation *rel, target->inlinks) {
+		if (rel->from->type == DEPSNODE_TYPE_TIMESOURCE) {
+			/* HACK: time source nodes don't get "done" flag set/cleared. */
+			/* TODO: there will be other types in future, so iterators above
+			 * need modifying.
+			 */
 		}
-
-		/* Remove redundant paths to the target. */
-		for (DepsNode::Relations::const_iterator it_rel = target->inlinks.begin();
-		     it_rel != target->inlinks.end();
-		     )
-		{
-			DepsRelation *rel = *it_rel;
-			/* Increment in advance, so we can safely remove the relation. */
-			++it_rel;
-
-			if (rel->from->type == DEPSNODE_TYPE_TIMESOURCE) {
-				/* HACK: time source nodes don't get "done" flag set/cleared. */
-				/* TODO: there will be other types in future, so iterators above
-				 * need modifying.
-				 */
-			}
-			else if (rel->from->done & OP_REACHABLE) {
-				OBJECT_GUARDED_DELETE(rel, DepsRelation);
-			}
+		else if (rel->from->done & OP_REACHABLE) {
+			rel->flag |= DEPSREL_FLAG_TRANSITIVE;
 		}
 	}
+
+	/* Clear tags, only of the nodes which were actually visited. */
+	foreach (DepsNode *node, *visited) {
+		node->done = 0;
+	}
+}
+
+void deg_graph_transitive_reduction(Depsgraph *graph)
+{
+	foreach (OperationDepsNode *node, graph->operations) {
+		node->done = 0;
+	}
+	vector<DepsNode *> visited;
+	foreach (OperationDepsNode *target, graph->operations) {
+		deg_graph_transitive_reduction_node(target, &visited);
+	}
+}
+
+void deg_graph_transitive_reduction_update(
+        Depsgraph *graph,
+        const vector<OperationDepsNode *> &targets)
+{
+	foreach (OperationDepsNode *node, graph->operations) {
+		node->done = 0;
+	}
+	vector<DepsNode *> visited;
+	foreach (OperationDepsNode *target, targets) {
+		deg_graph_transitive_reduction_node(target, &visited);
+	}
 }
 
 }  // namespace DEG
@@ -30,11 +30,21 @@
 
 #pragma once
 
+#include "intern/depsgraph_types.h"
+
 namespace DEG {
 
 struct Depsgraph;
+struct OperationDepsNode;
 
 /* Performs a transitive reduction to remove redundant relations. */
 void deg_graph_transitive_reduction(Depsgraph *graph);
 
+/* Update transitive reduction after relations of the given target nodes
+ * have been changed. Only relations coming into the targets are checked.
+ */
+void deg_graph_transitive_reduction_update(
+        Depsgraph *graph,
+        const vector<OperationDepsNode *> &targets);
+
 }  // namespace DEG
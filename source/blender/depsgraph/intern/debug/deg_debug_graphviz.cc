@@ -40,6 +40,7 @@ extern "C" {
 #include "DEG_depsgraph_debug.h"
 }  /* extern "C" */
 
+#include "intern/eval/deg_eval_profile.h"
 #include "intern/depsgraph_intern.h"
 #include "util/deg_util_foreach.h"
 
@@ -139,6 +140,10 @@ struct DebugContext {
 	FILE *file;
 	bool show_tags;
 	bool show_eval_priority;
+	/* Longest operation time of the last evaluation, zero when there are no
+	 * profiling timings to show.
+	 */
+	double max_eval_time;
 };
 
 static void deg_debug_fprintf(const DebugContext &ctx, const char *fmt, ...) ATTR_PRINTF_FORMAT(2, 3);
@@ -239,6 +244,15 @@ static void deg_debug_graphviz_node_fillcolor(const DebugContext &ctx,
                                               const DepsNode *node)
 {
 	const char *defaultcolor = "gainsboro";
+	if (ctx.max_eval_time > 0.0 && node->tclass == DEPSNODE_CLASS_OPERATION) {
+		OperationDepsNode *op_node = (OperationDepsNode *)node;
+		if (op_node->eval_thread_id != -1) {
+			/* Heat map from white to red, relative to the most expensive node. */
+			const double cost = deg_profile_operation_time(op_node) / ctx.max_eval_time;
+			deg_debug_fprintf(ctx, "\"0.000 %.3f 1.000\"", cost);
+			return;
+		}
+	}
 	int color_index = deg_debug_node_color_index(node);
 	const char *fillcolor = color_index < 0 ? defaultcolor : deg_debug_colors_light[color_index % deg_debug_max_colors];
 	deg_debug_fprintf(ctx, "\"%s\"", fillcolor);
@@ -249,10 +263,14 @@ static void deg_debug_graphviz_relation_color(const DebugContext &ctx,
 {
 	const char *color_default = "black";
 	const char *color_error = "red4";
+	const char *color_transitive = "gray60";
 	const char *color = color_default;
 	if (rel->flag & DEPSREL_FLAG_CYCLIC) {
 		color = color_error;
 	}
+	else if (rel->flag & DEPSREL_FLAG_TRANSITIVE) {
+		color = color_transitive;
+	}
 	deg_debug_fprintf(ctx, "%s", color);
 }
 
@@ -295,14 +313,23 @@ static void deg_debug_graphviz_node_single(const DebugContext &ctx,
 	if (ctx.show_eval_priority && node->tclass == DEPSNODE_CLASS_OPERATION) {
 		priority = ((OperationDepsNode *)node)->eval_priority;
 	}
+	if (ctx.max_eval_time > 0.0 && node->tclass == DEPSNODE_CLASS_OPERATION) {
+		OperationDepsNode *op_node = (OperationDepsNode *)node;
+		if (op_node->eval_thread_id != -1) {
+			char buf[64];
+			BLI_snprintf(buf, sizeof(buf), "<BR/>%.3f ms",
+			             deg_profile_operation_time(op_node) * 1000.0);
+			name += buf;
+		}
+	}
 	deg_debug_fprintf(ctx, "// %s\n", name.c_str());
 	deg_debug_fprintf(ctx, "\"node_%p\"", node);
 	deg_debug_fprintf(ctx, "[");
 //	deg_debug_fprintf(ctx, "label=<<B>%s</B>>", name);
 	if (priority >= 0.0f) {
-		deg_debug_fprintf(ctx, "label=<%s<BR/>(<I>%.2f</I>)>",
+		deg_debug_fprintf(ctx, "label=<%s<BR/>(<I>%.3f ms</I>)>",
 		                 name.c_str(),
-		                 priority);
+		                 priority * 1000.0f);
 	}
 	else {
 		deg_debug_fprintf(ctx, "label=<%s>", name.c_str());
@@ -566,6 +593,15 @@ void DEG_debug_graphviz(const Depsgraph *graph, FILE *f, const char *label, bool
 	ctx.file = f;
 	ctx.show_tags = show_eval;
 	ctx.show_eval_priority = show_eval;
+	ctx.max_eval_time = 0.0;
+	if (show_eval) {
+		foreach (DEG::OperationDepsNode *node, deg_graph->operations) {
+			const double eval_time = DEG::deg_profile_operation_time(node);
+			if (node->eval_thread_id != -1 && eval_time > ctx.max_eval_time) {
+				ctx.max_eval_time = eval_time;
+			}
+		}
+	}
 
 	DEG::deg_debug_fprintf(ctx, "digraph depgraph {" NL);
 	DEG::deg_debug_fprintf(ctx, "rankdir=LR;" NL);
@@ -51,6 +51,7 @@ extern "C" {
 #include "RNA_access.h"
 }
 
+#include <algorithm>
 #include <cstring>
 
 #include "DEG_depsgraph.h"
@@ -71,12 +72,15 @@ static DEG_EditorUpdateScenePreCb deg_editor_update_scene_pre_cb = NULL;
 Depsgraph::Depsgraph()
   : root_node(NULL),
     need_update(false),
-    layers(0)
+    layers(0),
+    eval_begin_time(0.0),
+    eval_end_time(0.0)
 {
 	BLI_spin_init(&lock);
 	id_hash = BLI_ghash_ptr_new("Depsgraph id hash");
 	subgraphs = BLI_gset_ptr_new("Depsgraph subgraphs");
 	entry_tags = BLI_gset_ptr_new("Depsgraph entry_tags");
+	id_relations_tags = BLI_gset_ptr_new("Depsgraph id_relations_tags");
 }
 
 Depsgraph::~Depsgraph()
@@ -87,6 +91,7 @@ Depsgraph::~Depsgraph()
 	BLI_ghash_free(id_hash, NULL, NULL);
 	BLI_gset_free(subgraphs, NULL);
 	BLI_gset_free(entry_tags, NULL);
+	BLI_gset_free(id_relations_tags, NULL);
 	if (this->root_node != NULL) {
 		OBJECT_GUARDED_DELETE(this->root_node, RootDepsNode);
 	}
@@ -454,6 +459,21 @@ DepsRelation::~DepsRelation()
 	BLI_assert(this->from && this->to);
 }
 
+void DepsRelation::unlink()
+{
+	/* Sanity check. */
+	BLI_assert(this->from && this->to);
+	DepsNode::Relations::iterator it;
+	it = std::find(from->outlinks.begin(), from->outlinks.end(), this);
+	if (it != from->outlinks.end()) {
+		from->outlinks.erase(it);
+	}
+	it = std::find(to->inlinks.begin(), to->inlinks.end(), this);
+	if (it != to->inlinks.end()) {
+		to->inlinks.erase(it);
+	}
+}
+
 /* Low level tagging -------------------------------------- */
 
 /* Tag a specific node as needing updates. */
@@ -68,6 +68,12 @@ typedef enum eDepsRelation_Flag {
 	 * which triggers a cyclic relationship to exist in the graph
 	 */
 	DEPSREL_FLAG_CYCLIC     = (1 << 1),
+
+	/* "transitive" link - relation is redundant, since there is another path
+	 * between the same nodes. Such relations are kept in the graph so it can
+	 * be updated incrementally, but they are ignored by the evaluation.
+	 */
+	DEPSREL_FLAG_TRANSITIVE = (1 << 2),
 } eDepsRelation_Flag;
 
 /* B depends on A (A -> B) */
@@ -88,6 +94,9 @@ struct DepsRelation {
 	             const char *description);
 
 	~DepsRelation();
+
+	/* Remove relation from the nodes it connects. */
+	void unlink();
 };
 
 /* ********* */
@@ -156,6 +165,11 @@ struct Depsgraph {
 	/* Indicates whether relations needs to be updated. */
 	bool need_update;
 
+	/* IDs which relations are to be updated, without rebuilding the whole
+	 * graph. Ignored when need_update is set.
+	 */
+	GSet *id_relations_tags;
+
 	/* Quick-Access Temp Data ............. */
 
 	/* Nodes which have been tagged as "directly modified". */
@@ -177,6 +191,14 @@ struct Depsgraph {
 	/* Visible layers bitfield, used for skipping invisible objects updates. */
 	unsigned int layers;
 
+	/* Profiling .......................... */
+
+	/* Time span of the last evaluation, only filled in when profiling
+	 * is enabled.
+	 */
+	double eval_begin_time;
+	double eval_end_time;
+
 	// XXX: additional stuff like eval contexts, mempools for allocating nodes from, etc.
 };
 
@@ -42,6 +42,7 @@ extern "C" {
 }  /* extern "C" */
 
 #include "intern/eval/deg_eval_debug.h"
+#include "intern/eval/deg_eval_profile.h"
 #include "intern/depsgraph_intern.h"
 #include "util/deg_util_foreach.h"
 
@@ -65,6 +66,18 @@ DepsgraphStatsID *DEG_stats_id(ID *id)
 	return DEG::DepsgraphDebug::get_id_stats(id, false);
 }
 
+void DEG_debug_profile_report(Depsgraph *graph, FILE *stream)
+{
+	DEG::Depsgraph *deg_graph = reinterpret_cast<DEG::Depsgraph *>(graph);
+	DEG::deg_profile_print_report(deg_graph, stream);
+}
+
+void DEG_debug_profile_chrome_trace(const Depsgraph *graph, FILE *stream)
+{
+	const DEG::Depsgraph *deg_graph = reinterpret_cast<const DEG::Depsgraph *>(graph);
+	DEG::deg_profile_write_chrome_trace(deg_graph, stream);
+}
+
 bool DEG_debug_compare(const struct Depsgraph *graph1,
                        const struct Depsgraph *graph2)
 {
@@ -33,13 +33,21 @@
 #include "MEM_guardedalloc.h"
 
 extern "C" {
+#include "BLI_utildefines.h"
+#include "BLI_ghash.h"
+
+#include "DNA_modifier_types.h"
+#include "DNA_object_types.h"
+
 #include "BKE_idcode.h"
 #include "BKE_main.h"
+#include "BKE_modifier.h"
 
 #include "DEG_depsgraph_query.h"
 } /* extern "C" */
 
 #include "intern/depsgraph_intern.h"
+#include "util/deg_util_foreach.h"
 
 bool DEG_id_type_tagged(Main *bmain, short idtype)
 {
@@ -68,3 +76,84 @@ short DEG_get_eval_flags_for_id(Depsgraph *graph, ID *id)
 
 	return id_node->eval_flags;
 }
+
+/* Modifiers which result depends on the state from the previous frames. */
+static bool deg_modifier_has_frame_state(const ModifierData *md)
+{
+	return ELEM(md->type,
+	            eModifierType_Cloth,
+	            eModifierType_Softbody,
+	            eModifierType_Collision,
+	            eModifierType_Smoke,
+	            eModifierType_DynamicPaint,
+	            eModifierType_Fluidsim,
+	            eModifierType_ParticleSystem);
+}
+
+static bool deg_operation_has_frame_state(const DEG::OperationDepsNode *op_node)
+{
+	switch (op_node->opcode) {
+		case DEG::DEG_OPCODE_RIGIDBODY_REBUILD:
+		case DEG::DEG_OPCODE_RIGIDBODY_SIM:
+		case DEG::DEG_OPCODE_TRANSFORM_RIGIDBODY:
+		case DEG::DEG_OPCODE_PSYS_EVAL:
+			return true;
+		case DEG::DEG_OPCODE_GEOMETRY_MODIFIER:
+		{
+			ID *id = op_node->owner->owner->id;
+			if (GS(id->name) == ID_OB) {
+				ModifierData *md = modifiers_findByName((Object *)id, op_node->name);
+				return md != NULL && deg_modifier_has_frame_state(md);
+			}
+			return false;
+		}
+		default:
+			return false;
+	}
+}
+
+bool DEG_id_is_frame_independent(Depsgraph *graph, ID *id)
+{
+	if (graph == NULL) {
+		return false;
+	}
+
+	DEG::Depsgraph *deg_graph = reinterpret_cast<DEG::Depsgraph *>(graph);
+
+	DEG::IDDepsNode *id_node = deg_graph->find_id_node(id);
+	if (id_node == NULL) {
+		return false;
+	}
+
+	/* Check all the operations the ID is evaluated from. */
+	GSet *visited = BLI_gset_ptr_new(__func__);
+	std::vector<DEG::OperationDepsNode *> stack;
+	GHASH_FOREACH_BEGIN(DEG::ComponentDepsNode *, comp_node, id_node->components)
+	{
+		foreach (DEG::OperationDepsNode *op_node, comp_node->operations) {
+			BLI_gset_insert(visited, op_node);
+			stack.push_back(op_node);
+		}
+	}
+	GHASH_FOREACH_END();
+
+	bool is_frame_independent = true;
+	while (!stack.empty() && is_frame_independent) {
+		DEG::OperationDepsNode *op_node = stack.back();
+		stack.pop_back();
+		if (deg_operation_has_frame_state(op_node)) {
+			is_frame_independent = false;
+			break;
+		}
+		foreach (DEG::DepsRelation *rel, op_node->inlinks) {
+			if (rel->from->type == DEG::DEPSNODE_TYPE_OPERATION &&
+			    BLI_gset_add(visited, rel->from))
+			{
+				stack.push_back((DEG::OperationDepsNode *)rel->from);
+			}
+		}
+	}
+
+	BLI_gset_free(visited, NULL);
+	return is_frame_independent;
+}
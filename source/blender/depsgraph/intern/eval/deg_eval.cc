@@ -49,6 +49,7 @@ extern "C" {
 
 #include "intern/eval/deg_eval_debug.h"
 #include "intern/eval/deg_eval_flush.h"
+#include "intern/eval/deg_eval_profile.h"
 #include "intern/nodes/deg_node.h"
 #include "intern/nodes/deg_node_component.h"
 #include "intern/nodes/deg_node_operation.h"
@@ -56,8 +57,10 @@ extern "C" {
 #include "intern/depsgraph_intern.h"
 #include "util/deg_util_foreach.h"
 
-/* Unfinished and unused, and takes quite some pre-processing time. */
-#undef USE_EVAL_PRIORITY
+/* Schedule operations on the longest (most expensive) path first, so heavy
+ * branches of the graph are not started behind lots of cheap operations.
+ */
+#define USE_EVAL_PRIORITY
 
 /* Use integrated debugger to keep track how much each of the nodes was
  * evaluating.
@@ -80,6 +83,7 @@ struct DepsgraphEvalState {
 	EvaluationContext *eval_ctx;
 	Depsgraph *graph;
 	unsigned int layers;
+	bool do_profile;
 };
 
 static void deg_task_run_func(TaskPool *pool,
@@ -114,8 +118,22 @@ static void deg_task_run_func(TaskPool *pool,
 		DepsgraphDebug::task_started(state->graph, node);
 #endif
 
-		/* Perform operation. */
-		node->evaluate(state->eval_ctx);
+		if (state->do_profile) {
+			const double start_time = PIL_check_seconds_timer();
+
+			/* Perform operation. */
+			node->evaluate(state->eval_ctx);
+
+			const double end_time = PIL_check_seconds_timer();
+			node->eval_cost = (float)(end_time - start_time);
+			node->eval_start_time = start_time;
+			node->eval_end_time = end_time;
+			node->eval_thread_id = thread_id;
+		}
+		else {
+			/* Perform operation. */
+			node->evaluate(state->eval_ctx);
+		}
 
 			/* Note how long this took. */
 #ifdef USE_DEBUGGER
@@ -151,7 +169,7 @@ static void calculate_pending_func(void *data_v, int i)
 	{
 		foreach (DepsRelation *rel, node->inlinks) {
 			if (rel->from->type == DEPSNODE_TYPE_OPERATION &&
-			    (rel->flag & DEPSREL_FLAG_CYCLIC) == 0)
+			    (rel->flag & (DEPSREL_FLAG_CYCLIC | DEPSREL_FLAG_TRANSITIVE)) == 0)
 			{
 				OperationDepsNode *from = (OperationDepsNode *)rel->from;
 				IDDepsNode *id_from_node = from->owner->owner;
@@ -180,28 +198,93 @@ static void calculate_pending_parents(Depsgraph *graph, unsigned int layers)
 }
 
 #ifdef USE_EVAL_PRIORITY
-static void calculate_eval_priority(OperationDepsNode *node)
+/* Cost of the operation in seconds, as measured in the last profiled
+ * evaluation, or a rough guess if the operation was never profiled.
+ */
+static float operation_cost(const OperationDepsNode *node)
 {
-	if (node->done) {
-		return;
+	if (node->is_noop()) {
+		return 0.0f;
 	}
-	node->done = 1;
+	if (node->eval_cost >= 0.0f) {
+		return node->eval_cost;
+	}
+	/* Geometry evaluation runs the whole modifier stack, which is usually
+	 * orders of magnitude heavier than anything else.
+	 */
+	if (node->opcode == DEG_OPCODE_GEOMETRY_UBEREVAL) {
+		return 1e-3f;
+	}
+	return 1e-5f;
+}
+
+static bool operation_needs_eval(const OperationDepsNode *node,
+                                 const unsigned int layers)
+{
+	return (node->flag & DEPSOP_FLAG_NEEDS_UPDATE) != 0 &&
+	       (node->owner->owner->layers & layers) != 0;
+}
 
-	if (node->flag & DEPSOP_FLAG_NEEDS_UPDATE) {
-		/* XXX standard cost of a node, could be estimated somewhat later on */
-		const float cost = 1.0f;
-		/* NOOP nodes have no cost */
-		node->eval_priority = node->is_noop() ? cost : 0.0f;
+/* Relations along which the evaluation is ordered, same as the ones counted
+ * in calculate_pending_func().
+ */
+static bool relation_orders_eval(const DepsRelation *rel)
+{
+	return rel->from->type == DEPSNODE_TYPE_OPERATION &&
+	       rel->to->type == DEPSNODE_TYPE_OPERATION &&
+	       (rel->flag & (DEPSREL_FLAG_CYCLIC | DEPSREL_FLAG_TRANSITIVE)) == 0;
+}
 
+/* Priority is the cost of the longest path of operations which are to be
+ * evaluated, starting with the given one.
+ *
+ * Operations are visited in reverse topological order, so all children of an
+ * operation have their priority when it is visited. The done tags, which
+ * are expected to be cleared, count the children an operation waits for.
+ */
+static void calculate_eval_priority(Depsgraph *graph, const unsigned int layers)
+{
+	vector<OperationDepsNode *> queue;
+	queue.reserve(graph->operations.size());
+
+	foreach (OperationDepsNode *node, graph->operations) {
+		node->eval_priority = 0.0f;
+		if (!operation_needs_eval(node, layers)) {
+			continue;
+		}
 		foreach (DepsRelation *rel, node->outlinks) {
-			OperationDepsNode *to = (OperationDepsNode *)rel->to;
-			BLI_assert(to->type == DEPSNODE_TYPE_OPERATION);
-			calculate_eval_priority(to);
-			node->eval_priority += to->eval_priority;
+			if (relation_orders_eval(rel) &&
+			    operation_needs_eval((OperationDepsNode *)rel->to, layers))
+			{
+				++node->done;
+			}
+		}
+		if (node->done == 0) {
+			queue.push_back(node);
 		}
 	}
-	else {
-		node->eval_priority = 0.0f;
+
+	for (size_t i = 0; i < queue.size(); ++i) {
+		OperationDepsNode *node = queue[i];
+		float max_child_priority = 0.0f;
+		foreach (DepsRelation *rel, node->outlinks) {
+			if (relation_orders_eval(rel)) {
+				OperationDepsNode *to = (OperationDepsNode *)rel->to;
+				if (to->eval_priority > max_child_priority) {
+					max_child_priority = to->eval_priority;
+				}
+			}
+		}
+		node->eval_priority = operation_cost(node) + max_child_priority;
+
+		foreach (DepsRelation *rel, node->inlinks) {
+			if (relation_orders_eval(rel)) {
+				OperationDepsNode *from = (OperationDepsNode *)rel->from;
+				if (operation_needs_eval(from, layers) && --from->done == 0) {
+					queue.push_back(from);
+				}
+			}
+		}
 	}
 }
 #endif
@@ -234,12 +317,21 @@ static void schedule_node(TaskPool *pool, Depsgraph *graph, unsigned int layers,
 				}
 				else {
 					/* children are scheduled once this task is completed */
+#ifdef USE_EVAL_PRIORITY
+					BLI_task_pool_push_ordered(pool,
+					                           deg_task_run_func,
+					                           node,
+					                           false,
+					                           node->eval_priority,
+					                           thread_id);
+#else
 					BLI_task_pool_push_from_thread(pool,
 					                               deg_task_run_func,
 					                               node,
 					                               false,
 					                               TASK_PRIORITY_HIGH,
 					                               thread_id);
+#endif
 				}
 			}
 		}
@@ -264,6 +356,10 @@ static void schedule_children(TaskPool *pool,
 	foreach (DepsRelation *rel, node->outlinks) {
 		OperationDepsNode *child = (OperationDepsNode *)rel->to;
 		BLI_assert(child->type == DEPSNODE_TYPE_OPERATION);
+		if (rel->flag & DEPSREL_FLAG_TRANSITIVE) {
+			/* Child is scheduled through another path. */
+			continue;
+		}
 		if (child->scheduled) {
 			/* Happens when having cyclic dependencies. */
 			continue;
@@ -310,6 +406,7 @@ void deg_evaluate_on_refresh(EvaluationContext *eval_ctx,
 	state.eval_ctx = eval_ctx;
 	state.graph = graph;
 	state.layers = layers;
+	state.do_profile = (G.debug & G_DEBUG_DEPSGRAPH_PROFILE) != 0;
 
 	TaskScheduler *task_scheduler;
 	bool need_free_scheduler;
@@ -334,18 +431,25 @@ void deg_evaluate_on_refresh(EvaluationContext *eval_ctx,
 
 	/* Calculate priority for operation nodes. */
 #ifdef USE_EVAL_PRIORITY
-	foreach (OperationDepsNode *node, graph->operations) {
-		calculate_eval_priority(node);
-	}
+	calculate_eval_priority(graph, layers);
 #endif
 
 	DepsgraphDebug::eval_begin(eval_ctx);
 
+	if (state.do_profile) {
+		deg_profile_eval_begin(graph);
+	}
+
 	schedule_graph(task_pool, graph, layers);
 
 	BLI_task_pool_work_and_wait(task_pool);
 	BLI_task_pool_free(task_pool);
 
+	if (state.do_profile) {
+		deg_profile_eval_end(graph);
+		deg_profile_print_summary(graph, stdout);
+	}
+
 	DepsgraphDebug::eval_end(eval_ctx);
 
 	/* Clear any uncleared tags - just in case. */
@@ -0,0 +1,318 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The Original Code is Copyright (C) 2016 Blender Foundation.
+ * All rights reserved.
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ */
+
+/** \file blender/depsgraph/intern/eval/deg_eval_profile.cc
+ *  \ingroup depsgraph
+ *
+ * Evaluation profiler: per-operation timings and critical path analysis.
+ *
+ * Timings are stored in the operation nodes themselves by the evaluation
+ * engine, so all the reports here describe the last evaluation of the graph.
+ */
+
+#include "intern/eval/deg_eval_profile.h"
+
+#include <algorithm>
+#include <functional>
+#include <utility>
+
+#include "PIL_time.h"
+
+extern "C" {
+#include "BLI_utildefines.h"
+#include "BLI_ghash.h"
+} /* extern "C" */
+
+#include "intern/nodes/deg_node.h"
+#include "intern/nodes/deg_node_component.h"
+#include "intern/nodes/deg_node_operation.h"
+#include "intern/depsgraph.h"
+#include "intern/depsgraph_intern.h"
+#include "util/deg_util_foreach.h"
+
+namespace DEG {
+
+/* Number of entries shown in the per-ID part of the report. */
+#define PROFILE_REPORT_MAX_IDS 20
+
+double deg_profile_operation_time(const OperationDepsNode *node)
+{
+	return node->eval_end_time - node->eval_start_time;
+}
+
+void deg_profile_eval_begin(Depsgraph *graph)
+{
+	foreach (OperationDepsNode *node, graph->operations) {
+		node->eval_start_time = 0.0;
+		node->eval_end_time = 0.0;
+		node->eval_thread_id = -1;
+	}
+	graph->eval_begin_time = PIL_check_seconds_timer();
+	graph->eval_end_time = graph->eval_begin_time;
+}
+
+void deg_profile_eval_end(Depsgraph *graph)
+{
+	graph->eval_end_time = PIL_check_seconds_timer();
+}
+
+static bool profile_relation_is_ordering(const DepsRelation *rel)
+{
+	return rel->from->type == DEPSNODE_TYPE_OPERATION &&
+	       rel->to->type == DEPSNODE_TYPE_OPERATION &&
+	       (rel->flag & DEPSREL_FLAG_CYCLIC) == 0;
+}
+
+double deg_profile_critical_path(Depsgraph *graph,
+                                 vector<OperationDepsNode *> *r_path)
+{
+	const int num_operations = graph->operations.size();
+	vector<int> num_pending(num_operations, 0);
+	vector<double> path_time(num_operations, 0.0);
+	vector<int> path_prev(num_operations, -1);
+	vector<int> queue;
+	queue.reserve(num_operations);
+
+	/* Generic tag is used as an index into the arrays above. */
+	for (int i = 0; i < num_operations; ++i) {
+		graph->operations[i]->tag = i;
+	}
+	for (int i = 0; i < num_operations; ++i) {
+		foreach (DepsRelation *rel, graph->operations[i]->inlinks) {
+			if (profile_relation_is_ordering(rel)) {
+				++num_pending[i];
+			}
+		}
+		if (num_pending[i] == 0) {
+			queue.push_back(i);
+		}
+	}
+
+	/* Traverse in topological order, so longest path to every node is
+	 * known by the time it is visited.
+	 */
+	int path_end = -1;
+	double critical_time = 0.0;
+	for (size_t q = 0; q < queue.size(); ++q) {
+		const int i = queue[q];
+		OperationDepsNode *node = graph->operations[i];
+		path_time[i] += deg_profile_operation_time(node);
+		if (path_end == -1 || path_time[i] > critical_time) {
+			critical_time = path_time[i];
+			path_end = i;
+		}
+		foreach (DepsRelation *rel, node->outlinks) {
+			if (!profile_relation_is_ordering(rel)) {
+				continue;
+			}
+			const int j = rel->to->tag;
+			if (path_time[i] > path_time[j] || path_prev[j] == -1) {
+				path_time[j] = path_time[i];
+				path_prev[j] = i;
+			}
+			if (--num_pending[j] == 0) {
+				queue.push_back(j);
+			}
+		}
+	}
+
+	if (r_path != NULL) {
+		r_path->clear();
+		for (int i = path_end; i != -1; i = path_prev[i]) {
+			/* Skip operations which were not evaluated at all. */
+			if (deg_profile_operation_time(graph->operations[i]) > 0.0) {
+				r_path->push_back(graph->operations[i]);
+			}
+		}
+		std::reverse(r_path->begin(), r_path->end());
+	}
+
+	return critical_time;
+}
+
+static int profile_count_evaluated(const Depsgraph *graph, double *r_total_time)
+{
+	int num_evaluated = 0;
+	double total_time = 0.0;
+	foreach (OperationDepsNode *node, graph->operations) {
+		if (node->eval_thread_id != -1) {
+			total_time += deg_profile_operation_time(node);
+			++num_evaluated;
+		}
+	}
+	*r_total_time = total_time;
+	return num_evaluated;
+}
+
+static string profile_component_name(const ComponentDepsNode *comp_node)
+{
+	DepsNodeFactory *factory = deg_get_node_factory(comp_node->type);
+	if (comp_node->name[0] != '\0') {
+		return string(factory->tname()) + " | " + comp_node->name;
+	}
+	return string(factory->tname());
+}
+
+void deg_profile_print_summary(Depsgraph *graph, FILE *stream)
+{
+	double total_time;
+	const int num_evaluated = profile_count_evaluated(graph, &total_time);
+	const double wall_time = graph->eval_end_time - graph->eval_begin_time;
+	const double critical_time = deg_profile_critical_path(graph, NULL);
+	fprintf(stream,
+	        "Depsgraph: evaluated %d operations in %.3f ms "
+	        "(operations %.3f ms, critical path %.3f ms, parallelism %.2f)\n",
+	        num_evaluated,
+	        wall_time * 1000.0,
+	        total_time * 1000.0,
+	        critical_time * 1000.0,
+	        wall_time > 0.0 ? total_time / wall_time : 0.0);
+}
+
+void deg_profile_print_report(Depsgraph *graph, FILE *stream)
+{
+	typedef std::pair<double, IDDepsNode *> IDTime;
+	typedef std::pair<double, ComponentDepsNode *> ComponentTime;
+
+	deg_profile_print_summary(graph, stream);
+
+	double total_time;
+	profile_count_evaluated(graph, &total_time);
+
+	/* Aggregate timings per ID and component. */
+	vector<IDTime> id_times;
+	GHASH_FOREACH_BEGIN(IDDepsNode *, id_node, graph->id_hash)
+	{
+		double id_time = 0.0;
+		GHASH_FOREACH_BEGIN(ComponentDepsNode *, comp_node, id_node->components)
+		{
+			foreach (OperationDepsNode *op_node, comp_node->operations) {
+				id_time += deg_profile_operation_time(op_node);
+			}
+		}
+		GHASH_FOREACH_END();
+		if (id_time > 0.0) {
+			id_times.push_back(IDTime(id_time, id_node));
+		}
+	}
+	GHASH_FOREACH_END();
+	std::sort(id_times.begin(), id_times.end(), std::greater<IDTime>());
+
+	fprintf(stream, "\nTime per ID:\n");
+	for (int i = 0; i < std::min((int)id_times.size(), PROFILE_REPORT_MAX_IDS); ++i) {
+		IDDepsNode *id_node = id_times[i].second;
+		fprintf(stream, "  %8.3f ms %5.1f%%  %s\n",
+		        id_times[i].first * 1000.0,
+		        total_time > 0.0 ? id_times[i].first / total_time * 100.0 : 0.0,
+		        id_node->name);
+
+		vector<ComponentTime> comp_times;
+		GHASH_FOREACH_BEGIN(ComponentDepsNode *, comp_node, id_node->components)
+		{
+			double comp_time = 0.0;
+			foreach (OperationDepsNode *op_node, comp_node->operations) {
+				comp_time += deg_profile_operation_time(op_node);
+			}
+			if (comp_time > 0.0) {
+				comp_times.push_back(ComponentTime(comp_time, comp_node));
+			}
+		}
+		GHASH_FOREACH_END();
+		std::sort(comp_times.begin(), comp_times.end(), std::greater<ComponentTime>());
+
+		foreach (const ComponentTime &comp_time, comp_times) {
+			fprintf(stream, "    %8.3f ms         %s\n",
+			        comp_time.first * 1000.0,
+			        profile_component_name(comp_time.second).c_str());
+		}
+	}
+	if (id_times.size() > PROFILE_REPORT_MAX_IDS) {
+		fprintf(stream, "  ... %d more\n",
+		        (int)id_times.size() - PROFILE_REPORT_MAX_IDS);
+	}
+
+	vector<OperationDepsNode *> path;
+	const double critical_time = deg_profile_critical_path(graph, &path);
+	fprintf(stream, "\nCritical path (%.3f ms, %d operations):\n",
+	        critical_time * 1000.0, (int)path.size());
+	foreach (OperationDepsNode *node, path) {
+		fprintf(stream, "  %8.3f ms  [thread %d]  %s\n",
+		        deg_profile_operation_time(node) * 1000.0,
+		        node->eval_thread_id,
+		        node->full_identifier().c_str());
+	}
+}
+
+static void profile_write_json_string(FILE *stream, const char *str)
+{
+	fputc('"', stream);
+	for (const char *c = str; *c != '\0'; ++c) {
+		switch (*c) {
+			case '"':
+				fputs("\\\"", stream);
+				break;
+			case '\\':
+				fputs("\\\\", stream);
+				break;
+			default:
+				if ((unsigned char)*c < 0x20) {
+					fprintf(stream, "\\u%04x", (unsigned int)(unsigned char)*c);
+				}
+				else {
+					fputc(*c, stream);
+				}
+				break;
+		}
+	}
+	fputc('"', stream);
+}
+
+void deg_profile_write_chrome_trace(const Depsgraph *graph, FILE *stream)
+{
+	bool first = true;
+	fprintf(stream, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	foreach (OperationDepsNode *node, graph->operations) {
+		if (node->eval_thread_id == -1) {
+			continue;
+		}
+		/* Timestamps are in microseconds, relative to evaluation start. */
+		const double start = (node->eval_start_time - graph->eval_begin_time) * 1e6;
+		const double duration = deg_profile_operation_time(node) * 1e6;
+		if (!first) {
+			fprintf(stream, ",\n");
+		}
+		first = false;
+		fprintf(stream, "{\"name\":");
+		profile_write_json_string(stream, node->identifier().c_str());
+		fprintf(stream, ",\"cat\":");
+		profile_write_json_string(stream, profile_component_name(node->owner).c_str());
+		fprintf(stream, ",\"ph\":\"X\",\"pid\":0,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+		        node->eval_thread_id, start, duration);
+		fprintf(stream, ",\"args\":{\"id\":");
+		profile_write_json_string(stream, node->owner->owner->name);
+		fprintf(stream, "}}");
+	}
+	fprintf(stream, "\n]}\n");
+}
+
+}  // namespace DEG
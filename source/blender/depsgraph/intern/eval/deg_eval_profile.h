@@ -0,0 +1,70 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The Original Code is Copyright (C) 2016 Blender Foundation.
+ * All rights reserved.
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ */
+
+/** \file blender/depsgraph/intern/eval/deg_eval_profile.h
+ *  \ingroup depsgraph
+ *
+ * Evaluation profiler: per-operation timings and critical path analysis.
+ */
+
+#pragma once
+
+#include <cstdio>
+
+#include "intern/depsgraph_types.h"
+
+namespace DEG {
+
+struct Depsgraph;
+struct OperationDepsNode;
+
+/* Time spent by the operation in its last evaluation, in seconds. */
+double deg_profile_operation_time(const OperationDepsNode *node);
+
+/* Reset timings of all operations and note start of the evaluation. */
+void deg_profile_eval_begin(Depsgraph *graph);
+/* Note end of the evaluation. */
+void deg_profile_eval_end(Depsgraph *graph);
+
+/* Calculate longest chain of dependent operations in the last evaluation,
+ * weighted by their evaluation time.
+ *
+ * \param r_path: Optional, receives operations of the path in the order
+ * they were evaluated.
+ * \return Duration of the critical path in seconds.
+ */
+double deg_profile_critical_path(Depsgraph *graph,
+                                 vector<OperationDepsNode *> *r_path);
+
+/* Print a one line summary of the last evaluation. */
+void deg_profile_print_summary(Depsgraph *graph, FILE *stream);
+
+/* Print timings aggregated per ID and component, and the critical path. */
+void deg_profile_print_report(Depsgraph *graph, FILE *stream);
+
+/* Write timings of the last evaluation in the Chrome Trace Event format,
+ * which can be loaded in chrome://tracing.
+ */
+void deg_profile_write_chrome_trace(const Depsgraph *graph, FILE *stream);
+
+}  // namespace DEG
@@ -143,11 +143,9 @@ void ComponentDepsNode::init(const ID * /*id*/,
 ComponentDepsNode::~ComponentDepsNode()
 {
 	clear_operations();
-	if (operations_map != NULL) {
-		BLI_ghash_free(operations_map,
-		               comp_node_hash_key_free,
-		               comp_node_hash_value_free);
-	}
+	BLI_ghash_free(operations_map,
+	               comp_node_hash_key_free,
+	               comp_node_hash_value_free);
 }
 
 string ComponentDepsNode::identifier() const
@@ -244,15 +242,12 @@ OperationDepsNode *ComponentDepsNode::add_operation(eDepsOperation_Type optype,
 
 void ComponentDepsNode::clear_operations()
 {
-	if (operations_map != NULL) {
-		BLI_ghash_clear(operations_map,
-		                comp_node_hash_key_free,
-		                comp_node_hash_value_free);
-	}
-	foreach (OperationDepsNode *op_node, operations) {
-		OBJECT_GUARDED_DELETE(op_node, OperationDepsNode);
-	}
+	BLI_ghash_clear(operations_map,
+	                comp_node_hash_key_free,
+	                comp_node_hash_value_free);
 	operations.clear();
+	entry_operation = NULL;
+	exit_operation = NULL;
 }
 
 void ComponentDepsNode::tag_update(Depsgraph *graph)
@@ -261,17 +256,12 @@ void ComponentDepsNode::tag_update(Depsgraph *graph)
 	if (entry_op != NULL && entry_op->flag & DEPSOP_FLAG_NEEDS_UPDATE) {
 		return;
 	}
-	foreach (OperationDepsNode *op_node, operations) {
+	/* NOTE: Use hash map, since tag might happen before finalization. */
+	GHASH_FOREACH_BEGIN(OperationDepsNode *, op_node, operations_map)
+	{
 		op_node->tag_update(graph);
 	}
-	// It is possible that tag happens before finalization.
-	if (operations_map != NULL) {
-		GHASH_FOREACH_BEGIN(OperationDepsNode *, op_node, operations_map)
-		{
-			op_node->tag_update(graph);
-		}
-		GHASH_FOREACH_END();
-	}
+	GHASH_FOREACH_END();
 }
 
 OperationDepsNode *ComponentDepsNode::get_entry_operation()
@@ -279,7 +269,7 @@ OperationDepsNode *ComponentDepsNode::get_entry_operation()
 	if (entry_operation) {
 		return entry_operation;
 	}
-	else if (operations_map != NULL && BLI_ghash_size(operations_map) == 1) {
+	else if (BLI_ghash_size(operations_map) == 1) {
 		OperationDepsNode *op_node = NULL;
 		/* TODO(sergey): This is somewhat slow. */
 		GHASH_FOREACH_BEGIN(OperationDepsNode *, tmp, operations_map)
@@ -291,9 +281,6 @@ OperationDepsNode *ComponentDepsNode::get_entry_operation()
 		entry_operation = op_node;
 		return op_node;
 	}
-	else if (operations.size() == 1) {
-		return operations[0];
-	}
 	return NULL;
 }
 
@@ -302,7 +289,7 @@ OperationDepsNode *ComponentDepsNode::get_exit_operation()
 	if (exit_operation) {
 		return exit_operation;
 	}
-	else if (operations_map != NULL && BLI_ghash_size(operations_map) == 1) {
+	else if (BLI_ghash_size(operations_map) == 1) {
 		OperationDepsNode *op_node = NULL;
 		/* TODO(sergey): This is somewhat slow. */
 		GHASH_FOREACH_BEGIN(OperationDepsNode *, tmp, operations_map)
@@ -314,24 +301,21 @@ OperationDepsNode *ComponentDepsNode::get_exit_operation()
 		exit_operation = op_node;
 		return op_node;
 	}
-	else if (operations.size() == 1) {
-		return operations[0];
-	}
 	return NULL;
 }
 
 void ComponentDepsNode::finalize_build()
 {
+	/* NOTE: Could be called multiple times for the same component when graph
+	 * is updated incrementally.
+	 */
+	operations.clear();
 	operations.reserve(BLI_ghash_size(operations_map));
 	GHASH_FOREACH_BEGIN(OperationDepsNode *, op_node, operations_map)
 	{
 		operations.push_back(op_node);
 	}
 	GHASH_FOREACH_END();
-	BLI_ghash_free(operations_map,
-	               comp_node_hash_key_free,
-	               NULL);
-	operations_map = NULL;
 }
 
 /* Parameter Component Defines ============================ */
@@ -132,12 +132,14 @@ struct ComponentDepsNode : public DepsNode {
 	/* ** Inner nodes for this component ** */
 
 	/* Operations stored as a hash map, for faster build.
-	 * This hash map will be freed when graph is fully built.
+	 * This hash map owns the operations, and is kept after the graph is built
+	 * so relations of the component can be updated incrementally.
 	 */
 	GHash *operations_map;
 
 	/* This is a "normal" list of operations, used by evaluation
-	 * and other routines after construction.
+	 * and other routines after construction. Filled in from the hash map
+	 * by finalize_build().
 	 */
 	vector<OperationDepsNode *> operations;
 
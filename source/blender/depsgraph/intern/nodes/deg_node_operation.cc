@@ -47,6 +47,10 @@ namespace DEG {
 
 OperationDepsNode::OperationDepsNode() :
     eval_priority(0.0f),
+    eval_cost(-1.0f),
+    eval_start_time(0.0),
+    eval_end_time(0.0),
+    eval_thread_id(-1),
     flag(0),
     customdata_mask(0)
 {
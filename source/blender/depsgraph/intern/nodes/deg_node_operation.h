@@ -81,9 +81,25 @@ struct OperationDepsNode : public DepsNode {
 
 	/* How many inlinks are we still waiting on before we can be evaluated. */
 	uint32_t num_links_pending;
+	/* Cost of the most expensive path of operations starting with this one,
+	 * operations with higher priority are scheduled first.
+	 */
 	float eval_priority;
 	bool scheduled;
 
+	/* Time in seconds spent in the last profiled evaluation, negative if the
+	 * operation was never evaluated with profiling enabled.
+	 */
+	float eval_cost;
+
+	/* Timing of the last evaluation, only filled in when profiling is enabled
+	 * (see G_DEBUG_DEPSGRAPH_PROFILE). Thread ID is -1 when the operation was
+	 * not evaluated.
+	 */
+	double eval_start_time;
+	double eval_end_time;
+	int eval_thread_id;
+
 	/* Stage of evaluation */
 	eDepsOperation_Type optype;
 
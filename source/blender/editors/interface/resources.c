@@ -2772,6 +2772,9 @@ void init_userdef_do_versions(void)
 	
 	if (U.image_draw_method == 0)
 		U.image_draw_method = IMAGE_DRAW_METHOD_2DTEXTURE;
+
+	if (U.file_compress_level == 0)
+		U.file_compress_level = 1;
 	
 	// keep the following until the new audaspace is default to be built with
 #ifdef WITH_SYSTEM_AUDASPACE
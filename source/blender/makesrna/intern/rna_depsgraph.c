@@ -55,6 +55,22 @@ static void rna_Depsgraph_debug_graphviz(Depsgraph *graph, const char *filename)
 	fclose(f);
 }
 
+static void rna_Depsgraph_debug_profile_trace(Depsgraph *graph, const char *filename)
+{
+	FILE *f = fopen(filename, "w");
+	if (f == NULL)
+		return;
+
+	DEG_debug_profile_chrome_trace(graph, f);
+
+	fclose(f);
+}
+
+static void rna_Depsgraph_debug_profile_report(Depsgraph *graph)
+{
+	DEG_debug_profile_report(graph, stdout);
+}
+
 static void rna_Depsgraph_debug_rebuild(Depsgraph *UNUSED(graph), Main *bmain)
 {
 	Scene *sce;
@@ -95,6 +111,17 @@ static void rna_def_depsgraph(BlenderRNA *brna)
 	                                "File in which to store graphviz debug output");
 	RNA_def_parameter_flags(parm, 0, PARM_REQUIRED);
 
+	func = RNA_def_function(srna, "debug_profile_trace", "rna_Depsgraph_debug_profile_trace");
+	RNA_def_function_ui_description(func, "Write timings of the last evaluation in Chrome trace format "
+	                                "(needs --debug-depsgraph-profile)");
+	parm = RNA_def_string_file_path(func, "filename", NULL, FILE_MAX, "File Name",
+	                                "File in which to store the trace");
+	RNA_def_parameter_flags(parm, 0, PARM_REQUIRED);
+
+	func = RNA_def_function(srna, "debug_profile_report", "rna_Depsgraph_debug_profile_report");
+	RNA_def_function_ui_description(func, "Print timings of the last evaluation per ID, component "
+	                                "and along the critical path (needs --debug-depsgraph-profile)");
+
 	func = RNA_def_function(srna, "debug_rebuild", "rna_Depsgraph_debug_rebuild");
 	RNA_def_function_flag(func, FUNC_USE_MAIN);
 
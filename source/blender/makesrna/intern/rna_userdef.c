@@ -4482,6 +4482,12 @@ static void rna_def_userdef_filepaths(BlenderRNA *brna)
 	RNA_def_property_boolean_sdna(prop, NULL, "flag", USER_FILECOMPRESS);
 	RNA_def_property_ui_text(prop, "Compress File", "Enable file compression when saving .blend files");
 
+	prop = RNA_def_property(srna, "file_compression_level", PROP_INT, PROP_NONE);
+	RNA_def_property_int_sdna(prop, NULL, "file_compress_level");
+	RNA_def_property_range(prop, 1, 9);
+	RNA_def_property_ui_text(prop, "Compression Level",
+	                         "Compression level of .blend files, higher levels give smaller files but save slower");
+
 	prop = RNA_def_property(srna, "use_load_ui", PROP_BOOLEAN, PROP_NONE);
 	RNA_def_property_boolean_negative_sdna(prop, NULL, "flag", USER_FILENOUI);
 	RNA_def_property_ui_text(prop, "Load UI", "Load user interface setup when loading .blend files");
@@ -41,6 +41,8 @@ extern "C" {
 
 #include "BLI_math.h"
 #include "BLI_linklist.h"
+#include "BLI_task.h"
+#include "BLI_threads.h"
 #include "BLI_utildefines.h"
 
 #include "BKE_cloth.h"
@@ -81,6 +83,164 @@ static int cloth_count_nondiag_blocks(Cloth *cloth)
 	return nondiag;
 }
 
+/* Number of off-diagonal blocks used by the force of a spring, see cloth_calc_spring_force. */
+static int cloth_spring_num_blocks(const ClothSpring *spring)
+{
+	if (spring->type & (CLOTH_SPRING_TYPE_STRUCTURAL | CLOTH_SPRING_TYPE_SEWING | CLOTH_SPRING_TYPE_SHEAR)) {
+		return 1;
+	}
+	else if (spring->type & CLOTH_SPRING_TYPE_BENDING_HAIR) {
+		return 3;
+	}
+	return 0;
+}
+
+/* Springs are split in chunks of consecutive springs, and chunks are grouped in batches of chunks that
+ * share no vertices, using greedy graph coloring. Forces of the chunks of a batch can then be added in parallel,
+ * while batches are handled one after another, always in the same order so results are reproducible.
+ * Chunks rather than single springs are colored to keep the memory locality of the spring order,
+ * and to need fewer batches. Chunks that don't fit in any batch end up in the last one, which is handled serially. */
+#define CLOTH_SPRING_CHUNK_SIZE 128
+#define CLOTH_SPRING_BATCHES_MAX 64
+
+typedef struct ClothSpringBatches {
+	ClothSpring **springs;		/* springs, sorted by batch */
+	int *blocks;				/* first off-diagonal block of each spring, relative to its batch */
+	int *chunk_start;			/* first spring of each chunk, sorted by batch */
+	int batch_start[CLOTH_SPRING_BATCHES_MAX + 2];	/* first chunk of each batch */
+	int batch_blocks[CLOTH_SPRING_BATCHES_MAX + 1];	/* number of blocks used by each batch */
+} ClothSpringBatches;
+
+/* Bit mask of the batches that already have springs using one of the spring vertices. */
+static uint64_t cloth_spring_batch_mask(const ClothSpring *spring, const uint64_t *vert_batches)
+{
+	uint64_t mask = vert_batches[spring->ij] | vert_batches[spring->kl];
+	int x;
+
+	if (spring->type & CLOTH_SPRING_TYPE_BENDING) {
+		for (x = 0; x < spring->la; x++) {
+			mask |= vert_batches[spring->pa[x]];
+		}
+		for (x = 0; x < spring->lb; x++) {
+			mask |= vert_batches[spring->pb[x]];
+		}
+	}
+	if (spring->type & CLOTH_SPRING_TYPE_BENDING_HAIR) {
+		mask |= vert_batches[spring->mn];
+	}
+	return mask;
+}
+
+static void cloth_spring_batch_mask_add(const ClothSpring *spring, uint64_t *vert_batches, const uint64_t batch_bit)
+{
+	int x;
+
+	vert_batches[spring->ij] |= batch_bit;
+	vert_batches[spring->kl] |= batch_bit;
+
+	if (spring->type & CLOTH_SPRING_TYPE_BENDING) {
+		for (x = 0; x < spring->la; x++) {
+			vert_batches[spring->pa[x]] |= batch_bit;
+		}
+		for (x = 0; x < spring->lb; x++) {
+			vert_batches[spring->pb[x]] |= batch_bit;
+		}
+	}
+	if (spring->type & CLOTH_SPRING_TYPE_BENDING_HAIR) {
+		vert_batches[spring->mn] |= batch_bit;
+	}
+}
+
+static ClothSpringBatches *cloth_spring_batches_create(Cloth *cloth)
+{
+	ClothSpringBatches *batches = (ClothSpringBatches *)MEM_callocN(sizeof(*batches), "cloth spring batches");
+	uint64_t *vert_batches = (uint64_t *)MEM_callocN(sizeof(*vert_batches) * cloth->mvert_num, "cloth vert batches");
+	const int num_springs = BLI_linklist_count(cloth->springs);
+	const int num_chunks = (num_springs + CLOTH_SPRING_CHUNK_SIZE - 1) / CLOTH_SPRING_CHUNK_SIZE;
+	ClothSpring **springs = (ClothSpring **)MEM_mallocN(sizeof(*springs) * num_springs, "cloth springs");
+	int *chunk_batch = (int *)MEM_mallocN(sizeof(*chunk_batch) * num_chunks, "cloth chunk batch");
+	LinkNode *link;
+	int i, c, b, k;
+
+	batches->springs = (ClothSpring **)MEM_mallocN(sizeof(*batches->springs) * num_springs, "cloth batch springs");
+	batches->blocks = (int *)MEM_mallocN(sizeof(*batches->blocks) * num_springs, "cloth batch blocks");
+	batches->chunk_start = (int *)MEM_mallocN(sizeof(*batches->chunk_start) * (num_chunks + 1), "cloth batch chunks");
+
+	for (link = cloth->springs, i = 0; link; link = link->next, i++) {
+		springs[i] = (ClothSpring *)link->link;
+	}
+
+	/* assign each chunk to the first batch none of its vertices are used in */
+	for (c = 0; c < num_chunks; c++) {
+		const int start = c * CLOTH_SPRING_CHUNK_SIZE;
+		const int stop = min_ii(start + CLOTH_SPRING_CHUNK_SIZE, num_springs);
+		uint64_t mask = 0;
+
+		for (i = start; i < stop; i++) {
+			mask |= cloth_spring_batch_mask(springs[i], vert_batches);
+		}
+
+		if (mask == ~(uint64_t)0) {
+			b = CLOTH_SPRING_BATCHES_MAX;
+		}
+		else {
+			for (b = 0; mask & ((uint64_t)1 << b); b++) {
+				/* pass */
+			}
+			for (i = start; i < stop; i++) {
+				cloth_spring_batch_mask_add(springs[i], vert_batches, (uint64_t)1 << b);
+			}
+		}
+
+		chunk_batch[c] = b;
+		batches->batch_start[b + 1]++;
+	}
+
+	/* sort chunks by batch, keeping their order within batches */
+	for (b = 0; b <= CLOTH_SPRING_BATCHES_MAX; b++) {
+		batches->batch_start[b + 1] += batches->batch_start[b];
+	}
+
+	k = 0;
+	for (b = 0; b <= CLOTH_SPRING_BATCHES_MAX; b++) {
+		for (c = 0; c < num_chunks; c++) {
+			if (chunk_batch[c] == b) {
+				const int start = c * CLOTH_SPRING_CHUNK_SIZE;
+				const int stop = min_ii(start + CLOTH_SPRING_CHUNK_SIZE, num_springs);
+
+				batches->chunk_start[batches->batch_start[b]++] = k;
+
+				for (i = start; i < stop; i++, k++) {
+					batches->springs[k] = springs[i];
+					batches->blocks[k] = batches->batch_blocks[b];
+					batches->batch_blocks[b] += cloth_spring_num_blocks(springs[i]);
+				}
+			}
+		}
+	}
+	batches->chunk_start[num_chunks] = k;
+
+	/* restore batch start offsets */
+	for (b = CLOTH_SPRING_BATCHES_MAX + 1; b > 0; b--) {
+		batches->batch_start[b] = batches->batch_start[b - 1];
+	}
+	batches->batch_start[0] = 0;
+
+	MEM_freeN(vert_batches);
+	MEM_freeN(springs);
+	MEM_freeN(chunk_batch);
+
+	return batches;
+}
+
+static void cloth_spring_batches_free(ClothSpringBatches *batches)
+{
+	MEM_freeN(batches->springs);
+	MEM_freeN(batches->blocks);
+	MEM_freeN(batches->chunk_start);
+	MEM_freeN(batches);
+}
+
 int BPH_cloth_solver_init(Object *UNUSED(ob), ClothModifierData *clmd)
 {
 	Cloth *cloth = clmd->clothObject;
@@ -91,6 +251,7 @@ int BPH_cloth_solver_init(Object *UNUSED(ob), ClothModifierData *clmd)
 	
 	nondiag = cloth_count_nondiag_blocks(cloth);
 	cloth->implicit = id = BPH_mass_spring_solver_create(cloth->mvert_num, nondiag);
+	cloth->spring_batches = cloth_spring_batches_create(cloth);
 	
 	for (i = 0; i < cloth->mvert_num; i++) {
 		BPH_mass_spring_set_vertex_mass(id, i, verts[i].mass);
@@ -111,6 +272,10 @@ void BPH_cloth_solver_free(ClothModifierData *clmd)
 		BPH_mass_spring_solver_free(cloth->implicit);
 		cloth->implicit = NULL;
 	}
+	if (cloth->spring_batches) {
+		cloth_spring_batches_free(cloth->spring_batches);
+		cloth->spring_batches = NULL;
+	}
 }
 
 void BKE_cloth_solver_set_positions(ClothModifierData *clmd)
@@ -336,7 +501,7 @@ static int UNUSED_FUNCTION(cloth_calc_helper_forces)(Object *UNUSED(ob), ClothMo
 	return 1;
 }
 
-BLI_INLINE void cloth_calc_spring_force(ClothModifierData *clmd, ClothSpring *s, float struct_plast,
+BLI_INLINE void cloth_calc_spring_force(ClothModifierData *clmd, ClothSpring *s, int block, float struct_plast,
                                         float bend_plast, bool collision_pass)
 {
 	Cloth *cloth = clmd->clothObject;
@@ -383,7 +548,7 @@ BLI_INLINE void cloth_calc_spring_force(ClothModifierData *clmd, ClothSpring *s,
 
 			// TODO: verify, half verified (couldn't see error)
 			// sewing springs usually have a large distance at first so clamp the force so we don't get tunnelling through colission objects
-			BPH_mass_spring_force_spring_linear(data, s->ij, s->kl, s->restlen, &s->lenfact, k_tension, 0.0f,
+			BPH_mass_spring_force_spring_linear(data, s->ij, s->kl, block, s->restlen, &s->lenfact, k_tension, 0.0f,
 			                                    d_tension, 0.0f, no_compress, parms->max_sewing, 0.0f, 1.0f, false);
 		}
 		else {
@@ -403,7 +568,7 @@ BLI_INLINE void cloth_calc_spring_force(ClothModifierData *clmd, ClothSpring *s,
 				d_compression = 0;
 			}
 
-			BPH_mass_spring_force_spring_linear(data, s->ij, s->kl, s->restlen, &s->lenfact, k_tension, k_compression,
+			BPH_mass_spring_force_spring_linear(data, s->ij, s->kl, block, s->restlen, &s->lenfact, k_tension, k_compression,
 			                                    d_tension, d_compression, no_compress, 0.0f,
 			                                    struct_plast, parms->struct_yield_fact, !collision_pass);
 		}
@@ -426,7 +591,7 @@ BLI_INLINE void cloth_calc_spring_force(ClothModifierData *clmd, ClothSpring *s,
 			d = parms->shear_damp * 10000;
 		}
 
-		BPH_mass_spring_force_spring_linear(data, s->ij, s->kl, s->restlen, &s->lenfact, k, 0.0f, d, 0.0f, true, 0.0f,
+		BPH_mass_spring_force_spring_linear(data, s->ij, s->kl, block, s->restlen, &s->lenfact, k, 0.0f, d, 0.0f, true, 0.0f,
 		                                    struct_plast, parms->struct_yield_fact, !collision_pass);
 #endif
 	}
@@ -447,7 +612,7 @@ BLI_INLINE void cloth_calc_spring_force(ClothModifierData *clmd, ClothSpring *s,
 		cb = kb * 0.5f; // this was multiplied by a constant parms->bending_damping, which is no longer constant
 		
 		/* XXX assuming same restlen for ij and jk segments here, this can be done correctly for hair later */
-		BPH_mass_spring_force_spring_bending_hair(data, s->ij, s->kl, s->mn, s->target, kb, cb);
+		BPH_mass_spring_force_spring_bending_hair(data, s->ij, s->kl, s->mn, block, s->target, kb, cb);
 		
 #if 0
 		{
@@ -485,6 +650,31 @@ static void hair_get_boundbox(ClothModifierData *clmd, float gmin[3], float gmax
 	}
 }
 
+typedef struct ClothSpringForceData {
+	ClothModifierData *clmd;
+	const ClothSpringBatches *batches;
+	int block_offset;
+	float struct_plast, bend_plast;
+	bool collision_pass;
+} ClothSpringForceData;
+
+static void cloth_calc_spring_force_cb(void *__restrict userdata, const int start, const int stop, const int UNUSED(thread_id))
+{
+	ClothSpringForceData *data = (ClothSpringForceData *)userdata;
+	const ClothSpringBatches *batches = data->batches;
+
+	for (int c = start; c < stop; c++) {
+		for (int i = batches->chunk_start[c]; i < batches->chunk_start[c + 1]; i++) {
+			ClothSpring *spring = batches->springs[i];
+			// only handle active springs
+			if (!(spring->flags & CLOTH_SPRING_FLAG_DEACTIVATE)) {
+				cloth_calc_spring_force(data->clmd, spring, data->block_offset + batches->blocks[i],
+				                        data->struct_plast, data->bend_plast, data->collision_pass);
+			}
+		}
+	}
+}
+
 static void cloth_calc_force(ClothModifierData *clmd, float UNUSED(frame), ListBase *effectors, float time, bool collision_pass)
 {
 	/* Collect forces and derivatives:  F, dFdX, dFdV */
@@ -618,11 +808,42 @@ static void cloth_calc_force(ClothModifierData *clmd, float UNUSED(frame), ListB
 	}
 
 	// calculate spring forces
-	for (LinkNode *link = cloth->springs; link; link = link->next) {
-		ClothSpring *spring = (ClothSpring *)link->link;
-		// only handle active springs
-		if (!(spring->flags & CLOTH_SPRING_FLAG_DEACTIVATE))
-			cloth_calc_spring_force(clmd, spring, struct_plast, bend_plast, collision_pass);
+	if (BLI_system_thread_count() == 1) {
+		/* batches only pay off with multiple threads, list order has better memory locality */
+		for (LinkNode *link = cloth->springs; link; link = link->next) {
+			ClothSpring *spring = (ClothSpring *)link->link;
+			// only handle active springs
+			if (!(spring->flags & CLOTH_SPRING_FLAG_DEACTIVATE))
+				cloth_calc_spring_force(clmd, spring, -1, struct_plast, bend_plast, collision_pass);
+		}
+		return;
+	}
+
+	ClothSpringBatches *batches = cloth->spring_batches;
+	ClothSpringForceData spring_data;
+
+	spring_data.clmd = clmd;
+	spring_data.batches = batches;
+	spring_data.struct_plast = struct_plast;
+	spring_data.bend_plast = bend_plast;
+	spring_data.collision_pass = collision_pass;
+
+	for (int b = 0; b <= CLOTH_SPRING_BATCHES_MAX; b++) {
+		const int start = batches->batch_start[b], stop = batches->batch_start[b + 1];
+
+		if (start == stop) {
+			continue;
+		}
+
+		spring_data.block_offset = BPH_mass_spring_reserve_blocks(data, batches->batch_blocks[b]);
+
+		if (b < CLOTH_SPRING_BATCHES_MAX) {
+			BLI_task_parallel_for(start, stop, &spring_data, cloth_calc_spring_force_cb, 1);
+		}
+		else {
+			/* chunks overlapping with all other batches */
+			cloth_calc_spring_force_cb(&spring_data, start, stop, 0);
+		}
 	}
 }
 
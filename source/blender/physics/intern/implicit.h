@@ -115,19 +115,24 @@ void BPH_mass_spring_force_face_wind(struct Implicit_Data *data, int v1, int v2,
 void BPH_mass_spring_force_edge_wind(struct Implicit_Data *data, int v1, int v2, float radius1, float radius2, const float (*winvec)[3]);
 /* Wind force, acting on a vertex */
 void BPH_mass_spring_force_vertex_wind(struct Implicit_Data *data, int v, float radius, const float (*winvec)[3]);
-/* Linear spring force between two points */
-bool BPH_mass_spring_force_spring_linear(struct Implicit_Data *data, int i, int j, float restlen, float *lenfact,
+/* Off-diagonal matrix blocks of spring forces are allocated in the order forces are added.
+ * To add spring forces from multiple threads, blocks are reserved up front instead,
+ * and the first block of each spring is passed to its force function (-1 to allocate as usual).
+ * Returns the first reserved block. */
+int BPH_mass_spring_reserve_blocks(struct Implicit_Data *data, int num);
+/* Linear spring force between two points, uses 1 block */
+bool BPH_mass_spring_force_spring_linear(struct Implicit_Data *data, int i, int j, int block, float restlen, float *lenfact,
                                          float tension, float compression, float damp_tension, float damp_compression,
 					 bool no_compress, float clamp_force, float plasticity, float yield_fact, bool do_plast);
 /* Angular spring force between two polygons */
 bool BPH_mass_spring_force_spring_angular(struct Implicit_Data *data, int i, int j, int *i_a, int *i_b, int len_a, int len_b,
                                           float restangorig, float *angoffset, float stiffness, float damping,
 					  float plasticity, float yield_ang, bool do_plast);
-/* Bending force, forming a triangle at the base of two structural springs */
-bool BPH_mass_spring_force_spring_bending(struct Implicit_Data *data, int i, int j, float restlen,
+/* Bending force, forming a triangle at the base of two structural springs, uses 1 block */
+bool BPH_mass_spring_force_spring_bending(struct Implicit_Data *data, int i, int j, int block, float restlen,
                                           float kb, float cb);
-/* Angular bending force based on local target vectors */
-bool BPH_mass_spring_force_spring_bending_hair(struct Implicit_Data *data, int i, int j, int k,
+/* Angular bending force based on local target vectors, uses 3 blocks */
+bool BPH_mass_spring_force_spring_bending_hair(struct Implicit_Data *data, int i, int j, int k, int block,
                                                   const float target[3], float stiffness, float damping);
 /* Global goal spring */
 bool BPH_mass_spring_force_spring_goal(struct Implicit_Data *data, int i, const float goal_x[3], const float goal_v[3],
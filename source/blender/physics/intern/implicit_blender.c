@@ -44,6 +44,7 @@
 #include "BLI_alloca.h"
 #include "BLI_math.h"
 #include "BLI_linklist.h"
+#include "BLI_task.h"
 #include "BLI_utildefines.h"
 
 #include "BKE_cloth.h"
@@ -632,6 +633,89 @@ DO_INLINE void subadd_bfmatrixS_bfmatrixS( fmatrix3x3 *to, fmatrix3x3 *from, flo
 
 }
 
+///////////////////////////
+// SPARSE SYMMETRIC big matrix in compressed row layout
+///////////////////////////
+
+/* Rows of a big matrix, each listing the blocks multiplied with the long vector
+ * for that row. Off-diagonal blocks are stored in both rows they contribute to,
+ * so rows can be multiplied independently (in parallel) and blocks are read
+ * in the order they are stored in. */
+typedef struct bfmatrixRows {
+	unsigned int *row_start;	/* first entry of each row, vcount + 1 items */
+	unsigned int *column;		/* column (vertex) of each entry */
+	float (*block)[3][3];		/* block of each entry */
+} bfmatrixRows;
+
+DO_INLINE void create_bfmatrix_rows(bfmatrixRows *rows, unsigned int verts, unsigned int springs)
+{
+	const unsigned int entries = verts + 2 * springs;
+
+	rows->row_start = MEM_callocN(sizeof(*rows->row_start) * (verts + 1), "cloth_implicit_alloc_rows");
+	rows->column = MEM_mallocN(sizeof(*rows->column) * entries, "cloth_implicit_alloc_rows_column");
+	rows->block = MEM_mallocN(sizeof(*rows->block) * entries, "cloth_implicit_alloc_rows_block");
+}
+
+DO_INLINE void del_bfmatrix_rows(bfmatrixRows *rows)
+{
+	MEM_SAFE_FREE(rows->row_start);
+	MEM_SAFE_FREE(rows->column);
+	MEM_SAFE_FREE(rows->block);
+}
+
+/* Fill rows from a big matrix, as multiplied by mul_bfmatrix_lfvector. */
+DO_INLINE void cp_bfmatrix_rows(bfmatrixRows *rows, fmatrix3x3 *from)
+{
+	const unsigned int vcount = from[0].vcount;
+	const unsigned int tot = from[0].vcount + from[0].scount;
+	unsigned int *row_start = rows->row_start;
+	unsigned int i;
+
+	/* count entries, one for the diagonal block of each row */
+	for (i = 0; i < vcount; i++) {
+		row_start[i] = 1;
+	}
+	row_start[vcount] = 0;
+	for (i = vcount; i < tot; i++) {
+		row_start[from[i].r]++;
+		row_start[from[i].c]++;
+	}
+
+	/* turn counts into offsets to the end of each row */
+	for (i = 1; i <= vcount; i++) {
+		row_start[i] += row_start[i - 1];
+	}
+
+	/* fill rows backwards, decreasing offsets down to the row start */
+	for (i = tot; i-- > vcount; ) {
+		unsigned int e;
+
+		e = --row_start[from[i].r];
+		rows->column[e] = from[i].c;
+		copy_m3_m3(rows->block[e], from[i].m);
+
+		e = --row_start[from[i].c];
+		rows->column[e] = from[i].r;
+		copy_m3_m3(rows->block[e], from[i].m);
+	}
+	for (i = vcount; i-- > 0; ) {
+		const unsigned int e = --row_start[i];
+		rows->column[e] = i;
+		copy_m3_m3(rows->block[e], from[i].m);
+	}
+}
+
+/* to = rows * fLongVector, for a single row */
+BLI_INLINE void mul_bfmatrix_rows_fvector(float to[3], const bfmatrixRows *rows, lfVector *fLongVector, unsigned int row)
+{
+	unsigned int e;
+
+	zero_v3(to);
+	for (e = rows->row_start[row]; e < rows->row_start[row + 1]; e++) {
+		muladd_fmatrix_fvector(to, rows->block[e], fLongVector[rows->column[e]]);
+	}
+}
+
 ///////////////////////////////////////////////////////////////////
 // simulator start
 ///////////////////////////////////////////////////////////////////
@@ -657,6 +741,7 @@ typedef struct Implicit_Data  {
 	lfVector *z;				/* target velocity in constrained directions */
 	fmatrix3x3 *S;				/* filtering matrix for constraints */
 	fmatrix3x3 *P, *Pinv;		/* pre-conditioning matrix */
+	bfmatrixRows Arows;			/* A in compressed row layout, for the solver */
 } Implicit_Data;
 
 Implicit_Data *BPH_mass_spring_solver_create(int numverts, int numsprings)
@@ -673,6 +758,7 @@ Implicit_Data *BPH_mass_spring_solver_create(int numverts, int numsprings)
 	id->P = create_bfmatrix(numverts, numsprings);
 	id->bigI = create_bfmatrix(numverts, numsprings); // TODO 0 springs
 	id->M = create_bfmatrix(numverts, numsprings);
+	create_bfmatrix_rows(&id->Arows, numverts, numsprings);
 	id->X = create_lfvector(numverts);
 	id->Xnew = create_lfvector(numverts);
 	id->V = create_lfvector(numverts);
@@ -698,6 +784,7 @@ void BPH_mass_spring_solver_free(Implicit_Data *id)
 	del_bfmatrix(id->Pinv);
 	del_bfmatrix(id->bigI);
 	del_bfmatrix(id->M);
+	del_bfmatrix_rows(&id->Arows);
 	
 	del_lfvector(id->X);
 	del_lfvector(id->Xnew);
@@ -815,40 +902,205 @@ static int  cg_filtered(lfVector *ldV, fmatrix3x3 *lA, lfVector *lB, lfVector *z
 }
 #endif
 
-static int cg_filtered(lfVector *ldV, fmatrix3x3 *lA, lfVector *lB, lfVector *z, fmatrix3x3 *S, ImplicitSolverResult *result)
+/* Number of vertices in the fixed blocks the solver loops are split into.
+ * Partial dot products of blocks are summed in order afterwards, so results
+ * don't depend on the number of threads (floating point addition is not associative). */
+#define CG_BLOCK_SIZE 1024
+
+typedef struct CGData {
+	const bfmatrixRows *A;
+	fmatrix3x3 *S;
+	fmatrix3x3 *Pinv;
+	lfVector *B, *z;
+	lfVector *dV, *r, *c, *q, *s;
+	float *dot_a, *dot_b;	/* partial dot products of each block */
+	unsigned int numverts;
+	float alpha, beta;
+} CGData;
+
+BLI_INLINE void cg_block_range(const CGData *data, const int block, unsigned int *r_start, unsigned int *r_stop)
+{
+	*r_start = (unsigned int)block * CG_BLOCK_SIZE;
+	*r_stop = *r_start + CG_BLOCK_SIZE;
+	if (*r_stop > data->numverts) {
+		*r_stop = data->numverts;
+	}
+}
+
+static float cg_sum_blocks(const float *dot, const int numblocks)
+{
+	float sum = 0.0f;
+	int b;
+
+	for (b = 0; b < numblocks; b++) {
+		sum += dot[b];
+	}
+	return sum;
+}
+
+/* Block Jacobi preconditioner: inverse of the (symmetrized) diagonal block of A,
+ * falls back to identity when the block is not positive definite. */
+BLI_INLINE void cg_precond_block(float Pinv[3][3], float Aii[3][3])
+{
+	float D[3][3];
+	int i, j;
+
+	for (i = 0; i < 3; i++) {
+		for (j = 0; j < 3; j++) {
+			D[i][j] = 0.5f * (Aii[i][j] + Aii[j][i]);
+		}
+	}
+
+	if (D[0][0] > 0.0f &&
+	    D[0][0] * D[1][1] - D[0][1] * D[1][0] > 0.0f &&
+	    determinant_m3_array(D) > 0.0f &&
+	    invert_m3_m3(Pinv, D))
+	{
+		return;
+	}
+	unit_m3(Pinv);
+}
+
+/* dV = z, r = filter(B - A * dV), c = filter(P^-1 * r),
+ * dot_a = filter(B)^T * P^-1 * filter(B), dot_b = r^T * c */
+static void cg_init_cb(void *__restrict userdata, const int start, const int stop, const int UNUSED(thread_id))
+{
+	CGData *data = userdata;
+	const bfmatrixRows *A = data->A;
+	int b;
+
+	for (b = start; b < stop; b++) {
+		unsigned int i, i_start, i_stop;
+		float dot_a = 0.0f, dot_b = 0.0f;
+
+		cg_block_range(data, b, &i_start, &i_stop);
+		for (i = i_start; i < i_stop; i++) {
+			float AdV[3], fB[3], PfB[3];
+
+			/* diagonal block is the first of each row */
+			cg_precond_block(data->Pinv[i].m, A->block[A->row_start[i]]);
+
+			copy_v3_v3(data->dV[i], data->z[i]);
+
+			mul_bfmatrix_rows_fvector(AdV, A, data->dV, i);
+			sub_v3_v3v3(data->r[i], data->B[i], AdV);
+			mul_m3_v3(data->S[i].m, data->r[i]);
+
+			copy_v3_v3(fB, data->B[i]);
+			mul_m3_v3(data->S[i].m, fB);
+			mul_fmatrix_fvector(PfB, data->Pinv[i].m, fB);
+			dot_a += dot_v3v3(fB, PfB);
+
+			mul_fmatrix_fvector(data->c[i], data->Pinv[i].m, data->r[i]);
+			mul_m3_v3(data->S[i].m, data->c[i]);
+			dot_b += dot_v3v3(data->r[i], data->c[i]);
+		}
+		data->dot_a[b] = dot_a;
+		data->dot_b[b] = dot_b;
+	}
+}
+
+/* q = filter(A * c), dot_a = c^T * q */
+static void cg_mul_cb(void *__restrict userdata, const int start, const int stop, const int UNUSED(thread_id))
+{
+	CGData *data = userdata;
+	int b;
+
+	for (b = start; b < stop; b++) {
+		unsigned int i, i_start, i_stop;
+		float dot_a = 0.0f;
+
+		cg_block_range(data, b, &i_start, &i_stop);
+		for (i = i_start; i < i_stop; i++) {
+			mul_bfmatrix_rows_fvector(data->q[i], data->A, data->c, i);
+			mul_m3_v3(data->S[i].m, data->q[i]);
+			dot_a += dot_v3v3(data->c[i], data->q[i]);
+		}
+		data->dot_a[b] = dot_a;
+	}
+}
+
+/* dV += alpha * c, r -= alpha * q, s = P^-1 * r, dot_b = r^T * s */
+static void cg_update_cb(void *__restrict userdata, const int start, const int stop, const int UNUSED(thread_id))
+{
+	CGData *data = userdata;
+	const float alpha = data->alpha;
+	int b;
+
+	for (b = start; b < stop; b++) {
+		unsigned int i, i_start, i_stop;
+		float dot_b = 0.0f;
+
+		cg_block_range(data, b, &i_start, &i_stop);
+		for (i = i_start; i < i_stop; i++) {
+			madd_v3_v3fl(data->dV[i], data->c[i], alpha);
+			madd_v3_v3fl(data->r[i], data->q[i], -alpha);
+			mul_fmatrix_fvector(data->s[i], data->Pinv[i].m, data->r[i]);
+			dot_b += dot_v3v3(data->r[i], data->s[i]);
+		}
+		data->dot_b[b] = dot_b;
+	}
+}
+
+/* c = filter(s + beta * c) */
+static void cg_direction_cb(void *__restrict userdata, const int start, const int stop, const int UNUSED(thread_id))
+{
+	CGData *data = userdata;
+	const float beta = data->beta;
+	int b;
+
+	for (b = start; b < stop; b++) {
+		unsigned int i, i_start, i_stop;
+
+		cg_block_range(data, b, &i_start, &i_stop);
+		for (i = i_start; i < i_stop; i++) {
+			VECADDS(data->c[i], data->s[i], data->c[i], beta);
+			mul_m3_v3(data->S[i].m, data->c[i]);
+		}
+	}
+}
+
+/* Preconditioned conjugate gradient, with constraints filtering as in [Baraff & Witkin 1998].
+ * Each step of the loop is a single pass over the vertices, done in parallel over fixed blocks
+ * of vertices. A is multiplied row by row from its compressed row layout (filled from lA into rows),
+ * and the block Jacobi preconditioner is stored in Pinv. */
+static int cg_filtered(lfVector *ldV, fmatrix3x3 *lA, lfVector *lB, lfVector *z, fmatrix3x3 *S,
+                       fmatrix3x3 *Pinv, bfmatrixRows *rows, ImplicitSolverResult *result)
 {
 	// Solves for unknown X in equation AX=B
 	unsigned int conjgrad_loopcount=0, conjgrad_looplimit=100;
 	float conjgrad_epsilon=0.01f;
 	
 	unsigned int numverts = lA[0].vcount;
-	lfVector *fB = create_lfvector(numverts);
-	lfVector *AdV = create_lfvector(numverts);
-	lfVector *r = create_lfvector(numverts);
-	lfVector *c = create_lfvector(numverts);
-	lfVector *q = create_lfvector(numverts);
-	lfVector *s = create_lfvector(numverts);
-	float bnorm2, delta_new, delta_old, delta_target, alpha;
-	
-	cp_lfvector(ldV, z, numverts);
-	
-	/* d0 = filter(B)^T * P * filter(B) */
-	cp_lfvector(fB, lB, numverts);
-	filter(fB, S);
-	bnorm2 = dot_lfvector(fB, fB, numverts);
+	const int numblocks = (int)((numverts + CG_BLOCK_SIZE - 1) / CG_BLOCK_SIZE);
+	float bnorm2, delta_new, delta_old, delta_target;
+	CGData data;
+	
+	cp_bfmatrix_rows(rows, lA);
+	
+	data.A = rows;
+	data.S = S;
+	data.Pinv = Pinv;
+	data.B = lB;
+	data.z = z;
+	data.dV = ldV;
+	data.r = create_lfvector(numverts);
+	data.c = create_lfvector(numverts);
+	data.q = create_lfvector(numverts);
+	data.s = create_lfvector(numverts);
+	data.dot_a = MEM_mallocN(sizeof(float) * numblocks, "cloth_implicit_alloc_dot");
+	data.dot_b = MEM_mallocN(sizeof(float) * numblocks, "cloth_implicit_alloc_dot");
+	data.numverts = numverts;
+	
+	/* dV = z, r = filter(B - A * dV), c = filter(P^-1 * r) */
+	BLI_task_parallel_for(0, numblocks, &data, cg_init_cb, 1);
+	
+	/* d0 = filter(B)^T * P^-1 * filter(B) */
+	bnorm2 = cg_sum_blocks(data.dot_a, numblocks);
 	delta_target = conjgrad_epsilon*conjgrad_epsilon * bnorm2;
 	
-	/* r = filter(B - A * dV) */
-	mul_bfmatrix_lfvector(AdV, lA, ldV);
-	sub_lfvector_lfvector(r, lB, AdV, numverts);
-	filter(r, S);
-	
-	/* c = filter(P^-1 * r) */
-	cp_lfvector(c, r, numverts);
-	filter(c, S);
-	
 	/* delta = r^T * c */
-	delta_new = dot_lfvector(r, c, numverts);
+	delta_new = cg_sum_blocks(data.dot_b, numblocks);
 	
 #ifdef IMPLICIT_PRINT_SOLVER_INPUT_OUTPUT
 	printf("==== A ====\n");
@@ -862,22 +1114,20 @@ static int cg_filtered(lfVector *ldV, fmatrix3x3 *lA, lfVector *lB, lfVector *z,
 #endif
 	
 	while (delta_new > delta_target && conjgrad_loopcount < conjgrad_looplimit) {
-		mul_bfmatrix_lfvector(q, lA, c);
-		filter(q, S);
+		/* q = filter(A * c) */
+		BLI_task_parallel_for(0, numblocks, &data, cg_mul_cb, 1);
 		
-		alpha = delta_new / dot_lfvector(c, q, numverts);
+		data.alpha = delta_new / cg_sum_blocks(data.dot_a, numblocks);
 		
-		add_lfvector_lfvectorS(ldV, ldV, c, alpha, numverts);
+		/* dV += alpha * c, r -= alpha * q, s = P^-1 * r */
+		BLI_task_parallel_for(0, numblocks, &data, cg_update_cb, 1);
 		
-		add_lfvector_lfvectorS(r, r, q, -alpha, numverts);
-		
-		/* s = P^-1 * r */
-		cp_lfvector(s, r, numverts);
 		delta_old = delta_new;
-		delta_new = dot_lfvector(r, s, numverts);
+		delta_new = cg_sum_blocks(data.dot_b, numblocks);
 		
-		add_lfvector_lfvectorS(c, s, c, delta_new / delta_old, numverts);
-		filter(c, S);
+		/* c = filter(s + beta * c) */
+		data.beta = delta_new / delta_old;
+		BLI_task_parallel_for(0, numblocks, &data, cg_direction_cb, 1);
 		
 		conjgrad_loopcount++;
 	}
@@ -888,12 +1138,12 @@ static int cg_filtered(lfVector *ldV, fmatrix3x3 *lA, lfVector *lB, lfVector *z,
 	printf("========\n");
 #endif
 	
-	del_lfvector(fB);
-	del_lfvector(AdV);
-	del_lfvector(r);
-	del_lfvector(c);
-	del_lfvector(q);
-	del_lfvector(s);
+	del_lfvector(data.r);
+	del_lfvector(data.c);
+	del_lfvector(data.q);
+	del_lfvector(data.s);
+	MEM_freeN(data.dot_a);
+	MEM_freeN(data.dot_b);
 	// printf("W/O conjgrad_loopcount: %d\n", conjgrad_loopcount);
 
 	result->status = conjgrad_loopcount < conjgrad_looplimit ? BPH_SOLVER_SUCCESS : BPH_SOLVER_NO_CONVERGENCE;
@@ -1118,7 +1368,7 @@ bool BPH_mass_spring_solve_velocities(Implicit_Data *data, float dt, ImplicitSol
 	double start = PIL_check_seconds_timer();
 #endif
 
-	cg_filtered(data->dV, data->A, data->B, data->z, data->S, result); /* conjugate gradient algorithm to solve Ax=b */
+	cg_filtered(data->dV, data->A, data->B, data->z, data->S, data->Pinv, &data->Arows, result); /* conjugate gradient algorithm to solve Ax=b */
 	// cg_filtered_pre(id->dV, id->A, id->B, id->z, id->S, id->P, id->Pinv, id->bigI);
 
 #ifdef DEBUG_TIME
@@ -1226,11 +1476,20 @@ void BPH_mass_spring_set_new_velocity(struct Implicit_Data *data, int index, con
 
 /* -------------------------------- */
 
-static int BPH_mass_spring_add_block(Implicit_Data *data, int v1, int v2)
+int BPH_mass_spring_reserve_blocks(Implicit_Data *data, int num)
 {
 	int s = data->M[0].vcount + data->num_blocks; /* index from array start */
-	BLI_assert(s < data->M[0].vcount + data->M[0].scount);
-	++data->num_blocks;
+	BLI_assert(data->num_blocks + num <= data->M[0].scount);
+	data->num_blocks += num;
+	
+	return s;
+}
+
+/* Use a reserved block for the v1, v2 interaction, or allocate one if block is -1 */
+static int BPH_mass_spring_add_block(Implicit_Data *data, int block, int v1, int v2)
+{
+	int s = (block != -1) ? block : BPH_mass_spring_reserve_blocks(data, 1);
+	BLI_assert(s >= data->M[0].vcount && s < data->M[0].vcount + data->num_blocks);
 	
 	/* tfm and S don't have spring entries (diagonal blocks only) */
 	init_fmatrix(data->bigI + s, v1, v2);
@@ -1573,9 +1832,9 @@ BLI_INLINE bool spring_length(Implicit_Data *data, int i, int j, float r_extent[
 	return true;
 }
 
-BLI_INLINE void apply_spring(Implicit_Data *data, int i, int j, const float f[3], float dfdx[3][3], float dfdv[3][3])
+BLI_INLINE void apply_spring(Implicit_Data *data, int i, int j, int block, const float f[3], float dfdx[3][3], float dfdv[3][3])
 {
-	int block_ij = BPH_mass_spring_add_block(data, i, j);
+	int block_ij = BPH_mass_spring_add_block(data, block, i, j);
 	
 	add_v3_v3(data->F[i], f);
 	sub_v3_v3(data->F[j], f);
@@ -1589,7 +1848,7 @@ BLI_INLINE void apply_spring(Implicit_Data *data, int i, int j, const float f[3]
 	sub_m3_m3m3(data->dFdV[block_ij].m, data->dFdV[block_ij].m, dfdv);
 }
 
-bool BPH_mass_spring_force_spring_linear(Implicit_Data *data, int i, int j, float restlenorig, float *lenfact,
+bool BPH_mass_spring_force_spring_linear(Implicit_Data *data, int i, int j, int block, float restlenorig, float *lenfact,
                                          float tension, float compression, float damp_tension, float damp_compression,
                                          bool no_compress, float clamp_force, float plasticity, float yield_fact, bool do_plast)
 {
@@ -1659,13 +1918,13 @@ bool BPH_mass_spring_force_spring_linear(Implicit_Data *data, int i, int j, floa
 	madd_v3_v3fl(f, dir, damping * dot_v3v3(vel, dir));
 	dfdv_damp(dfdv, dir, damping);
 
-	apply_spring(data, i, j, f, dfdx, dfdv);
+	apply_spring(data, i, j, block, f, dfdx, dfdv);
 
 	return true;
 }
 
 /* See "Stable but Responsive Cloth" (Choi, Ko 2005) */
-bool BPH_mass_spring_force_spring_bending(Implicit_Data *data, int i, int j, float restlen,
+bool BPH_mass_spring_force_spring_bending(Implicit_Data *data, int i, int j, int block, float restlen,
                                           float kb, float cb)
 {
 	float extent[3], length, dir[3], vel[3];
@@ -1684,7 +1943,7 @@ bool BPH_mass_spring_force_spring_bending(Implicit_Data *data, int i, int j, flo
 		/* XXX damping not supported */
 		zero_m3(dfdv);
 		
-		apply_spring(data, i, j, f, dfdx, dfdv);
+		apply_spring(data, i, j, block, f, dfdx, dfdv);
 		
 		return true;
 	}
@@ -1973,7 +2232,7 @@ BLI_INLINE void spring_hairbend_estimate_dfdv(Implicit_Data *data, int i, int j,
 /* Angular spring that pulls the vertex toward the local target
  * See "Artistic Simulation of Curly Hair" (Pixar technical memo #12-03a)
  */
-bool BPH_mass_spring_force_spring_bending_hair(Implicit_Data *data, int i, int j, int k,
+bool BPH_mass_spring_force_spring_bending_hair(Implicit_Data *data, int i, int j, int k, int block,
                                                   const float target[3], float stiffness, float damping)
 {
 	float goal[3];
@@ -1983,9 +2242,9 @@ bool BPH_mass_spring_force_spring_bending_hair(Implicit_Data *data, int i, int j
 	
 	const float vecnull[3] = {0.0f, 0.0f, 0.0f};
 	
-	int block_ij = BPH_mass_spring_add_block(data, i, j);
-	int block_jk = BPH_mass_spring_add_block(data, j, k);
-	int block_ik = BPH_mass_spring_add_block(data, i, k);
+	int block_ij = BPH_mass_spring_add_block(data, block, i, j);
+	int block_jk = BPH_mass_spring_add_block(data, (block != -1) ? block + 1 : -1, j, k);
+	int block_ik = BPH_mass_spring_add_block(data, (block != -1) ? block + 2 : -1, i, k);
 	
 	world_to_root_v3(data, j, goal, target);
 	
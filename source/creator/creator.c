@@ -65,6 +65,7 @@
 #include "BKE_sound.h"
 #include "BKE_image.h"
 #include "BKE_particle.h"
+#include "BKE_pointcache.h"
 
 
 #include "IMB_imbuf.h"  /* for IMB_init */
@@ -359,6 +360,7 @@ int main(
 
 	IMB_init();
 	BKE_cachefiles_init();
+	BKE_ptcache_io_init();
 	BKE_images_init();
 	BKE_modifier_init();
 	DAG_init();
@@ -156,6 +156,14 @@ TEST(ghash, TextGHash)
 	str_ghash_tests(ghash, "StrGHash - GHash");
 }
 
+TEST(ghash, TextGHashOpenAddressing)
+{
+	GHash *ghash = BLI_ghash_new(BLI_ghashutil_strhash_p, BLI_ghashutil_strcmp, __func__);
+
+	BLI_ghash_flag_set(ghash, GHASH_FLAG_OPEN_ADDRESSING);
+	str_ghash_tests(ghash, "StrGHash - GHash Open Addressing");
+}
+
 TEST(ghash, TextMurmur2a)
 {
 	GHash *ghash = BLI_ghash_new(BLI_ghashutil_strhash_p_murmur, BLI_ghashutil_strcmp, __func__);
@@ -228,6 +236,14 @@ TEST(ghash, IntGHash12000)
 	int_ghash_tests(ghash, "IntGHash - GHash - 12000", 12000);
 }
 
+TEST(ghash, IntGHashOpenAddressing12000)
+{
+	GHash *ghash = BLI_ghash_new(BLI_ghashutil_inthash_p, BLI_ghashutil_intcmp, __func__);
+
+	BLI_ghash_flag_set(ghash, GHASH_FLAG_OPEN_ADDRESSING);
+	int_ghash_tests(ghash, "IntGHash - GHash Open Addressing - 12000", 12000);
+}
+
 #ifdef GHASH_RUN_BIG
 TEST(ghash, IntGHash100000000)
 {
@@ -310,6 +326,14 @@ TEST(ghash, IntRandGHash12000)
 	randint_ghash_tests(ghash, "RandIntGHash - GHash - 12000", 12000);
 }
 
+TEST(ghash, IntRandGHashOpenAddressing12000)
+{
+	GHash *ghash = BLI_ghash_new(BLI_ghashutil_inthash_p, BLI_ghashutil_intcmp, __func__);
+
+	BLI_ghash_flag_set(ghash, GHASH_FLAG_OPEN_ADDRESSING);
+	randint_ghash_tests(ghash, "RandIntGHash - GHash Open Addressing - 12000", 12000);
+}
+
 #ifdef GHASH_RUN_BIG
 TEST(ghash, IntRandGHash50000000)
 {
@@ -422,6 +446,14 @@ TEST(ghash, Int4GHash2000)
 	int4_ghash_tests(ghash, "Int4GHash - GHash - 2000", 2000);
 }
 
+TEST(ghash, Int4GHashOpenAddressing2000)
+{
+	GHash *ghash = BLI_ghash_new(BLI_ghashutil_uinthash_v4_p, BLI_ghashutil_uinthash_v4_cmp, __func__);
+
+	BLI_ghash_flag_set(ghash, GHASH_FLAG_OPEN_ADDRESSING);
+	int4_ghash_tests(ghash, "Int4GHash - GHash Open Addressing - 2000", 2000);
+}
+
 #ifdef GHASH_RUN_BIG
 TEST(ghash, Int4GHash20000000)
 {
@@ -514,6 +546,14 @@ TEST(ghash, MultiRandIntGHash2000)
 	multi_small_ghash_tests(ghash, "MultiSmall RandIntGHash - GHash - 2000", 2000);
 }
 
+TEST(ghash, MultiRandIntGHashOpenAddressing2000)
+{
+	GHash *ghash = BLI_ghash_new(BLI_ghashutil_inthash_p, BLI_ghashutil_intcmp, __func__);
+
+	BLI_ghash_flag_set(ghash, GHASH_FLAG_OPEN_ADDRESSING);
+	multi_small_ghash_tests(ghash, "MultiSmall RandIntGHash - GHash Open Addressing - 2000", 2000);
+}
+
 TEST(ghash, MultiRandIntGHash200000)
 {
 	GHash *ghash = BLI_ghash_new(BLI_ghashutil_inthash_p, BLI_ghashutil_intcmp, __func__);
@@ -521,6 +561,14 @@ TEST(ghash, MultiRandIntGHash200000)
 	multi_small_ghash_tests(ghash, "MultiSmall RandIntGHash - GHash - 200000", 200000);
 }
 
+TEST(ghash, MultiRandIntGHashOpenAddressing200000)
+{
+	GHash *ghash = BLI_ghash_new(BLI_ghashutil_inthash_p, BLI_ghashutil_intcmp, __func__);
+
+	BLI_ghash_flag_set(ghash, GHASH_FLAG_OPEN_ADDRESSING);
+	multi_small_ghash_tests(ghash, "MultiSmall RandIntGHash - GHash Open Addressing - 200000", 200000);
+}
+
 TEST(ghash, MultiRandIntMurmur2a2000)
 {
 	GHash *ghash = BLI_ghash_new(BLI_ghashutil_inthash_p_murmur, BLI_ghashutil_intcmp, __func__);
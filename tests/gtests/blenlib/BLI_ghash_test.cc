@@ -198,3 +198,131 @@ TEST(ghash, Pop)
 
 	BLI_ghash_free(ghash, NULL, NULL);
 }
+
+/* Open addressing: insert, lookup, iterate and remove with shrinking. */
+TEST(ghash, OpenAddressingInsertLookupRemove)
+{
+	GHash *ghash = BLI_ghash_new(BLI_ghashutil_inthash_p, BLI_ghashutil_intcmp, __func__);
+	unsigned int keys[TESTCASE_SIZE], *k;
+	int i, bkt_size;
+
+	BLI_ghash_flag_set(ghash, GHASH_FLAG_OPEN_ADDRESSING | GHASH_FLAG_ALLOW_SHRINK);
+	init_keys(keys, 40);
+
+	for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+		BLI_ghash_insert(ghash, SET_UINT_IN_POINTER(*k), SET_UINT_IN_POINTER(*k));
+	}
+
+	EXPECT_EQ(BLI_ghash_size(ghash), TESTCASE_SIZE);
+	bkt_size = BLI_ghash_buckets_size(ghash);
+
+	for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+		void *v = BLI_ghash_lookup(ghash, SET_UINT_IN_POINTER(*k));
+		EXPECT_EQ(GET_UINT_FROM_POINTER(v), *k);
+	}
+
+	{
+		GHashIterator gh_iter;
+		int count = 0;
+		GHASH_ITER (gh_iter, ghash) {
+			EXPECT_EQ(BLI_ghashIterator_getKey(&gh_iter), BLI_ghashIterator_getValue(&gh_iter));
+			count++;
+		}
+		EXPECT_EQ(count, TESTCASE_SIZE);
+	}
+
+	/* Remove every other key, the remaining ones must still be found. */
+	for (i = 0, k = keys; i < TESTCASE_SIZE; i++, k++) {
+		if (i % 2) {
+			void *v = BLI_ghash_popkey(ghash, SET_UINT_IN_POINTER(*k), NULL);
+			EXPECT_EQ(GET_UINT_FROM_POINTER(v), *k);
+		}
+	}
+	for (i = 0, k = keys; i < TESTCASE_SIZE; i++, k++) {
+		EXPECT_EQ(BLI_ghash_haskey(ghash, SET_UINT_IN_POINTER(*k)), (i % 2) == 0);
+	}
+	for (i = 0, k = keys; i < TESTCASE_SIZE; i++, k++) {
+		if ((i % 2) == 0) {
+			EXPECT_TRUE(BLI_ghash_remove(ghash, SET_UINT_IN_POINTER(*k), NULL, NULL));
+		}
+	}
+
+	EXPECT_EQ(BLI_ghash_size(ghash), 0);
+	EXPECT_LT(BLI_ghash_buckets_size(ghash), bkt_size);
+
+	BLI_ghash_free(ghash, NULL, NULL);
+}
+
+/* Open addressing: ensure_p, reinsert, copy and pop. */
+TEST(ghash, OpenAddressingEnsureCopyPop)
+{
+	GHash *ghash = BLI_ghash_new(BLI_ghashutil_inthash_p, BLI_ghashutil_intcmp, __func__);
+	GHash *ghash_copy;
+	unsigned int keys[TESTCASE_SIZE], *k;
+	int i;
+
+	BLI_ghash_flag_set(ghash, GHASH_FLAG_OPEN_ADDRESSING);
+	init_keys(keys, 50);
+
+	for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+		void **val_p;
+		if (!BLI_ghash_ensure_p(ghash, SET_UINT_IN_POINTER(*k), &val_p)) {
+			*val_p = SET_UINT_IN_POINTER(*k);
+		}
+	}
+	for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+		EXPECT_FALSE(BLI_ghash_reinsert(ghash, SET_UINT_IN_POINTER(*k), SET_UINT_IN_POINTER(*k), NULL, NULL));
+	}
+
+	EXPECT_EQ(BLI_ghash_size(ghash), TESTCASE_SIZE);
+
+	ghash_copy = BLI_ghash_copy(ghash, NULL, NULL);
+
+	EXPECT_EQ(BLI_ghash_size(ghash_copy), TESTCASE_SIZE);
+	EXPECT_EQ(BLI_ghash_buckets_size(ghash_copy), BLI_ghash_buckets_size(ghash));
+
+	for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+		void *v = BLI_ghash_lookup(ghash_copy, SET_UINT_IN_POINTER(*k));
+		EXPECT_EQ(GET_UINT_FROM_POINTER(v), *k);
+	}
+
+	GHashIterState pop_state = {0};
+	{
+		void *k, *v;
+		while (BLI_ghash_pop(ghash, &pop_state, &k, &v)) {
+			EXPECT_EQ(k, v);
+		}
+	}
+	EXPECT_EQ(BLI_ghash_size(ghash), 0);
+
+	BLI_ghash_free(ghash, NULL, NULL);
+	BLI_ghash_free(ghash_copy, NULL, NULL);
+}
+
+/* Switching storage keeps the entries. */
+TEST(ghash, OpenAddressingSwitchStorage)
+{
+	GHash *ghash = BLI_ghash_new(BLI_ghashutil_inthash_p, BLI_ghashutil_intcmp, __func__);
+	unsigned int keys[TESTCASE_SIZE], *k;
+	int i;
+
+	init_keys(keys, 60);
+
+	for (i = 0, k = keys; i < TESTCASE_SIZE / 2; i++, k++) {
+		BLI_ghash_insert(ghash, SET_UINT_IN_POINTER(*k), SET_UINT_IN_POINTER(*k));
+	}
+	BLI_ghash_flag_set(ghash, GHASH_FLAG_OPEN_ADDRESSING);
+	for (; i < TESTCASE_SIZE; i++, k++) {
+		BLI_ghash_insert(ghash, SET_UINT_IN_POINTER(*k), SET_UINT_IN_POINTER(*k));
+	}
+	BLI_ghash_flag_clear(ghash, GHASH_FLAG_OPEN_ADDRESSING);
+
+	EXPECT_EQ(BLI_ghash_size(ghash), TESTCASE_SIZE);
+
+	for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+		void *v = BLI_ghash_lookup(ghash, SET_UINT_IN_POINTER(*k));
+		EXPECT_EQ(GET_UINT_FROM_POINTER(v), *k);
+	}
+
+	BLI_ghash_free(ghash, NULL, NULL);
+}
@@ -0,0 +1,86 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+extern "C" {
+#include "BLI_compiler_attrs.h"
+#include "BLI_utildefines.h"
+#include "BLI_rand.h"
+}
+
+/* Number of values compared after skipping, enough to tell the 48 bit states apart. */
+#define NUM_COMPARE 8
+
+static void rng_skip_test(const unsigned int seed, const int n)
+{
+	RNG *rng_skip = BLI_rng_new(seed);
+	RNG *rng_step = BLI_rng_new(seed);
+
+	int value = 0;
+	BLI_rng_skip(rng_skip, n);
+	for (int i = 0; i < n; i++) {
+		value = BLI_rng_get_int(rng_step);
+	}
+	UNUSED_VARS(value);
+
+	for (int i = 0; i < NUM_COMPARE; i++) {
+		EXPECT_EQ(BLI_rng_get_int(rng_skip), BLI_rng_get_int(rng_step)) << "seed " << seed << ", n " << n;
+	}
+
+	BLI_rng_free(rng_skip);
+	BLI_rng_free(rng_step);
+}
+
+TEST(rand, RNGSkip)
+{
+	const unsigned int seeds[] = {0, 1, 12345, 0xFFFFFFFF};
+	const int skips[] = {0, 1, 2, 3, 7, 64, 1000, 65537, (1 << 24) + 12345};
+
+	for (int i = 0; i < (int)ARRAY_SIZE(seeds); i++) {
+		for (int j = 0; j < (int)ARRAY_SIZE(skips); j++) {
+			rng_skip_test(seeds[i], skips[j]);
+		}
+	}
+}
+
+/* Skipping in steps gives the same state as skipping at once. */
+TEST(rand, RNGSkipSplit)
+{
+	RNG *rng_once = BLI_rng_new(42);
+	RNG *rng_split = BLI_rng_new(42);
+
+	BLI_rng_skip(rng_once, 1000000);
+	for (int i = 0; i < 1000; i++) {
+		BLI_rng_skip(rng_split, 1000);
+	}
+
+	for (int i = 0; i < NUM_COMPARE; i++) {
+		EXPECT_EQ(BLI_rng_get_int(rng_once), BLI_rng_get_int(rng_split));
+	}
+
+	BLI_rng_free(rng_once);
+	BLI_rng_free(rng_split);
+}
+
+TEST(rand, RandSkip)
+{
+	const int skips[] = {0, 1, 1000, 65537};
+
+	for (int j = 0; j < (int)ARRAY_SIZE(skips); j++) {
+		int values[NUM_COMPARE];
+
+		BLI_srandom(7);
+		for (int i = 0; i < skips[j]; i++) {
+			values[0] = BLI_rand();
+		}
+		for (int i = 0; i < NUM_COMPARE; i++) {
+			values[i] = BLI_rand();
+		}
+
+		BLI_srandom(7);
+		BLI_rand_skip(skips[j]);
+		for (int i = 0; i < NUM_COMPARE; i++) {
+			EXPECT_EQ(BLI_rand(), values[i]) << "n " << skips[j];
+		}
+	}
+}
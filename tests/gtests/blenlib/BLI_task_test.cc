@@ -0,0 +1,445 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+extern "C" {
+#include "atomic_ops.h"
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_utildefines.h"
+#include "BLI_math_base.h"
+#include "BLI_task.h"
+#include "BLI_threads.h"
+};
+
+#define NUM_TASKS 10000
+#define NUM_SUBTASKS 16
+#define NUM_THREADS 8
+
+typedef struct TaskTestData {
+	unsigned int num_done;
+	unsigned int num_wrong_thread;
+} TaskTestData;
+
+static void task_count_func(TaskPool *__restrict pool, void *UNUSED(taskdata), int threadid)
+{
+	TaskTestData *data = (TaskTestData *)BLI_task_pool_userdata(pool);
+	if (threadid < 0 || threadid >= NUM_THREADS) {
+		atomic_add_and_fetch_u(&data->num_wrong_thread, 1);
+	}
+	atomic_add_and_fetch_u(&data->num_done, 1);
+}
+
+/* Pushes more tasks from the worker thread, those go to its own deque and get stolen by others. */
+static void task_push_subtasks_func(TaskPool *__restrict pool, void *UNUSED(taskdata), int threadid)
+{
+	for (int i = 0; i < NUM_SUBTASKS; i++) {
+		BLI_task_pool_push_from_thread(pool, task_count_func, NULL, false, TASK_PRIORITY_HIGH, threadid);
+	}
+	task_count_func(pool, NULL, threadid);
+}
+
+TEST(task, PoolPush)
+{
+	TaskTestData data = {0};
+
+	BLI_threadapi_init();
+	TaskScheduler *scheduler = BLI_task_scheduler_create(NUM_THREADS);
+	TaskPool *pool = BLI_task_pool_create(scheduler, &data);
+
+	for (int i = 0; i < NUM_TASKS; i++) {
+		BLI_task_pool_push(pool, task_count_func, NULL, false, TASK_PRIORITY_LOW);
+	}
+	BLI_task_pool_work_and_wait(pool);
+
+	EXPECT_EQ(data.num_done, NUM_TASKS);
+	EXPECT_EQ(data.num_wrong_thread, 0);
+
+	BLI_task_pool_free(pool);
+	BLI_task_scheduler_free(scheduler);
+	BLI_threadapi_exit();
+}
+
+TEST(task, PoolPushFromThread)
+{
+	TaskTestData data = {0};
+
+	BLI_threadapi_init();
+	TaskScheduler *scheduler = BLI_task_scheduler_create(NUM_THREADS);
+	TaskPool *pool = BLI_task_pool_create(scheduler, &data);
+
+	/* More than fits in the deque of the main thread. */
+	for (int i = 0; i < NUM_TASKS / NUM_SUBTASKS; i++) {
+		BLI_task_pool_push_from_thread(pool, task_push_subtasks_func, NULL, false, TASK_PRIORITY_HIGH, 0);
+	}
+	BLI_task_pool_work_and_wait(pool);
+
+	EXPECT_EQ(data.num_done, (NUM_TASKS / NUM_SUBTASKS) * (NUM_SUBTASKS + 1));
+	EXPECT_EQ(data.num_wrong_thread, 0);
+
+	/* Pool can be reused after waiting. */
+	data.num_done = 0;
+	for (int i = 0; i < NUM_TASKS / NUM_SUBTASKS; i++) {
+		BLI_task_pool_push(pool, task_push_subtasks_func, NULL, false, TASK_PRIORITY_HIGH);
+	}
+	BLI_task_pool_work_and_wait(pool);
+
+	EXPECT_EQ(data.num_done, (NUM_TASKS / NUM_SUBTASKS) * (NUM_SUBTASKS + 1));
+
+	BLI_task_pool_free(pool);
+	BLI_task_scheduler_free(scheduler);
+	BLI_threadapi_exit();
+}
+
+typedef struct NestedTestData {
+	TaskScheduler *scheduler;
+	unsigned int num_done;
+} NestedTestData;
+
+static void task_nested_inner_func(TaskPool *__restrict pool, void *UNUSED(taskdata), int UNUSED(threadid))
+{
+	unsigned int *num_done = (unsigned int *)BLI_task_pool_userdata(pool);
+	atomic_add_and_fetch_u(num_done, 1);
+}
+
+/* Creates and waits for a pool from a worker thread, which must only run its own tasks meanwhile. */
+static void task_nested_outer_func(TaskPool *__restrict pool, void *UNUSED(taskdata), int threadid)
+{
+	NestedTestData *data = (NestedTestData *)BLI_task_pool_userdata(pool);
+	unsigned int num_done = 0;
+
+	TaskPool *inner_pool = BLI_task_pool_create(data->scheduler, &num_done);
+	for (int i = 0; i < NUM_SUBTASKS; i++) {
+		BLI_task_pool_push_from_thread(
+		        inner_pool, task_nested_inner_func, NULL, false, TASK_PRIORITY_HIGH, threadid);
+	}
+	BLI_task_pool_work_and_wait(inner_pool);
+	BLI_task_pool_free(inner_pool);
+
+	if (num_done == NUM_SUBTASKS) {
+		atomic_add_and_fetch_u(&data->num_done, 1);
+	}
+}
+
+TEST(task, PoolNested)
+{
+	NestedTestData data = {NULL, 0};
+
+	BLI_threadapi_init();
+	data.scheduler = BLI_task_scheduler_create(NUM_THREADS);
+	TaskPool *pool = BLI_task_pool_create(data.scheduler, &data);
+
+	for (int i = 0; i < NUM_TASKS / NUM_SUBTASKS; i++) {
+		BLI_task_pool_push_from_thread(pool, task_nested_outer_func, NULL, false, TASK_PRIORITY_HIGH, 0);
+	}
+	BLI_task_pool_work_and_wait(pool);
+
+	EXPECT_EQ(data.num_done, NUM_TASKS / NUM_SUBTASKS);
+
+	BLI_task_pool_free(pool);
+	BLI_task_scheduler_free(data.scheduler);
+	BLI_threadapi_exit();
+}
+
+TEST(task, PoolCancel)
+{
+	TaskTestData data = {0};
+
+	BLI_threadapi_init();
+	TaskScheduler *scheduler = BLI_task_scheduler_create(NUM_THREADS);
+	TaskPool *pool = BLI_task_pool_create_suspended(scheduler, &data);
+
+	for (int i = 0; i < NUM_TASKS; i++) {
+		BLI_task_pool_push(pool, task_count_func, NULL, false, TASK_PRIORITY_HIGH);
+	}
+	BLI_task_pool_cancel(pool);
+
+	/* Suspended tasks are only given to the scheduler when waiting. */
+	BLI_task_pool_work_and_wait(pool);
+	EXPECT_EQ(data.num_done, NUM_TASKS);
+
+	BLI_task_pool_free(pool);
+	BLI_task_scheduler_free(scheduler);
+
+	/* Without worker threads nothing runs until waiting, so cancel must drop
+	 * every task, both from the shared queue and from the deque of this thread. */
+	scheduler = BLI_task_scheduler_create(1);
+	pool = BLI_task_pool_create(scheduler, &data);
+	data.num_done = 0;
+
+	for (int i = 0; i < NUM_TASKS; i++) {
+		BLI_task_pool_push(pool, task_count_func, NULL, false, TASK_PRIORITY_LOW);
+		BLI_task_pool_push_from_thread(pool, task_count_func, NULL, false, TASK_PRIORITY_HIGH, 0);
+	}
+	BLI_task_pool_cancel(pool);
+	BLI_task_pool_work_and_wait(pool);
+	EXPECT_EQ(data.num_done, 0);
+
+	/* Pool can be used again after cancel. */
+	for (int i = 0; i < NUM_TASKS; i++) {
+		BLI_task_pool_push_from_thread(pool, task_count_func, NULL, false, TASK_PRIORITY_HIGH, 0);
+	}
+	BLI_task_pool_work_and_wait(pool);
+	EXPECT_EQ(data.num_done, NUM_TASKS);
+
+	BLI_task_pool_free(pool);
+	BLI_task_scheduler_free(scheduler);
+	BLI_threadapi_exit();
+}
+
+#define NUM_ORDERED_TASKS 1000
+
+typedef struct OrderedTestData {
+	int order[NUM_ORDERED_TASKS + 2];
+	int num_done;
+} OrderedTestData;
+
+/* Few distinct values, so there are lots of equal priorities. */
+static float task_ordered_priority(int index)
+{
+	return (float)((index * 7919) % 37);
+}
+
+static void task_ordered_func(TaskPool *__restrict pool, void *taskdata, int UNUSED(threadid))
+{
+	OrderedTestData *data = (OrderedTestData *)BLI_task_pool_userdata(pool);
+	data->order[data->num_done++] = GET_INT_FROM_POINTER(taskdata);
+}
+
+static void task_ordered_test(const bool suspended)
+{
+	OrderedTestData data = {{0}};
+
+	/* Without worker threads tasks only run in this thread while waiting, in order. */
+	TaskScheduler *scheduler = BLI_task_scheduler_create(1);
+	TaskPool *pool = suspended ? BLI_task_pool_create_suspended(scheduler, &data) :
+	                             BLI_task_pool_create(scheduler, &data);
+
+	BLI_task_pool_push(pool, task_ordered_func, SET_INT_IN_POINTER(-2), false, TASK_PRIORITY_LOW);
+	for (int i = 0; i < NUM_ORDERED_TASKS; i++) {
+		BLI_task_pool_push_ordered(pool, task_ordered_func, SET_INT_IN_POINTER(i), false,
+		                           task_ordered_priority(i), -1);
+	}
+	BLI_task_pool_push(pool, task_ordered_func, SET_INT_IN_POINTER(-1), false, TASK_PRIORITY_HIGH);
+	BLI_task_pool_work_and_wait(pool);
+
+	ASSERT_EQ(data.num_done, NUM_ORDERED_TASKS + 2);
+	EXPECT_EQ(data.order[0], -1);
+	EXPECT_EQ(data.order[NUM_ORDERED_TASKS + 1], -2);
+
+	/* Decreasing priority, equal priorities in push order. */
+	for (int i = 2; i <= NUM_ORDERED_TASKS; i++) {
+		const int prev = data.order[i - 1], curr = data.order[i];
+		ASSERT_TRUE(prev >= 0 && curr >= 0);
+		const float prev_priority = task_ordered_priority(prev), priority = task_ordered_priority(curr);
+		EXPECT_TRUE(prev_priority > priority || (prev_priority == priority && prev < curr));
+	}
+
+	BLI_task_pool_free(pool);
+	BLI_task_scheduler_free(scheduler);
+}
+
+TEST(task, PoolOrdered)
+{
+	BLI_threadapi_init();
+	task_ordered_test(false);
+	task_ordered_test(true);
+	BLI_threadapi_exit();
+}
+
+static void task_range_func(void *userdata, const int iter)
+{
+	int *data = (int *)userdata;
+	data[iter] = iter;
+}
+
+TEST(task, ParallelRange)
+{
+	int *data = (int *)MEM_callocN(sizeof(*data) * NUM_TASKS, __func__);
+
+	BLI_system_num_threads_override_set(NUM_THREADS);
+	BLI_threadapi_init();
+
+	for (int i = 0; i < 10; i++) {
+		BLI_task_parallel_range(0, NUM_TASKS, data, task_range_func, true);
+	}
+
+	for (int i = 0; i < NUM_TASKS; i++) {
+		EXPECT_EQ(data[i], i);
+	}
+
+	BLI_threadapi_exit();
+	BLI_system_num_threads_override_set(0);
+	MEM_freeN(data);
+}
+
+#define NUM_ITEMS 1000000
+
+static void task_for_func(void *__restrict userdata, const int start, const int stop, const int UNUSED(thread_id))
+{
+	int *data = (int *)userdata;
+	for (int i = start; i < stop; i++) {
+		data[i]++;
+	}
+}
+
+TEST(task, ParallelFor)
+{
+	int *data = (int *)MEM_callocN(sizeof(*data) * NUM_ITEMS, __func__);
+
+	BLI_system_num_threads_override_set(NUM_THREADS);
+	BLI_threadapi_init();
+
+	BLI_task_parallel_for(0, NUM_ITEMS, data, task_for_func, 0);
+	BLI_task_parallel_for(NUM_ITEMS / 2, NUM_ITEMS, data, task_for_func, 1);
+	/* Too small to be threaded. */
+	BLI_task_parallel_for(0, 10, data, task_for_func, 0);
+
+	for (int i = 0; i < NUM_ITEMS; i++) {
+		EXPECT_EQ(data[i], 1 + (i >= NUM_ITEMS / 2) + (i < 10));
+	}
+
+	BLI_threadapi_exit();
+	BLI_system_num_threads_override_set(0);
+	MEM_freeN(data);
+}
+
+static void task_for_slice_func(TaskPool *__restrict pool, void *taskdata, int UNUSED(threadid))
+{
+	int *data = (int *)BLI_task_pool_userdata(pool);
+	const int slice = GET_INT_FROM_POINTER(taskdata);
+	const int slice_size = NUM_ITEMS / NUM_SUBTASKS;
+
+	BLI_task_parallel_for(slice * slice_size, (slice + 1) * slice_size, data, task_for_func, 0);
+}
+
+TEST(task, ParallelForFromOtherScheduler)
+{
+	int *data = (int *)MEM_callocN(sizeof(*data) * NUM_ITEMS, __func__);
+
+	BLI_system_num_threads_override_set(NUM_THREADS);
+	BLI_threadapi_init();
+
+	/* Workers of this scheduler are unknown to the global one used by the loops. */
+	TaskScheduler *scheduler = BLI_task_scheduler_create(NUM_THREADS);
+	TaskPool *pool = BLI_task_pool_create(scheduler, data);
+
+	for (int i = 0; i < NUM_SUBTASKS; i++) {
+		BLI_task_pool_push(pool, task_for_slice_func, SET_INT_IN_POINTER(i), false, TASK_PRIORITY_HIGH);
+	}
+	BLI_task_pool_work_and_wait(pool);
+
+	for (int i = 0; i < (NUM_ITEMS / NUM_SUBTASKS) * NUM_SUBTASKS; i++) {
+		EXPECT_EQ(data[i], 1);
+	}
+
+	BLI_task_pool_free(pool);
+	BLI_task_scheduler_free(scheduler);
+	BLI_threadapi_exit();
+	BLI_system_num_threads_override_set(0);
+	MEM_freeN(data);
+}
+
+typedef struct ReduceTestAccum {
+	int64_t sum;
+	int min, max;
+} ReduceTestAccum;
+
+static void task_reduce_func(void *__restrict userdata, void *__restrict accum, const int start, const int stop)
+{
+	const int *data = (const int *)userdata;
+	ReduceTestAccum *acc = (ReduceTestAccum *)accum;
+	for (int i = start; i < stop; i++) {
+		acc->sum += data[i];
+		acc->min = min_ii(acc->min, data[i]);
+		acc->max = max_ii(acc->max, data[i]);
+	}
+}
+
+static void task_reduce_join(void *__restrict UNUSED(userdata), void *__restrict accum, const void *__restrict accum_other)
+{
+	ReduceTestAccum *acc = (ReduceTestAccum *)accum;
+	const ReduceTestAccum *acc_other = (const ReduceTestAccum *)accum_other;
+	acc->sum += acc_other->sum;
+	acc->min = min_ii(acc->min, acc_other->min);
+	acc->max = max_ii(acc->max, acc_other->max);
+}
+
+TEST(task, ParallelReduce)
+{
+	int *data = (int *)MEM_mallocN(sizeof(*data) * NUM_ITEMS, __func__);
+	int64_t sum = 0;
+
+	for (int i = 0; i < NUM_ITEMS; i++) {
+		data[i] = (i * 37) % 1000 - 500;
+		sum += data[i];
+	}
+
+	BLI_system_num_threads_override_set(NUM_THREADS);
+	BLI_threadapi_init();
+
+	ReduceTestAccum accum = {0, INT_MAX, INT_MIN};
+	BLI_task_parallel_reduce(0, NUM_ITEMS, data, &accum, sizeof(accum), task_reduce_func, task_reduce_join, 0);
+
+	EXPECT_EQ(accum.sum, sum);
+	EXPECT_EQ(accum.min, -500);
+	EXPECT_EQ(accum.max, 499);
+
+	BLI_threadapi_exit();
+	BLI_system_num_threads_override_set(0);
+	MEM_freeN(data);
+}
+
+typedef struct ScanTestData {
+	const int *src;
+	int *dst;
+} ScanTestData;
+
+/* Exclusive prefix sum. */
+static void task_scan_func(
+        void *__restrict userdata, void *__restrict accum, const int start, const int stop, const bool is_final)
+{
+	ScanTestData *data = (ScanTestData *)userdata;
+	int *sum = (int *)accum;
+	for (int i = start; i < stop; i++) {
+		if (is_final) {
+			data->dst[i] = *sum;
+		}
+		*sum += data->src[i];
+	}
+}
+
+static void task_scan_join(void *__restrict UNUSED(userdata), void *__restrict accum, const void *__restrict accum_other)
+{
+	*(int *)accum += *(const int *)accum_other;
+}
+
+TEST(task, ParallelScan)
+{
+	int *src = (int *)MEM_mallocN(sizeof(*src) * NUM_ITEMS, __func__);
+	int *dst = (int *)MEM_mallocN(sizeof(*dst) * NUM_ITEMS, __func__);
+	ScanTestData data = {src, dst};
+
+	for (int i = 0; i < NUM_ITEMS; i++) {
+		src[i] = i % 3;
+	}
+
+	BLI_system_num_threads_override_set(NUM_THREADS);
+	BLI_threadapi_init();
+
+	int total = 0;
+	BLI_task_parallel_scan(0, NUM_ITEMS, &data, &total, sizeof(total), task_scan_func, task_scan_join, 0);
+
+	int sum = 0;
+	for (int i = 0; i < NUM_ITEMS; i++) {
+		EXPECT_EQ(dst[i], sum);
+		sum += src[i];
+	}
+	EXPECT_EQ(total, sum);
+
+	BLI_threadapi_exit();
+	BLI_system_num_threads_override_set(0);
+	MEM_freeN(src);
+	MEM_freeN(dst);
+}